@@ -21,14 +21,19 @@ LOCAL_SRC_FILES = \
 		  control/control-data-plane/control-data-plane.c    \
 		  control/control-data-plane/tun/cdp_tun.c           \
 		  data-plane/data-plane.c        \
+		  data-plane/etable.c            \
+		  data-plane/pending_pkts.c      \
+		  data-plane/ptable.c            \
 		  data-plane/ttable.c            \
 		  data-plane/encapsulations/vxlan-gpe.c              \
 		  data-plane/tun/tun.c           \
 		  data-plane/tun/tun_input.c     \
 		  data-plane/tun/tun_output.c    \
+		  data-plane/tun/tun_worker.c    \
 		  elibs/mbedtls/md.c             \
 		  elibs/mbedtls/sha1.c           \
 		  elibs/mbedtls/sha256.c         \
+		  elibs/mbedtls/sha_hw.c         \
 		  elibs/mbedtls/md_wrap.c        \
 		  elibs/patricia/patricia.c      \
 		  fwd_policies/balancing_locators.c                  \
@@ -37,6 +42,8 @@ LOCAL_SRC_FILES = \
           fwd_policies/fwd_utils.c	     \
 		  fwd_policies/flow_balancing/flow_balancing.c       \
 		  fwd_policies/flow_balancing/fwd_entry_tuple.c      \
+		  fwd_policies/maglev_balancing/maglev_balancing.c   \
+		  fwd_policies/rtt_balancing/rtt_balancing.c         \
 		  liblisp/liblisp.c              \
 		  liblisp/lisp_address.c         \
 		  liblisp/lisp_data.c            \
@@ -63,10 +70,12 @@ LOCAL_SRC_FILES = \
 		  lib/mem_util.c	    	     \
           lib/nonces_table.c             \
           lib/packets.c                  \
+		  lib/pkt_ring.c                 \
 		  lib/prefixes.c                 \
 		  lib/routing_tables_lib.c       \
 		  lib/sockets.c                  \
 		  lib/sockets-util.c             \
+		  lib/spsc_ring.c                \
 		  lib/shash.c                    \
 		  lib/timers.c                   \
           lib/timers_utils.c             \
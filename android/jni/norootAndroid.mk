@@ -21,6 +21,7 @@ LOCAL_SRC_FILES = \
 		  control/control-data-plane/control-data-plane.c    \
 		  control/control-data-plane/vpnapi/cdp_vpnapi.c     \
 		  data-plane/data-plane.c        \
+		  data-plane/etable.c            \
 		  data-plane/ttable.c            \
 		  data-plane/encapsulations/vxlan-gpe.c              \
 		  data-plane/vpnapi/vpnapi.c     \
@@ -29,6 +30,7 @@ LOCAL_SRC_FILES = \
 		  elibs/mbedtls/md.c             \
 		  elibs/mbedtls/sha1.c           \
 		  elibs/mbedtls/sha256.c         \
+		  elibs/mbedtls/sha_hw.c         \
 		  elibs/mbedtls/md_wrap.c        \
 		  elibs/patricia/patricia.c      \
 		  fwd_policies/balancing_locators.c                  \
@@ -37,6 +39,8 @@ LOCAL_SRC_FILES = \
           fwd_policies/fwd_utils.c	     \
 		  fwd_policies/flow_balancing/flow_balancing.c       \
 		  fwd_policies/flow_balancing/fwd_entry_tuple.c      \
+		  fwd_policies/maglev_balancing/maglev_balancing.c   \
+		  fwd_policies/rtt_balancing/rtt_balancing.c         \
 		  liblisp/liblisp.c              \
 		  liblisp/lisp_address.c         \
 		  liblisp/lisp_data.c            \
@@ -0,0 +1,83 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Globals and helpers shared by the benchmarks. The benchmarks are linked
+ * with the objects of oor except the ones containing main and the
+ * configuration parsers, so the globals defined there are provided here.
+ */
+
+#include <stdlib.h>
+#include <sys/socket.h>
+
+#include "bench_common.h"
+#include "../oor_external.h"
+#include "../lib/oor_log.h"
+
+
+char    *config_file                        = NULL;
+int      debug_level                        = 0;
+int      default_rloc_afi                   = AF_UNSPEC;
+int      daemonize                          = FALSE;
+
+int     netlink_fd                          = -1;
+
+sockmstr_t *smaster = NULL;
+oor_ctrl_dev_t *ctrl_dev;
+oor_ctrl_t *lctrl;
+
+htable_nonces_t *nonces_ht;
+htable_ptrs_t *ptrs_to_timers_ht;
+
+
+void
+exit_cleanup()
+{
+    exit(EXIT_SUCCESS);
+}
+
+uint64_t
+bench_now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+/* xorshift generator: reproducible input between runs */
+uint32_t
+bench_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return (x);
+}
+
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
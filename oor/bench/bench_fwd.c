@@ -0,0 +1,1042 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Benchmark of the forwarding path of the tun data plane.
+ *
+ * In the default mode (inproc) the packets of a synthetic or pcap traffic
+ * source are passed to tun_output as if they had been read from the tun
+ * device. The encapsulated packets are sent to loopback RLOCs, read back from
+ * a data raw socket with tun_read_and_decap_pkt and discarded. The
+ * forwarding information is obtained from a static map cache served by a
+ * minimal control device: no Map-Server nor Map-Resolver is involved. Raw
+ * sockets require CAP_NET_RAW.
+ *
+ * The send and sink modes generate and count the same synthetic traffic over
+ * UDP sockets. They are used by bench_fwd_netns.sh to measure the forwarding
+ * end to end between two xTRs running in network namespaces.
+ *
+ * Usage: bench_fwd -h
+ */
+
+#include <byteswap.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#include "bench_common.h"
+#include "../iface_list.h"
+#include "../oor_external.h"
+#include "../control/oor_control.h"
+#include "../control/oor_ctrl_device.h"
+#include "../control/oor_map_cache.h"
+#include "../data-plane/data-plane.h"
+#include "../data-plane/tun/tun.h"
+#include "../data-plane/tun/tun_input.h"
+#include "../data-plane/tun/tun_output.h"
+#include "../fwd_policies/fwd_policy.h"
+#include "../fwd_policies/flow_balancing/fwd_entry_tuple.h"
+#include "../lib/mem_util.h"
+#include "../lib/oor_log.h"
+#include "../lib/packets.h"
+#include "../lib/pkt_ring.h"
+#include "../lib/sockets.h"
+#include "../lib/sockets-util.h"
+#include "../lib/timers.h"
+#include "../liblisp/liblisp.h"
+
+#define BENCH_DEFAULT_PKTS      1000000
+#define BENCH_DEFAULT_FLOWS     1024
+#define BENCH_DEFAULT_PREFIXES  256
+#define BENCH_DEFAULT_SIZES     "64:7,576:4,1500:1"
+#define BENCH_DEFAULT_PORT      9000
+#define BENCH_MAX_SIZES         16
+/* Distinct packets generated for the synthetic traffic. They are replayed
+ * until the requested number of packets is reached */
+#define BENCH_MAX_TEMPLATES     (1 << 20)
+#define BENCH_MIN_TEMPLATES     65536
+#define BENCH_MAX_PKT_SIZE      (MAX_IP_PKT_LEN - LBUF_STACK_OFFSET - PKT_HDR_TMPL_MAX_LEN)
+/* Seconds without packets after which the sink reports its results */
+#define BENCH_SINK_IDLE         2
+
+/* Address space of the synthetic traffic. Destinations are spread over the
+ * prefixes of the static map cache. bench_fwd_netns.sh uses the same
+ * prefixes */
+#define BENCH_SRC_EID_V4        "10.1.0.1"
+#define BENCH_SRC_EID_V6        "fd00:1::1"
+
+typedef enum {
+    BENCH_INPROC,
+    BENCH_SEND,
+    BENCH_SINK
+} bench_mode_e;
+
+typedef struct bench_conf_ {
+    bench_mode_e mode;
+    long npkts;
+    int nflows;
+    int nprefixes;
+    int v6_pct;
+    int rloc_afi;
+    int port;
+    oor_encap_t encap;
+    int rx_ring_size;
+    char *pcap_file;
+    int nsizes;
+    int sizes[BENCH_MAX_SIZES];
+    int weights[BENCH_MAX_SIZES];
+    int total_weight;
+} bench_conf_t;
+
+/* Socket from which the encapsulated packets are read back */
+typedef struct bench_input_ {
+    int fd;
+    pkt_ring_t *ring;
+} bench_input_t;
+
+typedef struct bench_pkt_ {
+    uint8_t *data;
+    int len;
+} bench_pkt_t;
+
+typedef struct bench_traffic_ {
+    bench_pkt_t *pkts;
+    int npkts;
+    uint64_t bytes;
+} bench_traffic_t;
+
+/* Control device answering the flow misses from a static map cache */
+typedef struct bench_ctrl_dev_ {
+    oor_ctrl_dev_t super;
+    map_cache_db_t *mcache;
+    lisp_addr_t srloc;
+    lisp_addr_t src_eid_v4;
+    lisp_addr_t src_eid_v6;
+    oor_encap_t encap;
+} bench_ctrl_dev_t;
+
+static fwd_info_t *bench_get_fwd_entry(oor_ctrl_dev_t *dev, packet_tuple_t *tuple);
+
+static ctrl_dev_class_t bench_ctrl_class = {
+        .get_fwd_entry = bench_get_fwd_entry
+};
+
+/* Allocations done through the malloc family. The benchmark is linked with
+ * --wrap for these functions. Memory allocated inside libc is not counted */
+static uint64_t bench_allocs = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *s);
+
+void *
+__wrap_malloc(size_t size)
+{
+    bench_allocs++;
+    return (__real_malloc(size));
+}
+
+void *
+__wrap_calloc(size_t nmemb, size_t size)
+{
+    bench_allocs++;
+    return (__real_calloc(nmemb, size));
+}
+
+void *
+__wrap_realloc(void *ptr, size_t size)
+{
+    bench_allocs++;
+    return (__real_realloc(ptr, size));
+}
+
+char *
+__wrap_strdup(const char *s)
+{
+    bench_allocs++;
+    return (__real_strdup(s));
+}
+
+
+static void
+usage(char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -m MODE    inproc (default), send or sink\n"
+            "  -n PKTS    Packets to forward or send [%d]\n"
+            "  -f FLOWS   Flows of the synthetic traffic [%d]\n"
+            "  -s SIZES   IP sizes of the synthetic packets as size:weight,... [%s]\n"
+            "  -6 PCT     Percentage of IPv6 flows [0]\n"
+            "  -r FILE    Replay the IP packets of a pcap file (inproc only)\n"
+            "  -p NUM     Prefixes per AFI of the static map cache [1..256] [%d]\n"
+            "  -R AFI     AFI of the RLOCs: 4 or 6 [4]\n"
+            "  -e ENCAP   LISP or VXLAN-GPE [LISP]\n"
+            "  -b NUM     Packets processed per batch [%d]\n"
+            "  -t NUM     Max flows of the flow table [%d]\n"
+            "  -x NUM     Max entries of the prefix table, 0 disables it [%d]\n"
+            "  -k KB      Decapsulate from an AF_PACKET ring of KB instead of a raw socket\n"
+            "  -P PORT    UDP port used by the send and sink modes [%d]\n",
+            prog, BENCH_DEFAULT_PKTS, BENCH_DEFAULT_FLOWS, BENCH_DEFAULT_SIZES,
+            BENCH_DEFAULT_PREFIXES, DEFAULT_DATA_PKT_BATCH_SIZE,
+            DEFAULT_FLOW_TABLE_SIZE, DEFAULT_PREFIX_TABLE_SIZE, BENCH_DEFAULT_PORT);
+}
+
+static int
+parse_sizes(bench_conf_t *conf, char *str)
+{
+    char *tok, *saveptr = NULL, *sep;
+
+    conf->nsizes = 0;
+    conf->total_weight = 0;
+    for (tok = strtok_r(str, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)){
+        if (conf->nsizes == BENCH_MAX_SIZES){
+            return (BAD);
+        }
+        conf->sizes[conf->nsizes] = strtol(tok, &sep, 10);
+        conf->weights[conf->nsizes] = *sep == ':' ? strtol(sep + 1, NULL, 10) : 1;
+        if (conf->sizes[conf->nsizes] <= 0 || conf->sizes[conf->nsizes] > BENCH_MAX_PKT_SIZE
+                || conf->weights[conf->nsizes] <= 0){
+            return (BAD);
+        }
+        conf->total_weight += conf->weights[conf->nsizes];
+        conf->nsizes++;
+    }
+    return (conf->nsizes > 0 ? GOOD : BAD);
+}
+
+/************************** Traffic generation ******************************/
+
+static void
+traffic_add_pkt(bench_traffic_t *traffic, void *data, int len)
+{
+    bench_pkt_t *pkt = &traffic->pkts[traffic->npkts++];
+
+    pkt->data = xmalloc(len);
+    memcpy(pkt->data, data, len);
+    pkt->len = len;
+    traffic->bytes += len;
+}
+
+static void
+flow_addresses(bench_conf_t *conf, int flow, lisp_addr_t *src, lisp_addr_t *dst)
+{
+    uint8_t addr[16];
+    int pref = flow % conf->nprefixes;
+    int host = flow / conf->nprefixes;
+
+    memset(addr, 0, sizeof(addr));
+    if ((flow % 100) < conf->v6_pct){
+        /* fd00:1::<flow> -> fd00:2:0:<pref>::<host> */
+        addr[0] = 0xfd; addr[3] = 1;
+        addr[12] = (flow + 1) >> 24; addr[13] = (flow + 1) >> 16;
+        addr[14] = (flow + 1) >> 8; addr[15] = flow + 1;
+        lisp_addr_ip_init(src, addr, AF_INET6);
+        addr[3] = 2;
+        addr[7] = pref;
+        addr[12] = (host + 1) >> 24; addr[13] = (host + 1) >> 16;
+        addr[14] = (host + 1) >> 8; addr[15] = host + 1;
+        lisp_addr_ip_init(dst, addr, AF_INET6);
+    }else{
+        /* 10.1.x.y -> 10.2.<pref>.<host> */
+        addr[0] = 10; addr[1] = 1;
+        addr[2] = flow >> 8; addr[3] = flow;
+        lisp_addr_ip_init(src, addr, AF_INET);
+        addr[1] = 2;
+        addr[2] = pref;
+        addr[3] = 1 + host % 254;
+        lisp_addr_ip_init(dst, addr, AF_INET);
+    }
+}
+
+static int
+pick_size(bench_conf_t *conf, uint32_t *seed)
+{
+    int i, w = bench_rand(seed) % conf->total_weight;
+
+    for (i = 0; i < conf->nsizes - 1; i++){
+        if (w < conf->weights[i]){
+            break;
+        }
+        w -= conf->weights[i];
+    }
+    return (conf->sizes[i]);
+}
+
+static int
+traffic_synthetic(bench_conf_t *conf, bench_traffic_t *traffic)
+{
+    uint8_t buf[MAX_IP_PKT_LEN];
+    lisp_addr_t src, dst;
+    lbuf_t b;
+    uint32_t seed = 2013;
+    int i, flow, size, hdrs, ntmpl;
+
+    ntmpl = conf->npkts < BENCH_MIN_TEMPLATES ? conf->npkts : BENCH_MIN_TEMPLATES;
+    if (ntmpl < conf->nflows){
+        ntmpl = conf->nflows < BENCH_MAX_TEMPLATES ? conf->nflows : BENCH_MAX_TEMPLATES;
+    }
+    traffic->pkts = xzalloc(ntmpl * sizeof(bench_pkt_t));
+    lisp_addr_set_lafi(&src, LM_AFI_IP);
+    lisp_addr_set_lafi(&dst, LM_AFI_IP);
+
+    for (i = 0; i < ntmpl; i++){
+        /* Each flow is seen at least once */
+        flow = i < conf->nflows ? i : bench_rand(&seed) % conf->nflows;
+        flow_addresses(conf, flow, &src, &dst);
+        hdrs = (lisp_addr_ip_afi(&dst) == AF_INET ? sizeof(struct ip) : sizeof(struct ip6_hdr))
+                + sizeof(struct udphdr);
+        size = pick_size(conf, &seed);
+        if (size < hdrs){
+            size = hdrs;
+        }
+
+        lbuf_use_stack(&b, buf, sizeof(buf));
+        lbuf_reserve(&b, hdrs);
+        memset(lbuf_put_uninit(&b, size - hdrs), 0xa5, size - hdrs);
+        pkt_push_udp_and_ip(&b, 1024 + flow % 64000, conf->port,
+                lisp_addr_ip(&src), lisp_addr_ip(&dst));
+        traffic_add_pkt(traffic, lbuf_data(&b), lbuf_size(&b));
+    }
+    return (GOOD);
+}
+
+/* Classic pcap file. Only the IP packets are kept */
+#define PCAP_MAGIC          0xa1b2c3d4
+#define PCAP_MAGIC_NSEC     0xa1b23c4d
+#define PCAP_LINK_ETH       1
+#define PCAP_LINK_RAW       101
+#define PCAP_LINK_RAW_BSD   12
+#define PCAP_LINK_SLL       113
+#define PCAP_LINK_IPV4      228
+#define PCAP_LINK_IPV6      229
+
+typedef struct pcap_file_hdr_ {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t  thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+} pcap_file_hdr_t;
+
+typedef struct pcap_rec_hdr_ {
+    uint32_t ts_sec;
+    uint32_t ts_frac;
+    uint32_t caplen;
+    uint32_t len;
+} pcap_rec_hdr_t;
+
+/* Returns the offset of the IP header in a frame or -1 if it is not IP */
+static int
+pcap_ip_offset(uint32_t linktype, uint8_t *frame, int len)
+{
+    int off;
+    uint16_t type;
+
+    switch (linktype){
+    case PCAP_LINK_RAW:
+    case PCAP_LINK_RAW_BSD:
+    case PCAP_LINK_IPV4:
+    case PCAP_LINK_IPV6:
+        return (0);
+    case PCAP_LINK_SLL:
+        return (len > 16 ? 16 : -1);
+    case PCAP_LINK_ETH:
+        off = 12;
+        while (off + 2 <= len){
+            type = (frame[off] << 8) | frame[off + 1];
+            if (type == 0x8100 || type == 0x88a8){
+                off += 4;
+                continue;
+            }
+            return ((type == 0x0800 || type == 0x86dd) ? off + 2 : -1);
+        }
+        return (-1);
+    default:
+        return (-1);
+    }
+}
+
+static int
+traffic_pcap(bench_conf_t *conf, bench_traffic_t *traffic)
+{
+    FILE *f;
+    pcap_file_hdr_t fh;
+    pcap_rec_hdr_t rh;
+    uint8_t *frame;
+    uint8_t swapped;
+    int off, size, alloc = 1024;
+
+    f = fopen(conf->pcap_file, "r");
+    if (!f){
+        fprintf(stderr, "Couldn't open %s: %s\n", conf->pcap_file, strerror(errno));
+        return (BAD);
+    }
+    if (fread(&fh, sizeof(fh), 1, f) != 1){
+        fclose(f);
+        return (BAD);
+    }
+    swapped = (fh.magic == bswap_32(PCAP_MAGIC) || fh.magic == bswap_32(PCAP_MAGIC_NSEC));
+    if (swapped){
+        fh.snaplen = bswap_32(fh.snaplen);
+        fh.linktype = bswap_32(fh.linktype);
+    }else if (fh.magic != PCAP_MAGIC && fh.magic != PCAP_MAGIC_NSEC){
+        fprintf(stderr, "%s is not a pcap file\n", conf->pcap_file);
+        fclose(f);
+        return (BAD);
+    }
+
+    frame = xmalloc(fh.snaplen > 65535 ? fh.snaplen : 65535);
+    traffic->pkts = xmalloc(alloc * sizeof(bench_pkt_t));
+    while (traffic->npkts < BENCH_MAX_TEMPLATES && fread(&rh, sizeof(rh), 1, f) == 1){
+        if (swapped){
+            rh.caplen = bswap_32(rh.caplen);
+        }
+        if (rh.caplen > fh.snaplen && rh.caplen > 65535){
+            break;
+        }
+        if (fread(frame, rh.caplen, 1, f) != 1){
+            break;
+        }
+        off = pcap_ip_offset(fh.linktype, frame, rh.caplen);
+        size = rh.caplen - off;
+        if (off < 0 || size < (int)sizeof(struct ip) || size > BENCH_MAX_PKT_SIZE){
+            continue;
+        }
+        if ((frame[off] >> 4) != 4 && (frame[off] >> 4) != 6){
+            continue;
+        }
+        if (traffic->npkts == alloc){
+            alloc *= 2;
+            traffic->pkts = xrealloc(traffic->pkts, alloc * sizeof(bench_pkt_t));
+        }
+        traffic_add_pkt(traffic, frame + off, size);
+    }
+    free(frame);
+    fclose(f);
+
+    if (traffic->npkts == 0){
+        fprintf(stderr, "No IP packets found in %s\n", conf->pcap_file);
+        return (BAD);
+    }
+    return (GOOD);
+}
+
+/**************************** Static map cache ******************************/
+
+static lisp_addr_t *
+bench_mapping_rloc(mapping_t *map)
+{
+    locator_t *loct;
+
+    mapping_foreach_active_locator(map, loct){
+        return (locator_addr(loct));
+    }mapping_foreach_active_locator_end;
+    return (NULL);
+}
+
+static fwd_info_t *
+bench_get_fwd_entry(oor_ctrl_dev_t *dev, packet_tuple_t *tuple)
+{
+    bench_ctrl_dev_t *bdev = CONTAINER_OF(dev, bench_ctrl_dev_t, super);
+    fwd_info_t *fi;
+    mcache_entry_t *mce;
+    lisp_addr_t *drloc = NULL;
+
+    mce = mcache_lookup(bdev->mcache, &tuple->dst_addr);
+    if (!mce){
+        return (NULL);
+    }
+    fi = fwd_info_new();
+    fi->associated_entry = lisp_addr_clone(mcache_entry_eid(mce));
+    fi->neg_map_reply_act = ACT_DROP;
+    fi->encap = bdev->encap;
+    tuple->iid = 0;
+    drloc = bench_mapping_rloc(mcache_entry_mapping(mce));
+    fi->dp_conf_inf = fwd_entry_tuple_new_init(tuple, drloc ? &bdev->srloc : NULL,
+            drloc, LISP_DATA_PORT, LISP_DATA_PORT, 0, NULL);
+    fi->data_del_fn = (fwd_info_data_del_fn)fwd_entry_tuple_del;
+
+    /* The static map cache has no overlapping prefixes apart from the
+     * default routes, so every answer can be reused by the prefix table */
+    if (drloc && dplane_conf.prefix_table_size > 0){
+        fi->pref_info = fwd_pref_info_new(lisp_addr_ip_afi(&tuple->dst_addr) == AF_INET ?
+                &bdev->src_eid_v4 : &bdev->src_eid_v6, mcache_entry_eid(mce));
+        if (fi->pref_info){
+            fi->pref_info->encap = bdev->encap;
+            fi->pref_info->src_rlocs = lisp_addr_clone(&bdev->srloc);
+            fi->pref_info->src_rlocs_len = 1;
+            if (lisp_addr_ip_afi(drloc) == AF_INET){
+                fi->pref_info->dst_rlocs_v4 = lisp_addr_clone(drloc);
+                fi->pref_info->dst_rlocs_v4_len = 1;
+            }else{
+                fi->pref_info->dst_rlocs_v6 = lisp_addr_clone(drloc);
+                fi->pref_info->dst_rlocs_v6_len = 1;
+            }
+        }
+    }
+    return (fi);
+}
+
+static void
+mcache_add_static(map_cache_db_t *mcache, char *prefix, lisp_addr_t *rloc)
+{
+    lisp_addr_t eid;
+    mapping_t *map;
+    mcache_entry_t *mce;
+
+    lisp_addr_ippref_from_char(prefix, &eid);
+    map = mapping_new_init(&eid);
+    mapping_add_locator(map, locator_new_init(rloc, UP, 1, 1, 1, 100, 255, 0));
+    mce = mcache_entry_new();
+    mcache_entry_init_static(mce, map);
+    mcache_add_entry(mcache, mapping_eid(map), mce);
+}
+
+static bench_ctrl_dev_t *
+bench_ctrl_dev_new(bench_conf_t *conf)
+{
+    bench_ctrl_dev_t *dev;
+    lisp_addr_t drloc;
+    char prefix[64];
+    int i;
+
+    dev = xzalloc(sizeof(bench_ctrl_dev_t));
+    dev->super.mode = xTR_MODE;
+    dev->super.ctrl_class = &bench_ctrl_class;
+    dev->encap = conf->encap;
+    dev->mcache = mcache_new();
+    lisp_addr_ippref_from_char("0.0.0.0/0", &dev->src_eid_v4);
+    lisp_addr_ippref_from_char("::/0", &dev->src_eid_v6);
+
+    if (conf->rloc_afi == AF_INET){
+        lisp_addr_ip_from_char("127.0.0.1", &dev->srloc);
+        lisp_addr_ip_from_char("127.0.0.2", &drloc);
+    }else{
+        lisp_addr_ip_from_char("::1", &dev->srloc);
+        lisp_addr_ip_from_char("::1", &drloc);
+    }
+
+    for (i = 0; i < conf->nprefixes; i++){
+        sprintf(prefix, "10.2.%d.0/24", i);
+        mcache_add_static(dev->mcache, prefix, &drloc);
+        sprintf(prefix, "fd00:2:0:%x::/64", i);
+        mcache_add_static(dev->mcache, prefix, &drloc);
+    }
+    /* Traffic of pcap files is not limited to the previous prefixes */
+    mcache_add_static(dev->mcache, "0.0.0.0/0", &drloc);
+    mcache_add_static(dev->mcache, "::/0", &drloc);
+
+    return (dev);
+}
+
+/***************************** In process mode ******************************/
+
+static int
+inproc_setup(bench_conf_t *conf, bench_input_t *in)
+{
+    bench_ctrl_dev_t *dev;
+    tun_dplane_data_t *data;
+    iface_t *iface;
+    int afi = conf->rloc_afi;
+    int port;
+
+    smaster = sockmstr_create();
+    oor_timers_init();
+
+    /* Loopback interface owning the source RLOC */
+    interface_list = glist_new();
+    iface = xzalloc(sizeof(iface_t));
+    iface->iface_name = strdup("lo");
+    iface->status = UP;
+    iface->out_socket_v4 = ERR_SOCKET;
+    iface->out_socket_v6 = ERR_SOCKET;
+    glist_add(iface, interface_list);
+
+    lctrl = ctrl_create();
+    dev = bench_ctrl_dev_new(conf);
+    ctrl_dev_set_ctrl(&dev->super, lctrl);
+    ctrl_dev = &dev->super;
+
+    if (afi == AF_INET){
+        iface->ipv4_address = lisp_addr_clone(&dev->srloc);
+        iface->out_socket_v4 = open_ip_raw_socket(AF_INET);
+    }else{
+        iface->ipv6_address = lisp_addr_clone(&dev->srloc);
+        iface->out_socket_v6 = open_ip_raw_socket(AF_INET6);
+    }
+    port = conf->encap == ENCP_LISP ? LISP_DATA_PORT : VXLAN_GPE_DATA_PORT;
+    if (conf->rx_ring_size > 0){
+        in->ring = pkt_ring_new(afi, port, conf->rx_ring_size * 1024);
+        in->fd = in->ring ? pkt_ring_fd(in->ring) : ERR_SOCKET;
+    }else{
+        in->ring = NULL;
+        in->fd = open_data_raw_input_socket(afi, port);
+    }
+    if (*iface_socket_pointer(iface, afi) == ERR_SOCKET || in->fd == ERR_SOCKET){
+        fprintf(stderr, "Couldn't open the raw sockets. CAP_NET_RAW is required\n");
+        return (BAD);
+    }
+    fcntl(in->fd, F_SETFL, fcntl(in->fd, F_GETFL, 0) | O_NONBLOCK);
+
+    data = tun_dplane_data_new_init(conf->encap, 0);
+    dplane_tun.datap_data = data;
+    data_plane = &dplane_tun;
+    /* Decapsulated packets are not written to any tun device */
+    tun_shard_init(&data->shards[0], ERR_SOCKET, NULL);
+
+    return (GOOD);
+}
+
+/* Decapsulate the packets available in the ring. They are processed in
+ * place */
+static long
+inproc_drain_ring(pkt_ring_t *ring)
+{
+    lbuf_t bufs[MAX_DATA_PKT_BATCH_SIZE];
+    data_pkt_inf_t inf[MAX_DATA_PKT_BATCH_SIZE];
+    uint32_t iid;
+    long ndecap = 0;
+    int i, n;
+
+    do {
+        n = pkt_ring_recv_batch(ring, bufs, inf, dplane_conf.pkt_batch_size);
+        for (i = 0; i < n; i++){
+            if (tun_decap_pkt(&bufs[i], inf[i].afi, inf[i].ttl, inf[i].tos, &iid) == GOOD){
+                ndecap++;
+            }
+        }
+        pkt_ring_release(ring);
+    } while (n > 0);
+
+    return (ndecap);
+}
+
+/* Read and decapsulate the packets queued in the data socket or ring */
+static long
+inproc_drain(bench_input_t *in, uint64_t *ns, uint64_t *allocs)
+{
+    uint8_t buf[MAX_IP_PKT_LEN];
+    lbuf_t b;
+    uint32_t iid;
+    uint64_t start, allocs_start;
+    long ndecap = 0;
+    int pending = 0;
+
+    start = bench_now_ns();
+    allocs_start = bench_allocs;
+    if (in->ring){
+        ndecap = inproc_drain_ring(in->ring);
+    }
+    while (!in->ring && ioctl(in->fd, FIONREAD, &pending) == 0 && pending > 0){
+        lbuf_use_stack(&b, buf, sizeof(buf));
+        if (tun_read_and_decap_pkt(in->fd, &b, &iid) == GOOD){
+            ndecap++;
+        }
+    }
+    *allocs += bench_allocs - allocs_start;
+    *ns += bench_now_ns() - start;
+    return (ndecap);
+}
+
+static void
+report(const char *name, long npkts, uint64_t ns, uint64_t allocs)
+{
+    printf("  %-24s %10ld pkts %10.3f Mpps %9.1f ns/pkt %6.2f allocs/pkt\n", name,
+            npkts, ns ? (double)npkts * 1000.0 / (double)ns : 0.0,
+            npkts ? (double)ns / (double)npkts : 0.0,
+            npkts ? (double)allocs / (double)npkts : 0.0);
+}
+
+static int
+bench_inproc(bench_conf_t *conf, bench_traffic_t *traffic)
+{
+    tun_dplane_shard_t *shard;
+    packet_tuple_t tuple;
+    bench_pkt_t *pkt;
+    ttable_stats_t *st;
+    ptable_stats_t *pst;
+    uint64_t start, out_ns = 0, send_ns = 0, in_ns = 0;
+    uint64_t out_allocs = 0, send_allocs = 0, in_allocs = 0, allocs_start;
+    bench_input_t in;
+    struct pollfd pfd;
+    long done = 0, ndecap = 0;
+    int i, n;
+
+    if (inproc_setup(conf, &in) != GOOD){
+        return (BAD);
+    }
+    shard = tun_get_shard();
+
+    while (done < conf->npkts){
+        n = conf->npkts - done < shard->pkt_batch_size ? conf->npkts - done : shard->pkt_batch_size;
+
+        /* Same state of the batch as after reading it from the tun */
+        tun_pkt_batch_reset(shard, LBUF_STACK_OFFSET);
+        for (i = 0; i < n; i++){
+            pkt = &traffic->pkts[(done + i) % traffic->npkts];
+            lbuf_put(&shard->pkts[i], pkt->data, pkt->len);
+            lbuf_reset_ip(&shard->pkts[i]);
+        }
+
+        start = bench_now_ns();
+        allocs_start = bench_allocs;
+        for (i = 0; i < n; i++){
+            if (pkt_parse_5_tuple(&shard->pkts[i], &tuple) != GOOD){
+                continue;
+            }
+            tun_output(&shard->pkts[i], &tuple);
+        }
+        out_allocs += bench_allocs - allocs_start;
+        out_ns += bench_now_ns() - start;
+
+        start = bench_now_ns();
+        allocs_start = bench_allocs;
+        tun_output_flush();
+        send_allocs += bench_allocs - allocs_start;
+        send_ns += bench_now_ns() - start;
+
+        ndecap += inproc_drain(&in, &in_ns, &in_allocs);
+        done += n;
+    }
+    /* The blocks of a ring are handed over when they are full or after a
+     * timeout */
+    pfd.fd = in.fd;
+    pfd.events = POLLIN;
+    while (ndecap < done && poll(&pfd, 1, 100) > 0){
+        ndecap += inproc_drain(&in, &in_ns, &in_allocs);
+    }
+
+    st = &shard->ttable.stats;
+    printf("In process forwarding, %s RLOCs, %s, batch %d\n",
+            conf->rloc_afi == AF_INET ? "IPv4" : "IPv6",
+            conf->encap == ENCP_LISP ? "LISP" : "VXLAN-GPE", shard->pkt_batch_size);
+    report("tun_output", done, out_ns, out_allocs);
+    report("tun_output + send", done, out_ns + send_ns, out_allocs + send_allocs);
+    report(in.ring ? "ring + tun_decap_pkt" : "tun_read_and_decap_pkt", ndecap, in_ns,
+            in_allocs);
+    printf("  flow table: %u flows, %"PRIu64" hits, %"PRIu64" misses, %.2f%% hit ratio, "
+            "%"PRIu64" evictions\n", ttable_size(&shard->ttable), st->hits, st->misses,
+            st->hits + st->misses ? 100.0 * st->hits / (st->hits + st->misses) : 0.0,
+            st->evictions);
+    pst = &shard->ptable.stats;
+    printf("  prefix table: %u entries, %"PRIu64" hits, %"PRIu64" misses\n",
+            ptable_size(&shard->ptable), pst->hits, pst->misses);
+    printf("  decapsulated %ld of %ld packets\n", ndecap, done);
+
+    return (GOOD);
+}
+
+/************************** Send and sink modes *****************************/
+
+/* Destination address and UDP payload of a synthetic packet */
+static int
+pkt_udp_payload(bench_pkt_t *pkt, struct sockaddr_storage *dst, socklen_t *dst_len,
+        uint8_t **payload)
+{
+    struct sockaddr_in *sin = (struct sockaddr_in *)dst;
+    struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)dst;
+    struct ip *iph = (struct ip *)pkt->data;
+    struct ip6_hdr *ip6h = (struct ip6_hdr *)pkt->data;
+    struct udphdr *udph;
+
+    memset(dst, 0, sizeof(struct sockaddr_storage));
+    if (iph->ip_v == IPVERSION){
+        sin->sin_family = AF_INET;
+        sin->sin_addr = iph->ip_dst;
+        udph = (struct udphdr *)(iph + 1);
+        sin->sin_port = udph->dest;
+        *dst_len = sizeof(struct sockaddr_in);
+    }else{
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_addr = ip6h->ip6_dst;
+        udph = (struct udphdr *)(ip6h + 1);
+        sin6->sin6_port = udph->dest;
+        *dst_len = sizeof(struct sockaddr_in6);
+    }
+    *payload = (uint8_t *)(udph + 1);
+    return (pkt->len - (*payload - pkt->data));
+}
+
+static int
+bench_send(bench_conf_t *conf, bench_traffic_t *traffic)
+{
+    struct mmsghdr *msgs;
+    struct iovec *iovs;
+    struct sockaddr_storage *dsts;
+    lisp_addr_t src;
+    bench_pkt_t *pkt;
+    uint64_t start, ns;
+    long done = 0, sent = 0;
+    int fds[2], batch = dplane_conf.pkt_batch_size;
+    int i, n, fd, ret;
+
+    fds[0] = open_udp_datagram_socket(AF_INET);
+    fds[1] = open_udp_datagram_socket(AF_INET6);
+    if (fds[0] == ERR_SOCKET || fds[1] == ERR_SOCKET){
+        fprintf(stderr, "Couldn't open the UDP sockets\n");
+        return (BAD);
+    }
+    /* Use the source EIDs of the synthetic traffic when they are local */
+    lisp_addr_ip_from_char(BENCH_SRC_EID_V4, &src);
+    bind_socket(fds[0], AF_INET, &src, 0);
+    lisp_addr_ip_from_char(BENCH_SRC_EID_V6, &src);
+    bind_socket(fds[1], AF_INET6, &src, 0);
+
+    msgs = xzalloc(batch * sizeof(struct mmsghdr));
+    iovs = xzalloc(batch * sizeof(struct iovec));
+    dsts = xzalloc(batch * sizeof(struct sockaddr_storage));
+
+    start = bench_now_ns();
+    while (done < conf->npkts){
+        /* A batch is sent through a single socket, so it ends when the
+         * AFI of the destination changes */
+        n = 0;
+        fd = -1;
+        while (n < batch && done + n < conf->npkts){
+            pkt = &traffic->pkts[(done + n) % traffic->npkts];
+            if (fd != -1 && fd != fds[(pkt->data[0] >> 4) == 6]){
+                break;
+            }
+            fd = fds[(pkt->data[0] >> 4) == 6];
+            iovs[n].iov_len = pkt_udp_payload(pkt, &dsts[n], &msgs[n].msg_hdr.msg_namelen,
+                    (uint8_t **)&iovs[n].iov_base);
+            msgs[n].msg_hdr.msg_name = &dsts[n];
+            msgs[n].msg_hdr.msg_iov = &iovs[n];
+            msgs[n].msg_hdr.msg_iovlen = 1;
+            n++;
+        }
+        for (i = 0; i < n; i += ret){
+            ret = sendmmsg(fd, &msgs[i], n - i, 0);
+            if (ret <= 0){
+                if (errno != EAGAIN && errno != ENOBUFS && errno != EINTR){
+                    /* Skip the packet that can not be sent */
+                    ret = 1;
+                    continue;
+                }
+                ret = 0;
+                continue;
+            }
+            sent += ret;
+        }
+        done += n;
+    }
+    ns = bench_now_ns() - start;
+
+    printf("Sent %ld of %ld packets\n", sent, done);
+    report("sendmmsg", sent, ns, 0);
+
+    free(msgs);
+    free(iovs);
+    free(dsts);
+    close(fds[0]);
+    close(fds[1]);
+    return (GOOD);
+}
+
+static int
+bench_sink(bench_conf_t *conf)
+{
+    struct pollfd pfds[2];
+    struct mmsghdr *msgs;
+    struct iovec *iovs;
+    uint8_t *bufs;
+    uint64_t first = 0, last = 0;
+    long received = 0;
+    int batch = dplane_conf.pkt_batch_size;
+    int i, ret;
+
+    pfds[0].fd = open_udp_datagram_socket(AF_INET);
+    pfds[1].fd = open_udp_datagram_socket(AF_INET6);
+    if (pfds[0].fd == ERR_SOCKET || pfds[1].fd == ERR_SOCKET
+            || bind_socket(pfds[0].fd, AF_INET, NULL, conf->port) != GOOD
+            || bind_socket(pfds[1].fd, AF_INET6, NULL, conf->port) != GOOD){
+        fprintf(stderr, "Couldn't bind the UDP sockets to port %d\n", conf->port);
+        return (BAD);
+    }
+    pfds[0].events = pfds[1].events = POLLIN;
+
+    msgs = xzalloc(batch * sizeof(struct mmsghdr));
+    iovs = xzalloc(batch * sizeof(struct iovec));
+    bufs = xmalloc(batch * MAX_IP_PKT_LEN);
+    for (i = 0; i < batch; i++){
+        iovs[i].iov_base = bufs + i * MAX_IP_PKT_LEN;
+        iovs[i].iov_len = MAX_IP_PKT_LEN;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    printf("Waiting for packets on port %d\n", conf->port);
+    fflush(stdout);
+    while (received < conf->npkts){
+        ret = poll(pfds, 2, BENCH_SINK_IDLE * 1000);
+        if (ret == 0 && received > 0){
+            break;
+        }
+        for (i = 0; i < 2; i++){
+            if (!(pfds[i].revents & POLLIN)){
+                continue;
+            }
+            ret = recvmmsg(pfds[i].fd, msgs, batch, MSG_DONTWAIT, NULL);
+            if (ret > 0){
+                if (received == 0){
+                    first = bench_now_ns();
+                }
+                received += ret;
+                last = bench_now_ns();
+            }
+        }
+    }
+
+    printf("Received %ld packets\n", received);
+    report("recvmmsg", received, last - first, 0);
+
+    free(msgs);
+    free(iovs);
+    free(bufs);
+    close(pfds[0].fd);
+    close(pfds[1].fd);
+    return (GOOD);
+}
+
+int
+main(int argc, char **argv)
+{
+    bench_conf_t conf;
+    bench_traffic_t traffic;
+    char sizes[] = BENCH_DEFAULT_SIZES;
+    char *size_str = sizes;
+    int opt, res;
+
+    memset(&conf, 0, sizeof(conf));
+    memset(&traffic, 0, sizeof(traffic));
+    conf.mode = BENCH_INPROC;
+    conf.npkts = BENCH_DEFAULT_PKTS;
+    conf.nflows = BENCH_DEFAULT_FLOWS;
+    conf.nprefixes = BENCH_DEFAULT_PREFIXES;
+    conf.rloc_afi = AF_INET;
+    conf.port = BENCH_DEFAULT_PORT;
+    conf.encap = ENCP_LISP;
+
+    while ((opt = getopt(argc, argv, "m:n:f:s:6:r:p:R:e:b:t:x:k:P:h")) != -1){
+        switch (opt){
+        case 'm':
+            if (strcmp(optarg, "inproc") == 0){
+                conf.mode = BENCH_INPROC;
+            }else if (strcmp(optarg, "send") == 0){
+                conf.mode = BENCH_SEND;
+            }else if (strcmp(optarg, "sink") == 0){
+                conf.mode = BENCH_SINK;
+            }else{
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'n':
+            conf.npkts = strtol(optarg, NULL, 10);
+            break;
+        case 'f':
+            conf.nflows = strtol(optarg, NULL, 10);
+            break;
+        case 's':
+            size_str = optarg;
+            break;
+        case '6':
+            conf.v6_pct = strtol(optarg, NULL, 10);
+            break;
+        case 'r':
+            conf.pcap_file = optarg;
+            break;
+        case 'p':
+            conf.nprefixes = strtol(optarg, NULL, 10);
+            break;
+        case 'R':
+            conf.rloc_afi = strcmp(optarg, "6") == 0 ? AF_INET6 : AF_INET;
+            break;
+        case 'e':
+            conf.encap = strcasecmp(optarg, "vxlan-gpe") == 0 ? ENCP_VXLAN_GPE : ENCP_LISP;
+            break;
+        case 'b':
+            dplane_conf.pkt_batch_size = strtol(optarg, NULL, 10);
+            break;
+        case 't':
+            dplane_conf.flow_table_size = strtol(optarg, NULL, 10);
+            break;
+        case 'x':
+            dplane_conf.prefix_table_size = strtol(optarg, NULL, 10);
+            break;
+        case 'k':
+            conf.rx_ring_size = strtol(optarg, NULL, 10);
+            break;
+        case 'P':
+            conf.port = strtol(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            exit(opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+
+    if (conf.npkts <= 0 || conf.nflows <= 0 || conf.v6_pct < 0 || conf.v6_pct > 100
+            || conf.nprefixes <= 0 || conf.nprefixes > 256
+            || dplane_conf.pkt_batch_size <= 0 || dplane_conf.pkt_batch_size > MAX_DATA_PKT_BATCH_SIZE
+            || parse_sizes(&conf, size_str) != GOOD){
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (conf.mode == BENCH_SINK){
+        exit(bench_sink(&conf) == GOOD ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (conf.pcap_file && conf.mode == BENCH_INPROC){
+        res = traffic_pcap(&conf, &traffic);
+    }else{
+        res = traffic_synthetic(&conf, &traffic);
+    }
+    if (res != GOOD){
+        exit(EXIT_FAILURE);
+    }
+    printf("Traffic: %d distinct packets, %.1f bytes/pkt\n", traffic.npkts,
+            (double)traffic.bytes / traffic.npkts);
+
+    if (conf.mode == BENCH_SEND){
+        res = bench_send(&conf, &traffic);
+    }else{
+        res = bench_inproc(&conf, &traffic);
+    }
+
+    exit(res == GOOD ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
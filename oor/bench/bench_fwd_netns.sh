@@ -0,0 +1,158 @@
+#!/bin/sh
+#
+# Copyright (C) 2011, 2015 Cisco Systems, Inc.
+# Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at:
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+#
+
+#
+# End to end forwarding benchmark between two xTRs running in their own
+# network namespaces and connected with a veth pair:
+#
+#   bench_fwd -m send -> lispTun [oor A] veth ==== veth [oor B] lispTun -> bench_fwd -m sink
+#      10.1.0.0/16                 172.31.255.1  172.31.255.2                10.2.0.0/16
+#      fd00:1::/48                                                           fd00:2::/48
+#
+# The mappings of the peer site are configured as static map cache entries.
+# Requires root. Usage:
+#
+#   bench_fwd_netns.sh [bench_fwd send options]
+#
+# The OOR and BENCH environment variables select the binaries to use
+# (./oor and ./bench/bench_fwd by default).
+#
+
+OOR=${OOR:-./oor}
+BENCH=${BENCH:-./bench/bench_fwd}
+NS_A=oor-bench-a
+NS_B=oor-bench-b
+RLOC_A=172.31.255.1
+RLOC_B=172.31.255.2
+PORT=9000
+TMP=${TMP_DIR:-$(mktemp -d)}
+
+cleanup()
+{
+    for ns in $NS_A $NS_B; do
+        ip netns pids $ns 2>/dev/null | xargs -r kill
+    done
+    sleep 1
+    ip netns del $NS_A 2>/dev/null
+    ip netns del $NS_B 2>/dev/null
+    [ -z "$TMP_DIR" ] && rm -rf $TMP
+}
+
+# oor_conf <local eid v4> <local eid v6> <peer eid v4> <peer eid v6> <peer rloc>
+oor_conf()
+{
+    cat <<END_CONF
+debug                  = 0
+map-request-retries    = 2
+operating-mode         = xTR
+encapsulation          = LISP
+
+rloc-probing {
+    rloc-probe-interval             = 0
+    rloc-probe-retries              = 0
+    rloc-probe-retries-interval     = 5
+}
+
+map-resolver        = {
+        $5
+}
+
+database-mapping {
+    eid-prefix          = $1
+    iid                 = 0
+    rloc-iface{
+        interface       = veth0
+        ip_version      = 4
+        priority        = 1
+        weight          = 100
+    }
+}
+
+database-mapping {
+    eid-prefix          = $2
+    iid                 = 0
+    rloc-iface{
+        interface       = veth0
+        ip_version      = 4
+        priority        = 1
+        weight          = 100
+    }
+}
+
+static-map-cache {
+    eid-prefix          = $3
+    iid                 = 0
+    rloc-address {
+        address         = $5
+        priority        = 1
+        weight          = 100
+    }
+}
+
+static-map-cache {
+    eid-prefix          = $4
+    iid                 = 0
+    rloc-address {
+        address         = $5
+        priority        = 1
+        weight          = 100
+    }
+}
+END_CONF
+}
+
+if [ "$(id -u)" != "0" ]; then
+    echo "$0 must be run as root"
+    exit 1
+fi
+
+trap cleanup EXIT INT TERM
+
+ip netns add $NS_A || exit 1
+ip netns add $NS_B || exit 1
+ip link add veth0 netns $NS_A type veth peer name veth0 netns $NS_B || exit 1
+ip -n $NS_A addr add $RLOC_A/30 dev veth0
+ip -n $NS_B addr add $RLOC_B/30 dev veth0
+for ns in $NS_A $NS_B; do
+    ip -n $ns link set lo up
+    ip -n $ns link set veth0 up
+    ip netns exec $ns sysctl -qw net.ipv4.conf.all.rp_filter=0
+    ip netns exec $ns sysctl -qw net.ipv4.conf.default.rp_filter=0
+done
+# The sink accepts the packets sent to any address of its site
+ip -n $NS_B route add local 10.2.0.0/16 dev lo
+ip -n $NS_B -6 route add local fd00:2::/48 dev lo
+
+oor_conf 10.1.0.1/16 fd00:1::1/48 10.2.0.0/16 fd00:2::/48 $RLOC_B > $TMP/oor-a.conf
+oor_conf 10.2.0.1/16 fd00:2::1/48 10.1.0.0/16 fd00:1::/48 $RLOC_A > $TMP/oor-b.conf
+
+ip netns exec $NS_A $OOR -f $TMP/oor-a.conf > $TMP/oor-a.log 2>&1 &
+ip netns exec $NS_B $OOR -f $TMP/oor-b.conf > $TMP/oor-b.log 2>&1 &
+# Wait for the tun devices and the EID routes
+sleep 3
+
+ip netns exec $NS_B $BENCH -m sink -P $PORT > $TMP/sink.log 2>&1 &
+SINK=$!
+sleep 1
+
+echo "Sender:"
+ip netns exec $NS_A $BENCH -m send -P $PORT -s 64:7,576:4,1400:1 "$@"
+wait $SINK
+echo "Sink:"
+cat $TMP/sink.log
@@ -0,0 +1,301 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Micro-benchmark of the authentication of the control messages. The
+ * HMAC computed with the key string on each message (previous
+ * implementation) is compared with the precomputed key states, using the
+ * portable SHA code and the SHA instructions of the CPU, one message at a
+ * time and in batches.
+ * Before measuring, the known answers of RFC 2202 and RFC 4231 are checked
+ * and the results of all the variants are compared with the portable code.
+ *
+ * Usage: bench_hmac [iterations] [batch size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_common.h"
+#include "../lib/hmac.h"
+#include "../lib/mem_util.h"
+#include "../liblisp/lisp_message_fields.h"
+#include "../elibs/mbedtls/sha_hw.h"
+
+#define DEFAULT_ITERATIONS  200000
+#define DEFAULT_BATCH       32
+#define MAX_PCKT_LEN        1500
+#define AUTH_DATA_OFFSET    16
+#define KAT_PCKT_LENS       600
+
+static const char *bench_key = "bench-map-server-key";
+static const int pckt_lens[] = { 84, 220, 620 };
+
+typedef struct hmac_kat_ {
+    const char *key;
+    const char *data;
+    mbedtls_md_type_t md_type;
+    const char *hex;
+} hmac_kat_t;
+
+static const hmac_kat_t hmac_kats[] = {
+    { "\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b",
+      "Hi There", MBEDTLS_MD_SHA1,
+      "b617318655057264e28bc0b6fb378c8ef146be00" },
+    { "Jefe", "what do ya want for nothing?", MBEDTLS_MD_SHA1,
+      "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79" },
+    { "\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b",
+      "Hi There", MBEDTLS_MD_SHA256,
+      "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7" },
+    { "Jefe", "what do ya want for nothing?", MBEDTLS_MD_SHA256,
+      "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843" },
+};
+
+static volatile uint32_t sink;
+
+static mbedtls_md_type_t
+key_id_md(uint8_t key_id)
+{
+    return (key_id == HMAC_SHA_1_96 ? MBEDTLS_MD_SHA1 : MBEDTLS_MD_SHA256);
+}
+
+/* Previous implementation: HMAC with the key string of each message */
+static void
+legacy_hmac(uint8_t key_id, const char *key, uint8_t *pckt, size_t len,
+        uint8_t *out)
+{
+    mbedtls_md_hmac(mbedtls_md_info_from_type(key_id_md(key_id)),
+            (const unsigned char *)key, strlen(key), pckt, len, out);
+}
+
+static int
+hex_cmp(const uint8_t *bin, const char *hex, size_t len)
+{
+    char str[2 * MBEDTLS_MD_MAX_SIZE + 1];
+    size_t i;
+
+    for (i = 0; i < len; i++){
+        sprintf(str + 2 * i, "%02x", bin[i]);
+    }
+    return (strcmp(str, hex));
+}
+
+static int
+check_rfc_kats()
+{
+    uint8_t out[MBEDTLS_MD_MAX_SIZE];
+    const hmac_kat_t *kat;
+    const mbedtls_md_info_t *md_info;
+    size_t i;
+    int hw;
+
+    for (hw = 0; hw < 2; hw++){
+        mbedtls_sha_hw_enable(hw);
+        for (i = 0; i < sizeof(hmac_kats) / sizeof(hmac_kats[0]); i++){
+            kat = &hmac_kats[i];
+            md_info = mbedtls_md_info_from_type(kat->md_type);
+            mbedtls_md_hmac(md_info, (const unsigned char *)kat->key,
+                    strlen(kat->key), (const unsigned char *)kat->data,
+                    strlen(kat->data), out);
+            if (hex_cmp(out, kat->hex, mbedtls_md_get_size(md_info)) != 0){
+                fprintf(stderr, "RFC known answer %d failed (%s)\n", (int)i,
+                        hw ? "SHA instructions" : "portable");
+                return (BAD);
+            }
+        }
+    }
+    return (GOOD);
+}
+
+/* The auth data computed by each variant must be the one computed by the
+ * portable code with the key string */
+static int
+check_against_portable(uint8_t key_id, hmac_key_t *hkey)
+{
+    uint8_t pckt[KAT_PCKT_LENS + AUTH_DATA_OFFSET + MBEDTLS_MD_MAX_SIZE];
+    uint8_t ref[MBEDTLS_MD_MAX_SIZE];
+    uint8_t *auth = pckt + AUTH_DATA_OFFSET;
+    size_t auth_len = auth_data_get_len_for_type(key_id);
+    size_t len;
+    uint32_t seed = 2013;
+    hmac_auth_req_t req;
+    size_t i;
+    int hw;
+
+    for (len = AUTH_DATA_OFFSET + auth_len; len < sizeof(pckt); len++){
+        for (i = 0; i < sizeof(pckt); i++){
+            pckt[i] = bench_rand(&seed);
+        }
+        memset(auth, 0, auth_len);
+        mbedtls_sha_hw_enable(0);
+        legacy_hmac(key_id, bench_key, pckt, len, ref);
+
+        for (hw = 0; hw < 2; hw++){
+            mbedtls_sha_hw_enable(hw);
+            complete_auth_fields(key_id, hkey, pckt, len, auth);
+            if (memcmp(auth, ref, auth_len) != 0
+                    || check_auth_field(key_id, hkey, pckt, len, auth) != GOOD){
+                fprintf(stderr, "Known answer failed: key id %d, %d bytes (%s)\n",
+                        key_id, (int)len, hw ? "SHA instructions" : "portable");
+                return (BAD);
+            }
+            req.key_id = key_id;
+            req.key = hkey;
+            req.packet = pckt;
+            req.pckt_len = len;
+            req.auth_data_pos = auth;
+            if (check_auth_fields_batch(&req, 1) != 1){
+                fprintf(stderr, "Batch known answer failed: key id %d, %d bytes (%s)\n",
+                        key_id, (int)len, hw ? "SHA instructions" : "portable");
+                return (BAD);
+            }
+        }
+    }
+    return (GOOD);
+}
+
+static void
+report(const char *name, uint64_t start, uint64_t end, long msgs)
+{
+    printf("  %-32s %8.1f ns/msg\n", name,
+            (double)(end - start) / (double)msgs);
+}
+
+static void
+run_bench(uint8_t key_id, hmac_key_t *hkey, size_t len, long iterations,
+        int batch)
+{
+    uint8_t *pckts;
+    hmac_auth_req_t *reqs;
+    uint8_t out[MBEDTLS_MD_MAX_SIZE];
+    size_t auth_len = auth_data_get_len_for_type(key_id);
+    uint32_t seed = 2013, acc = 0;
+    uint64_t start;
+    long i, rounds;
+    int j, hw;
+    char name[64];
+
+    pckts = xmalloc(batch * MAX_PCKT_LEN);
+    reqs = xzalloc(batch * sizeof(hmac_auth_req_t));
+    for (j = 0; j < batch * MAX_PCKT_LEN; j++){
+        pckts[j] = bench_rand(&seed);
+    }
+    for (j = 0; j < batch; j++){
+        reqs[j].key_id = key_id;
+        reqs[j].key = hkey;
+        reqs[j].packet = pckts + j * MAX_PCKT_LEN;
+        reqs[j].pckt_len = len;
+        reqs[j].auth_data_pos = pckts + j * MAX_PCKT_LEN + AUTH_DATA_OFFSET;
+        complete_auth_fields(key_id, hkey, reqs[j].packet, len,
+                reqs[j].auth_data_pos);
+    }
+    rounds = iterations / batch;
+
+    printf("%s, %d bytes, %ld messages\n", key_id == HMAC_SHA_1_96 ?
+            "HMAC-SHA-1-96" : "HMAC-SHA-256-128", (int)len, rounds * batch);
+
+    mbedtls_sha_hw_enable(0);
+    start = bench_now_ns();
+    for (i = 0; i < rounds * batch; i++){
+        j = i % batch;
+        memset(reqs[j].auth_data_pos, 0, auth_len);
+        legacy_hmac(key_id, bench_key, reqs[j].packet, len, out);
+        acc += out[0];
+    }
+    report("mbedtls_md_hmac (key string)", start, bench_now_ns(), rounds * batch);
+    /* Restore the auth data cleared by the legacy loop */
+    for (j = 0; j < batch; j++){
+        complete_auth_fields(key_id, hkey, reqs[j].packet, len,
+                reqs[j].auth_data_pos);
+    }
+
+    for (hw = 0; hw < 2; hw++){
+        mbedtls_sha_hw_enable(hw);
+        if (hw && !mbedtls_sha_hw()){
+            break;
+        }
+        start = bench_now_ns();
+        for (i = 0; i < rounds * batch; i++){
+            j = i % batch;
+            acc += check_auth_field(key_id, hkey, reqs[j].packet, len,
+                    reqs[j].auth_data_pos);
+        }
+        sprintf(name, "check_auth_field (%s)", hw ? "SHA insn" : "portable");
+        report(name, start, bench_now_ns(), rounds * batch);
+
+        start = bench_now_ns();
+        for (i = 0; i < rounds; i++){
+            acc += check_auth_fields_batch(reqs, batch);
+        }
+        sprintf(name, "batch of %d (%s)", batch, hw ? "SHA insn" : "portable");
+        report(name, start, bench_now_ns(), rounds * batch);
+    }
+
+    sink = acc;
+    free(pckts);
+    free(reqs);
+}
+
+int
+main(int argc, char **argv)
+{
+    long iterations = DEFAULT_ITERATIONS;
+    int batch = DEFAULT_BATCH;
+    hmac_key_t *hkey;
+    size_t i;
+
+    if (argc > 1){
+        iterations = strtol(argv[1], NULL, 10);
+    }
+    if (argc > 2){
+        batch = strtol(argv[2], NULL, 10);
+    }
+    if (iterations <= 0 || batch <= 0 || batch > iterations){
+        fprintf(stderr, "Usage: %s [iterations] [batch size]\n", argv[0]);
+        return (EXIT_FAILURE);
+    }
+
+    printf("SHA instructions: %s\n",
+            mbedtls_sha_hw() ? mbedtls_sha_hw()->name : "not available");
+
+    hkey = hmac_key_new(bench_key);
+    if (check_rfc_kats() != GOOD
+            || check_against_portable(HMAC_SHA_1_96, hkey) != GOOD
+            || check_against_portable(HMAC_SHA_256_128, hkey) != GOOD){
+        hmac_key_del(hkey);
+        return (EXIT_FAILURE);
+    }
+    printf("Known answer tests passed\n");
+
+    for (i = 0; i < sizeof(pckt_lens) / sizeof(pckt_lens[0]); i++){
+        run_bench(HMAC_SHA_1_96, hkey, pckt_lens[i], iterations, batch);
+        run_bench(HMAC_SHA_256_128, hkey, pckt_lens[i], iterations, batch);
+    }
+
+    hmac_key_del(hkey);
+    return (EXIT_SUCCESS);
+}
+
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
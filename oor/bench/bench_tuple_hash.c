@@ -0,0 +1,208 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Micro-benchmark of the 5-tuple hash and compare functions used by the
+ * forwarding tables. The current implementation (fixed layout key) is
+ * compared with the previous one, which allocated a scratch array on each
+ * call and compared the addresses with lisp_addr_cmp.
+ *
+ * Usage: bench_tuple_hash [iterations] [flows]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_common.h"
+#include "../lib/mem_util.h"
+#include "../lib/packets.h"
+#include "../liblisp/lisp_address.h"
+
+#define DEFAULT_ITERATIONS  5000000
+#define DEFAULT_FLOWS       4096
+
+uint32_t hashword(const uint32_t *k, size_t length, uint32_t initval);
+
+static volatile uint32_t sink;
+
+/* Previous implementation of pkt_tuple_hash */
+static uint32_t
+legacy_tuple_hash(packet_tuple_t *tuple)
+{
+    int hash = 0;
+    int len = 0;
+    int port = tuple->src_port;
+    uint32_t *tuples = NULL;
+
+    port = port + ((int)tuple->dst_port << 16);
+    switch (lisp_addr_ip_afi(&tuple->src_addr)){
+    case AF_INET:
+        len = 5;
+        tuples = xmalloc(len * sizeof(uint32_t));
+        lisp_addr_copy_to(&tuples[0], &tuple->src_addr);
+        lisp_addr_copy_to(&tuples[1], &tuple->dst_addr);
+        tuples[2] = port;
+        tuples[3] = tuple->protocol;
+        tuples[4] = tuple->iid;
+        break;
+    case AF_INET6:
+        len = 11;
+        tuples = xmalloc(len * sizeof(uint32_t));
+        lisp_addr_copy_to(&tuples[0], &tuple->src_addr);
+        lisp_addr_copy_to(&tuples[4], &tuple->dst_addr);
+        tuples[8] = port;
+        tuples[9] = tuple->protocol;
+        tuples[10] = tuple->iid;
+        break;
+    }
+
+    hash = hashword(tuples, len, 2013);
+    free(tuples);
+    return (hash);
+}
+
+/* Previous implementation of pkt_tuple_cmp */
+static int
+legacy_tuple_cmp(packet_tuple_t *t1, packet_tuple_t *t2)
+{
+    return(t1->src_port == t2->src_port
+           && t1->dst_port == t2->dst_port
+           && (lisp_addr_cmp(&t1->src_addr, &t2->src_addr) == 0)
+           && (lisp_addr_cmp(&t1->dst_addr, &t2->dst_addr) == 0)
+           && t1->iid == t2->iid);
+}
+
+static void
+fill_tuples(packet_tuple_t *tuples, int nflows, int afi)
+{
+    uint32_t seed = 2013;
+    uint32_t addr[4];
+    int i, j;
+
+    memset(tuples, 0, nflows * sizeof(packet_tuple_t));
+    for (i = 0; i < nflows; i++){
+        for (j = 0; j < 4; j++){
+            addr[j] = bench_rand(&seed);
+        }
+        lisp_addr_ip_init(&tuples[i].src_addr, addr, afi);
+        for (j = 0; j < 4; j++){
+            addr[j] = bench_rand(&seed);
+        }
+        lisp_addr_ip_init(&tuples[i].dst_addr, addr, afi);
+        tuples[i].src_port = bench_rand(&seed);
+        tuples[i].dst_port = bench_rand(&seed);
+        tuples[i].protocol = IPPROTO_UDP;
+        tuples[i].iid = 0;
+    }
+}
+
+static void
+report(const char *name, uint64_t start, uint64_t end, long iterations)
+{
+    printf("  %-28s %8.2f ns/op\n", name,
+            (double)(end - start) / (double)iterations);
+}
+
+static void
+run_bench(int afi, long iterations, int nflows)
+{
+    packet_tuple_t *tuples;
+    pkt_tuple_key_t *keys;
+    uint64_t start;
+    uint32_t acc = 0;
+    long i;
+    int mask = nflows - 1;
+
+    tuples = xmalloc(nflows * sizeof(packet_tuple_t));
+    keys = xmalloc(nflows * sizeof(pkt_tuple_key_t));
+    fill_tuples(tuples, nflows, afi);
+    for (i = 0; i < nflows; i++){
+        pkt_tuple_to_key(&tuples[i], &keys[i]);
+    }
+
+    printf("%s, %d flows, %ld iterations\n", afi == AF_INET ? "IPv4" : "IPv6",
+            nflows, iterations);
+
+    start = bench_now_ns();
+    for (i = 0; i < iterations; i++){
+        acc += legacy_tuple_hash(&tuples[i & mask]);
+    }
+    report("hashword (xmalloc)", start, bench_now_ns(), iterations);
+
+    start = bench_now_ns();
+    for (i = 0; i < iterations; i++){
+        acc += pkt_tuple_hash(&tuples[i & mask]);
+    }
+    report("pkt_tuple_hash", start, bench_now_ns(), iterations);
+
+    start = bench_now_ns();
+    for (i = 0; i < iterations; i++){
+        acc += pkt_tuple_key_hash(&keys[i & mask]);
+    }
+    report("pkt_tuple_key_hash", start, bench_now_ns(), iterations);
+
+    start = bench_now_ns();
+    for (i = 0; i < iterations; i++){
+        acc += legacy_tuple_cmp(&tuples[i & mask], &tuples[(i + 1) & mask]);
+        acc += legacy_tuple_cmp(&tuples[i & mask], &tuples[i & mask]);
+    }
+    report("lisp_addr_cmp compare", start, bench_now_ns(), 2 * iterations);
+
+    start = bench_now_ns();
+    for (i = 0; i < iterations; i++){
+        acc += pkt_tuple_key_equal(&keys[i & mask], &keys[(i + 1) & mask]);
+        acc += pkt_tuple_key_equal(&keys[i & mask], &keys[i & mask]);
+    }
+    report("pkt_tuple_key_equal", start, bench_now_ns(), 2 * iterations);
+
+    sink = acc;
+    free(tuples);
+    free(keys);
+}
+
+int
+main(int argc, char **argv)
+{
+    long iterations = DEFAULT_ITERATIONS;
+    int nflows = DEFAULT_FLOWS;
+
+    if (argc > 1){
+        iterations = strtol(argv[1], NULL, 10);
+    }
+    if (argc > 2){
+        nflows = strtol(argv[2], NULL, 10);
+    }
+    if (iterations <= 0 || nflows <= 0 || (nflows & (nflows - 1)) != 0){
+        fprintf(stderr, "Usage: %s [iterations] [flows (power of 2)]\n", argv[0]);
+        return (EXIT_FAILURE);
+    }
+
+    run_bench(AF_INET, iterations, nflows);
+    run_bench(AF_INET6, iterations, nflows);
+
+    return (EXIT_SUCCESS);
+}
+
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
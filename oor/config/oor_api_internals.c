@@ -19,7 +19,9 @@
 
 #include "oor_api_internals.h"
 #include "oor_config_functions.h"
+#include "../oor_external.h"
 #include "../lib/oor_log.h"
+#include "../lib/sockets.h"
 #include "../liblisp/liblisp.h"
 #include "../lib/mem_util.h"
 #include <libxml/tree.h>
@@ -353,8 +355,9 @@ lxml_update_map_server_list(xmlNodePtr xml_map_servers, uint8_t proxy_reply,
             key_type = HMAC_SHA_256_128;
         }
         free(key_type_aux);
-        if (key_type != HMAC_SHA_1_96){
-            OOR_LOG(LERR, "Configuration file: Only SHA-1 (1) authentication is supported");
+        if (key_type != HMAC_SHA_1_96 && key_type != HMAC_SHA_256_128){
+            OOR_LOG(LERR, "Configuration file: Only SHA-1 (1) and SHA-256 (2) "
+                    "authentication are supported");
             free(str_addr);
             free(key);
             return (BAD);
@@ -412,11 +415,34 @@ lxml_update_map_server_list(xmlNodePtr xml_map_servers, uint8_t proxy_reply,
 }
 
 
+/* Called when the file descriptor of the API socket is signaled. This
+ * descriptor only notifies changes of state of the ZMQ socket, so all the
+ * pending requests are processed */
+static int
+oor_api_process_requests(sock_t *sl)
+{
+    oor_api_connection_t *conn = (oor_api_connection_t *)sl->arg;
+    int events;
+    size_t len;
+
+    for (;;){
+        len = sizeof(events);
+        if (zmq_getsockopt(conn->socket, ZMQ_EVENTS, &events, &len) != 0
+                || !(events & ZMQ_POLLIN)){
+            break;
+        }
+        oor_api_loop(conn);
+    }
+    return (GOOD);
+}
+
 int
 oor_api_init_server(oor_api_connection_t *conn)
 {
 
 	int error;
+	int fd;
+	size_t fd_len = sizeof(fd);
 
     conn->context = zmq_ctx_new();
     OOR_LOG(LDBG_3,"OOR_API: zmq_ctx_new errno: %s\n",zmq_strerror (errno));
@@ -433,6 +459,16 @@ oor_api_init_server(oor_api_connection_t *conn)
     	goto err;
     }
 
+    if (zmq_getsockopt(conn->socket, ZMQ_FD, &fd, &fd_len) != 0){
+        OOR_LOG(LDBG_2,"OOR_API: Error while getting the ZMQ file descriptor: %s\n",zmq_strerror (errno));
+        goto err;
+    }
+    /* The descriptor belongs to ZMQ. Register a duplicate that can be closed
+     * by the socket master */
+    if (!sockmstr_register_read_listener(smaster, oor_api_process_requests, conn, dup(fd))){
+        goto err;
+    }
+
     OOR_LOG(LDBG_2,"OOR_API: API server initiated using ZMQ\n");
 
     return (GOOD);
@@ -404,6 +404,9 @@ int
 configure_tunnel_router(cfg_t *cfg, oor_ctrl_dev_t *dev, lisp_tr_t *tr, shash_t *lcaf_ht)
 {
     int i,n,ret;
+    int mc_max_entries, mc_max_mem;
+    mcache_evict_policy_e mc_evict;
+    char *mc_snapshot;
     char *map_resolver;
     char *encap, *encap_str;
     mapping_t *mapping;
@@ -413,7 +416,10 @@ configure_tunnel_router(cfg_t *cfg, oor_ctrl_dev_t *dev, lisp_tr_t *tr, shash_t
 #ifdef VPP
     tr->fwd_policy = fwd_policy_class_find("vpp_balancing");
 #else
-    tr->fwd_policy = fwd_policy_class_find("flow_balancing");
+    tr->fwd_policy = fwd_policy_class_find(cfg_getstr(cfg, "forwarding-policy"));
+    if (!tr->fwd_policy){
+        return (BAD);
+    }
 #endif
     tr->fwd_policy_dev_parm = tr->fwd_policy->new_dev_policy_inf(ctrl_dev,NULL);
 
@@ -435,6 +441,26 @@ configure_tunnel_router(cfg_t *cfg, oor_ctrl_dev_t *dev, lisp_tr_t *tr, shash_t
     ret = cfg_getint(cfg, "map-request-retries");
     tr->map_request_retries = (ret != 0) ? ret : DEFAULT_MAP_REQUEST_RETRIES;
 
+    /* MAP CACHE REFRESH */
+    tr->map_cache_refresh = cfg_getint(cfg, "map-cache-refresh");
+    validate_map_cache_refresh(&tr->map_cache_refresh);
+
+    /* MAP CACHE LIMITS */
+    mc_max_entries = cfg_getint(cfg, "map-cache-max-entries");
+    mc_max_mem = cfg_getint(cfg, "map-cache-max-memory");
+    validate_map_cache_limits(&mc_max_entries, &mc_max_mem);
+    if (parse_map_cache_eviction(cfg_getstr(cfg, "map-cache-eviction"), &mc_evict) != GOOD){
+        return (BAD);
+    }
+    mcache_set_limits(tr->map_cache, mc_max_entries, (uint64_t)mc_max_mem * 1024, mc_evict);
+
+    /* MAP CACHE SNAPSHOT */
+    mc_snapshot = cfg_getstr(cfg, "map-cache-snapshot");
+    tr->mc_snapshot_interval = cfg_getint(cfg, "map-cache-snapshot-interval");
+    validate_map_cache_snapshot(mc_snapshot, &tr->mc_snapshot_interval);
+    if (mc_snapshot && *mc_snapshot != '\0'){
+        tr->mc_snapshot_file = strdup(mc_snapshot);
+    }
 
     /* RLOC PROBING CONFIG */
     cfg_t *dm = cfg_getnsec(cfg, "rloc-probing", 0);
@@ -980,12 +1006,29 @@ handle_config_file()
             CFG_SEC("proxy-etr-ipv4",       petr_mapping_opts,      CFGF_MULTI),
             CFG_SEC("proxy-etr-ipv6",       petr_mapping_opts,      CFGF_MULTI),
             CFG_STR("encapsulation",        "LISP",                 CFGF_NONE),
+            CFG_STR("forwarding-policy",    "flow_balancing",       CFGF_NONE),
             CFG_SEC("rloc-probing",         rloc_probing_opts,      CFGF_MULTI),
             CFG_INT("map-request-retries",  0, CFGF_NONE),
+            CFG_INT("map-cache-refresh",    DEFAULT_MAP_CACHE_REFRESH, CFGF_NONE),
+            CFG_INT("map-cache-max-entries", DEFAULT_MAP_CACHE_MAX_ENTRIES, CFGF_NONE),
+            CFG_INT("map-cache-max-memory", DEFAULT_MAP_CACHE_MAX_MEM, CFGF_NONE),
+            CFG_STR("map-cache-eviction",   "lru",                  CFGF_NONE),
+            CFG_STR("map-cache-snapshot",   0,                      CFGF_NONE),
+            CFG_INT("map-cache-snapshot-interval", DEFAULT_MAP_CACHE_SNAPSHOT_INTERVAL, CFGF_NONE),
             CFG_INT("control-port",         0, CFGF_NONE),
             CFG_INT("debug",                0, CFGF_NONE),
             CFG_STR("log-file",             0, CFGF_NONE),
             CFG_STR("ipv6-scope",          "GLOBAL",               CFGF_NONE),
+            CFG_INT("packet-batch-size",    DEFAULT_DATA_PKT_BATCH_SIZE, CFGF_NONE),
+            CFG_INT("flow-table-size",      DEFAULT_FLOW_TABLE_SIZE, CFGF_NONE),
+            CFG_INT("flow-idle-timeout",    DEFAULT_FLOW_IDLE_TIMEOUT, CFGF_NONE),
+            CFG_INT("data-plane-threads",   DEFAULT_DATA_PLANE_THREADS, CFGF_NONE),
+            CFG_INT("pending-packets-per-eid", DEFAULT_PENDING_PKTS_PER_EID, CFGF_NONE),
+            CFG_INT("pending-packets-memory", DEFAULT_PENDING_PKTS_MEM, CFGF_NONE),
+            CFG_BOOL("ipv4-udp-checksum",   cfg_true, CFGF_NONE),
+            CFG_BOOL("edge-triggered-sockets", cfg_false, CFGF_NONE),
+            CFG_INT("data-rx-ring-size",    DEFAULT_DATA_RX_RING_SIZE, CFGF_NONE),
+            CFG_INT("prefix-table-size",    DEFAULT_PREFIX_TABLE_SIZE, CFGF_NONE),
             CFG_INT("rloc-probing-interval",0, CFGF_NONE),
             CFG_STR_LIST("map-resolver",    0, CFGF_NONE),
             CFG_STR_LIST("proxy-itrs",      0, CFGF_NONE),
@@ -1077,6 +1120,24 @@ handle_config_file()
     }
     free(scope);
 
+    dplane_conf.pkt_batch_size = cfg_getint(cfg, "packet-batch-size");
+    validate_pkt_batch_size(&dplane_conf.pkt_batch_size);
+    dplane_conf.flow_table_size = cfg_getint(cfg, "flow-table-size");
+    validate_flow_table_size(&dplane_conf.flow_table_size);
+    dplane_conf.flow_idle_timeout = cfg_getint(cfg, "flow-idle-timeout");
+    validate_flow_idle_timeout(&dplane_conf.flow_idle_timeout);
+    dplane_conf.data_plane_threads = cfg_getint(cfg, "data-plane-threads");
+    validate_data_plane_threads(&dplane_conf.data_plane_threads);
+    dplane_conf.pending_pkts_per_eid = cfg_getint(cfg, "pending-packets-per-eid");
+    dplane_conf.pending_pkts_mem = cfg_getint(cfg, "pending-packets-memory");
+    validate_pending_pkts(&dplane_conf.pending_pkts_per_eid, &dplane_conf.pending_pkts_mem);
+    dplane_conf.ipv4_udp_checksum = cfg_getbool(cfg, "ipv4-udp-checksum") ? TRUE : FALSE;
+    sockmstr_set_edge_triggered(smaster, cfg_getbool(cfg, "edge-triggered-sockets") ? TRUE : FALSE);
+    dplane_conf.rx_ring_size = cfg_getint(cfg, "data-rx-ring-size");
+    validate_data_rx_ring_size(&dplane_conf.rx_ring_size);
+    dplane_conf.prefix_table_size = cfg_getint(cfg, "prefix-table-size");
+    validate_prefix_table_size(&dplane_conf.prefix_table_size);
+
 
     mode_str = cfg_getstr(cfg, "operating-mode");
     if (mode_str) {
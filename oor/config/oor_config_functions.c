@@ -299,6 +299,178 @@ validate_rloc_probing_parameters(int *interval,int *retries,int *retries_int)
     }
 }
 
+void
+validate_pkt_batch_size(int *batch_size)
+{
+    if (*batch_size < 1) {
+        *batch_size = 1;
+        OOR_LOG(LWRN, "Packet batch size should be between 1 and %d. "
+                "Using 1", MAX_DATA_PKT_BATCH_SIZE);
+    } else if (*batch_size > MAX_DATA_PKT_BATCH_SIZE) {
+        *batch_size = MAX_DATA_PKT_BATCH_SIZE;
+        OOR_LOG(LWRN, "Packet batch size should be between 1 and %d. "
+                "Using %d", MAX_DATA_PKT_BATCH_SIZE, MAX_DATA_PKT_BATCH_SIZE);
+    }
+    OOR_LOG(LDBG_1, "Data plane packet batch size: %d", *batch_size);
+}
+
+void
+validate_flow_table_size(int *size)
+{
+    if (*size < MIN_FLOW_TABLE_SIZE) {
+        *size = MIN_FLOW_TABLE_SIZE;
+        OOR_LOG(LWRN, "Flow table size should be between %d and %d. "
+                "Using %d", MIN_FLOW_TABLE_SIZE, MAX_FLOW_TABLE_SIZE, MIN_FLOW_TABLE_SIZE);
+    } else if (*size > MAX_FLOW_TABLE_SIZE) {
+        *size = MAX_FLOW_TABLE_SIZE;
+        OOR_LOG(LWRN, "Flow table size should be between %d and %d. "
+                "Using %d", MIN_FLOW_TABLE_SIZE, MAX_FLOW_TABLE_SIZE, MAX_FLOW_TABLE_SIZE);
+    }
+    OOR_LOG(LDBG_1, "Data plane flow table size: %d", *size);
+}
+
+void
+validate_flow_idle_timeout(int *timeout)
+{
+    if (*timeout < 0) {
+        *timeout = 0;
+        OOR_LOG(LWRN, "Flow idle timeout should be between 0 and %d. "
+                "Aging of flows disabled", MAX_FLOW_IDLE_TIMEOUT);
+    } else if (*timeout > MAX_FLOW_IDLE_TIMEOUT) {
+        *timeout = MAX_FLOW_IDLE_TIMEOUT;
+        OOR_LOG(LWRN, "Flow idle timeout should be between 0 and %d. "
+                "Using %d", MAX_FLOW_IDLE_TIMEOUT, MAX_FLOW_IDLE_TIMEOUT);
+    }
+    OOR_LOG(LDBG_1, "Data plane flow idle timeout: %d", *timeout);
+}
+
+void
+validate_data_plane_threads(int *threads)
+{
+    if (*threads < 0) {
+        *threads = 0;
+        OOR_LOG(LWRN, "Data plane threads should be between 0 and %d. "
+                "Forwarding in the main thread", MAX_DATA_PLANE_THREADS);
+    } else if (*threads > MAX_DATA_PLANE_THREADS) {
+        *threads = MAX_DATA_PLANE_THREADS;
+        OOR_LOG(LWRN, "Data plane threads should be between 0 and %d. "
+                "Using %d", MAX_DATA_PLANE_THREADS, MAX_DATA_PLANE_THREADS);
+    }
+    OOR_LOG(LDBG_1, "Data plane threads: %d", *threads);
+}
+
+void
+validate_data_rx_ring_size(int *size)
+{
+    if (*size < 0) {
+        *size = 0;
+        OOR_LOG(LWRN, "Data RX ring size should be between 0 and %d KB. "
+                "Using raw sockets", MAX_DATA_RX_RING_SIZE);
+    } else if (*size > MAX_DATA_RX_RING_SIZE) {
+        *size = MAX_DATA_RX_RING_SIZE;
+        OOR_LOG(LWRN, "Data RX ring size should be between 0 and %d KB. "
+                "Using %d KB", MAX_DATA_RX_RING_SIZE, MAX_DATA_RX_RING_SIZE);
+    }
+    OOR_LOG(LDBG_1, "Data RX ring size: %d KB", *size);
+}
+
+void
+validate_prefix_table_size(int *size)
+{
+    if (*size < 0 || *size > MAX_PREFIX_TABLE_SIZE) {
+        *size = *size < 0 ? 0 : MAX_PREFIX_TABLE_SIZE;
+        OOR_LOG(LWRN, "Prefix table size should be between 0 and %d. "
+                "Using %d", MAX_PREFIX_TABLE_SIZE, *size);
+    }
+    OOR_LOG(LDBG_1, "Prefix table size: %d", *size);
+}
+
+void
+validate_map_cache_refresh(int *percent)
+{
+    if (*percent < 0 || *percent > MAX_MAP_CACHE_REFRESH) {
+        *percent = *percent < 0 ? 0 : MAX_MAP_CACHE_REFRESH;
+        OOR_LOG(LWRN, "Map cache refresh should be between 0 and %d %% of the TTL. "
+                "Using %d %%", MAX_MAP_CACHE_REFRESH, *percent);
+    }
+    if (*percent > 0) {
+        OOR_LOG(LDBG_1, "Map cache entries in use refreshed %d %% of the TTL "
+                "before expiry", *percent);
+    } else {
+        OOR_LOG(LDBG_1, "Map cache refresh disabled");
+    }
+}
+
+void
+validate_map_cache_limits(int *max_entries, int *max_mem)
+{
+    if (*max_entries < 0) {
+        *max_entries = 0;
+        OOR_LOG(LWRN, "Map cache max entries should be 0 or positive. Using no limit");
+    }
+    if (*max_mem < 0) {
+        *max_mem = 0;
+        OOR_LOG(LWRN, "Map cache max memory should be 0 or positive. Using no limit");
+    }
+    OOR_LOG(LDBG_1, "Map cache limits: %d entries, %d KB (0 is no limit)",
+            *max_entries, *max_mem);
+}
+
+/* Eviction policy of the map cache. LRU if not specified */
+int
+parse_map_cache_eviction(char *str, mcache_evict_policy_e *policy)
+{
+    if (!str || strcasecmp(str, "lru") == 0) {
+        *policy = MCACHE_EVICT_LRU;
+    } else if (strcasecmp(str, "lfu") == 0) {
+        *policy = MCACHE_EVICT_LFU;
+    } else {
+        OOR_LOG(LERR, "Unknown map cache eviction policy: %s. Use lru or lfu", str);
+        return (BAD);
+    }
+    return (GOOD);
+}
+
+void
+validate_map_cache_snapshot(char *file, int *interval)
+{
+    if (!file || *file == '\0') {
+        OOR_LOG(LDBG_1, "Map cache snapshot disabled");
+        return;
+    }
+    if (*interval < 0) {
+        *interval = 0;
+        OOR_LOG(LWRN, "Map cache snapshot interval should be 0 or positive. "
+                "Saving it only on shutdown");
+    } else if (*interval > 0 && *interval < MIN_MAP_CACHE_SNAPSHOT_INTERVAL) {
+        *interval = MIN_MAP_CACHE_SNAPSHOT_INTERVAL;
+        OOR_LOG(LWRN, "Map cache snapshot interval should be at least %d seconds. "
+                "Using %d", MIN_MAP_CACHE_SNAPSHOT_INTERVAL, *interval);
+    }
+    if (*interval > 0) {
+        OOR_LOG(LDBG_1, "Map cache saved in %s every %d seconds and on shutdown",
+                file, *interval);
+    } else {
+        OOR_LOG(LDBG_1, "Map cache saved in %s on shutdown", file);
+    }
+}
+
+void
+validate_pending_pkts(int *per_eid, int *mem)
+{
+    if (*per_eid < 0 || *per_eid > MAX_PENDING_PKTS_PER_EID) {
+        *per_eid = *per_eid < 0 ? 0 : MAX_PENDING_PKTS_PER_EID;
+        OOR_LOG(LWRN, "Pending packets per EID should be between 0 and %d. "
+                "Using %d", MAX_PENDING_PKTS_PER_EID, *per_eid);
+    }
+    if (*mem < 0 || *mem > MAX_PENDING_PKTS_MEM) {
+        *mem = *mem < 0 ? 0 : MAX_PENDING_PKTS_MEM;
+        OOR_LOG(LWRN, "Pending packets memory should be between 0 and %d KB. "
+                "Using %d", MAX_PENDING_PKTS_MEM, *mem);
+    }
+    OOR_LOG(LDBG_1, "Data plane pending packets: %d per EID, %d KB", *per_eid, *mem);
+}
+
 int
 validate_priority_weight(int p, int w)
 {
@@ -371,8 +543,9 @@ add_map_server(glist_t *ms_list, char *str_addr, int key_type, char *key,
         exit_cleanup();
     }
 
-    if (key_type != HMAC_SHA_1_96){
-        OOR_LOG(LERR, "Configuration file: Only SHA-1 (1) authentication is supported");
+    if (key_type != HMAC_SHA_1_96 && key_type != HMAC_SHA_256_128){
+        OOR_LOG(LERR, "Configuration file: Only SHA-1 (1) and SHA-256 (2) "
+                "authentication are supported");
         exit_cleanup();
     }
 
@@ -127,6 +127,39 @@ get_no_addr_loct_from_list(glist_t *list, locator_t *locator);
 void
 validate_rloc_probing_parameters(int *interval,int *retries,int *retries_int);
 
+void
+validate_pkt_batch_size(int *batch_size);
+
+void
+validate_flow_table_size(int *size);
+
+void
+validate_flow_idle_timeout(int *timeout);
+
+void
+validate_data_plane_threads(int *threads);
+
+void
+validate_data_rx_ring_size(int *size);
+
+void
+validate_prefix_table_size(int *size);
+
+void
+validate_map_cache_refresh(int *percent);
+
+void
+validate_map_cache_limits(int *max_entries, int *max_mem);
+
+int
+parse_map_cache_eviction(char *str, mcache_evict_policy_e *policy);
+
+void
+validate_map_cache_snapshot(char *file, int *interval);
+
+void
+validate_pending_pkts(int *per_eid, int *mem);
+
 int
 validate_priority_weight(int p, int w);
 
@@ -88,6 +88,9 @@ parse_elp_node(
         struct uci_section      *section,
         shash_t                *ht);
 
+/* Forwarding policy of the tunnel routers. Set from the daemon section */
+static fwd_policy_class *uci_fwd_policy = NULL;
+
 /********************************** FUNCTIONS ********************************/
 
 int
@@ -103,7 +106,8 @@ handle_config_file()
     int uci_debug;
     char *uci_log_file;
     char *uci_scope, *scope;
-    char *uci_op_mode, *mode;
+    int edge_triggered, udp_checksum;
+    char *uci_op_mode, *mode, *uci_policy;
     int res = BAD;
 
     if (config_file == NULL){
@@ -180,6 +184,62 @@ handle_config_file()
                 ipv6_scope = SCOPE_GLOBAL;
             }
 
+            if (uci_lookup_option_string(ctx, sect, "packet_batch_size") != NULL){
+                dplane_conf.pkt_batch_size = strtol(uci_lookup_option_string(ctx, sect, "packet_batch_size"),NULL,10);
+                validate_pkt_batch_size(&dplane_conf.pkt_batch_size);
+            }
+            if (uci_lookup_option_string(ctx, sect, "flow_table_size") != NULL){
+                dplane_conf.flow_table_size = strtol(uci_lookup_option_string(ctx, sect, "flow_table_size"),NULL,10);
+                validate_flow_table_size(&dplane_conf.flow_table_size);
+            }
+            if (uci_lookup_option_string(ctx, sect, "flow_idle_timeout") != NULL){
+                dplane_conf.flow_idle_timeout = strtol(uci_lookup_option_string(ctx, sect, "flow_idle_timeout"),NULL,10);
+                validate_flow_idle_timeout(&dplane_conf.flow_idle_timeout);
+            }
+            if (uci_lookup_option_string(ctx, sect, "data_plane_threads") != NULL){
+                dplane_conf.data_plane_threads = strtol(uci_lookup_option_string(ctx, sect, "data_plane_threads"),NULL,10);
+                validate_data_plane_threads(&dplane_conf.data_plane_threads);
+            }
+            if (uci_lookup_option_string(ctx, sect, "pending_packets_per_eid") != NULL){
+                dplane_conf.pending_pkts_per_eid = strtol(uci_lookup_option_string(ctx, sect, "pending_packets_per_eid"),NULL,10);
+            }
+            if (uci_lookup_option_string(ctx, sect, "pending_packets_memory") != NULL){
+                dplane_conf.pending_pkts_mem = strtol(uci_lookup_option_string(ctx, sect, "pending_packets_memory"),NULL,10);
+            }
+            validate_pending_pkts(&dplane_conf.pending_pkts_per_eid, &dplane_conf.pending_pkts_mem);
+            if (uci_lookup_option_string(ctx, sect, "ipv4_udp_checksum") != NULL){
+                udp_checksum = str_to_boolean((char *)uci_lookup_option_string(ctx, sect, "ipv4_udp_checksum"));
+                if (udp_checksum == UNKNOWN){
+                    OOR_LOG(LERR,"Configuration file: unknown value \"%s\" for ipv4_udp_checksum",
+                            uci_lookup_option_string(ctx, sect, "ipv4_udp_checksum"));
+                    return (BAD);
+                }
+                dplane_conf.ipv4_udp_checksum = udp_checksum;
+            }
+            if (uci_lookup_option_string(ctx, sect, "edge_triggered_sockets") != NULL){
+                edge_triggered = str_to_boolean((char *)uci_lookup_option_string(ctx, sect, "edge_triggered_sockets"));
+                if (edge_triggered == UNKNOWN){
+                    OOR_LOG(LERR,"Configuration file: unknown value \"%s\" for edge_triggered_sockets",
+                            uci_lookup_option_string(ctx, sect, "edge_triggered_sockets"));
+                    return (BAD);
+                }
+                sockmstr_set_edge_triggered(smaster, edge_triggered);
+            }
+            if (uci_lookup_option_string(ctx, sect, "data_rx_ring_size") != NULL){
+                dplane_conf.rx_ring_size = strtol(uci_lookup_option_string(ctx, sect, "data_rx_ring_size"),NULL,10);
+                validate_data_rx_ring_size(&dplane_conf.rx_ring_size);
+            }
+            if (uci_lookup_option_string(ctx, sect, "prefix_table_size") != NULL){
+                dplane_conf.prefix_table_size = strtol(uci_lookup_option_string(ctx, sect, "prefix_table_size"),NULL,10);
+                validate_prefix_table_size(&dplane_conf.prefix_table_size);
+            }
+
+            uci_policy = (char *)uci_lookup_option_string(ctx, sect, "forwarding_policy");
+            uci_fwd_policy = fwd_policy_class_find(uci_policy ? uci_policy : "flow_balancing");
+            if (uci_fwd_policy == NULL){
+                return (BAD);
+            }
+
             uci_op_mode = (char *)uci_lookup_option_string(ctx, sect, "operating_mode");
 
             if (uci_op_mode != NULL) {
@@ -214,6 +274,9 @@ configure_xtr(struct uci_context *ctx, struct uci_package *pck)
     struct uci_element *elem_addr;
     struct uci_option *opt;
     int uci_retries;
+    int mc_max_entries, mc_max_mem;
+    mcache_evict_policy_e mc_evict;
+    const char *mc_snapshot;
     char *uci_address, *boolean_char;
     int uci_key_type;
     char *uci_key;
@@ -242,7 +305,7 @@ configure_xtr(struct uci_context *ctx, struct uci_package *pck)
     ipv6_petrs_mc = mcache_get_all_space_entry(xtr->tr.map_cache,AF_INET6);
 
     /* FWD POLICY STRUCTURES */
-    xtr->tr.fwd_policy = fwd_policy_class_find("flow_balancing");
+    xtr->tr.fwd_policy = uci_fwd_policy;
     xtr->tr.fwd_policy_dev_parm = xtr->tr.fwd_policy->new_dev_policy_inf(ctrl_dev,NULL);
 
     /* CREATE LCAFS HTABLE */
@@ -299,6 +362,38 @@ configure_xtr(struct uci_context *ctx, struct uci_package *pck)
         sect = uci_to_section(element);
         if (strcmp(sect->type, "daemon") == 0){
 
+            /* MAP CACHE REFRESH */
+            if (uci_lookup_option_string(ctx, sect, "map_cache_refresh") != NULL){
+                xtr->tr.map_cache_refresh = strtol(uci_lookup_option_string(ctx, sect, "map_cache_refresh"),NULL,10);
+                validate_map_cache_refresh(&xtr->tr.map_cache_refresh);
+            }
+
+            /* MAP CACHE LIMITS */
+            mc_max_entries = DEFAULT_MAP_CACHE_MAX_ENTRIES;
+            mc_max_mem = DEFAULT_MAP_CACHE_MAX_MEM;
+            if (uci_lookup_option_string(ctx, sect, "map_cache_max_entries") != NULL){
+                mc_max_entries = strtol(uci_lookup_option_string(ctx, sect, "map_cache_max_entries"),NULL,10);
+            }
+            if (uci_lookup_option_string(ctx, sect, "map_cache_max_memory") != NULL){
+                mc_max_mem = strtol(uci_lookup_option_string(ctx, sect, "map_cache_max_memory"),NULL,10);
+            }
+            validate_map_cache_limits(&mc_max_entries, &mc_max_mem);
+            if (parse_map_cache_eviction((char *)uci_lookup_option_string(ctx, sect, "map_cache_eviction"),
+                    &mc_evict) != GOOD){
+                return (BAD);
+            }
+            mcache_set_limits(xtr->tr.map_cache, mc_max_entries, (uint64_t)mc_max_mem * 1024, mc_evict);
+
+            /* MAP CACHE SNAPSHOT */
+            mc_snapshot = uci_lookup_option_string(ctx, sect, "map_cache_snapshot");
+            if (uci_lookup_option_string(ctx, sect, "map_cache_snapshot_interval") != NULL){
+                xtr->tr.mc_snapshot_interval = strtol(uci_lookup_option_string(ctx, sect, "map_cache_snapshot_interval"),NULL,10);
+            }
+            validate_map_cache_snapshot((char *)mc_snapshot, &xtr->tr.mc_snapshot_interval);
+            if (mc_snapshot && *mc_snapshot != '\0'){
+                xtr->tr.mc_snapshot_file = strdup(mc_snapshot);
+            }
+
             /* RETRIES */
             if (uci_lookup_option_string(ctx, sect, "map_request_retries") != NULL){
                 uci_retries = strtol(uci_lookup_option_string(ctx, sect, "map_request_retries"),NULL,10);
@@ -575,6 +670,9 @@ configure_mn(struct uci_context *ctx, struct uci_package *pck)
     struct uci_element *elem_addr;
     struct uci_option *opt;
     int uci_retries;
+    int mc_max_entries, mc_max_mem;
+    mcache_evict_policy_e mc_evict;
+    const char *mc_snapshot;
     char *uci_address, *boolean_char;
     int uci_key_type;
     char *uci_key;
@@ -603,7 +701,7 @@ configure_mn(struct uci_context *ctx, struct uci_package *pck)
     ipv6_petrs_mc = mcache_get_all_space_entry(xtr->tr.map_cache,AF_INET6);
 
     /* FWD POLICY STRUCTURES */
-    xtr->tr.fwd_policy = fwd_policy_class_find("flow_balancing");
+    xtr->tr.fwd_policy = uci_fwd_policy;
     xtr->tr.fwd_policy_dev_parm = xtr->tr.fwd_policy->new_dev_policy_inf(ctrl_dev,NULL);
 
     /* CREATE LCAFS HTABLE */
@@ -659,6 +757,38 @@ configure_mn(struct uci_context *ctx, struct uci_package *pck)
         sect = uci_to_section(element);
         if (strcmp(sect->type, "daemon") == 0){
 
+            /* MAP CACHE REFRESH */
+            if (uci_lookup_option_string(ctx, sect, "map_cache_refresh") != NULL){
+                xtr->tr.map_cache_refresh = strtol(uci_lookup_option_string(ctx, sect, "map_cache_refresh"),NULL,10);
+                validate_map_cache_refresh(&xtr->tr.map_cache_refresh);
+            }
+
+            /* MAP CACHE LIMITS */
+            mc_max_entries = DEFAULT_MAP_CACHE_MAX_ENTRIES;
+            mc_max_mem = DEFAULT_MAP_CACHE_MAX_MEM;
+            if (uci_lookup_option_string(ctx, sect, "map_cache_max_entries") != NULL){
+                mc_max_entries = strtol(uci_lookup_option_string(ctx, sect, "map_cache_max_entries"),NULL,10);
+            }
+            if (uci_lookup_option_string(ctx, sect, "map_cache_max_memory") != NULL){
+                mc_max_mem = strtol(uci_lookup_option_string(ctx, sect, "map_cache_max_memory"),NULL,10);
+            }
+            validate_map_cache_limits(&mc_max_entries, &mc_max_mem);
+            if (parse_map_cache_eviction((char *)uci_lookup_option_string(ctx, sect, "map_cache_eviction"),
+                    &mc_evict) != GOOD){
+                return (BAD);
+            }
+            mcache_set_limits(xtr->tr.map_cache, mc_max_entries, (uint64_t)mc_max_mem * 1024, mc_evict);
+
+            /* MAP CACHE SNAPSHOT */
+            mc_snapshot = uci_lookup_option_string(ctx, sect, "map_cache_snapshot");
+            if (uci_lookup_option_string(ctx, sect, "map_cache_snapshot_interval") != NULL){
+                xtr->tr.mc_snapshot_interval = strtol(uci_lookup_option_string(ctx, sect, "map_cache_snapshot_interval"),NULL,10);
+            }
+            validate_map_cache_snapshot((char *)mc_snapshot, &xtr->tr.mc_snapshot_interval);
+            if (mc_snapshot && *mc_snapshot != '\0'){
+                xtr->tr.mc_snapshot_file = strdup(mc_snapshot);
+            }
+
             /* RETRIES */
             if (uci_lookup_option_string(ctx, sect, "map_request_retries") != NULL){
                 uci_retries = strtol(uci_lookup_option_string(ctx, sect, "map_request_retries"),NULL,10);
@@ -939,6 +1069,9 @@ configure_rtr(struct uci_context *ctx, struct uci_package *pck)
     shash_t *rlocs_ht;
     shash_t *rloc_set_ht;
     int uci_retries;
+    int mc_max_entries, mc_max_mem;
+    mcache_evict_policy_e mc_evict;
+    const char *mc_snapshot;
     char *uci_iface;
     char *uci_encap, *encap;
     mapping_t *mapping;
@@ -955,7 +1088,7 @@ configure_rtr(struct uci_context *ctx, struct uci_package *pck)
     rtr = lisp_rtr_cast(ctrl_dev);
 
     /* FWD POLICY STRUCTURES */
-    rtr->tr.fwd_policy = fwd_policy_class_find("flow_balancing");
+    rtr->tr.fwd_policy = uci_fwd_policy;
     rtr->tr.fwd_policy_dev_parm = rtr->tr.fwd_policy->new_dev_policy_inf(ctrl_dev,NULL);
 
     /* CREATE LCAFS HTABLE */
@@ -983,6 +1116,38 @@ configure_rtr(struct uci_context *ctx, struct uci_package *pck)
         sect = uci_to_section(element);
         if (strcmp(sect->type, "daemon") == 0){
 
+            /* MAP CACHE REFRESH */
+            if (uci_lookup_option_string(ctx, sect, "map_cache_refresh") != NULL){
+                rtr->tr.map_cache_refresh = strtol(uci_lookup_option_string(ctx, sect, "map_cache_refresh"),NULL,10);
+                validate_map_cache_refresh(&rtr->tr.map_cache_refresh);
+            }
+
+            /* MAP CACHE LIMITS */
+            mc_max_entries = DEFAULT_MAP_CACHE_MAX_ENTRIES;
+            mc_max_mem = DEFAULT_MAP_CACHE_MAX_MEM;
+            if (uci_lookup_option_string(ctx, sect, "map_cache_max_entries") != NULL){
+                mc_max_entries = strtol(uci_lookup_option_string(ctx, sect, "map_cache_max_entries"),NULL,10);
+            }
+            if (uci_lookup_option_string(ctx, sect, "map_cache_max_memory") != NULL){
+                mc_max_mem = strtol(uci_lookup_option_string(ctx, sect, "map_cache_max_memory"),NULL,10);
+            }
+            validate_map_cache_limits(&mc_max_entries, &mc_max_mem);
+            if (parse_map_cache_eviction((char *)uci_lookup_option_string(ctx, sect, "map_cache_eviction"),
+                    &mc_evict) != GOOD){
+                return (BAD);
+            }
+            mcache_set_limits(rtr->tr.map_cache, mc_max_entries, (uint64_t)mc_max_mem * 1024, mc_evict);
+
+            /* MAP CACHE SNAPSHOT */
+            mc_snapshot = uci_lookup_option_string(ctx, sect, "map_cache_snapshot");
+            if (uci_lookup_option_string(ctx, sect, "map_cache_snapshot_interval") != NULL){
+                rtr->tr.mc_snapshot_interval = strtol(uci_lookup_option_string(ctx, sect, "map_cache_snapshot_interval"),NULL,10);
+            }
+            validate_map_cache_snapshot((char *)mc_snapshot, &rtr->tr.mc_snapshot_interval);
+            if (mc_snapshot && *mc_snapshot != '\0'){
+                rtr->tr.mc_snapshot_file = strdup(mc_snapshot);
+            }
+
             /* RETRIES */
             if (uci_lookup_option_string(ctx, sect, "map_request_retries") != NULL){
                 uci_retries = strtol(uci_lookup_option_string(ctx, sect, "map_request_retries"),NULL,10);
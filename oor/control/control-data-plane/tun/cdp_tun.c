@@ -58,6 +58,15 @@ int
 tun_control_dp_get_default_ctrl_socket(tun_ctr_dplane_data_t * data,int afi);
 int
 tun_control_dp_get_output_ctrl_sock(tun_ctr_dplane_data_t * data, uconn_t *udp_conn);
+static void
+tun_control_dp_batch_init(tun_ctr_dplane_data_t * data);
+static void
+tun_control_dp_batch_uninit(tun_ctr_dplane_data_t * data);
+static void
+tun_control_dp_batch_reset(tun_ctr_dplane_data_t * data);
+static int
+tun_control_dp_batch_add(tun_ctr_dplane_data_t * data, int sock, lbuf_t *buff,
+        ip_addr_t *dst_addr);
 
 control_dplane_struct_t control_dp_tun = {
         .control_dp_init = tun_control_dp_init,
@@ -95,6 +104,7 @@ tun_control_dp_init(oor_ctrl_t *ctrl, ...)
     data = (tun_ctr_dplane_data_t *)xmalloc(sizeof(tun_ctr_dplane_data_t));
     ctrl->control_data_plane->control_dp_data = (void *)data;
     tun_control_dp_set_default_ctrl_ifaces(data);
+    tun_control_dp_batch_init(data);
 
     return (GOOD);
 }
@@ -106,6 +116,7 @@ tun_control_dp_uninit (oor_ctrl_t *ctrl)
     tun_ctr_dplane_data_t * data;
     data = (tun_ctr_dplane_data_t *)ctrl->control_data_plane->control_dp_data;
 
+    tun_control_dp_batch_uninit(data);
     free(data);
 }
 
@@ -138,47 +149,64 @@ tun_control_dp_add_iface_gw(oor_ctrl_t *ctrl,iface_t *iface, int afi){
     return (GOOD);
 }
 
-/*  Process a LISP protocol message sitting on
- *  socket s with address family afi */
+/*  Process the LISP protocol messages sitting on
+ *  socket s with address family afi. Up to CTRL_MSG_BATCH_SIZE messages
+ *  are read at once and the answers are sent once all of them have been
+ *  processed */
 int
 tun_control_dp_recv_msg(sock_t *sl)
 {
-    uconn_t uc;
+    tun_ctr_dplane_data_t * data;
+    uconn_t *uc;
     lbuf_t *b;
     oor_ctrl_t *ctrl;
     oor_ctrl_dev_t *dev;
+    int i, nmsgs;
 
     ctrl = sl->arg;
+    data = (tun_ctr_dplane_data_t *)ctrl->control_data_plane->control_dp_data;
     /* Only one device supported for now */
     dev = glist_first_data(ctrl->devices);
 
-    uc.lp = LISP_CONTROL_PORT;
-
-    b = lisp_msg_create_buf();
-
-    if (sock_ctrl_recv(sl->fd, b, &uc) != GOOD) {
+    tun_control_dp_batch_reset(data);
+    nmsgs = sock_ctrl_recv_batch(sl->fd, data->msgs, data->msgs_uc,
+            CTRL_MSG_BATCH_SIZE);
+    if (nmsgs == 0) {
         OOR_LOG(LDBG_1, "Couldn't retrieve socket information"
                 "for control message! Discarding packet!");
-        lbuf_del(b);
         return (BAD);
     }
 
-    if (lbuf_size(b) < 4){
-        OOR_LOG(LDBG_3, "Received a non LISP message in the "
-                "control port! Discarding packet!");
-        return (BAD);
+    for (i = 0; i < nmsgs; i++){
+        lbuf_reset_lisp(&data->msgs[i]);
     }
+    ctrl_dev_recv_batch(dev, data->msgs, nmsgs);
+
+    data->in_batch = TRUE;
+    for (i = 0; i < nmsgs; i++){
+        b = &data->msgs[i];
+        uc = &data->msgs_uc[i];
+        uc->lp = LISP_CONTROL_PORT;
+
+        if (lbuf_size(b) < 4){
+            OOR_LOG(LDBG_3, "Received a non LISP message in the "
+                    "control port! Discarding packet!");
+            continue;
+        }
 
-    lbuf_reset_lisp(b);
-    OOR_LOG(LDBG_1, "Received %s, IP: %s -> %s, UDP: %d -> %d",
-            lisp_msg_hdr_to_char(b), lisp_addr_to_char(&uc.ra),
-            lisp_addr_to_char(&uc.la), uc.rp, uc.lp);
+        OOR_LOG(LDBG_1, "Received %s, IP: %s -> %s, UDP: %d -> %d",
+                lisp_msg_hdr_to_char(b), lisp_addr_to_char(&uc->ra),
+                lisp_addr_to_char(&uc->la), uc->rp, uc->lp);
 
-    /* direct call of ctrl device
-     * TODO: check type to decide where to send msg*/
-    ctrl_dev_recv(dev, b, &uc);
+        /* direct call of ctrl device
+         * TODO: check type to decide where to send msg*/
+        ctrl_dev_recv(dev, b, uc);
+    }
+    data->in_batch = FALSE;
 
-    lbuf_del(b);
+    if (send_batch_flush(data->send_batch) != 0) {
+        OOR_LOG(LDBG_1, "Failed to send some of the control messages of the batch");
+    }
 
     return (GOOD);
 }
@@ -189,6 +217,7 @@ tun_control_dp_send_msg(oor_ctrl_t *ctrl, lbuf_t *buff, uconn_t *udp_conn)
     int ret, sock;
     ip_addr_t *src_addr, *dst_addr;
     lisp_addr_t *s_addr;
+    tun_ctr_dplane_data_t * data;
 
     if (lisp_addr_lafi(&udp_conn->ra) != LM_AFI_IP) {
         OOR_LOG(LDBG_2, "tun_control_dp_send_msg: Destination address %s of UDP connection is not a IP. "
@@ -209,8 +238,8 @@ tun_control_dp_send_msg(oor_ctrl_t *ctrl, lbuf_t *buff, uconn_t *udp_conn)
         lisp_addr_del(s_addr);
     }
 
-    sock = tun_control_dp_get_output_ctrl_sock(
-            (tun_ctr_dplane_data_t *)ctrl->control_data_plane->control_dp_data, udp_conn);
+    data = (tun_ctr_dplane_data_t *)ctrl->control_data_plane->control_dp_data;
+    sock = tun_control_dp_get_output_ctrl_sock(data, udp_conn);
     if (sock == ERR_SOCKET){
         return (BAD);
     }
@@ -227,7 +256,11 @@ tun_control_dp_send_msg(oor_ctrl_t *ctrl, lbuf_t *buff, uconn_t *udp_conn)
 
     pkt_push_udp_and_ip(buff, udp_conn->lp, udp_conn->rp, src_addr, dst_addr);
 
-    ret = send_raw_packet(sock, lbuf_data(buff), lbuf_size(buff), dst_addr);
+    if (data->in_batch) {
+        ret = tun_control_dp_batch_add(data, sock, buff, dst_addr);
+    } else {
+        ret = send_raw_packet(sock, lbuf_data(buff), lbuf_size(buff), dst_addr);
+    }
 
 
     if (ret != GOOD) {
@@ -235,7 +268,8 @@ tun_control_dp_send_msg(oor_ctrl_t *ctrl, lbuf_t *buff, uconn_t *udp_conn)
                 lisp_addr_to_char(&udp_conn->la), lisp_addr_to_char(&udp_conn->ra));
         return(BAD);
     } else {
-        OOR_LOG(LDBG_1, "Sent control message IP: %s -> %s UDP: %d -> %d",
+        OOR_LOG(LDBG_1, "%s control message IP: %s -> %s UDP: %d -> %d",
+                data->in_batch ? "Queued" : "Sent",
                 lisp_addr_to_char(&udp_conn->la), lisp_addr_to_char(&udp_conn->ra),
                 udp_conn->lp, udp_conn->rp);
         return(GOOD);
@@ -451,3 +485,70 @@ tun_control_dp_get_output_ctrl_sock(tun_ctr_dplane_data_t * data,
 
     return (sock);
 }
+
+static void
+tun_control_dp_batch_init(tun_ctr_dplane_data_t * data)
+{
+    int i;
+
+    data->msgs = xzalloc(CTRL_MSG_BATCH_SIZE * sizeof(lbuf_t));
+    data->msgs_uc = xzalloc(CTRL_MSG_BATCH_SIZE * sizeof(uconn_t));
+    for (i = 0; i < CTRL_MSG_BATCH_SIZE; i++){
+        /* Same layout as the buffers of lisp_msg_create_buf */
+        lbuf_init(&data->msgs[i], MAX_IP_PKT_LEN + MAX_LISP_MSG_ENCAP_LEN);
+    }
+    data->in_batch = FALSE;
+    data->out_mem = xmalloc(CTRL_MSG_BATCH_SIZE * MAX_IP_PKT_LEN);
+    data->send_batch = send_batch_new(CTRL_MSG_BATCH_SIZE);
+}
+
+static void
+tun_control_dp_batch_uninit(tun_ctr_dplane_data_t * data)
+{
+    int i;
+
+    for (i = 0; i < CTRL_MSG_BATCH_SIZE; i++){
+        lbuf_uninit(&data->msgs[i]);
+    }
+    free(data->msgs);
+    free(data->msgs_uc);
+    free(data->out_mem);
+    send_batch_del(data->send_batch);
+}
+
+/* Empty the receive buffers leaving headroom to push headers. The memory of
+ * a buffer may have been reallocated while processing its message */
+static void
+tun_control_dp_batch_reset(tun_ctr_dplane_data_t * data)
+{
+    lbuf_t *b;
+    int i;
+
+    for (i = 0; i < CTRL_MSG_BATCH_SIZE; i++){
+        b = &data->msgs[i];
+        lbuf_use(b, lbuf_base(b), b->allocated);
+        lbuf_reserve(b, MAX_LISP_MSG_ENCAP_LEN);
+        memset(&data->msgs_uc[i], 0, sizeof(uconn_t));
+    }
+}
+
+/* Queue a copy of the message: the caller may free it once sent. Messages
+ * that don't fit in a slot of out_mem are sent directly */
+static int
+tun_control_dp_batch_add(tun_ctr_dplane_data_t * data, int sock, lbuf_t *buff,
+        ip_addr_t *dst_addr)
+{
+    uint8_t *slot;
+
+    if (lbuf_size(buff) > MAX_IP_PKT_LEN) {
+        return (send_raw_packet(sock, lbuf_data(buff), lbuf_size(buff), dst_addr));
+    }
+    if (send_batch_count(data->send_batch) == CTRL_MSG_BATCH_SIZE) {
+        send_batch_flush(data->send_batch);
+    }
+    slot = data->out_mem + send_batch_count(data->send_batch) * MAX_IP_PKT_LEN;
+    memcpy(slot, lbuf_data(buff), lbuf_size(buff));
+
+    return (send_batch_add_packet(data->send_batch, sock, slot, lbuf_size(buff),
+            dst_addr, 0));
+}
@@ -21,10 +21,22 @@
 #define CDP_TUN_H_
 
 #include "../../../iface_list.h"
+#include "../../../lib/sockets-util.h"
+
+/* Max number of control messages read per wakeup of a control socket */
+#define CTRL_MSG_BATCH_SIZE     32
 
 typedef struct tun_ctr_dplane_data_{
     iface_t *default_ctrl_iface_v4;
     iface_t *default_ctrl_iface_v6;
+    /* Buffers reused to receive the control messages of a batch */
+    lbuf_t *msgs;
+    uconn_t *msgs_uc;
+    /* Messages sent while processing a batch are copied to out_mem and
+     * sent together once the batch has been processed */
+    uint8_t in_batch;
+    uint8_t *out_mem;
+    send_batch_t *send_batch;
 }tun_ctr_dplane_data_t;
 
 
@@ -29,6 +29,7 @@ static int ms_recv_enc_ctrl_msg(lisp_ms_t *ms, lbuf_t *msg, void **ecm_hdr, ucon
 static int ms_recv_map_request(lisp_ms_t *ms, lbuf_t *buf,  void *ecm_hdr, uconn_t *int_uc, uconn_t *ext_uc);
 static int ms_recv_map_register(lisp_ms_t *, lbuf_t *,void *ecm_hdr, uconn_t *int_uc, uconn_t *ext_uc);
 static int ms_recv_msg(oor_ctrl_dev_t *, lbuf_t *, uconn_t *);
+static void ms_recv_batch(oor_ctrl_dev_t *, lbuf_t *, int);
 
 
 
@@ -127,6 +128,234 @@ forward_mreq(lisp_ms_t *ms, lbuf_t *b, mapping_t *m)
 }
 
 
+/* Forget the last registered record of the site */
+static void
+ms_reg_site_unset_rec(lisp_ms_t *ms, lisp_reg_site_t *rsite)
+{
+    if (rsite->rec && int_htable_lookup(ms->reg_recs, rsite->rec_digest) == rsite){
+        int_htable_remove(ms->reg_recs, rsite->rec_digest);
+    }
+    lisp_reg_site_unset_rec(rsite);
+}
+
+/* Keep the bytes of the last accepted record of the site. The Map-Notify
+ * record built from the previous record is kept if the bytes didn't change */
+static void
+ms_reg_site_set_rec(lisp_ms_t *ms, lisp_reg_site_t *rsite,
+        lisp_site_prefix_t *reg_pref, uint8_t *rec, uint32_t len)
+{
+    uint32_t digest;
+
+    digest = lisp_reg_site_rec_digest(rec, len);
+    if (!rsite->rec || rsite->rec_digest != digest || rsite->rec_len != len
+            || rsite->site_pref != reg_pref || memcmp(rsite->rec, rec, len) != 0){
+        ms_reg_site_unset_rec(ms, rsite);
+        lisp_reg_site_set_rec(rsite, reg_pref, rec, len, digest);
+    }
+    /* In case of collision, the last registered site wins */
+    int_htable_insert(ms->reg_recs, digest, rsite);
+}
+
+/* Registered site whose last record is byte-identical to 'rec'. When a
+ * Map-Notify is requested, the record to answer must be available too */
+static lisp_reg_site_t *
+ms_lookup_unchanged_reg_site(lisp_ms_t *ms, uint8_t *rec, uint32_t len,
+        uint8_t need_ntf)
+{
+    lisp_reg_site_t *rsite;
+
+    if (len == 0){
+        return (NULL);
+    }
+    rsite = int_htable_lookup(ms->reg_recs, lisp_reg_site_rec_digest(rec, len));
+    if (!rsite || rsite->rec_len != len || memcmp(rsite->rec, rec, len) != 0
+            || (need_ntf && !rsite->ntf_rec)){
+        return (NULL);
+    }
+    return (rsite);
+}
+
+/* Authentication data of a Map-Register checked with its batch. Each result
+ * is only used once. BAD if the message has not been checked with the key */
+static int
+ms_auth_batch_result(lisp_ms_t *ms, lbuf_t *buf, void *mreg_auth_hdr,
+        hmac_key_t *key, int *res)
+{
+    hmac_auth_req_t *req;
+    int i;
+
+    for (i = 0; i < ms->auth_batch_count; i++) {
+        req = &ms->auth_batch_reqs[i];
+        if (ms->auth_batch_msgs[i] == buf && req->key == key
+                && req->auth_data_pos == AUTH_REC_DATA(mreg_auth_hdr)) {
+            ms->auth_batch_msgs[i] = NULL;
+            *res = req->res;
+            return (GOOD);
+        }
+    }
+    return (BAD);
+}
+
+/* The first record of the Map-Register is used to validate the message. The
+ * rest of records must share its key. All of them must be configured with
+ * the algorithm used by the message */
+static int
+ms_check_reg_site_key(lisp_ms_t *ms, lbuf_t *buf, void *mreg_auth_hdr,
+        lisp_site_prefix_t *reg_pref, lisp_addr_t *eid, hmac_key_t **key)
+{
+    int res;
+
+    if (ntohs(AUTH_REC_KEY_ID(mreg_auth_hdr)) != reg_pref->key_type) {
+        OOR_LOG(LDBG_1, "Map-Register for EID %s uses key id %d instead of the "
+                "configured %d. Discarding!", lisp_addr_to_char(eid),
+                ntohs(AUTH_REC_KEY_ID(mreg_auth_hdr)), reg_pref->key_type);
+        return (BAD);
+    }
+    if (!*key) {
+        if (ms_auth_batch_result(ms, buf, mreg_auth_hdr, reg_pref->key, &res) != GOOD) {
+            res = lisp_msg_check_auth_field(buf, mreg_auth_hdr, reg_pref->key);
+        }
+        if (res != GOOD) {
+            OOR_LOG(LDBG_1, "Message validation failed for EID %s with key "
+                    "%s. Stopping processing!", lisp_addr_to_char(eid),
+                    hmac_key_str(reg_pref->key));
+            return (BAD);
+        }
+        OOR_LOG(LDBG_2, "Message validated with key associated to EID %s",
+                lisp_addr_to_char(eid));
+        *key = reg_pref->key;
+    } else if (*key != reg_pref->key
+            && strcmp(hmac_key_str(*key), hmac_key_str(reg_pref->key)) != 0) {
+        OOR_LOG(LDBG_1, "EID %s part of multi EID Map-Register with different "
+                "key! Discarding!", lisp_addr_to_char(eid));
+        return (BAD);
+    }
+    return (GOOD);
+}
+
+/* Copy of a cached Map-Reply answering the Map-Request with 'nonce' */
+static lbuf_t *
+ms_cached_mrep_copy(lbuf_t *cached, uint64_t nonce)
+{
+    lbuf_t *mrep;
+
+    mrep = lisp_msg_create_buf();
+    lbuf_put(mrep, lbuf_data(cached), lbuf_size(cached));
+    MREP_NONCE(lisp_msg_hdr(mrep)) = nonce;
+    return (mrep);
+}
+
+static void
+ms_neg_rec_del(ms_neg_rec_t *nrec)
+{
+    free(nrec->rec);
+    free(nrec);
+}
+
+static void
+ms_neg_mreps_flush(lisp_ms_t *ms)
+{
+    if (mdb_n_entries(ms->neg_mreps_db) > 0){
+        mdb_del(ms->neg_mreps_db, (mdb_del_fct)ms_neg_rec_del);
+        ms->neg_mreps_db = mdb_new();
+    }
+}
+
+/* Keep the record of a negative Map-Reply for the rest of EIDs of its
+ * negative prefix. The table is emptied when it is full */
+static void
+ms_neg_rec_add(lisp_ms_t *ms, lisp_addr_t *neg_pref, lbuf_t *mrep)
+{
+    ms_neg_rec_t *nrec;
+
+    /* mdb_add_entry doesn't replace the data of an existing prefix */
+    if (mdb_lookup_entry_exact(ms->neg_mreps_db, neg_pref)){
+        return;
+    }
+    if (mdb_n_entries(ms->neg_mreps_db) >= MS_NEG_MREPS_MAX){
+        OOR_LOG(LDBG_1, "Negative Map-Replies cache full. Flushing it");
+        ms_neg_mreps_flush(ms);
+    }
+    nrec = xmalloc(sizeof(ms_neg_rec_t));
+    nrec->len = lbuf_size(mrep) - sizeof(map_reply_hdr_t);
+    nrec->rec = xmalloc(nrec->len);
+    memcpy(nrec->rec, (uint8_t *)lbuf_data(mrep) + sizeof(map_reply_hdr_t), nrec->len);
+    if (mdb_add_entry(ms->neg_mreps_db, neg_pref, nrec) != GOOD){
+        ms_neg_rec_del(nrec);
+    }
+}
+
+/* Negative Map-Reply for an EID not covered by any configured site. EIDs of
+ * an IID without sites get its whole address space and are not cached, as
+ * any IID can be requested */
+static lbuf_t *
+ms_neg_mrep_get(lisp_ms_t *ms, lisp_addr_t *deid, uint64_t nonce)
+{
+    ms_neg_rec_t *nrec;
+    lbuf_t *mrep;
+    lisp_addr_t *neg_pref, full;
+    uint8_t act_flag, cache;
+
+    nrec = mdb_lookup_entry(ms->neg_mreps_db, deid);
+    if (nrec){
+        mrep = lisp_msg_create(LISP_MAP_REPLY);
+        lisp_msg_put_mapping_rec(mrep, nrec->rec, nrec->len);
+        MREP_NONCE(lisp_msg_hdr(mrep)) = nonce;
+        return (mrep);
+    }
+
+    cache = !lisp_addr_is_iid(deid)
+            || _get_local_db_for_addr(ms->lisp_sites_db, deid) != NULL;
+    if (cache){
+        neg_pref = mdb_get_shortest_negative_prefix(ms->lisp_sites_db, deid);
+        if (!neg_pref){
+            return (NULL);
+        }
+    }else{
+        lisp_addr_ippref_from_char(lisp_addr_ip_afi(deid) == AF_INET ?
+                FULL_IPv4_ADDRESS_SPACE : FULL_IPv6_ADDRESS_SPACE, &full);
+        neg_pref = lisp_addr_clone(deid);
+        lisp_addr_copy_ip_pref(neg_pref, &full);
+    }
+    if (lisp_addr_is_iid(deid)){
+        act_flag = ACT_NO_ACTION;
+    }else{
+        act_flag = ACT_NATIVE_FWD;
+    }
+    /* send negative map-reply with TTL 15 min */
+    mrep = lisp_msg_neg_mrep_create(neg_pref, 15, act_flag, A_AUTHORITATIVE, nonce);
+    if (cache){
+        ms_neg_rec_add(ms, neg_pref, mrep);
+    }
+    lisp_addr_del(neg_pref);
+    return (mrep);
+}
+
+/* Map-Reply sent on behalf of a registered site */
+static lbuf_t *
+ms_proxy_mrep_get(lisp_reg_site_t *rsite)
+{
+    lbuf_t *mrep;
+    mapping_record_hdr_t *rec;
+
+    if (rsite->proxy_mrep){
+        return (rsite->proxy_mrep);
+    }
+
+    mrep = lisp_msg_create(LISP_MAP_REPLY);
+    rec = lisp_msg_put_mapping(mrep, rsite->site_map, NULL);
+    if (!rec){
+        lisp_msg_destroy(mrep);
+        return (NULL);
+    }
+    /* Set the authoritative bit of the record to false*/
+    MAP_REC_AUTH(rec) = A_NO_AUTHORITATIVE;
+    MREP_RLOC_PROBE(lisp_msg_hdr(mrep)) = 0;
+
+    rsite->proxy_mrep = mrep;
+    return (mrep);
+}
+
 /* Called when the timer associated with a registered lisp site expires. */
 static int
 lsite_entry_expiration_timer_cb(oor_timer_t *t)
@@ -141,6 +370,7 @@ lsite_entry_expiration_timer_cb(oor_timer_t *t)
             lisp_addr_to_char(addr));
 
     mdb_remove_entry(ms->reg_sites_db, addr);
+    ms_reg_site_unset_rec(ms, rsite);
     lisp_reg_site_del(rsite);
     ms_dump_registered_sites(ms, LDBG_3);
     return(GOOD);
@@ -220,19 +450,16 @@ ms_recv_map_request(lisp_ms_t *ms, lbuf_t *buf,  void *ecm_hdr, uconn_t *int_uc,
 
     lisp_addr_t *   seid        = NULL;
     lisp_addr_t *   deid        = NULL;
-    lisp_addr_t *   neg_pref    = NULL;
     lisp_addr_t *   aux_deid    = NULL;
     mapping_t *     map         = NULL;
     glist_t *       itr_rlocs   = NULL;
     void *          mreq_hdr    = NULL;
-    void *          mrep_hdr    = NULL;
-    mapping_record_hdr_t *  rec            = NULL;
     int             i           = 0;
     lbuf_t *        mrep        = NULL;
+    lbuf_t *        cached_mrep = NULL;
     lbuf_t  b;
     lisp_site_prefix_t *    site            = NULL;
     lisp_reg_site_t *       rsite           = NULL;
-    uint8_t act_flag;
     uconn_t send_uc;
 
     if (!ecm_hdr){
@@ -280,24 +507,19 @@ ms_recv_map_request(lisp_ms_t *ms, lbuf_t *buf,  void *ecm_hdr, uconn_t *int_uc,
         rsite = mdb_lookup_entry(ms->reg_sites_db, deid);
         /* Static entries will have null site and not null rsite */
         if (!site && !rsite) {
-            /* send negative map-reply with TTL 15 min */
-            neg_pref = mdb_get_shortest_negative_prefix(ms->lisp_sites_db, deid);
-
-            if (lisp_addr_is_iid(deid)){
-                act_flag = ACT_NO_ACTION;
-            }else{
-                act_flag = ACT_NATIVE_FWD;
-            }
-            mrep = lisp_msg_neg_mrep_create(neg_pref, 15, act_flag,A_AUTHORITATIVE,
-                    MREQ_NONCE(mreq_hdr));
             OOR_LOG(LDBG_1,"The requested EID %s doesn't belong to this Map Server",
                     lisp_addr_to_char(deid));
+            mrep = ms_neg_mrep_get(ms, deid, MREQ_NONCE(mreq_hdr));
+            if (!mrep) {
+                lisp_addr_del(deid);
+                continue;
+            }
             OOR_LOG(LDBG_2, "%s, EID: %s, NEGATIVE", lisp_msg_hdr_to_char(mrep),
                     lisp_addr_to_char(deid));
             send_msg(&ms->super, mrep, ext_uc);
             lisp_msg_destroy(mrep);
+            mrep = NULL;
             lisp_addr_del(deid);
-            lisp_addr_del(neg_pref);
 
             continue;
         }
@@ -337,15 +559,12 @@ ms_recv_map_request(lisp_ms_t *ms, lbuf_t *buf,  void *ecm_hdr, uconn_t *int_uc,
         OOR_LOG(LDBG_1,"The requested EID %s belongs to the registered prefix %s. Send Map Reply",
                 lisp_addr_to_char(deid), lisp_addr_to_char(mapping_eid(map)));
 
-        /* IF PROXY REPLY: build Map-Reply */
-        mrep = lisp_msg_create(LISP_MAP_REPLY);
-        rec = lisp_msg_put_mapping(mrep, map, NULL);
-        /* Set the authoritative bit of the record to false*/
-        MAP_REC_AUTH(rec) = A_NO_AUTHORITATIVE;
-
-        mrep_hdr = lisp_msg_hdr(mrep);
-        MREP_RLOC_PROBE(mrep_hdr) = 0;
-        MREP_NONCE(mrep_hdr) = MREQ_NONCE(mreq_hdr);
+        /* IF PROXY REPLY: copy the Map-Reply of the site */
+        cached_mrep = ms_proxy_mrep_get(rsite);
+        if (!cached_mrep) {
+            goto err;
+        }
+        mrep = ms_cached_mrep_copy(cached_mrep, MREQ_NONCE(mreq_hdr));
 
         /* SEND MAP-REPLY */
 
@@ -357,6 +576,7 @@ ms_recv_map_request(lisp_ms_t *ms, lbuf_t *buf,  void *ecm_hdr, uconn_t *int_uc,
             OOR_LOG(LDBG_1, "Couldn't send Map-Reply!");
         }
         lisp_msg_destroy(mrep);
+        mrep = NULL;
         lisp_addr_del(deid);
     }
 
@@ -380,14 +600,16 @@ ms_recv_map_register(lisp_ms_t *ms, lbuf_t *buf, void *ecm_hdr, uconn_t *int_uc,
     lisp_site_prefix_t *reg_pref = NULL;
     lisp_site_id site_id;
     lisp_xtr_id xtr_id;
-    char *key = NULL;
+    hmac_key_t *key = NULL;
     lisp_addr_t *eid;
     lbuf_t b,*mntf = NULL;
+    uint8_t *rec = NULL, *ntf_rec = NULL;
+    int rec_len;
     void *hdr = NULL, *mntf_hdr = NULL, *enc_mntf_hdr, *mreg_auth_hdr, *mnot_auth_hdr, *rtr_auth_hdr;
     int i = 0;
     mapping_t *m = NULL;
     locator_t *probed = NULL;
-    lisp_key_type_e keyid = HMAC_SHA_1_96; /* TODO configurable */
+    lisp_key_type_e keyid;
     int valid_records = FALSE;
     ms_rtr_node_t *rtr = NULL;
     uconn_t *uc;
@@ -402,20 +624,55 @@ ms_recv_map_register(lisp_ms_t *ms, lbuf_t *buf, void *ecm_hdr, uconn_t *int_uc,
         uc = int_uc;
     }
 
+    mreg_auth_hdr = lisp_msg_pull_auth_field(&b);
+    /* The Map-Notify is authenticated with the algorithm of the Map-Register */
+    keyid = ntohs(AUTH_REC_KEY_ID(mreg_auth_hdr));
+
     if (MREG_WANT_MAP_NOTIFY(hdr)) {
         mntf = lisp_msg_create(LISP_MAP_NOTIFY);
         lisp_msg_put_empty_auth_record(mntf, keyid);
     }
 
 
-    mreg_auth_hdr = lisp_msg_pull_auth_field(&b);
-
-
     for (i = 0; i < MREG_REC_COUNT(hdr); i++) {
+        /* The mapping of the previous record belongs now to its site */
+        m = NULL;
+        rec = lbuf_data(&b);
+        rec_len = lisp_msg_mapping_record_len(&b);
+
+        /* Refresh of an unchanged record: the site only has to be validated
+         * and its registration extended */
+        rsite = ms_lookup_unchanged_reg_site(ms, rec, rec_len, mntf != NULL);
+        if (rsite) {
+            eid = mapping_eid(rsite->site_map);
+            if (MAP_REC_AUTH(rec) == 0){
+                OOR_LOG(LWRN,"ms_recv_map_register: Received a none authoritative record in a Map Register: %s",
+                        lisp_addr_to_char(eid));
+            }
+            if (ms_check_reg_site_key(ms, buf, mreg_auth_hdr, rsite->site_pref,
+                    eid, &key) != GOOD) {
+                goto err;
+            }
+            OOR_LOG(LDBG_2, "Prefix %s registered again without changes",
+                    lisp_addr_to_char(eid));
+            rsite->proxy_reply = MREG_PROXY_REPLY(hdr);
+            lsite_entry_update_expiration_timer(ms, rsite);
+            if (mntf) {
+                lisp_msg_put_mapping_rec(mntf, rsite->ntf_rec, rsite->ntf_rec_len);
+                valid_records = TRUE;
+            }
+            lbuf_pull(&b, rec_len);
+            continue;
+        }
+
         m = mapping_new();
         if (lisp_msg_parse_mapping_record(&b, m, &probed) != GOOD) {
             goto err;
         }
+        /* Only records whose length is known can be compared later */
+        if ((uint8_t *)lbuf_data(&b) - rec != rec_len) {
+            rec_len = 0;
+        }
 
         if (mapping_auth(m) == 0){
             OOR_LOG(LWRN,"ms_recv_map_register: Received a none authoritative record in a Map Register: %s",
@@ -438,21 +695,7 @@ ms_recv_map_register(lisp_ms_t *ms, lbuf_t *buf, void *ecm_hdr, uconn_t *int_uc,
         }
 
         /* CHECK AUTH */
-
-        /* if first record, lookup the key */
-        if (!key) {
-            if (lisp_msg_check_auth_field(buf, mreg_auth_hdr, reg_pref->key) != GOOD) {
-                OOR_LOG(LDBG_1, "Message validation failed for EID %s with key "
-                        "%s. Stopping processing!", lisp_addr_to_char(eid),
-                        reg_pref->key);
-                goto err;
-            }
-            OOR_LOG(LDBG_2, "Message validated with key associated to EID %s",
-                    lisp_addr_to_char(eid));
-            key = reg_pref->key;
-        } else if (strncmp(key, reg_pref->key, strlen(key)) !=0 ) {
-            OOR_LOG(LDBG_1, "EID %s part of multi EID Map-Register with different "
-                    "key! Discarding!", lisp_addr_to_char(eid));
+        if (ms_check_reg_site_key(ms, buf, mreg_auth_hdr, reg_pref, eid, &key) != GOOD) {
             goto err;
         }
 
@@ -486,6 +729,7 @@ ms_recv_map_register(lisp_ms_t *ms, lbuf_t *buf, void *ecm_hdr, uconn_t *int_uc,
                     OOR_LOG(LDBG_3, "Prefix %s already registered, updating "
                             "locators", lisp_addr_to_char(eid));
                     mapping_update_locators(rsite->site_map,mapping_locators_lists(m));
+                    lisp_reg_site_unset_proxy_mrep(rsite);
                 } else {
                     /* TREAT MERGE SEMANTICS */
                     OOR_LOG(LWRN, "Prefix %s has merge semantics",
@@ -507,9 +751,20 @@ ms_recv_map_register(lisp_ms_t *ms, lbuf_t *buf, void *ecm_hdr, uconn_t *int_uc,
             ms_dump_registered_sites(ms, LDBG_3);
         }
 
+        /* Merged sites don't match a single record */
+        if (rec_len > 0 && !reg_pref->merge) {
+            ms_reg_site_set_rec(ms, rsite ? rsite : new_rsite, reg_pref, rec, rec_len);
+        } else {
+            ms_reg_site_unset_rec(ms, rsite ? rsite : new_rsite);
+        }
+
         if (mntf) {
-            lisp_msg_put_mapping(mntf, m, NULL);
+            ntf_rec = lisp_msg_put_mapping(mntf, m, NULL);
             valid_records = TRUE;
+            if (ntf_rec && rec_len > 0 && !reg_pref->merge) {
+                lisp_reg_site_set_ntf_rec(rsite ? rsite : new_rsite, ntf_rec,
+                        (uint8_t *)lbuf_tail(mntf) - ntf_rec);
+            }
         }
 
         /* if site previously registered, just remove the parsed mapping */
@@ -571,7 +826,7 @@ ms_recv_map_register(lisp_ms_t *ms, lbuf_t *buf, void *ecm_hdr, uconn_t *int_uc,
                 ECM_SECURITY_BIT(enc_mntf_hdr) = 1;
             }else{
                 if (MNTF_R_BIT(mntf_hdr)){
-                    rtr_auth_hdr = lisp_msg_put_empty_auth_record(mntf, keyid);
+                    rtr_auth_hdr = lisp_msg_put_empty_auth_record(mntf, rtr->key_type);
                     lisp_msg_fill_auth_data(mntf,rtr_auth_hdr,rtr->key_type, rtr->passwd);
                 }
             }
@@ -632,10 +887,16 @@ ms_recv_inf_request(lisp_ms_t *ms, lbuf_t *buf, uconn_t *uc)
 
     /* Verify authentication of the msg */
 
+    if (ntohs(AUTH_REC_KEY_ID(req_auth_hdr)) != reg_pref->key_type) {
+        OOR_LOG(LDBG_1, "Info Request for EID %s uses key id %d instead of the "
+                "configured %d. Discarding!", lisp_addr_to_char(eid),
+                ntohs(AUTH_REC_KEY_ID(req_auth_hdr)), reg_pref->key_type);
+        goto err;
+    }
     if (lisp_msg_check_auth_field(buf, req_auth_hdr, reg_pref->key) != GOOD) {
         OOR_LOG(LDBG_1, "Info Request validation failed for EID %s with key "
                 "%s. Stopping processing!", lisp_addr_to_char(eid),
-                reg_pref->key);
+                hmac_key_str(reg_pref->key));
         goto err;
     }
 
@@ -692,6 +953,8 @@ ms_add_lisp_site_prefix(lisp_ms_t *ms, lisp_site_prefix_t *sp)
 
     if(!mdb_add_entry(ms->lisp_sites_db, lsite_prefix(sp), sp))
         return(BAD);
+    /* The negative prefixes of the new site may be smaller */
+    ms_neg_mreps_flush(ms);
     return(GOOD);
 }
 
@@ -758,6 +1021,54 @@ lisp_ms_cast(oor_ctrl_dev_t *dev)
     return(CONTAINER_OF(dev, lisp_ms_t, super));
 }
 
+/* Verify together the authentication data of the Map-Registers of a batch
+ * that refresh a registration without changes, the usual case of a loaded
+ * Map-Server. The first record selects the key, as in ms_recv_map_register */
+static void
+ms_recv_batch(oor_ctrl_dev_t *dev, lbuf_t *msgs, int nmsgs)
+{
+    lisp_ms_t *ms = lisp_ms_cast(dev);
+    lisp_reg_site_t *rsite;
+    hmac_auth_req_t *req;
+    lbuf_t b;
+    void *hdr, *auth_hdr;
+    uint16_t keyid, ad_len;
+    int i;
+
+    ms->auth_batch_count = 0;
+    for (i = 0; i < nmsgs && ms->auth_batch_count < MS_AUTH_BATCH_SIZE; i++) {
+        b = msgs[i];
+        if (lbuf_size(&b) < sizeof(map_register_hdr_t) + sizeof(auth_record_hdr_t)
+                || lisp_msg_type(&b) != LISP_MAP_REGISTER) {
+            continue;
+        }
+        hdr = lisp_msg_pull_hdr(&b);
+        auth_hdr = lbuf_data(&b);
+        keyid = ntohs(AUTH_REC_KEY_ID(auth_hdr));
+        ad_len = auth_data_get_len_for_type(keyid);
+        if (MREG_REC_COUNT(hdr) == 0 || ad_len != ntohs(AUTH_REC_DATA_LEN(auth_hdr))
+                || lbuf_size(&b) < sizeof(auth_record_hdr_t) + ad_len) {
+            continue;
+        }
+        lisp_msg_pull_auth_field(&b);
+        rsite = ms_lookup_unchanged_reg_site(ms, lbuf_data(&b),
+                lisp_msg_mapping_record_len(&b), MREG_WANT_MAP_NOTIFY(hdr));
+        if (!rsite || rsite->site_pref->key_type != keyid) {
+            continue;
+        }
+        ms->auth_batch_msgs[ms->auth_batch_count] = &msgs[i];
+        req = &ms->auth_batch_reqs[ms->auth_batch_count++];
+        req->key_id = keyid;
+        req->key = rsite->site_pref->key;
+        req->packet = lbuf_lisp(&msgs[i]);
+        req->pckt_len = lbuf_size(&msgs[i]);
+        req->auth_data_pos = AUTH_REC_DATA(auth_hdr);
+    }
+    if (ms->auth_batch_count > 0) {
+        check_auth_fields_batch(ms->auth_batch_reqs, ms->auth_batch_count);
+    }
+}
+
 static int
 ms_recv_msg(oor_ctrl_dev_t *dev, lbuf_t *msg, uconn_t *uc)
 {
@@ -853,6 +1164,8 @@ ms_ctrl_construct(oor_ctrl_dev_t *dev)
 
     ms->reg_sites_db = mdb_new();
     ms->lisp_sites_db = mdb_new();
+    ms->reg_recs = int_htable_new();
+    ms->neg_mreps_db = mdb_new();
 
     ms->rtrs_set_table = shash_new_managed((free_value_fn_t)ms_rtr_set_del);
     // rtrs_table_by_name and rtrs_table_by_ip points to the same pointers value. Only one
@@ -876,6 +1189,8 @@ ms_ctrl_destruct(oor_ctrl_dev_t *dev)
     lisp_ms_t *ms = lisp_ms_cast(dev);
     mdb_del(ms->lisp_sites_db, (mdb_del_fct)lisp_site_prefix_del);
     mdb_del(ms->reg_sites_db, (mdb_del_fct)lisp_reg_site_del);
+    int_htable_destroy(ms->reg_recs);
+    mdb_del(ms->neg_mreps_db, (mdb_del_fct)ms_neg_rec_del);
     shash_destroy(ms->rtrs_set_table);
     shash_destroy(ms->rtrs_table_by_name);
     shash_destroy(ms->rtrs_table_by_ip);
@@ -914,6 +1229,7 @@ ctrl_dev_class_t ms_ctrl_class = {
         .destruct = ms_ctrl_destruct,
         .run = ms_ctrl_run,
         .recv_msg = ms_recv_msg,
+        .recv_batch = ms_recv_batch,
         .if_link_update = ms_if_link_update,
         .if_addr_update = ms_if_addr_update,
         .route_update = ms_route_update,
@@ -934,7 +1250,7 @@ ms_rtr_node_new_init(char *id, lisp_addr_t *addr, char *passwd)
     }
     rtr->id = strdup(id);
     rtr->addr = lisp_addr_clone(addr);
-    rtr->passwd = strdup(passwd);
+    rtr->passwd = hmac_key_new(passwd);
     // Message Authentication Code hardcoded
     rtr->key_type = HMAC_SHA_1_96;
 
@@ -946,7 +1262,7 @@ ms_rtr_node_del(ms_rtr_node_t * rtr)
 {
     lisp_addr_del(rtr->addr);
     free(rtr->id);
-    free(rtr->passwd);
+    hmac_key_del(rtr->passwd);
     free(rtr);
 }
 
@@ -21,6 +21,7 @@
 #define LISP_MS_H_
 
 #include "oor_ctrl_device.h"
+#include "../lib/int_table.h"
 #include "../lib/lisp_site.h"
 
 typedef struct _rtr_set {
@@ -33,15 +34,31 @@ typedef struct _rtr_node_t {
     char *id;
     lisp_addr_t *addr;
     lisp_key_type_e key_type;
-    char *passwd;
+    hmac_key_t *passwd;
 }ms_rtr_node_t;
 
+/* Max number of Map-Registers of a received batch verified together */
+#define MS_AUTH_BATCH_SIZE  32
+/* Max number of negative prefixes whose Map-Reply is cached */
+#define MS_NEG_MREPS_MAX    16384
+
+/* Record of the negative Map-Reply of a negative prefix */
+typedef struct _ms_neg_rec {
+    uint8_t *rec;
+    int len;
+} ms_neg_rec_t;
+
 typedef struct _lisp_ms {
     oor_ctrl_dev_t super;    /* base "class" */
 
     /* ms members */
     mdb_t *lisp_sites_db;
     mdb_t *reg_sites_db;
+    /* Registered sites indexed by the digest of their last record */
+    int_htable *reg_recs; // <key= digest , value= lisp_reg_site_t *>
+    /* Records of the negative Map-Replies for the EIDs not covered by the
+     * configured sites, indexed by the negative prefix they answer */
+    mdb_t *neg_mreps_db; // <ms_neg_rec_t *>
 
     /* List of lists of RTRs used for NAT Traversal */
     shash_t *rtrs_set_table; // <key= id , value= rtr_set_t *>
@@ -49,6 +66,12 @@ typedef struct _lisp_ms {
     shash_t *rtrs_table_by_name; // <key= id , value= rtr_node_t *>
     shash_t *rtrs_table_by_ip; // <key= ip_str , value= rtr_node_t *>
     ms_rtr_set_t *def_rtr_set;
+
+    /* Map-Registers of the batch being received whose authentication data
+     * has been verified together, and the result of each one */
+    lbuf_t *auth_batch_msgs[MS_AUTH_BATCH_SIZE];
+    hmac_auth_req_t auth_batch_reqs[MS_AUTH_BATCH_SIZE];
+    int auth_batch_count;
 } lisp_ms_t;
 
 
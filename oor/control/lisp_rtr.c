@@ -176,6 +176,9 @@ rtr_run(oor_ctrl_dev_t *dev)
     OOR_LOG(LINF, "Active interfaces status");
     rtr->tr.fwd_policy->updated_map_loc_inf(rtr->tr.fwd_policy_dev_parm,rtr->all_locs_map);
     OOR_LOG(LINF, "%s", mapping_to_char(mapping));
+
+    /* Restore the map cache saved before the last shutdown */
+    tr_mcache_snapshot_start(&rtr->tr);
 }
 
 static int
@@ -448,11 +451,16 @@ rtr_get_forwarding_entry(oor_ctrl_dev_t *dev, packet_tuple_t *tuple)
         /* Get the temporal mce created */
         mce = mcache_lookup(rtr->tr.map_cache, dst_eid);
         fwd_info->associated_entry = lisp_addr_clone(mcache_entry_eid(mce));
+        fwd_info->map_pending = TRUE;
     } else{
         fwd_info->associated_entry = lisp_addr_clone(mcache_entry_eid(mce));
         if (mcache_entry_active(mce) == NOT_ACTIVE) {
             OOR_LOG(LDBG_2, "Already sent Map-Request for %s. Waiting for reply!",
                     lisp_addr_to_char(dst_eid));
+            fwd_info->map_pending = TRUE;
+        }else{
+            /* Used to refresh the entry before it expires */
+            fwd_info_set_activity(fwd_info, mce->activity);
         }
     }
 
@@ -724,7 +732,7 @@ rtr_recv_map_notify(lisp_rtr_t *rtr, lbuf_t *buf, void *ecm_hdr, uconn_t *int_uc
         }
 
         /* Find the RTR auth_hdr and validate RTR authentication*/
-        auth_hdr = hdr + lbuf_size(buf) - auth_data_get_len_for_type(HMAC_SHA_1_96) - sizeof(auth_record_hdr_t);
+        auth_hdr = hdr + lbuf_size(buf) - auth_data_get_len_for_type(ms_node->key_type) - sizeof(auth_record_hdr_t);
         res = lisp_msg_check_auth_field(buf,auth_hdr, ms_node->key);
         if (res != GOOD){
             OOR_LOG(LDBG_1, "Map-Notify message is invalid");
@@ -786,6 +794,7 @@ rtr_recv_map_notify(lisp_rtr_t *rtr, lbuf_t *buf, void *ecm_hdr, uconn_t *int_uc
         /* If the mapping has changed, reset the entries of the data plane associated with
          * the affected cache entry */
         if (res == UPDATED){
+            mcache_update_entry_size(rtr->tr.map_cache, mce);
             rtr->tr.fwd_policy->updated_map_cache_inf(rtr->tr.fwd_policy_dev_parm,mce);
             notify_datap_rm_fwd_from_entry(&rtr->super, eid, FALSE);
         }
@@ -884,6 +893,7 @@ rtr_nat_loc_expire_cb(oor_timer_t *timer)
         OOR_LOG(LDBG_1,"Got expiration for EID %s", lisp_addr_to_char(mcache_entry_eid(mce)));
         tr_mcache_remove_entry(&rtr->tr, mce);
     }else{
+        mcache_update_entry_size(rtr->tr.map_cache, mce);
         /* Notify of the change of the map cache entry to the data plane */
         notify_datap_rm_fwd_from_entry(&rtr->super,mcache_entry_eid(mce),FALSE);
     }
@@ -964,7 +974,7 @@ rtr_ms_node_new_init(lisp_addr_t *addr, char *key, nat_version version)
         return(NULL);
     }
     ms_node->addr = lisp_addr_clone(addr);
-    ms_node->key = strdup(key);
+    ms_node->key = hmac_key_new(key);
     ms_node->key_type = HMAC_SHA_1_96;
     ms_node->nat_version = version;
 
@@ -975,7 +985,7 @@ void
 rtr_ms_node_destroy(rtr_ms_node_t *ms_node)
 {
     lisp_addr_del(ms_node->addr);
-    free(ms_node->key);
+    hmac_key_del(ms_node->key);
     free(ms_node);
 }
 
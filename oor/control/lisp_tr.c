@@ -17,6 +17,10 @@
  *
  */
 
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+
 #include "lisp_tr.h"
 #include "../lib/iface_locators.h"
 #include "../lib/nonces_table.h"
@@ -25,11 +29,63 @@
 #include "../lib/timers_utils.h"
 #include "../oor_external.h"
 
+/* Gains of the smoothed RTT, RTT variation and loss of the RLOC probes, as
+ * shifts (RFC 6298) */
+#define RTT_ALPHA_SHIFT         3
+#define RTTVAR_BETA_SHIFT       2
+#define LOSS_SHIFT              3
+/* Change of the measurements of an RLOC required to update the metrics seen
+ * by the forwarding policy: 1/4 of its delay (at least 1 ms) or 5% of loss */
+#define FWD_METRICS_DELAY_SHIFT 2
+#define FWD_METRICS_MIN_DELAY   1000
+#define FWD_METRICS_LOSS        50
+/* An entry is refreshed if it has been used in the last max(lead time of the
+ * refresh, MC_REFRESH_MIN_IDLE) seconds. The lead time must leave room for a
+ * retransmission */
+#define MC_REFRESH_MIN_IDLE     60
+#define MC_REFRESH_MIN_LEAD     (2 * OOR_INITIAL_MRQ_TIMEOUT)
+/* The entries loaded from a snapshot are revalidated at a random instant of
+ * a window long enough to send at most MC_SNAPSHOT_MRQ_RATE Map-Requests per
+ * second, and at least MC_SNAPSHOT_MIN_WINDOW seconds long */
+#define MC_SNAPSHOT_MRQ_RATE    50
+#define MC_SNAPSHOT_MIN_WINDOW  30
+
+/* Map cache snapshot: a header followed by a record per entry with the time
+ * it expires, the mapping in the format of a Map-Reply record and the EID
+ * that requested it. Integers are in network byte order */
+#define MC_SNAPSHOT_MAGIC       0x4f4d4353 /* "OMCS" */
+#define MC_SNAPSHOT_VERSION     1
+#define MC_SNAPSHOT_REQUESTER   0x01
+/* Expected size of a record, used to size the buffer of the snapshot */
+#define MC_SNAPSHOT_REC_SIZE    128
+
+typedef struct mc_snapshot_hdr_ {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+} mc_snapshot_hdr_t;
+
+typedef struct mc_snapshot_rec_hdr_ {
+    uint32_t expires;   /* Wall clock time in seconds */
+    uint16_t len;       /* Length of the mapping and the requester */
+    uint8_t flags;
+    uint8_t reserved;
+} mc_snapshot_rec_hdr_t;
 
 /************************** Function declaration *****************************/
 
 static void *tr_get_device(lisp_tr_t *tr);
 static oor_ctrl_dev_t * tr_get_ctrl_device(lisp_tr_t *tr);
+static tr_probed_rloc_t *tr_probed_rloc_new(lisp_tr_t *tr, lisp_addr_t *addr, uint8_t state);
+static void tr_probed_rloc_del(tr_probed_rloc_t *prloc);
+static lisp_addr_t *tr_probed_rloc_eid(tr_probed_rloc_t *prloc);
+static void tr_release_probed_rlocs(lisp_tr_t *tr, mcache_entry_t *mce,
+        glist_t *prlocs, glist_t *kept);
+static void tr_probed_rloc_set_state(lisp_tr_t *tr, tr_probed_rloc_t *prloc, uint8_t state);
+static inline uint64_t tr_time_us();
+static int tr_mcache_evict_timer_cb(oor_timer_t *timer);
+static void tr_probed_rloc_sample(lisp_tr_t *tr, tr_probed_rloc_t *prloc,
+        uint64_t rtt, uint8_t lost);
 
 /*****************************************************************************/
 
@@ -40,10 +96,19 @@ lisp_tr_init(lisp_tr_t *tr)
     tr->map_cache = mcache_new();
     tr->map_resolvers = glist_new_managed((glist_del_fct)lisp_addr_del);
     tr->iface_locators_table = shash_new_managed((free_value_fn_t)iface_locators_del);
+    tr->probed_rlocs = shash_new_managed((free_value_fn_t)tr_probed_rloc_del);
+    tr->mce_probed_rlocs = htable_ptrs_new_managed((free_value_fn_t)glist_destroy);
+    tr->map_cache_refresh = DEFAULT_MAP_CACHE_REFRESH;
+    tr->mc_snapshot_interval = DEFAULT_MAP_CACHE_SNAPSHOT_INTERVAL;
+    tr->mc_evict_timer = oor_timer_create(MAP_CACHE_EVICT_TIMER);
+    oor_timer_init(tr->mc_evict_timer, tr, tr_mcache_evict_timer_cb, tr, NULL, NULL);
     /* fwd_policy and fwd_policy_dev_parm are initialized during configuration process */
-    if (!tr->map_cache || !tr->map_resolvers || !tr->iface_locators_table){
+    if (!tr->map_cache || !tr->map_resolvers || !tr->iface_locators_table
+            || !tr->probed_rlocs || !tr->mce_probed_rlocs){
         return (BAD);
     }
+    mcache_set_limits(tr->map_cache, DEFAULT_MAP_CACHE_MAX_ENTRIES,
+            DEFAULT_MAP_CACHE_MAX_MEM * 1024, MCACHE_EVICT_LRU);
     return (GOOD);
 }
 
@@ -54,7 +119,17 @@ lisp_tr_uninit(lisp_tr_t *tr)
         return;
     }
 
+    if (tr->mc_snapshot_started){
+        tr_mcache_snapshot_save(tr);
+    }
+    stop_timers_from_obj(tr,ptrs_to_timers_ht, nonces_ht);
+    oor_timer_stop(tr->mc_evict_timer);
+    free(tr->mc_snapshot_file);
+
     shash_destroy(tr->iface_locators_table);
+    /* Probed RLOCs point to the map cache entries. Remove them first */
+    htable_ptrs_destroy(tr->mce_probed_rlocs);
+    shash_destroy(tr->probed_rlocs);
     mcache_del(tr->map_cache);
     glist_destroy(tr->map_resolvers);
     if (tr->fwd_policy_dev_parm){
@@ -92,14 +167,16 @@ tr_recv_map_reply(lisp_tr_t *tr, lbuf_t *buf, uconn_t *udp_con)
 {
     void *mrep_hdr;
     locator_t *probed;
-    lisp_addr_t *probed_addr;
+    lisp_addr_t *pending_eid = NULL;
     lbuf_t b;
     mcache_entry_t *mce;
     mapping_t *m;
     nonces_list_t *nonces_lst;
     oor_timer_t *timer;
     timer_map_req_argument *t_mr_arg;
+    lisp_addr_t *requester = NULL;
     int records,active_entry,i;
+    uint8_t changed;
 
     /* local copy */
     b = *buf;
@@ -123,6 +200,11 @@ tr_recv_map_reply(lisp_tr_t *tr, lbuf_t *buf, uconn_t *udp_con)
         active_entry = mcache_entry_active(mce);
         if (!active_entry){
             records = MREP_REC_COUNT(mrep_hdr);
+            /* The packets waiting for the placeholder are forwarded once the
+             * new mapping is installed */
+            pending_eid = lisp_addr_clone(mcache_entry_eid(mce));
+            /* Used as source EID of the Map-Requests refreshing the entry */
+            requester = lisp_addr_clone(t_mr_arg->src_eid);
             /* delete placeholder/dummy mapping inorder to install the new one */
             tr_mcache_remove_entry(tr, mce);
             /* Timers are removed during the process of deleting the mce*/
@@ -157,9 +239,13 @@ tr_recv_map_reply(lisp_tr_t *tr, lbuf_t *buf, uconn_t *udp_con)
                 /* DO NOT free mapping in this case */
                 mce = tr_mcache_add_mapping(tr, m, MCE_DYNAMIC, ACTIVE);
                 if (mce){
+                    mcache_entry_set_requester(mce, requester);
                     tr_mcache_entry_program_timers(tr,mce);
                     OOR_LOG(LDBG_1, "Added Map Cache entry with EID prefix %s in the database.",
                             lisp_addr_to_char(mapping_eid(m)));
+                    /* Flows and EID prefixes cached by the data plane that
+                     * cover the new prefix are no longer valid for it */
+                    notify_datap_rm_fwd_from_entry(tr_get_ctrl_device(tr),mapping_eid(m),FALSE);
                 }else{
                     OOR_LOG(LERR, "Can't add Map Cache entry with EID prefix %s. Discarded ...",
                             mapping_eid(m));
@@ -168,52 +254,41 @@ tr_recv_map_reply(lisp_tr_t *tr, lbuf_t *buf, uconn_t *udp_con)
                 }
                 /* Mapping is ACTIVE */
             } else {
-                /* the reply might be for an active mapping (SMR)*/
-                if (tr_update_mcache_entry(tr, m) == GOOD){
+                /* the reply might be for an active mapping (SMR or refresh)*/
+                if (tr_update_mcache_entry(tr, m, &changed) == GOOD){
+                    if (oor_timer_type(timer) == REFRESH_MAP_CACHE_TIMER){
+                        /* Replaced by the refresh of the new TTL */
+                        stop_timer_from_obj(t_mr_arg->mce,timer,ptrs_to_timers_ht,nonces_ht);
+                        timer = NULL;
+                    }
                     mce = mcache_lookup_exact(tr->map_cache, mapping_eid(m));
                     tr_mcache_entry_program_timers(tr, mce);
-                    /* Update data plane */
-                    notify_datap_rm_fwd_from_entry(tr_get_ctrl_device(tr),mapping_eid(m),FALSE);
+                    /* Update data plane. The flows of an unchanged mapping
+                     * are kept */
+                    if (changed){
+                        notify_datap_rm_fwd_from_entry(tr_get_ctrl_device(tr),mapping_eid(m),FALSE);
+                    }
                     mapping_del(m);
                 }
             }
 
             mcache_dump_db(tr->map_cache, LDBG_3);
         }
-    }else{
-        if (MREP_REC_COUNT(mrep_hdr) >1){
-            OOR_LOG(LDBG_1,"Received Map Reply Probe with multiple records. Only first one will be processed");
+        if (pending_eid){
+            notify_datap_flush_pending(tr_get_ctrl_device(tr), pending_eid, TRUE);
+            lisp_addr_del(pending_eid);
         }
-        records = 1;
-        for (i = 0; i < records; i++) {
-            m = mapping_new();
-            if (lisp_msg_parse_mapping_record(&b, m, &probed) != GOOD) {
-                goto err;
-            }
-            if (mapping_has_elp_with_l_bit(m)){
-                OOR_LOG(LDBG_1,"Received a Map Reply with an ELP with the L bit set. "
-                        "Not supported -> Discrding map reply");
-                goto err;
-            }
-
-            if (probed != NULL){
-                probed_addr = locator_addr(probed);
-            }else{
-                probed_addr = &(udp_con->ra);
-            }
-
-            mce = mcache_lookup_exact(tr->map_cache, mapping_eid(m));
-            if (!mce){
-                OOR_LOG(LDBG_2,"Received a non requested Map Reply probe");
-                return (BAD);
-            }
-
-            handle_locator_probe_reply(tr, mce, probed_addr);
-
-            /* No need to free 'probed' since it's a pointer to a locator in
-             * of m's */
-            mapping_del(m);
+        lisp_addr_del(requester);
+    }else{
+        /* The nonce identifies the probed RLOC. Its timer is shared by all the
+         * map cache entries using the RLOC and is reprogrammed, not removed */
+        if (oor_timer_type(timer) != RLOC_PROBING_TIMER){
+            OOR_LOG(LDBG_2,"Received a non requested Map Reply probe");
+            return (BAD);
         }
+        return (handle_locator_probe_reply(tr,
+                (tr_probed_rloc_t *)oor_timer_cb_argument(timer),
+                MREP_NONCE(mrep_hdr)));
     }
     if (timer != NULL){
         /* Remove nonces_lst and associated timer*/
@@ -222,6 +297,11 @@ tr_recv_map_reply(lisp_tr_t *tr, lbuf_t *buf, uconn_t *udp_con)
 
     return(GOOD);
 err:
+    if (pending_eid){
+        notify_datap_flush_pending(tr_get_ctrl_device(tr), pending_eid, FALSE);
+        lisp_addr_del(pending_eid);
+    }
+    lisp_addr_del(requester);
     locator_del(probed);
     mapping_del(m);
     return(BAD);
@@ -395,23 +475,20 @@ tr_build_and_send_encap_map_request(lisp_tr_t *tr, lisp_addr_t *seid,
     return(GOOD);
 }
 
-/* Send a Map-Request probe to check status of 'loc' */
+/* Send a Map-Request probe for 'deid' to check status of the RLOC 'drloc' */
 int
-tr_build_and_send_mreq_probe(lisp_tr_t *tr, mapping_t *map, locator_t *loc, uint64_t nonce)
+tr_build_and_send_mreq_probe(lisp_tr_t *tr, lisp_addr_t *deid, lisp_addr_t *drloc,
+        uint64_t nonce)
 {
     uconn_t uc;
-    lisp_addr_t * deid, *drloc, empty;
+    lisp_addr_t empty;
     lbuf_t * b;
     glist_t * rlocs = NULL;
     void * hdr = NULL;
     int ret;
     oor_ctrl_t *ctrl;
 
-    deid = mapping_eid(map);
-
     ctrl = ctrl_dev_get_ctrl_t(tr_get_ctrl_device(tr));
-    // XXX alopez -> What we have to do with ELP and probe bit
-    drloc = tr->fwd_policy->get_fwd_ip_addr(locator_addr(loc), ctrl_rlocs(ctrl));
     lisp_addr_set_lafi(&empty, LM_AFI_NO_ADDR);
 
     rlocs = ctrl_default_rlocs(ctrl);
@@ -477,6 +554,436 @@ tr_mc_entry_program_expiration_timer2(lisp_tr_t *tr, mcache_entry_t *mce, int ti
     }
 }
 
+/************************* Map Cache refresh-ahead ***************************/
+
+/* The entry has been used by the data plane recently enough to be refreshed
+ * before it expires */
+static uint8_t
+tr_mc_entry_in_use(lisp_tr_t *tr, mcache_entry_t *mce)
+{
+    uint32_t idle, window;
+
+    window = (uint64_t)mapping_ttl(mcache_entry_mapping(mce)) * 60 * tr->map_cache_refresh / 100;
+    if (window < MC_REFRESH_MIN_IDLE){
+        window = MC_REFRESH_MIN_IDLE;
+    }
+    idle = (uint32_t)(tr_time_us() / 1000000) - mcache_activity_last_used(mce->activity);
+
+    return (idle <= window);
+}
+
+/* Send a Map-Request for an entry about to expire if it is still in use. The
+ * reply updates the entry in place. Without reply, the entry expires */
+int
+tr_mc_entry_refresh_timer_cb(oor_timer_t *timer)
+{
+    timer_map_req_argument *timer_arg = (timer_map_req_argument *)oor_timer_cb_argument(timer);
+    nonces_list_t *nonces_list = oor_timer_nonces(timer);
+    tr_abstract_device *tr_dev = oor_timer_owner(timer);
+    lisp_tr_t *tr = &tr_dev->tr;
+    mcache_entry_t *mce = timer_arg->mce;
+    lisp_addr_t *deid = mcache_entry_eid(mce);
+    int retries = nonces_list_size(nonces_list);
+    uint64_t nonce;
+
+    if (retries == 0 && !tr_mc_entry_in_use(tr, mce)){
+        OOR_LOG(LDBG_2, "The map cache entry of EID %s is not in use. Letting it expire",
+                lisp_addr_to_char(deid));
+        stop_timer_from_obj(mce,timer,ptrs_to_timers_ht,nonces_ht);
+        return (GOOD);
+    }
+    if (retries - 1 < tr->map_request_retries) {
+        OOR_LOG(LDBG_1, "Refreshing the map cache entry of EID %s (%d retries)",
+                lisp_addr_to_char(deid), retries);
+        nonce = nonce_new();
+        if (tr_build_and_send_encap_map_request(tr, timer_arg->src_eid, mce, nonce) != GOOD){
+            return (BAD);
+        }
+        htable_nonces_insert(nonces_ht, nonce, nonces_list);
+        oor_timer_start(timer, OOR_INITIAL_MRQ_TIMEOUT);
+        return (GOOD);
+    }
+    OOR_LOG(LDBG_1, "No Map-Reply refreshing EID %s after %d retries. Letting it expire",
+            lisp_addr_to_char(deid), retries - 1);
+    stop_timer_from_obj(mce,timer,ptrs_to_timers_ht,nonces_ht);
+
+    return (ERR_NO_REPLY);
+}
+
+/* Program the refresh of a dynamic entry some percentage of its TTL before it
+ * expires */
+void
+tr_mc_entry_program_refresh_timer(lisp_tr_t *tr, mcache_entry_t *mce)
+{
+    int ttl, lead;
+
+    stop_timers_of_type_from_obj(mce,REFRESH_MAP_CACHE_TIMER,ptrs_to_timers_ht, nonces_ht);
+    ttl = mapping_ttl(mcache_entry_mapping(mce)) * 60;
+    lead = (uint64_t)ttl * tr->map_cache_refresh / 100;
+    if (lead < MC_REFRESH_MIN_LEAD){
+        return;
+    }
+    tr_mc_entry_program_refresh_timer2(tr, mce, ttl - lead);
+}
+
+/* Refresh the entry in time seconds if it is still in use. The Map-Requests
+ * are sent from the EID that requested it */
+void
+tr_mc_entry_program_refresh_timer2(lisp_tr_t *tr, mcache_entry_t *mce, int time)
+{
+    oor_timer_t *timer;
+    timer_map_req_argument *timer_arg;
+
+    if (!mce->requester){
+        return;
+    }
+
+    timer_arg = timer_map_req_arg_new_init(mce, mce->requester);
+    timer = oor_timer_with_nonce_new(REFRESH_MAP_CACHE_TIMER, tr_get_device(tr),
+            tr_mc_entry_refresh_timer_cb, timer_arg,
+            (oor_timer_del_cb_arg_fn)timer_map_req_arg_free);
+    htable_ptrs_timers_add(ptrs_to_timers_ht, mce, timer);
+    oor_timer_start(timer, time);
+}
+
+/*************************** Map Cache snapshot ******************************/
+
+/* Seconds left before the entry expires. 0 if it has no expiration timer */
+static uint32_t
+tr_mc_entry_time_to_expire(mcache_entry_t *mce)
+{
+    glist_t *timers;
+    oor_timer_t *timer;
+    uint64_t now_ms;
+    uint32_t left = 0;
+
+    timers = htable_ptrs_timers_get_timers_of_type_from_obj(ptrs_to_timers_ht,
+            mce, EXPIRE_MAP_CACHE_TIMER);
+    if (!timers){
+        return (0);
+    }
+    if (glist_size(timers) > 0){
+        timer = (oor_timer_t *)glist_first_data(timers);
+        now_ms = tr_time_us() / 1000;
+        if (timer->expires > now_ms){
+            left = (timer->expires - now_ms) / 1000;
+        }
+    }
+    glist_destroy(timers);
+    return (left);
+}
+
+/* Append the record of an entry to the snapshot */
+static int
+tr_mcache_snapshot_put_entry(lbuf_t *b, mcache_entry_t *mce, time_t now)
+{
+    mc_snapshot_rec_hdr_t *rec;
+    mapping_t *map = mcache_entry_mapping(mce);
+    void *mrec;
+    uint32_t offset, left, len;
+    uint8_t flags = 0;
+
+    left = tr_mc_entry_time_to_expire(mce);
+    if (left <= MC_REFRESH_MIN_LEAD){
+        return (BAD);
+    }
+    /* Grow the buffer geometrically if the estimate falls short */
+    if (lbuf_tailroom(b) < MC_SNAPSHOT_REC_SIZE){
+        lbuf_prealloc_tailroom(b, lbuf_size(b) + MC_SNAPSHOT_REC_SIZE);
+    }
+    offset = lbuf_size(b);
+    lbuf_put_uninit(b, sizeof(mc_snapshot_rec_hdr_t));
+    if ((mrec = lisp_msg_put_mapping(b, map, NULL)) == NULL){
+        goto err;
+    }
+    MAP_REC_ACTION(mrec) = mapping_action(map);
+    if (mce->requester){
+        if (lisp_msg_put_addr(b, mce->requester) == NULL){
+            goto err;
+        }
+        flags |= MC_SNAPSHOT_REQUESTER;
+    }
+    len = lbuf_size(b) - offset - sizeof(mc_snapshot_rec_hdr_t);
+    if (len > UINT16_MAX){
+        goto err;
+    }
+    rec = lbuf_at(b, offset, sizeof(mc_snapshot_rec_hdr_t));
+    rec->expires = htonl((uint32_t)now + left);
+    rec->len = htons(len);
+    rec->flags = flags;
+    rec->reserved = 0;
+    return (GOOD);
+err:
+    lbuf_set_size(b, offset);
+    return (BAD);
+}
+
+/* Write the active dynamic entries of the map cache to the snapshot file.
+ * The file is replaced once the new one is completely written */
+int
+tr_mcache_snapshot_save(lisp_tr_t *tr)
+{
+    mc_snapshot_hdr_t *hdr;
+    mcache_entry_t *mce;
+    void *it;
+    lbuf_t *b;
+    char *tmp_file;
+    FILE *fp;
+    uint32_t count = 0;
+    time_t now;
+    int ret = GOOD;
+
+    if (!tr->mc_snapshot_file){
+        return (GOOD);
+    }
+
+    now = time(NULL);
+    b = lbuf_new(sizeof(mc_snapshot_hdr_t)
+            + mcache_get_stats(tr->map_cache)->entries * MC_SNAPSHOT_REC_SIZE);
+    lbuf_put_uninit(b, sizeof(mc_snapshot_hdr_t));
+
+    mcache_foreach_active_entry(tr->map_cache, it){
+        mce = (mcache_entry_t *)it;
+        /* Static entries are configured and the entries with device data
+         * (NAT) can't be restored without the state of the device */
+        if (mcache_how_learned(mce) == MCE_DYNAMIC && !mce->dev_specific_data
+                && tr_mcache_snapshot_put_entry(b, mce, now) == GOOD){
+            count++;
+        }
+    } mcache_foreach_end;
+
+    hdr = lbuf_data(b);
+    hdr->magic = htonl(MC_SNAPSHOT_MAGIC);
+    hdr->version = htonl(MC_SNAPSHOT_VERSION);
+    hdr->count = htonl(count);
+
+    tmp_file = xmalloc(strlen(tr->mc_snapshot_file) + 5);
+    sprintf(tmp_file, "%s.tmp", tr->mc_snapshot_file);
+    fp = fopen(tmp_file, "wb");
+    if (!fp){
+        OOR_LOG(LWRN, "Couldn't create the map cache snapshot %s: %s", tmp_file,
+                strerror(errno));
+        ret = BAD;
+        goto done;
+    }
+    if (fwrite(lbuf_data(b), 1, lbuf_size(b), fp) != lbuf_size(b)){
+        OOR_LOG(LWRN, "Couldn't write the map cache snapshot %s: %s", tmp_file,
+                strerror(errno));
+        fclose(fp);
+        remove(tmp_file);
+        ret = BAD;
+        goto done;
+    }
+    if (fclose(fp) != 0 || rename(tmp_file, tr->mc_snapshot_file) != 0){
+        OOR_LOG(LWRN, "Couldn't save the map cache snapshot %s: %s",
+                tr->mc_snapshot_file, strerror(errno));
+        remove(tmp_file);
+        ret = BAD;
+        goto done;
+    }
+    OOR_LOG(LDBG_1, "Saved %u map cache entries in %s", count, tr->mc_snapshot_file);
+
+done:
+    free(tmp_file);
+    lbuf_del(b);
+    return (ret);
+}
+
+/* Read the snapshot file into a buffer. NULL if it doesn't exist or can't be
+ * read */
+static lbuf_t *
+tr_mcache_snapshot_read(char *file)
+{
+    lbuf_t *b;
+    FILE *fp;
+    long size;
+
+    fp = fopen(file, "rb");
+    if (!fp){
+        if (errno != ENOENT){
+            OOR_LOG(LWRN, "Couldn't open the map cache snapshot %s: %s", file,
+                    strerror(errno));
+        }
+        return (NULL);
+    }
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0
+            || fseek(fp, 0, SEEK_SET) != 0){
+        OOR_LOG(LWRN, "Couldn't read the map cache snapshot %s: %s", file,
+                strerror(errno));
+        fclose(fp);
+        return (NULL);
+    }
+    b = lbuf_new(size > 0 ? size : 1);
+    if (size > 0 && fread(lbuf_put_uninit(b, size), 1, size, fp) != (size_t)size){
+        OOR_LOG(LWRN, "Couldn't read the map cache snapshot %s", file);
+        lbuf_del(b);
+        b = NULL;
+    }
+    fclose(fp);
+    return (b);
+}
+
+/* Install an entry of the snapshot. It keeps the time it had left and it is
+ * revalidated after delay seconds if it is used by then. It starts idle, so
+ * it is not refreshed if no packet uses it. Returns ERR_EXIST if the entry is
+ * not installed and BAD if the record is corrupted */
+static int
+tr_mcache_snapshot_add_entry(lisp_tr_t *tr, lbuf_t *b, uint8_t flags,
+        int left, int delay)
+{
+    mcache_entry_t *mce;
+    mapping_t *m;
+    lisp_addr_t *requester = NULL;
+
+    m = mapping_new();
+    if (lisp_msg_parse_mapping_record(b, m, NULL) != GOOD){
+        mapping_del(m);
+        return (BAD);
+    }
+    if (flags & MC_SNAPSHOT_REQUESTER){
+        requester = lisp_addr_new();
+        if (lisp_msg_parse_addr(b, requester) != GOOD){
+            lisp_addr_del(requester);
+            mapping_del(m);
+            return (BAD);
+        }
+    }
+    if (mcache_lookup_exact(tr->map_cache, mapping_eid(m))){
+        OOR_LOG(LDBG_2, "Map cache snapshot: EID %s already in the map cache. Ignoring it",
+                lisp_addr_to_char(mapping_eid(m)));
+        lisp_addr_del(requester);
+        mapping_del(m);
+        return (ERR_EXIST);
+    }
+
+    mce = tr_mcache_add_mapping(tr, m, MCE_DYNAMIC, ACTIVE);
+    if (!mce){
+        lisp_addr_del(requester);
+        return (ERR_EXIST);
+    }
+    mcache_entry_set_requester(mce, requester);
+    lisp_addr_del(requester);
+    /* Last used longer ago than any refresh window */
+    mcache_set_entry_last_used(tr->map_cache, mce, (uint32_t)(tr_time_us() / 1000000)
+            - mapping_ttl(m) * 60 - MC_REFRESH_MIN_IDLE - 1);
+
+    tr_mc_entry_program_expiration_timer2(tr, mce, left);
+    if (delay > left - MC_REFRESH_MIN_LEAD){
+        delay = left - MC_REFRESH_MIN_LEAD;
+    }
+    tr_mc_entry_program_refresh_timer2(tr, mce, delay);
+    tr_program_mce_rloc_probing(tr, mce);
+
+    return (GOOD);
+}
+
+/* Load the entries of the snapshot file not expired yet. They are used
+ * right away and revalidated with a Map-Request spread over a window that
+ * limits the load of the Map-Resolvers. The entries not used once the
+ * daemon is restarted expire without being revalidated */
+int
+tr_mcache_snapshot_load(lisp_tr_t *tr)
+{
+    mc_snapshot_hdr_t *hdr;
+    mc_snapshot_rec_hdr_t *rec;
+    lbuf_t *b, rb;
+    uint32_t count, expires, len, i, loaded = 0;
+    int window, ret;
+    time_t now;
+
+    if (!tr->mc_snapshot_file){
+        return (GOOD);
+    }
+    b = tr_mcache_snapshot_read(tr->mc_snapshot_file);
+    if (!b){
+        return (BAD);
+    }
+
+    hdr = lbuf_data(b);
+    if (lbuf_size(b) < sizeof(mc_snapshot_hdr_t) || ntohl(hdr->magic) != MC_SNAPSHOT_MAGIC
+            || ntohl(hdr->version) != MC_SNAPSHOT_VERSION){
+        OOR_LOG(LWRN, "%s is not a valid map cache snapshot. Ignoring it",
+                tr->mc_snapshot_file);
+        lbuf_del(b);
+        return (BAD);
+    }
+    count = ntohl(hdr->count);
+    lbuf_pull(b, sizeof(mc_snapshot_hdr_t));
+
+    window = count / MC_SNAPSHOT_MRQ_RATE;
+    if (window < MC_SNAPSHOT_MIN_WINDOW){
+        window = MC_SNAPSHOT_MIN_WINDOW;
+    }
+    now = time(NULL);
+
+    for (i = 0; i < count; i++){
+        if (lbuf_size(b) < sizeof(mc_snapshot_rec_hdr_t)){
+            break;
+        }
+        rec = lbuf_pull(b, sizeof(mc_snapshot_rec_hdr_t));
+        len = ntohs(rec->len);
+        expires = ntohl(rec->expires);
+        if (lbuf_size(b) < len){
+            break;
+        }
+        /* The record is parsed from a copy limited to its length */
+        lbuf_use_stack(&rb, lbuf_data(b), len);
+        lbuf_set_size(&rb, len);
+        lbuf_pull(b, len);
+        if (expires <= (uint32_t)now + MC_REFRESH_MIN_LEAD){
+            continue;
+        }
+        ret = tr_mcache_snapshot_add_entry(tr, &rb, rec->flags, expires - (uint32_t)now,
+                1 + random() % window);
+        if (ret == BAD){
+            break;
+        }
+        if (ret == GOOD){
+            loaded++;
+        }
+    }
+    if (i < count){
+        OOR_LOG(LWRN, "Map cache snapshot %s is truncated or corrupted. Ignoring "
+                "the rest of entries", tr->mc_snapshot_file);
+    }
+    OOR_LOG(LINF, "Loaded %u of %u map cache entries from %s", loaded, count,
+            tr->mc_snapshot_file);
+
+    lbuf_del(b);
+    return (GOOD);
+}
+
+int
+tr_mcache_snapshot_timer_cb(oor_timer_t *timer)
+{
+    tr_abstract_device *tr_dev = oor_timer_owner(timer);
+    lisp_tr_t *tr = &tr_dev->tr;
+
+    tr_mcache_snapshot_save(tr);
+    oor_timer_start(timer, tr->mc_snapshot_interval);
+    return (GOOD);
+}
+
+/* Load the snapshot when the device starts and program its periodic save */
+void
+tr_mcache_snapshot_start(lisp_tr_t *tr)
+{
+    oor_timer_t *timer;
+
+    if (!tr->mc_snapshot_file){
+        return;
+    }
+    tr_mcache_snapshot_load(tr);
+    tr->mc_snapshot_started = TRUE;
+
+    if (tr->mc_snapshot_interval > 0){
+        timer = oor_timer_without_nonce_new(MAP_CACHE_SNAPSHOT_TIMER, tr_get_device(tr),
+                tr_mcache_snapshot_timer_cb, NULL, NULL);
+        htable_ptrs_timers_add(ptrs_to_timers_ht, tr, timer);
+        oor_timer_start(timer, tr->mc_snapshot_interval);
+    }
+}
+
 /**************************** SMR invoked timer  *****************************/
 
 int
@@ -508,160 +1015,375 @@ tr_smr_invoked_map_request_cb(oor_timer_t *timer)
 /***************************** RLOC Probing **********************************/
 
 
-/* Program RLOC probing for each locator of the mapping */
+/* Program RLOC probing for each locator of the mapping. Each remote RLOC is
+ * probed only once whatever the number of map cache entries using it */
 void
 tr_program_mce_rloc_probing(lisp_tr_t *tr, mcache_entry_t *mce)
 {
     mapping_t *map;
     locator_t *locator;
+    lisp_addr_t *drloc;
+    tr_probed_rloc_t *prloc;
+    glist_t *prlocs, *old_prlocs;
+    oor_ctrl_t *ctrl;
+    uint8_t updated = FALSE;
 
     if (tr->probe_interval == 0) {
         return;
     }
-    /* Cancel previous RLOCs Probing associated to this mce */
-    stop_timers_of_type_from_obj(mce,RLOC_PROBING_TIMER,ptrs_to_timers_ht, nonces_ht);
+    /* RLOCs probed for the previous locators of the mce */
+    old_prlocs = htable_ptrs_remove(tr->mce_probed_rlocs, mce);
 
+    ctrl = ctrl_dev_get_ctrl_t(tr_get_ctrl_device(tr));
     map = mcache_entry_mapping(mce);
+    prlocs = glist_new();
     /* Start rloc probing for each locator of the mapping */
     mapping_foreach_active_locator(map,locator){
         // XXX alopez: Check if RLOC probing is available for all LCAF. ELP RLOC Probing bit
-        tr_program_rloc_probing(tr, mce, locator, tr->probe_interval);
+        if (locator_R_bit(locator) == 0 || locator_priority(locator) == UNUSED_RLOC_PRIORITY){
+            continue;
+        }
+        drloc = tr->fwd_policy->get_fwd_ip_addr(locator_addr(locator), ctrl_rlocs(ctrl));
+        if (!drloc){
+            continue;
+        }
+        prloc = shash_lookup(tr->probed_rlocs, lisp_addr_to_char(drloc));
+        if (!prloc){
+            prloc = tr_probed_rloc_new(tr, drloc, locator_state(locator));
+        }else if (locator_state(locator) != prloc->state){
+            /* The RLOC is already probed. Use its last known state */
+            locator_set_state(locator, prloc->state);
+            updated = TRUE;
+        }
+        /* Several locators of the mapping can be reached through the same RLOC */
+        if (glist_contain(prloc, prlocs)){
+            continue;
+        }
+        htable_ptrs_insert(prloc->mces, mce, mce);
+        glist_add(prloc, prlocs);
+        OOR_LOG(LDBG_2,"Programming probing of EID's %s locator %s (%d seconds, "
+                "%d map cache entries)", lisp_addr_to_char(mapping_eid(map)),
+                lisp_addr_to_char(drloc), tr->probe_interval,
+                htable_ptrs_size(prloc->mces));
     }mapping_foreach_active_locator_end;
-}
 
+    /* Cancel the probing of the RLOCs no longer used by the mce. Done once the
+     * new ones are added to keep the state of the RLOCs still in use */
+    tr_release_probed_rlocs(tr, mce, old_prlocs, prlocs);
+    if (glist_size(prlocs) == 0){
+        glist_destroy(prlocs);
+    }else{
+        htable_ptrs_insert(tr->mce_probed_rlocs, mce, prlocs);
+    }
 
+    if (updated){
+        tr->fwd_policy->updated_map_cache_inf(tr->fwd_policy_dev_parm,mce);
+        notify_datap_rm_fwd_from_entry(tr_get_ctrl_device(tr),mapping_eid(map),FALSE);
+    }
+}
 
+/* Stop using the mce in the probing of its RLOCs. RLOCs not used by any
+ * other entry are no longer probed */
 void
-tr_program_rloc_probing(lisp_tr_t *tr, mcache_entry_t *mce, locator_t *loc, int time)
+tr_stop_mce_rloc_probing(lisp_tr_t *tr, mcache_entry_t *mce)
 {
-    oor_timer_t *timer;
-    timer_rloc_probe_argument *arg;
+    tr_release_probed_rlocs(tr, mce, htable_ptrs_remove(tr->mce_probed_rlocs, mce), NULL);
+}
 
-    if (locator_R_bit(loc) == 0 || locator_priority(loc) == UNUSED_RLOC_PRIORITY){
+/* Remove the mce from the RLOCs of 'prlocs' not present in 'kept'. The list
+ * 'prlocs' is released */
+static void
+tr_release_probed_rlocs(lisp_tr_t *tr, mcache_entry_t *mce, glist_t *prlocs,
+        glist_t *kept)
+{
+    glist_entry_t *it;
+    tr_probed_rloc_t *prloc;
+
+    if (!prlocs){
         return;
     }
-
-    arg = timer_rloc_probe_argument_new_init(mce,loc);
-    timer = oor_timer_with_nonce_new(RLOC_PROBING_TIMER,tr_get_device(tr),tr_rloc_probing_cb,
-            arg,(oor_timer_del_cb_arg_fn)timer_rloc_probe_argument_free);
-    htable_ptrs_timers_add(ptrs_to_timers_ht, mce, timer);
-
-    oor_timer_start(timer, time);
-    OOR_LOG(LDBG_2,"Programming probing of EID's %s locator %s (%d seconds)",
-            lisp_addr_to_char(mapping_eid(mcache_entry_mapping(mce))),
-            lisp_addr_to_char(locator_addr(loc)), time);
-
+    glist_for_each_entry(it, prlocs){
+        prloc = (tr_probed_rloc_t *)glist_entry_data(it);
+        if (kept && glist_contain(prloc, kept)){
+            continue;
+        }
+        htable_ptrs_remove(prloc->mces, mce);
+        if (htable_ptrs_size(prloc->mces) == 0){
+            OOR_LOG(LDBG_2,"Stop probing of locator %s", lisp_addr_to_char(prloc->addr));
+            /* Removes also prloc */
+            shash_remove(tr->probed_rlocs, lisp_addr_to_char(prloc->addr));
+        }
+    }
+    glist_destroy(prlocs);
 }
 
-
 int
 tr_rloc_probing_cb(oor_timer_t *timer)
 {
-    timer_rloc_probe_argument *rparg = oor_timer_cb_argument(timer);
+    tr_probed_rloc_t *prloc = oor_timer_cb_argument(timer);
     nonces_list_t *nonces_lst = oor_timer_nonces(timer);
     tr_abstract_device *tr_dev = oor_timer_owner(timer);
     lisp_tr_t *tr = &tr_dev->tr;
-    mapping_t *map = mcache_entry_mapping(rparg->mce);
-    locator_t *loct = rparg->locator;
-    lisp_addr_t * drloc;
+    lisp_addr_t *deid;
     uint64_t nonce;
-    mcache_entry_t * mce;
-
-    // XXX alopez -> What we have to do with ELP and probe bit
-    drloc = tr->fwd_policy->get_fwd_ip_addr(locator_addr(loct), ctrl_rlocs(ctrl_dev_get_ctrl_t(tr_get_ctrl_device(tr))));
 
     if ((nonces_list_size(nonces_lst) -1) < tr->probe_retries){
+        /* Any EID reachable through the RLOC can be used in the probe */
+        deid = tr_probed_rloc_eid(prloc);
         nonce = nonce_new();
-        if (tr_build_and_send_mreq_probe(tr, map,loct,nonce) != GOOD){
+        if (tr_build_and_send_mreq_probe(tr, deid, prloc->addr, nonce) != GOOD){
             /* Retry send RLOC Probe in rloc probe interval. No short retries */
             goto no_probe;
         }
+        if (prloc->probe_time != 0){
+            /* The previous probe has not been answered */
+            tr_probed_rloc_sample(tr, prloc, 0, TRUE);
+        }
+        prloc->probe_nonce = nonce;
+        prloc->probe_time = tr_time_us();
         if (nonces_list_size(nonces_lst) > 0) {
             OOR_LOG(LDBG_1,"Retry Map-Request Probe for locator %s and "
-                    "EID: %s (%d retries)", lisp_addr_to_char(drloc),
-                    lisp_addr_to_char(mapping_eid(map)), nonces_list_size(nonces_lst));
+                    "EID: %s (%d retries)", lisp_addr_to_char(prloc->addr),
+                    lisp_addr_to_char(deid), nonces_list_size(nonces_lst));
         } else {
             OOR_LOG(LDBG_1,"Map-Request Probe for locator %s and "
-                    "EID: %s", lisp_addr_to_char(drloc),
-                    lisp_addr_to_char(mapping_eid(map)));
+                    "EID: %s", lisp_addr_to_char(prloc->addr),
+                    lisp_addr_to_char(deid));
         }
         htable_nonces_insert(nonces_ht, nonce,nonces_lst);
         oor_timer_start(timer, tr->probe_retries_interval);
         return (GOOD);
     }else{
 no_probe:
+        if (prloc->probe_time != 0){
+            tr_probed_rloc_sample(tr, prloc, 0, TRUE);
+            prloc->probe_time = 0;
+        }
         /* If we have reached maximum number of retransmissions, change remote
          *  locator status */
-        if (locator_state(loct) == UP) {
-            locator_set_state(loct, DOWN);
+        if (prloc->state == UP) {
             OOR_LOG(LDBG_1,"rloc_probing: No Map-Reply Probe received for locator"
-                    " %s and EID: %s -> Locator state changes to DOWN",
-                    lisp_addr_to_char(drloc), lisp_addr_to_char(mapping_eid(map)));
-
-            /* [re]Calculate forwarding info  if it has been a change
-             * of status*/
-            mce = mcache_lookup_exact(tr->map_cache,mapping_eid(map));
-            if (mce == NULL){
-                OOR_LOG(LERR,"rloc_probing: No map cache entry for EID %s. It should never happened",
-                        lisp_addr_to_char(mapping_eid(map)));
-                return(BAD);
-            }
-
-            tr->fwd_policy->updated_map_cache_inf(tr->fwd_policy_dev_parm,mce);
-            notify_datap_rm_fwd_from_entry(tr_get_ctrl_device(tr),mcache_entry_eid(mce),FALSE);
+                    " %s -> Locator state changes to DOWN",
+                    lisp_addr_to_char(prloc->addr));
+            tr_probed_rloc_set_state(tr, prloc, DOWN);
         }
 
         /* Reprogram time for next probe interval */
         htable_nonces_reset_nonces_lst(nonces_ht,nonces_lst);
         oor_timer_start(timer, tr->probe_interval);
-        OOR_LOG(LDBG_2,"Reprogramed RLOC probing of the locator %s of the EID %s "
-                "in %d seconds", lisp_addr_to_char(drloc),
-                lisp_addr_to_char(mapping_eid(map)), tr->probe_interval);
+        OOR_LOG(LDBG_2,"Reprogramed RLOC probing of the locator %s in %d seconds",
+                lisp_addr_to_char(prloc->addr), tr->probe_interval);
 
         return (BAD);
     }
 }
 
-/* Process a record from map-reply probe message */
+/* Process a map-reply probe message of the RLOC */
 int
-handle_locator_probe_reply(lisp_tr_t *tr, mcache_entry_t *mce,
-        lisp_addr_t *probed_addr)
+handle_locator_probe_reply(lisp_tr_t *tr, tr_probed_rloc_t *prloc, uint64_t nonce)
 {
-    locator_t * loct = NULL;
-    mapping_t * map = NULL;
+    OOR_LOG(LDBG_1," Successfully probed RLOC %s (%d map cache entries)",
+            lisp_addr_to_char(prloc->addr), htable_ptrs_size(prloc->mces));
 
-    map = mcache_entry_mapping(mce);
-    loct = mapping_get_loct_with_addr(map, probed_addr);
+    /* Only the reply to the last probe gives an RTT sample. The previous
+     * ones have already been accounted as lost */
+    if (prloc->probe_time != 0 && nonce == prloc->probe_nonce){
+        tr_probed_rloc_sample(tr, prloc, tr_time_us() - prloc->probe_time, FALSE);
+    }
+    prloc->probe_time = 0;
+
+    if (prloc->state == DOWN) {
+        OOR_LOG(LDBG_1," Locator %s state changed to UP",
+                lisp_addr_to_char(prloc->addr));
+        tr_probed_rloc_set_state(tr, prloc, UP);
+    }
+
+    /* Reprogramming timer of rloc probing */
+    htable_nonces_reset_nonces_lst(nonces_ht,oor_timer_nonces(prloc->timer));
+    oor_timer_start(prloc->timer, tr->probe_interval);
+
+    return (GOOD);
+}
+
+/* Metrics of the RLOC to be used by the forwarding policy. NULL if the RLOC
+ * is not probed */
+tr_rloc_metrics_t *
+tr_rloc_metrics(lisp_tr_t *tr, lisp_addr_t *rloc)
+{
+    tr_probed_rloc_t *prloc;
+
+    prloc = shash_lookup(tr->probed_rlocs, lisp_addr_to_char(rloc));
+    if (!prloc){
+        return (NULL);
+    }
+    return (&prloc->fwd_metrics);
+}
 
+static tr_probed_rloc_t *
+tr_probed_rloc_new(lisp_tr_t *tr, lisp_addr_t *addr, uint8_t state)
+{
+    tr_probed_rloc_t *prloc;
+
+    prloc = xzalloc(sizeof(tr_probed_rloc_t));
+    prloc->addr = lisp_addr_clone(addr);
+    prloc->mces = htable_ptrs_new();
+    prloc->state = state;
+    prloc->timer = oor_timer_with_nonce_new(RLOC_PROBING_TIMER,tr_get_device(tr),
+            tr_rloc_probing_cb, prloc, NULL);
+    htable_ptrs_timers_add(ptrs_to_timers_ht, prloc, prloc->timer);
+    shash_insert(tr->probed_rlocs, strdup(lisp_addr_to_char(addr)), prloc);
+
+    /* The first probe is sent at a random instant of the interval. The RLOCs
+     * of the entries added at once, like the ones of a snapshot, are not
+     * probed together */
+    oor_timer_start(prloc->timer, 1 + random() % tr->probe_interval);
+
+    return (prloc);
+}
+
+static void
+tr_probed_rloc_del(tr_probed_rloc_t *prloc)
+{
+    stop_timers_from_obj(prloc,ptrs_to_timers_ht, nonces_ht);
+    htable_ptrs_destroy(prloc->mces);
+    lisp_addr_del(prloc->addr);
+    free(prloc);
+}
 
-    if (!loct){
-        OOR_LOG(LDBG_2,"Probed locator %s not part of the the mapping %s",
-                lisp_addr_to_char(probed_addr),
-                lisp_addr_to_char(mapping_eid(map)));
-        return (ERR_NO_EXIST);
+/* EID of one of the map cache entries using the RLOC */
+static lisp_addr_t *
+tr_probed_rloc_eid(tr_probed_rloc_t *prloc)
+{
+    khiter_t k;
+
+    for (k = kh_begin(prloc->mces->htable); k != kh_end(prloc->mces->htable); ++k){
+        if (kh_exist(prloc->mces->htable, k)){
+            return (mcache_entry_eid((mcache_entry_t *)kh_key(prloc->mces->htable, k)));
+        }
     }
+    return (NULL);
+}
 
+/* Change the state of the RLOC and of the locators reached through it. The
+ * forwarding information is only recalculated for the map cache entries with
+ * a locator whose state has changed */
+static void
+tr_probed_rloc_set_state(lisp_tr_t *tr, tr_probed_rloc_t *prloc, uint8_t state)
+{
+    oor_ctrl_t *ctrl;
+    mcache_entry_t *mce;
+    mapping_t *map;
+    locator_t *locator;
+    lisp_addr_t *drloc;
+    glist_t *mces;
+    glist_entry_t *it;
+    uint8_t updated;
 
-    OOR_LOG(LDBG_1," Successfully probed RLOC %s of cache entry with EID %s",
-                lisp_addr_to_char(locator_addr(loct)),
-                lisp_addr_to_char(mapping_eid(map)));
+    prloc->state = state;
 
+    ctrl = ctrl_dev_get_ctrl_t(tr_get_ctrl_device(tr));
+    mces = htable_ptrs_keys(prloc->mces);
+    glist_for_each_entry(it, mces){
+        mce = (mcache_entry_t *)glist_entry_data(it);
+        map = mcache_entry_mapping(mce);
+        updated = FALSE;
+        mapping_foreach_active_locator(map,locator){
+            if (locator_state(locator) == state){
+                continue;
+            }
+            drloc = tr->fwd_policy->get_fwd_ip_addr(locator_addr(locator), ctrl_rlocs(ctrl));
+            if (drloc && lisp_addr_cmp(drloc, prloc->addr) == 0){
+                locator_set_state(locator, state);
+                updated = TRUE;
+            }
+        }mapping_foreach_active_locator_end;
 
-    if (loct->state == DOWN) {
-        loct->state = UP;
+        if (updated){
+            /* [re]Calculate forwarding info if status changed */
+            tr->fwd_policy->updated_map_cache_inf(tr->fwd_policy_dev_parm,mce);
+            notify_datap_rm_fwd_from_entry(tr_get_ctrl_device(tr),mapping_eid(map),FALSE);
+        }
+    }
+    glist_destroy(mces);
+}
 
-        OOR_LOG(LDBG_1," Locator %s state changed to UP",
-                lisp_addr_to_char(locator_addr(loct)));
+static inline uint64_t
+tr_time_us()
+{
+    struct timespec ts;
 
-        /* [re]Calculate forwarding info if status changed*/
-        tr->fwd_policy->updated_map_cache_inf(tr->fwd_policy_dev_parm,mce);
-        notify_datap_rm_fwd_from_entry(tr_get_ctrl_device(tr),mapping_eid(map),FALSE);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+static inline uint8_t
+tr_delay_differ(uint64_t ref, uint64_t val)
+{
+    uint64_t diff = ref > val ? ref - val : val - ref;
+
+    if ((ref >> FWD_METRICS_DELAY_SHIFT) > FWD_METRICS_MIN_DELAY){
+        return (diff > (ref >> FWD_METRICS_DELAY_SHIFT));
     }
+    return (diff > FWD_METRICS_MIN_DELAY);
+}
 
-    /* Reprogramming timers of rloc probing */
-    tr_program_rloc_probing(tr, mce, loct, tr->probe_interval);
+/* Add the result of a probe to the measurements of the RLOC. When they
+ * differ enough from the metrics seen by the forwarding policy, these are
+ * updated and the forwarding information of the dependent entries is
+ * recalculated */
+static void
+tr_probed_rloc_sample(lisp_tr_t *tr, tr_probed_rloc_t *prloc, uint64_t rtt,
+        uint8_t lost)
+{
+    tr_rloc_metrics_t *m = &prloc->metrics;
+    tr_rloc_metrics_t *fm = &prloc->fwd_metrics;
+    glist_t *mces;
+    glist_entry_t *it;
+    mcache_entry_t *mce;
+    uint32_t diff;
 
-    return (GOOD);
+    if (lost){
+        m->loss = m->loss - (m->loss >> LOSS_SHIFT) + (1000 >> LOSS_SHIFT);
+    }else{
+        m->loss = m->loss - (m->loss >> LOSS_SHIFT);
+        if (rtt == 0){
+            rtt = 1;
+        }else if (rtt > UINT32_MAX){
+            rtt = UINT32_MAX;
+        }
+        if (m->srtt == 0){
+            m->srtt = rtt;
+            m->rttvar = rtt / 2;
+        }else{
+            diff = m->srtt > rtt ? m->srtt - rtt : rtt - m->srtt;
+            m->rttvar = m->rttvar - (m->rttvar >> RTTVAR_BETA_SHIFT)
+                    + (diff >> RTTVAR_BETA_SHIFT);
+            m->srtt = m->srtt - (m->srtt >> RTT_ALPHA_SHIFT)
+                    + ((uint32_t)rtt >> RTT_ALPHA_SHIFT);
+        }
+    }
+    OOR_LOG(LDBG_2,"RLOC %s: RTT %u us, jitter %u us, loss %u/1000",
+            lisp_addr_to_char(prloc->addr), m->srtt, m->rttvar, m->loss);
+
+    if ((fm->srtt == 0) == (m->srtt == 0)
+            && !tr_delay_differ(tr_rloc_metrics_delay(fm), tr_rloc_metrics_delay(m))
+            && abs((int)fm->loss - (int)m->loss) < FWD_METRICS_LOSS){
+        return;
+    }
+    *fm = *m;
+    if (!tr->fwd_policy->updated_rloc_metrics){
+        return;
+    }
+    OOR_LOG(LDBG_1,"Metrics of RLOC %s changed: RTT %u us, jitter %u us, "
+            "loss %u/1000 -> Updating forwarding information", lisp_addr_to_char(prloc->addr),
+            fm->srtt, fm->rttvar, fm->loss);
+    mces = htable_ptrs_keys(prloc->mces);
+    glist_for_each_entry(it, mces){
+        mce = (mcache_entry_t *)glist_entry_data(it);
+        tr->fwd_policy->updated_rloc_metrics(tr->fwd_policy_dev_parm,mce);
+        notify_datap_rm_fwd_from_entry(tr_get_ctrl_device(tr),mcache_entry_eid(mce),FALSE);
+    }
+    glist_destroy(mces);
 }
 
 /*************************** Map Cache miss **********************************/
@@ -731,6 +1453,7 @@ send_map_request_retry_cb(oor_timer_t *timer)
     } else {
         OOR_LOG(LDBG_1, "No Map-Reply for EID %s after %d retries. Aborting!",
                 lisp_addr_to_char(deid), retries -1 );
+        notify_datap_flush_pending(tr_get_ctrl_device(tr), deid, FALSE);
         /* When removing mce, all timers associated to it are canceled */
         tr_mcache_remove_entry(tr,timer_arg->mce);
 
@@ -742,20 +1465,6 @@ send_map_request_retry_cb(oor_timer_t *timer)
 /*********************** Map Cache Expiration timer  *************************/
 
 
-timer_rloc_probe_argument *
-timer_rloc_probe_argument_new_init(mcache_entry_t *mce,locator_t *locator)
-{
-    timer_rloc_probe_argument *timer_arg = xmalloc(sizeof(timer_rloc_probe_argument));
-    timer_arg->mce = mce;
-    timer_arg->locator = locator;
-    return (timer_arg);
-}
-
-void
-timer_rloc_probe_argument_free(timer_rloc_probe_argument *timer_arg){
-    free (timer_arg);
-}
-
 timer_map_req_argument *
 timer_map_req_arg_new_init(mcache_entry_t *mce,lisp_addr_t *src_eid)
 {
@@ -806,6 +1515,12 @@ tr_mcache_add_mapping(lisp_tr_t *tr, mapping_t *m, mce_type_e how_learned, uint8
         return(NULL);
     }
 
+    /* The entry may be added from the data plane miss path. Evicting removes
+     * flows and pending packets, so it is done from the event loop */
+    if (mcache_entry_evictable(mce) && mcache_over_limits(tr->map_cache)){
+        oor_timer_start_ms(tr->mc_evict_timer, 0);
+    }
+
     if (is_active){
         mcache_entry_set_active(mce, ACTIVE);
     }else{
@@ -815,6 +1530,34 @@ tr_mcache_add_mapping(lisp_tr_t *tr, mapping_t *m, mce_type_e how_learned, uint8
     return(mce);
 }
 
+/* Evict dynamic entries until the map cache is back within its limits. The
+ * static entries are kept even if they exceed them */
+static int
+tr_mcache_evict_timer_cb(oor_timer_t *timer)
+{
+    lisp_tr_t *tr = oor_timer_cb_argument(timer);
+    mcache_entry_t *mce;
+    lisp_addr_t *eid;
+
+    while (mcache_over_limits(tr->map_cache)){
+        mce = mcache_eviction_candidate(tr->map_cache);
+        if (!mce){
+            OOR_LOG(LDBG_1, "Map cache full of static entries. Exceeding its limits");
+            return (GOOD);
+        }
+        eid = mcache_entry_eid(mce);
+        OOR_LOG(LDBG_1, "Map cache over its limits. Evicting %s entry of EID %s",
+                mcache_entry_active(mce) ? "the" : "the not active", lisp_addr_to_char(eid));
+        if (!mcache_entry_active(mce)){
+            /* The packets waiting for its Map-Reply are dropped */
+            notify_datap_flush_pending(tr_get_ctrl_device(tr), eid, FALSE);
+        }
+        tr->map_cache->stats.evictions++;
+        tr_mcache_remove_entry(tr, mce);
+    }
+    return (GOOD);
+}
+
 /* Remove an entry from the cache and destroy it */
 int
 tr_mcache_remove_entry(lisp_tr_t *tr, mcache_entry_t *mce)
@@ -823,6 +1566,7 @@ tr_mcache_remove_entry(lisp_tr_t *tr, mcache_entry_t *mce)
     lisp_addr_t *eid = mapping_eid(mcache_entry_mapping(mce));
 
     notify_datap_rm_fwd_from_entry(tr_get_ctrl_device(tr),eid,FALSE);
+    tr_stop_mce_rloc_probing(tr, mce);
 
     data = mcache_remove_entry(tr->map_cache, eid);
     mcache_entry_del(data);
@@ -832,8 +1576,42 @@ tr_mcache_remove_entry(lisp_tr_t *tr, mcache_entry_t *mce)
 }
 
 
+/* Check if the received mapping would change how the packets of the entry
+ * are forwarded. Besides what is compared by mapping_cmp, the action and the
+ * reachability of the locators (state, R-bit and L-bit) must be the same */
+static uint8_t
+tr_mapping_unchanged(mapping_t *map, mapping_t *recv_map)
+{
+    glist_entry_t *it_list, *it_list2, *it_loct, *it_loct2;
+    locator_t *loct, *loct2;
+
+    if (mapping_cmp(map, recv_map) != 0
+            || mapping_action(map) != mapping_action(recv_map)){
+        return (FALSE);
+    }
+    /* Both mappings have the same number of locators in each list */
+    it_list2 = glist_first(mapping_locators_lists(recv_map));
+    glist_for_each_entry(it_list, mapping_locators_lists(map)){
+        it_loct2 = glist_first((glist_t *)glist_entry_data(it_list2));
+        glist_for_each_entry(it_loct, (glist_t *)glist_entry_data(it_list)){
+            loct = (locator_t *)glist_entry_data(it_loct);
+            loct2 = (locator_t *)glist_entry_data(it_loct2);
+            if (locator_state(loct) != locator_state(loct2)
+                    || locator_R_bit(loct) != locator_R_bit(loct2)
+                    || locator_L_bit(loct) != locator_L_bit(loct2)){
+                return (FALSE);
+            }
+            it_loct2 = glist_next(it_loct2);
+        }
+        it_list2 = glist_next(it_list2);
+    }
+    return (TRUE);
+}
+
+/* Update the locators of the entry of the received mapping. changed is FALSE
+ * if they are the same, in which case the forwarding state is kept */
 int
-tr_update_mcache_entry(lisp_tr_t *tr, mapping_t *recv_map)
+tr_update_mcache_entry(lisp_tr_t *tr, mapping_t *recv_map, uint8_t *changed)
 {
     mcache_entry_t *mce = NULL;
     mapping_t *map = NULL;
@@ -849,13 +1627,23 @@ tr_update_mcache_entry(lisp_tr_t *tr, mapping_t *recv_map)
         return (BAD);
     }
 
+    map = mcache_entry_mapping(mce);
+    mapping_set_ttl(map, mapping_ttl(recv_map));
+    if (tr_mapping_unchanged(map, recv_map)){
+        OOR_LOG(LDBG_2, "Mapping with EID %s already exists and has not changed",
+                lisp_addr_to_char(eid));
+        *changed = FALSE;
+        return (GOOD);
+    }
+
     OOR_LOG(LDBG_2, "Mapping with EID %s already exists, replacing!",
             lisp_addr_to_char(eid));
-
-    map = mcache_entry_mapping(mce);
+    *changed = TRUE;
 
     /* DISCARD all locator state */
     mapping_update_locators(map, mapping_locators_lists(recv_map));
+    mapping_set_action(map, mapping_action(recv_map));
+    mcache_update_entry_size(tr->map_cache, mce);
 
     /* Update forwarding info */
     tr->fwd_policy->updated_map_cache_inf(tr->fwd_policy_dev_parm,mce);
@@ -869,6 +1657,7 @@ tr_mcache_entry_program_timers(lisp_tr_t *tr, mcache_entry_t *mce )
     if (mcache_how_learned(mce) == MCE_DYNAMIC){
         /* Reprogramming timers */
         tr_mc_entry_program_expiration_timer(tr, mce);
+        tr_mc_entry_program_refresh_timer(tr, mce);
     }
 
     /* RLOC probing timer */
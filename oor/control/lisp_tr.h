@@ -25,6 +25,7 @@
 #include "oor_map_cache.h"
 #include "../defs.h"
 #include "../fwd_policies/fwd_policy.h"
+#include "../lib/htable_ptrs.h"
 #include "../lib/shash.h"
 
 typedef struct lisp_tr {
@@ -32,6 +33,20 @@ typedef struct lisp_tr {
     mapping_t *(*lookup_eid_map_cache)(lisp_addr_t *eid);
 
     int map_request_retries;
+    /* Percentage of the TTL before expiry at which the entries still used
+     * by the data plane are refreshed. 0 disables it */
+    int map_cache_refresh;
+    /* File where the map cache is saved to be reloaded on restart. NULL if
+     * disabled */
+    char *mc_snapshot_file;
+    /* Seconds between saves of the map cache. 0 only saves it on shutdown */
+    int mc_snapshot_interval;
+    /* The snapshot has been loaded. Saving it before would overwrite it with
+     * the entries of a daemon that didn't start */
+    uint8_t mc_snapshot_started;
+    /* Evicts the entries exceeding the limits of the map cache out of the
+     * path that inserted them */
+    oor_timer_t *mc_evict_timer;
     int probe_interval;
     int probe_retries;
     int probe_retries_interval;
@@ -49,6 +64,10 @@ typedef struct lisp_tr {
     /* MAPPING IFACE TO LOCATORS */
     shash_t *iface_locators_table; /* Key: Iface name, Value: iface_locators */
 
+    /* RLOC PROBING */
+    shash_t *probed_rlocs; /* Key: RLOC address string, Value: tr_probed_rloc_t */
+    htable_ptrs_t *mce_probed_rlocs; /* Key: mcache_entry_t, Value: glist_t <tr_probed_rloc_t *> */
+
     oor_encap_t encap_type;
 
 } lisp_tr_t;
@@ -61,10 +80,35 @@ typedef struct tr_abstract_device_ {
     lisp_tr_t tr; /* Don't change order */
 }tr_abstract_device;
 
-typedef struct _timer_rloc_prob_argument {
-    mcache_entry_t *mce;
-    locator_t      *locator;
-} timer_rloc_probe_argument;
+/* Measurements of a remote RLOC obtained from its RLOC probes */
+typedef struct tr_rloc_metrics_ {
+    uint32_t        srtt;       /* Smoothed RTT in microseconds. 0 if not measured */
+    uint32_t        rttvar;     /* RTT variation (jitter) in microseconds */
+    uint16_t        loss;       /* Smoothed loss of probes in 1/1000 */
+} tr_rloc_metrics_t;
+
+/* Expected delay of the path to the RLOC: RTT plus twice its jitter */
+static inline uint64_t tr_rloc_metrics_delay(tr_rloc_metrics_t *m)
+{
+    return ((uint64_t)m->srtt + 2 * (uint64_t)m->rttvar);
+}
+
+/* Remote RLOC probed by the tunnel router. The RLOC is probed once per probe
+ * interval whatever the number of map cache entries using it. The result of
+ * the probe is applied to the locators of all these entries */
+typedef struct tr_probed_rloc_ {
+    lisp_addr_t     *addr;
+    htable_ptrs_t   *mces;  /* Key and value: mcache_entry_t */
+    oor_timer_t     *timer;
+    uint8_t         state;  /* UP or DOWN */
+    uint64_t        probe_nonce;    /* Nonce of the last probe sent */
+    uint64_t        probe_time;     /* Time it was sent (us). 0 if answered */
+    tr_rloc_metrics_t metrics;
+    /* Metrics seen by the forwarding policy. Only updated when they differ
+     * enough from the measured ones to avoid recalculating the forwarding
+     * information after each probe */
+    tr_rloc_metrics_t fwd_metrics;
+} tr_probed_rloc_t;
 
 typedef struct _timer_map_req_argument {
     mcache_entry_t  *mce;
@@ -73,6 +117,7 @@ typedef struct _timer_map_req_argument {
 
 
 static inline int tr_map_request_retries(lisp_tr_t *tr){return (tr->map_request_retries);}
+static inline int tr_map_cache_refresh(lisp_tr_t *tr){return (tr->map_cache_refresh);}
 static inline int tr_probe_interval(lisp_tr_t *tr){return (tr->probe_interval);}
 static inline int tr_probe_retries(lisp_tr_t *tr){return (tr->probe_retries);}
 static inline int tr_probe_retries_interval(lisp_tr_t *tr){return (tr->probe_retries_interval);}
@@ -89,7 +134,8 @@ int tr_recv_map_reply(lisp_tr_t *tr, lbuf_t *buf, uconn_t *udp_con);
 int tr_reply_to_smr(lisp_tr_t *tr, lisp_addr_t *src_eid, lisp_addr_t *req_eid);
 int tr_build_and_send_encap_map_request(lisp_tr_t *tr, lisp_addr_t *seid,
         mcache_entry_t *mce, uint64_t nonce);
-int tr_build_and_send_mreq_probe(lisp_tr_t *tr, mapping_t *map, locator_t *loc, uint64_t nonce);
+int tr_build_and_send_mreq_probe(lisp_tr_t *tr, lisp_addr_t *deid, lisp_addr_t *drloc,
+        uint64_t nonce);
 
 /**************************** LOGICAL PROCESSES ******************************/
 /************************** Map Cache Expiration *****************************/
@@ -98,6 +144,19 @@ int tr_mc_entry_expiration_timer_cb(oor_timer_t *timer);
 void tr_mc_entry_program_expiration_timer(lisp_tr_t *tr, mcache_entry_t *mce);
 void tr_mc_entry_program_expiration_timer2(lisp_tr_t *tr, mcache_entry_t *mce, int time);
 
+/************************* Map Cache refresh-ahead ***************************/
+
+int tr_mc_entry_refresh_timer_cb(oor_timer_t *timer);
+void tr_mc_entry_program_refresh_timer(lisp_tr_t *tr, mcache_entry_t *mce);
+void tr_mc_entry_program_refresh_timer2(lisp_tr_t *tr, mcache_entry_t *mce, int time);
+
+/*************************** Map Cache snapshot ******************************/
+
+int tr_mcache_snapshot_save(lisp_tr_t *tr);
+int tr_mcache_snapshot_load(lisp_tr_t *tr);
+void tr_mcache_snapshot_start(lisp_tr_t *tr);
+int tr_mcache_snapshot_timer_cb(oor_timer_t *timer);
+
 /**************************** SMR invoked timer  *****************************/
 
 int tr_smr_invoked_map_request_cb(oor_timer_t *timer);
@@ -106,10 +165,10 @@ int tr_smr_invoked_map_request_cb(oor_timer_t *timer);
 
 /* Program RLOC probing for each locator of the mapping */
 void tr_program_mce_rloc_probing(lisp_tr_t *tr, mcache_entry_t *mce);
-void tr_program_rloc_probing(lisp_tr_t *tr, mcache_entry_t *mce, locator_t *loc, int time);
+void tr_stop_mce_rloc_probing(lisp_tr_t *tr, mcache_entry_t *mce);
 int tr_rloc_probing_cb(oor_timer_t *timer);
-int handle_locator_probe_reply(lisp_tr_t *tr, mcache_entry_t *mce,
-        lisp_addr_t *probed_addr);
+int handle_locator_probe_reply(lisp_tr_t *tr, tr_probed_rloc_t *prloc, uint64_t nonce);
+tr_rloc_metrics_t *tr_rloc_metrics(lisp_tr_t *tr, lisp_addr_t *rloc);
 
 /*************************** Map Cache miss **********************************/
 
@@ -120,9 +179,6 @@ int send_map_request_retry_cb(oor_timer_t *timer);
 /******************************* TIMERS **************************************/
 /*********************** Map Cache Expiration timer  *************************/
 
-timer_rloc_probe_argument * timer_rloc_probe_argument_new_init(mcache_entry_t *mce,
-        locator_t *locator);
-void timer_rloc_probe_argument_free(timer_rloc_probe_argument *timer_arg);
 timer_map_req_argument * timer_map_req_arg_new_init(mcache_entry_t *mce,lisp_addr_t *src_eid);
 void timer_map_req_arg_free(timer_map_req_argument * timer_arg);
 
@@ -130,7 +186,7 @@ void timer_map_req_arg_free(timer_map_req_argument * timer_arg);
 
 mcache_entry_t *tr_mcache_add_mapping(lisp_tr_t *tr, mapping_t *m, mce_type_e how_learned, uint8_t is_active);
 int tr_mcache_remove_entry(lisp_tr_t *tr, mcache_entry_t *mce);
-int tr_update_mcache_entry(lisp_tr_t *tr, mapping_t *recv_map);
+int tr_update_mcache_entry(lisp_tr_t *tr, mapping_t *recv_map, uint8_t *changed);
 void tr_mcache_entry_program_timers(lisp_tr_t *tr, mcache_entry_t *mce);
 
 /*****************************************************************************/
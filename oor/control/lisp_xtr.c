@@ -18,6 +18,7 @@
  */
 
 #include <unistd.h>
+#include "../data-plane/data-plane.h"
 #include "../lib/iface_locators.h"
 #include "../lib/sockets.h"
 #include "../lib/mem_util.h"
@@ -93,6 +94,7 @@ static int xtr_program_info_req_per_loct(lisp_xtr_t *xtr, map_local_entry_t *mle
 static int xtr_info_request_cb(oor_timer_t *timer);
 /**************************** AUXILIAR FUNCTIONS *****************************/
 static int xtr_iface_event_signaling(lisp_xtr_t * xtr, iface_locators * if_loct);
+static void xtr_update_local_fwd(lisp_xtr_t *xtr, map_local_entry_t *mle);
 /****************************** NAT traversal ********************************/
 static int xtr_update_nat_info(lisp_xtr_t *xtr, map_local_entry_t *mle, locator_t *loct,
         glist_t *rtr_list);
@@ -356,6 +358,12 @@ xtr_run(oor_ctrl_dev_t *dev)
     /* RLOC Probing proxy ETRs */
     tr_program_mce_rloc_probing(&xtr->tr, ipv4_petrs_mc);
     tr_program_mce_rloc_probing(&xtr->tr, ipv6_petrs_mc);
+
+    /* Restore the map cache saved before the last shutdown. The entries
+     * behind NAT depend on the RTRs and are not restored */
+    if (!xtr->nat_aware){
+        tr_mcache_snapshot_start(&xtr->tr);
+    }
 }
 
 
@@ -448,7 +456,7 @@ xtr_if_link_update(oor_ctrl_dev_t *dev, char *iface_name, uint8_t status)
     glist_for_each_entry(it_m, if_loct->map_loc_entries){
         map_loc_e = (map_local_entry_t *)glist_entry_data(it_m);
         xtr->tr.fwd_policy->updated_map_loc_inf(xtr->tr.fwd_policy_dev_parm,map_loc_e);
-        notify_datap_rm_fwd_from_entry(&(xtr->super),map_local_entry_eid(map_loc_e),TRUE);
+        xtr_update_local_fwd(xtr, map_loc_e);
     }
 
     xtr_iface_event_signaling(xtr, if_loct);
@@ -456,6 +464,26 @@ xtr_if_link_update(oor_ctrl_dev_t *dev, char *iface_name, uint8_t status)
     return (GOOD);
 }
 
+/* The locators of a local mapping changed and its balancing vectors have been
+ * recalculated. The flows of the data plane using a source RLOC that can
+ * still be selected keep their RLOCs, the rest are resolved again */
+static void
+xtr_update_local_fwd(lisp_xtr_t *xtr, map_local_entry_t *mle)
+{
+    glist_t *src_rlocs = NULL;
+
+    /* Behind a NAT the RLOCs of the flows depend on the RTRs */
+    if (!xtr->nat_aware && xtr->tr.fwd_policy->get_src_rlocs){
+        src_rlocs = xtr->tr.fwd_policy->get_src_rlocs(xtr->tr.fwd_policy_dev_parm, mle);
+    }
+    if (!src_rlocs){
+        notify_datap_rm_fwd_from_entry(&(xtr->super),map_local_entry_eid(mle),TRUE);
+        return;
+    }
+    notify_datap_update_local_fwd(&(xtr->super),map_local_entry_eid(mle),src_rlocs);
+    glist_destroy(src_rlocs);
+}
+
 int
 xtr_if_addr_update(oor_ctrl_dev_t *dev, char *iface_name, lisp_addr_t *old_addr,
         lisp_addr_t *new_addr, uint8_t status)
@@ -507,7 +535,7 @@ xtr_if_addr_update(oor_ctrl_dev_t *dev, char *iface_name, lisp_addr_t *old_addr,
             mapping_desactivate_locator(mapping,locator);
             /* Recalculate forwarding info of the mappings with activated locators */
             xtr->tr.fwd_policy->updated_map_loc_inf(xtr->tr.fwd_policy_dev_parm,map_loc_e);
-            notify_datap_rm_fwd_from_entry(&(xtr->super),map_local_entry_eid(map_loc_e),TRUE);
+            xtr_update_local_fwd(xtr, map_loc_e);
         }
 
         /* prev_addr is the previous address before starting the transition process */
@@ -557,7 +585,7 @@ xtr_if_addr_update(oor_ctrl_dev_t *dev, char *iface_name, lisp_addr_t *old_addr,
             mapping_activate_locator(mapping,locator,new_addr);
             /* Recalculate forwarding info of the mappings with activated locators */
             xtr->tr.fwd_policy->updated_map_loc_inf(xtr->tr.fwd_policy_dev_parm,map_loc_e);
-            notify_datap_rm_fwd_from_entry(&(xtr->super),map_local_entry_eid(map_loc_e),TRUE);
+            xtr_update_local_fwd(xtr, map_loc_e);
         }else{
             if (!lisp_addr_is_ip(locator_addr(locator))){
                 OOR_LOG(LERR,"OOR doesn't support change of non IP locator!!!");
@@ -605,6 +633,25 @@ xtr_route_update(oor_ctrl_dev_t *dev, int command, char *iface_name ,lisp_addr_t
     return (GOOD);
 }
 
+/* The RLOCs of the flows between a local and a remote EID prefix can be cached
+ * by the data plane when they only depend on both prefixes: the mapping is
+ * resolved and no more specific prefix of the map cache or of the local
+ * database is used for some of the flows */
+static fwd_pref_info_t *
+xtr_fwd_pref_info_new(lisp_xtr_t *xtr, map_local_entry_t *map_loc_e,
+        mcache_entry_t *mce, fwd_info_t *fwd_info)
+{
+    if (dplane_conf.prefix_table_size == 0 || xtr->nat_aware
+            || fwd_info->map_pending || !map_loc_e){
+        return (NULL);
+    }
+    if (mcache_has_more_specific(xtr->tr.map_cache, mcache_entry_eid(mce))
+            || local_map_db_has_more_specific(xtr->local_mdb, map_local_entry_eid(map_loc_e))){
+        return (NULL);
+    }
+    return (fwd_pref_info_new(map_local_entry_eid(map_loc_e), mcache_entry_eid(mce)));
+}
+
 static fwd_info_t *
 xtr_get_forwarding_entry(oor_ctrl_dev_t *dev, packet_tuple_t *tuple)
 {
@@ -639,6 +686,7 @@ xtr_get_forwarding_entry(oor_ctrl_dev_t *dev, packet_tuple_t *tuple)
     }else{
         eid = map_local_entry_eid(map_loc_e);
         simple_eid = lisp_addr_get_ip_pref_addr(eid);
+        fwd_info->local_entry = lisp_addr_clone(eid);
         if (lisp_addr_is_iid(eid)){
             tuple->iid = lcaf_iid_get_iid(lisp_addr_get_lcaf(eid));
         }else{
@@ -672,11 +720,16 @@ xtr_get_forwarding_entry(oor_ctrl_dev_t *dev, packet_tuple_t *tuple)
         /* Get the temporal mce created */
         mce = mcache_lookup(xtr->tr.map_cache, dst_eid);
         fwd_info->associated_entry = lisp_addr_clone(mcache_entry_eid(mce));
+        fwd_info->map_pending = TRUE;
     } else{
         fwd_info->associated_entry = lisp_addr_clone(mcache_entry_eid(mce));
         if (mcache_entry_active(mce) == NOT_ACTIVE) {
             OOR_LOG(LDBG_2, "Already sent Map-Request for %s. Waiting for reply!",
                     lisp_addr_to_char(dst_eid));
+            fwd_info->map_pending = TRUE;
+        }else{
+            /* Used to refresh the entry before it expires */
+            fwd_info_set_activity(fwd_info, mce->activity);
         }
     }
 
@@ -684,11 +737,24 @@ xtr_get_forwarding_entry(oor_ctrl_dev_t *dev, packet_tuple_t *tuple)
 
     /* native_fwd can be TRUE for VPP if src packet is not an EID */
     if (!native_fwd){
+        fwd_info->pref_info = xtr_fwd_pref_info_new(xtr, map_loc_e, mce, fwd_info);
         xtr->tr.fwd_policy->get_fwd_info(xtr->tr.fwd_policy_dev_parm,map_loc_e,mce,mce_petrs,tuple, fwd_info);
     }
 
     /* Assign encapsulated that should be used */
     fwd_info->encap = xtr->tr.encap_type;
+    if (fwd_info->pref_info){
+        if (fwd_info->pref_info->src_rlocs_len == 0){
+            /* Not filled by the policy */
+            fwd_pref_info_del(fwd_info->pref_info);
+            fwd_info->pref_info = NULL;
+        }else{
+            fwd_info->pref_info->encap = fwd_info->encap;
+            if (fwd_info->activity){
+                fwd_info->pref_info->activity = mcache_activity_ref(fwd_info->activity);
+            }
+        }
+    }
     lisp_addr_del(src_eid);
     lisp_addr_del(dst_eid);
     return (fwd_info);
@@ -983,7 +1049,7 @@ xtr_recv_info_nat(lisp_xtr_t *xtr, lbuf_t *buf, uconn_t *uc)
     if (lisp_msg_check_auth_field(buf,auth_hdr,timer_arg->ms->key) != GOOD) {
         OOR_LOG(LDBG_1, "Info-Reply message validation failed for EID %s with key "
                 "%s. Stopping processing!", lisp_addr_to_char(inf_req_eid),
-                timer_arg->ms->key);
+                hmac_key_str(timer_arg->ms->key));
         return (BAD);
     }
 
@@ -1788,7 +1854,7 @@ xtr_update_rtrs_cache_afi(lisp_xtr_t *xtr, int afi)
         }
         glist_destroy(rtr_addr_list);
     }local_map_db_foreach_end;
-
+    mcache_update_entry_size(xtr->tr.map_cache, rtrs_mce);
 
     /* Update forwarding info of rtrs */
     xtr->tr.fwd_policy->updated_map_cache_inf(xtr->tr.fwd_policy_dev_parm,rtrs_mce);
@@ -1883,7 +1949,7 @@ map_server_elt_new_init(lisp_addr_t *address,uint8_t key_type, char *key,
     }
     ms->address     = lisp_addr_clone(address);
     ms->key_type    = key_type;
-    ms->key         = strdup(key);
+    ms->key         = hmac_key_new(key);
     ms->proxy_reply = proxy_reply;
 
     return (ms);
@@ -1896,7 +1962,7 @@ map_server_elt_del (map_server_elt *map_server)
         return;
     }
     lisp_addr_del (map_server->address);
-    free(map_server->key);
+    hmac_key_del(map_server->key);
     free(map_server);
 }
 
@@ -53,7 +53,7 @@ typedef struct lisp_xtr {
 typedef struct map_server_elt_t {
     lisp_addr_t *   address;
     uint8_t         key_type;
-    char *          key;
+    hmac_key_t *    key;
     uint8_t         proxy_reply;
 } map_server_elt;
 
@@ -301,12 +301,33 @@ ctrl_datap_rm_fwd_from_entry(lisp_addr_t *eid_prefix, uint8_t is_local)
     return (data_plane->datap_rm_fwd_from_entry(eid_prefix, is_local));
 }
 
+/* The locators of a local mapping changed. Only the flows whose source RLOC
+ * is not in src_rlocs need to be resolved again */
+int
+ctrl_datap_update_local_fwd(lisp_addr_t *eid_prefix, glist_t *src_rlocs)
+{
+    if (!data_plane->datap_update_local_fwd){
+        return (data_plane->datap_rm_fwd_from_entry(eid_prefix, TRUE));
+    }
+    return (data_plane->datap_update_local_fwd(eid_prefix, src_rlocs));
+}
+
 int
 ctrl_datap_reset_all_fwd()
 {
     return (data_plane->datap_reset_all_fwd());
 }
 
+int
+ctrl_datap_flush_pending(lisp_addr_t *eid_prefix, uint8_t resolved)
+{
+    /* Not all the data planes queue packets during map cache misses */
+    if (!data_plane->datap_flush_pending){
+        return (GOOD);
+    }
+    return (data_plane->datap_flush_pending(eid_prefix, resolved));
+}
+
 /*
  * Multicast Interface to end-hosts
  */
@@ -73,7 +73,9 @@ int ctrl_unregister_mapping_dp(oor_ctrl_dev_t *dev, mapping_t *map);
 int ctrl_notify_mapping_change_to_dp(lisp_addr_t *eid_prefix, uint8_t is_local);
 
 int ctrl_datap_rm_fwd_from_entry(lisp_addr_t *eid_prefix, uint8_t is_local);
+int ctrl_datap_update_local_fwd(lisp_addr_t *eid_prefix, glist_t *src_rlocs);
 int ctrl_datap_reset_all_fwd();
+int ctrl_datap_flush_pending(lisp_addr_t *eid_prefix, uint8_t resolved);
 
 
 void multicast_join_channel(lisp_addr_t *src, lisp_addr_t *grp);
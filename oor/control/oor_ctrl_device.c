@@ -53,6 +53,14 @@ ctrl_dev_recv(oor_ctrl_dev_t *dev, lbuf_t *b, uconn_t *uc)
     return(dev->ctrl_class->recv_msg(dev, b, uc));
 }
 
+void
+ctrl_dev_recv_batch(oor_ctrl_dev_t *dev, lbuf_t *msgs, int nmsgs)
+{
+    if (dev->ctrl_class->recv_batch){
+        dev->ctrl_class->recv_batch(dev, msgs, nmsgs);
+    }
+}
+
 void
 ctrl_dev_run(oor_ctrl_dev_t *dev)
 {
@@ -101,12 +109,26 @@ notify_datap_rm_fwd_from_entry(oor_ctrl_dev_t *dev, lisp_addr_t *eid_prefix, uin
     return(ctrl_datap_rm_fwd_from_entry(eid_prefix, is_local));
 }
 
+int
+notify_datap_update_local_fwd(oor_ctrl_dev_t *dev, lisp_addr_t *eid_prefix, glist_t *src_rlocs)
+{
+    return(ctrl_datap_update_local_fwd(eid_prefix, src_rlocs));
+}
+
 int
 notify_datap_reset_all_fwd(oor_ctrl_dev_t *dev)
 {
     return(ctrl_datap_reset_all_fwd());
 }
 
+/* The Map-Request of eid_prefix has been answered (resolved) or abandoned.
+ * The data plane forwards or drops the packets waiting for it */
+int
+notify_datap_flush_pending(oor_ctrl_dev_t *dev, lisp_addr_t *eid_prefix, uint8_t resolved)
+{
+    return(ctrl_datap_flush_pending(eid_prefix, resolved));
+}
+
 int
 ctrl_dev_if_link_update(oor_ctrl_dev_t *dev, char *iface_name, uint8_t status)
 {
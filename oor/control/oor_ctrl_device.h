@@ -37,6 +37,9 @@ typedef struct ctrl_dev_class_t {
     void (*init)(oor_ctrl_dev_t *);
     void (*run)(oor_ctrl_dev_t *dev);
     int (*recv_msg)(oor_ctrl_dev_t *, lbuf_t *, uconn_t *);
+    /* Optional. Called with the messages received at once before passing
+     * them one by one to recv_msg */
+    void (*recv_batch)(oor_ctrl_dev_t *, lbuf_t *, int);
     int (*if_link_update)(oor_ctrl_dev_t *, char *, uint8_t);
     int (*if_addr_update)(oor_ctrl_dev_t *, char *, lisp_addr_t *,lisp_addr_t *, uint8_t);
     int (*route_update)(oor_ctrl_dev_t *, int , char *,lisp_addr_t *,
@@ -60,6 +63,7 @@ extern ctrl_dev_class_t rtr_ctrl_class;
 int ctrl_dev_create(oor_dev_type_e , oor_ctrl_dev_t **);
 void ctrl_dev_destroy(oor_ctrl_dev_t *);
 int ctrl_dev_recv(oor_ctrl_dev_t *, lbuf_t *, uconn_t *);
+void ctrl_dev_recv_batch(oor_ctrl_dev_t *, lbuf_t *, int);
 void ctrl_dev_run(oor_ctrl_dev_t *);
 int ctrl_dev_if_link_update(oor_ctrl_dev_t *dev, char *iface_name, uint8_t status);
 int ctrl_dev_if_addr_update(oor_ctrl_dev_t *dev, char *iface_name,
@@ -73,7 +77,9 @@ int ctrl_dev_set_ctrl(oor_ctrl_dev_t *, oor_ctrl_t *);
 fwd_info_t *ctrl_dev_get_fwd_entry(oor_ctrl_dev_t *, packet_tuple_t *);
 
 int notify_datap_rm_fwd_from_entry(oor_ctrl_dev_t *dev, lisp_addr_t *eid_prefix, uint8_t is_local);
+int notify_datap_update_local_fwd(oor_ctrl_dev_t *dev, lisp_addr_t *eid_prefix, glist_t *src_rlocs);
 int notify_datap_reset_all_fwd(oor_ctrl_dev_t *dev);
+int notify_datap_flush_pending(oor_ctrl_dev_t *dev, lisp_addr_t *eid_prefix, uint8_t resolved);
 /* PRIVATE functions, used by xtr and ms */
 int send_msg(oor_ctrl_dev_t *, lbuf_t *, uconn_t *);
 
@@ -194,6 +194,13 @@ local_map_db_n_entries(local_map_db_t *lmdb)
     return(lmdb->db->n_entries);
 }
 
+/* Check if there are local EIDs more specific than the prefix eid */
+uint8_t
+local_map_db_has_more_specific(local_map_db_t *lmdb, lisp_addr_t *eid)
+{
+    return (mdb_has_more_specific(lmdb->db, eid));
+}
+
 void
 local_map_db_dump(local_map_db_t *lmdb, int log_level)
 {
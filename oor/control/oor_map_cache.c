@@ -21,6 +21,13 @@
 #include "../lib/oor_log.h"
 #include <math.h>
 
+/* Max number of entries checked to find one to evict, as a multiple of the
+ * number of entries */
+#define MCACHE_EVICT_MAX_ROUNDS     4
+
+static void mcache_evict_link(map_cache_db_t *mcdb, mcache_entry_t *mce);
+static void mcache_evict_unlink(map_cache_db_t *mcdb, mcache_entry_t *mce);
+static uint32_t mcache_evict_activity(map_cache_db_t *mcdb, mcache_entry_t *mce);
 
 map_cache_db_t*
 mcache_new()
@@ -43,21 +50,169 @@ mcache_new()
 void
 mcache_del(map_cache_db_t *mcdb)
 {
+    mcache_dump_stats(mcdb, LDBG_1);
     mdb_del(mcdb->db, (mdb_del_fct)mcache_entry_del);
     free(mcdb);
 }
 
+void
+mcache_set_limits(map_cache_db_t *mcdb, uint32_t max_entries, uint64_t max_bytes,
+        mcache_evict_policy_e policy)
+{
+    mcdb->max_entries = max_entries;
+    mcdb->max_bytes = max_bytes;
+    mcdb->evict_policy = policy;
+}
+
 
 int
 mcache_add_entry(map_cache_db_t *mcdb, lisp_addr_t *key, mcache_entry_t *mce)
 {
-    return(mdb_add_entry(mcdb->db, key, mce));
+    if (mdb_add_entry(mcdb->db, key, mce) != GOOD){
+        return (BAD);
+    }
+    mce->size = mcache_entry_mem_size(mce);
+    mcdb->stats.entries++;
+    mcdb->stats.bytes += mce->size;
+    if (mcache_entry_evictable(mce)){
+        mcache_evict_link(mcdb, mce);
+    }
+    return (GOOD);
 }
 
 void *
 mcache_remove_entry(map_cache_db_t *mcdb, lisp_addr_t *key)
 {
-    return(mdb_remove_entry(mcdb->db, key));
+    mcache_entry_t *mce = mdb_remove_entry(mcdb->db, key);
+
+    if (!mce){
+        return (NULL);
+    }
+    mcdb->stats.entries--;
+    mcdb->stats.bytes -= mce->size;
+    mcache_evict_unlink(mcdb, mce);
+
+    return (mce);
+}
+
+/* Account the memory of an entry whose mapping has changed */
+void
+mcache_update_entry_size(map_cache_db_t *mcdb, mcache_entry_t *mce)
+{
+    uint32_t size = mcache_entry_mem_size(mce);
+
+    mcdb->stats.bytes = mcdb->stats.bytes - mce->size + size;
+    mce->size = size;
+}
+
+/* The entries of the map cache exceed its limits */
+uint8_t
+mcache_over_limits(map_cache_db_t *mcdb)
+{
+    if (mcdb->max_entries != 0 && mcdb->stats.entries > mcdb->max_entries){
+        return (TRUE);
+    }
+    if (mcdb->max_bytes != 0 && mcdb->stats.bytes > mcdb->max_bytes){
+        return (TRUE);
+    }
+    return (FALSE);
+}
+
+/* Value of the activity of the entry used by the eviction policy */
+static uint32_t
+mcache_evict_activity(map_cache_db_t *mcdb, mcache_entry_t *mce)
+{
+    if (mcdb->evict_policy == MCACHE_EVICT_LFU){
+        return (mcache_activity_uses(mce->activity));
+    }
+    return (mcache_activity_last_used(mce->activity));
+}
+
+/* New entries are linked just behind the hand, so they are the last ones to be
+ * checked */
+static void
+mcache_evict_link(map_cache_db_t *mcdb, mcache_entry_t *mce)
+{
+    mcache_entry_t *hand = mcdb->evict_hand;
+
+    mce->evict_seen = mcache_evict_activity(mcdb, mce);
+    mce->evict_credit = 0;
+    if (!hand){
+        mce->evict_prev = mce;
+        mce->evict_next = mce;
+        mcdb->evict_hand = mce;
+        return;
+    }
+    mce->evict_next = hand;
+    mce->evict_prev = hand->evict_prev;
+    hand->evict_prev->evict_next = mce;
+    hand->evict_prev = mce;
+}
+
+static void
+mcache_evict_unlink(map_cache_db_t *mcdb, mcache_entry_t *mce)
+{
+    if (!mce->evict_next){
+        return;
+    }
+    if (mce->evict_next == mce){
+        mcdb->evict_hand = NULL;
+    }else{
+        mce->evict_prev->evict_next = mce->evict_next;
+        mce->evict_next->evict_prev = mce->evict_prev;
+        if (mcdb->evict_hand == mce){
+            mcdb->evict_hand = mce->evict_next;
+        }
+    }
+    mce->evict_prev = NULL;
+    mce->evict_next = NULL;
+}
+
+/* Set the last use of an entry not yet used by the data plane, without
+ * counting it as a use for the eviction */
+void
+mcache_set_entry_last_used(map_cache_db_t *mcdb, mcache_entry_t *mce,
+        uint32_t last_used)
+{
+    mcache_activity_set_last_used(mce->activity, last_used);
+    mce->evict_seen = mcache_evict_activity(mcdb, mce);
+}
+
+/*
+ * Select the entry to evict with the CLOCK algorithm. The hand gives a new
+ * chance to the entries used since its last pass:
+ *  - LRU: One chance if the entry has been used.
+ *  - LFU: The seconds in which the entry has been used are added to its
+ *    chances, which are halved in each pass to age them.
+ * The entries waiting for a Map-Reply get no chance. Returns NULL if no entry
+ * can be evicted
+ */
+mcache_entry_t *
+mcache_eviction_candidate(map_cache_db_t *mcdb)
+{
+    mcache_entry_t *mce;
+    uint32_t activity;
+    uint64_t budget = (uint64_t)mcdb->stats.entries * MCACHE_EVICT_MAX_ROUNDS;
+
+    while (mcdb->evict_hand && budget > 0){
+        budget--;
+        mce = mcdb->evict_hand;
+        mcdb->evict_hand = mce->evict_next;
+        activity = mcache_evict_activity(mcdb, mce);
+        if (mcdb->evict_policy == MCACHE_EVICT_LFU){
+            mce->evict_credit = (mce->evict_credit + activity - mce->evict_seen) >> 1;
+        }else if (activity != mce->evict_seen){
+            mce->evict_credit = 1;
+        }else{
+            mce->evict_credit = 0;
+        }
+        mce->evict_seen = activity;
+        if (mce->evict_credit == 0 || !mcache_entry_active(mce)){
+            return (mce);
+        }
+    }
+    /* Every entry is in use. Evict the one under the hand */
+    return (mcdb->evict_hand);
 }
 
 
@@ -72,13 +227,16 @@ mcache_lookup(map_cache_db_t *mcdb, lisp_addr_t *laddr)
     mcache_entry_t * mce = mdb_lookup_entry(mcdb->db, laddr);
     lisp_addr_t *eid;
     if (!mce){
+        mcdb->stats.misses++;
         return (NULL);
     }
     eid =  mcache_entry_eid(mce);
     // If the entry is the all space entry return NULL
     if (lisp_addr_is_ip_pref(eid) && lisp_addr_get_plen(eid) == 0){
+        mcdb->stats.misses++;
         return (NULL);
     }
+    mcdb->stats.hits++;
     return(mce);
 }
 
@@ -114,6 +272,29 @@ mcache_get_all_space_entry(map_cache_db_t *mcdb, int afi)
     }
 }
 
+/*
+ * Check if there are entries more specific than the prefix laddr
+ */
+uint8_t
+mcache_has_more_specific(map_cache_db_t *mcdb, lisp_addr_t *laddr)
+{
+    return (mdb_has_more_specific(mcdb->db, laddr));
+}
+
+void
+mcache_dump_stats(map_cache_db_t *mcdb, int log_level)
+{
+    uint64_t lookups = mcdb->stats.hits + mcdb->stats.misses;
+
+    if (!is_loggable(log_level)){
+        return;
+    }
+    OOR_LOG(log_level, "Map cache: %u/%u entries, %"PRIu64"/%"PRIu64" bytes, "
+            "hits: %"PRIu64", misses: %"PRIu64" (hit ratio %"PRIu64"%%), evictions: %"PRIu64,
+            mcdb->stats.entries, mcdb->max_entries, mcdb->stats.bytes, mcdb->max_bytes,
+            mcdb->stats.hits, mcdb->stats.misses,
+            lookups > 0 ? mcdb->stats.hits * 100 / lookups : 0, mcdb->stats.evictions);
+}
 
 void mcache_dump_db(map_cache_db_t *mcdb, int log_level)
 {
@@ -129,6 +310,7 @@ void mcache_dump_db(map_cache_db_t *mcdb, int log_level)
         mce = (mcache_entry_t *)it;
         map_cache_entry_dump(mce, log_level);
     } mdb_foreach_entry_end;
+    mcache_dump_stats(mcdb, log_level);
     OOR_LOG(log_level,"*******************************************************\n");
 
 }
@@ -25,12 +25,43 @@
 #include "../lib/mapping_db.h"
 #include "../liblisp/liblisp.h"
 
+typedef enum mcache_evict_policy {
+    MCACHE_EVICT_LRU,
+    MCACHE_EVICT_LFU
+} mcache_evict_policy_e;
+
+typedef struct mcache_stats_ {
+    uint32_t entries;
+    uint64_t bytes;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} mcache_stats_t;
+
 typedef struct map_cache_db {
     mdb_t *db;
+    /* Limits of the map cache. 0 means no limit. Only the dynamic entries
+     * are evicted to keep it under them */
+    uint32_t max_entries;
+    uint64_t max_bytes;
+    mcache_evict_policy_e evict_policy;
+    /* Circular list of the evictable entries. The hand points to the next
+     * entry to check */
+    mcache_entry_t *evict_hand;
+    mcache_stats_t stats;
 } map_cache_db_t;
 
 map_cache_db_t *mcache_new();
 void mcache_del(map_cache_db_t *mcdb);
+void mcache_set_limits(map_cache_db_t *mcdb, uint32_t max_entries, uint64_t max_bytes,
+        mcache_evict_policy_e policy);
+uint8_t mcache_over_limits(map_cache_db_t *mcdb);
+mcache_entry_t *mcache_eviction_candidate(map_cache_db_t *mcdb);
+void mcache_update_entry_size(map_cache_db_t *mcdb, mcache_entry_t *mce);
+void mcache_set_entry_last_used(map_cache_db_t *mcdb, mcache_entry_t *mce,
+        uint32_t last_used);
+void mcache_dump_stats(map_cache_db_t *mcdb, int log_level);
+static inline mcache_stats_t *mcache_get_stats(map_cache_db_t *mcdb);
 
 
 int mcache_add_entry(map_cache_db_t *, lisp_addr_t *key, mcache_entry_t *entry);
@@ -39,9 +70,16 @@ void map_cache_del_entry(map_cache_db_t *, lisp_addr_t *laddr);
 mcache_entry_t *mcache_lookup_exact(map_cache_db_t *, lisp_addr_t *addr);
 mcache_entry_t *mcache_lookup(map_cache_db_t *, lisp_addr_t *addr);
 mcache_entry_t *mcache_get_all_space_entry(map_cache_db_t *mcdb,int afi);
+uint8_t mcache_has_more_specific(map_cache_db_t *mcdb, lisp_addr_t *laddr);
 
 void mcache_dump_db(map_cache_db_t *, int log_level);
 
+static inline mcache_stats_t *
+mcache_get_stats(map_cache_db_t *mcdb)
+{
+    return (&mcdb->stats);
+}
+
 #define mcache_foreach_entry(MC, EIT)               \
     mdb_foreach_entry((MC)->db, (EIT)) {
 
@@ -22,6 +22,18 @@
 
 data_plane_struct_t *data_plane = NULL;
 
+data_plane_conf_t dplane_conf = {
+        .pkt_batch_size = DEFAULT_DATA_PKT_BATCH_SIZE,
+        .flow_table_size = DEFAULT_FLOW_TABLE_SIZE,
+        .flow_idle_timeout = DEFAULT_FLOW_IDLE_TIMEOUT,
+        .data_plane_threads = DEFAULT_DATA_PLANE_THREADS,
+        .pending_pkts_per_eid = DEFAULT_PENDING_PKTS_PER_EID,
+        .pending_pkts_mem = DEFAULT_PENDING_PKTS_MEM,
+        .ipv4_udp_checksum = DEFAULT_IPV4_UDP_CHECKSUM,
+        .rx_ring_size = DEFAULT_DATA_RX_RING_SIZE,
+        .prefix_table_size = DEFAULT_PREFIX_TABLE_SIZE
+};
+
 void data_plane_select()
 {
 #ifdef VPNAPI
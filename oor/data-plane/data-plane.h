@@ -24,6 +24,59 @@
 typedef struct iface iface_t;
 typedef struct sock sock_t;
 
+/* Number of packets read and sent per socket wake up of the data plane */
+#define DEFAULT_DATA_PKT_BATCH_SIZE     32
+#define MAX_DATA_PKT_BATCH_SIZE         256
+
+/* Max number of flows of the forwarding table of the data plane */
+#define DEFAULT_FLOW_TABLE_SIZE         16384
+#define MIN_FLOW_TABLE_SIZE             64
+#define MAX_FLOW_TABLE_SIZE             4194304
+
+/* Seconds without packets after which a flow is removed from the forwarding
+ * table of the data plane. 0 disables the aging of flows */
+#define DEFAULT_FLOW_IDLE_TIMEOUT       300
+#define MAX_FLOW_IDLE_TIMEOUT           86400
+
+/* Number of threads forwarding data packets. 0 forwards them in the main loop */
+#define DEFAULT_DATA_PLANE_THREADS      0
+#define MAX_DATA_PLANE_THREADS          64
+
+/* Packets kept per destination EID while its Map-Request is outstanding and
+ * KB of memory used by all of them. 0 packets disables the queuing */
+#define DEFAULT_PENDING_PKTS_PER_EID    16
+#define MAX_PENDING_PKTS_PER_EID        1024
+#define DEFAULT_PENDING_PKTS_MEM        1024
+#define MAX_PENDING_PKTS_MEM            262144
+
+/* Compute the UDP checksum of the encapsulated IPv4 packets. It is always
+ * computed for IPv6 */
+#define DEFAULT_IPV4_UDP_CHECKSUM       TRUE
+
+/* KB of the AF_PACKET ring used to receive encapsulated packets when they are
+ * forwarded by the main loop. 0 uses raw sockets */
+#define DEFAULT_DATA_RX_RING_SIZE       0
+#define MAX_DATA_RX_RING_SIZE           1048576
+
+/* Max number of pairs of local and remote EID prefixes whose RLOCs are cached
+ * per data plane thread, so new flows between them don't use the control
+ * plane. 0 disables the cache */
+#define DEFAULT_PREFIX_TABLE_SIZE       1024
+#define MAX_PREFIX_TABLE_SIZE           65536
+
+/* Data plane tunables. Filled by the configuration parser before datap_init */
+typedef struct data_plane_conf_ {
+    int pkt_batch_size;
+    int flow_table_size;
+    int flow_idle_timeout;
+    int data_plane_threads;
+    int pending_pkts_per_eid;
+    int pending_pkts_mem;
+    int ipv4_udp_checksum;
+    int rx_ring_size;
+    int prefix_table_size;
+} data_plane_conf_t;
+
 /* functions to manipulate routing */
 typedef struct data_plane_struct {
     int (*datap_init)(oor_dev_type_e dev_type, oor_encap_t encap_type,  ...);
@@ -40,13 +93,17 @@ typedef struct data_plane_struct {
     int (*datap_updated_addr)(iface_t *iface,lisp_addr_t *old_addr,lisp_addr_t *new_addr);
     int (*datap_update_link)(iface_t *iface, int old_iface_index, int new_iface_index, int status);
     int (*datap_rm_fwd_from_entry)(lisp_addr_t *eid_prefix, uint8_t is_local);
+    int (*datap_update_local_fwd)(lisp_addr_t *eid_prefix, glist_t *src_rlocs);
     int (*datap_reset_all_fwd)();
+    int (*datap_flush_pending)(lisp_addr_t *eid_prefix, uint8_t resolved);
 
     void *datap_data;
 } data_plane_struct_t;
 
 void data_plane_select();
 
+extern data_plane_conf_t dplane_conf;
+
 extern data_plane_struct_t dplane_tun;
 extern data_plane_struct_t dplane_vpnapi;
 extern data_plane_struct_t dplane_vpp;
@@ -84,6 +84,32 @@ vxlan_gpe_data_encap(lbuf_t *b, int lp, int rp, lisp_addr_t *la, lisp_addr_t *ra
     return(lbuf_data(b));
 }
 
+/* Prebuild the outer headers used to encapsulate the packets to 'dst_eid' sent
+ * from RLOC 'la' to RLOC 'ra'. See pkt_push_hdr_tmpl */
+int
+vxlan_gpe_data_hdr_tmpl_init(pkt_hdr_tmpl_t *tmpl, int lp, int rp, lisp_addr_t *la,
+        lisp_addr_t *ra, uint32_t vni, lisp_addr_t *dst_eid, uint8_t udp_csum)
+{
+    vxlan_gpe_hdr_t vhdr;
+    vxlan_gpe_nprot_t next_prot;
+
+    switch (lisp_addr_ip_afi(dst_eid)){
+    case AF_INET:
+        next_prot = NP_IPv4;
+        break;
+    case AF_INET6:
+        next_prot = NP_IPv6;
+        break;
+    default:
+        OOR_LOG(LDBG_1, "vxlan_gpe_data_hdr_tmpl_init: Next protocol not supported");
+        return (BAD);
+    }
+
+    vxlan_gpe_data_hdr_init(&vhdr, vni, next_prot);
+    return (pkt_hdr_tmpl_init(tmpl, lp, rp, lisp_addr_ip(la), lisp_addr_ip(ra),
+            &vhdr, sizeof(vxlan_gpe_hdr_t), udp_csum));
+}
+
 void *
 vxlan_gpe_data_pull_hdr(lbuf_t *b)
 {
@@ -0,0 +1,394 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "etable.h"
+#include "../lib/mem_util.h"
+#include "../lib/packets.h"
+#include "../lib/oor_log.h"
+#include "../fwd_policies/fwd_policy.h"
+#include "../fwd_policies/flow_balancing/fwd_entry_tuple.h"
+#include "../liblisp/liblisp.h"
+
+
+#define ETABLE_MIN_BUCKETS  64
+
+static inline int
+etable_afi_idx(int afi)
+{
+    return (afi == AF_INET ? 0 : 1);
+}
+
+static int
+etable_key_from_laddr(lisp_addr_t *laddr, etable_list_e type, etable_key_t *key)
+{
+    lisp_addr_t *ip_pref = lisp_addr_get_ip_pref_addr(laddr);
+    ip_addr_t *ip;
+    uint8_t plen;
+    int nbytes;
+
+    if (ip_pref){
+        ip = lisp_addr_ip_get_addr(ip_pref);
+        plen = lisp_addr_ip_get_plen(ip_pref);
+    }else{
+        /* Host EID */
+        ip_pref = lisp_addr_get_ip_addr(laddr);
+        if (!ip_pref){
+            return (BAD);
+        }
+        ip = lisp_addr_ip(ip_pref);
+        plen = ip_addr_afi(ip) == AF_INET ? 32 : 128;
+    }
+    if (!ip || (ip_addr_afi(ip) != AF_INET && ip_addr_afi(ip) != AF_INET6)){
+        return (BAD);
+    }
+
+    memset(key, 0, sizeof(etable_key_t));
+    nbytes = plen >> 3;
+    memcpy(key->addr, ip_addr_get_addr(ip), nbytes);
+    if (plen & 0x07){
+        key->addr[nbytes] = ((uint8_t *)ip_addr_get_addr(ip))[nbytes] & (0xff << (8 - (plen & 0x07)));
+    }
+    key->plen = plen;
+    key->afi = ip_addr_afi(ip);
+    key->type = type;
+    if (lisp_addr_is_iid(laddr)){
+        key->iid = lcaf_iid_get_iid(lisp_addr_get_lcaf(laddr));
+    }
+    return (GOOD);
+}
+
+static inline uint32_t
+etable_key_hash(etable_key_t *key)
+{
+    return (pkt_hash_key((uint32_t *)key, sizeof(etable_key_t) / sizeof(uint32_t), 1982));
+}
+
+static inline fwd_info_link_t *
+etable_link(etable_bucket_t *b, fwd_info_t *fi)
+{
+    switch (b->key.type){
+    case ETABLE_LOCAL_EID:
+        return (&fi->local_link);
+    case ETABLE_PXTR:
+        return (&fi->pxtr_link);
+    default:
+        return (&fi->eid_link);
+    }
+}
+
+static void
+etable_list_add(etable_bucket_t *b, fwd_info_t *fi)
+{
+    fwd_info_link_t *link = etable_link(b, fi);
+
+    link->prev = NULL;
+    link->next = b->flows;
+    link->list = b;
+    if (b->flows){
+        etable_link(b, b->flows)->prev = fi;
+    }
+    b->flows = fi;
+    b->nflows++;
+}
+
+static void
+etable_list_del(etable_bucket_t *b, fwd_info_t *fi)
+{
+    fwd_info_link_t *link = etable_link(b, fi);
+
+    if (link->prev){
+        etable_link(b, link->prev)->next = link->next;
+    }else{
+        b->flows = link->next;
+    }
+    if (link->next){
+        etable_link(b, link->next)->prev = link->prev;
+    }
+    link->prev = link->next = NULL;
+    link->list = NULL;
+    b->nflows--;
+}
+
+static etable_bucket_t *
+etable_bucket_lookup(etable_t *et, etable_key_t *key, uint32_t hash)
+{
+    etable_bucket_t *b;
+
+    for (b = et->buckets[hash & et->mask]; b; b = b->next){
+        if (b->hash == hash && memcmp(&b->key, key, sizeof(etable_key_t)) == 0){
+            return (b);
+        }
+    }
+    return (NULL);
+}
+
+/* Double the number of buckets when the EIDs outnumber them */
+static void
+etable_grow(etable_t *et)
+{
+    etable_bucket_t **buckets, *b, *next;
+    uint32_t nbuckets = (et->mask + 1) << 1;
+    uint32_t i;
+
+    buckets = xzalloc(nbuckets * sizeof(etable_bucket_t *));
+    for (i = 0; i <= et->mask; i++){
+        for (b = et->buckets[i]; b; b = next){
+            next = b->next;
+            b->next = buckets[b->hash & (nbuckets - 1)];
+            buckets[b->hash & (nbuckets - 1)] = b;
+        }
+    }
+    free(et->buckets);
+    et->buckets = buckets;
+    et->mask = nbuckets - 1;
+}
+
+static etable_bucket_t *
+etable_bucket_get(etable_t *et, etable_key_t *key)
+{
+    etable_bucket_t *b;
+    uint32_t hash = etable_key_hash(key);
+
+    b = etable_bucket_lookup(et, key, hash);
+    if (b){
+        return (b);
+    }
+    if (et->count > et->mask){
+        etable_grow(et);
+    }
+    b = xzalloc(sizeof(etable_bucket_t));
+    b->hash = hash;
+    b->key = *key;
+    b->next = et->buckets[hash & et->mask];
+    et->buckets[hash & et->mask] = b;
+    et->count++;
+    return (b);
+}
+
+static void
+etable_bucket_del(etable_t *et, etable_bucket_t *b)
+{
+    etable_bucket_t **prev = &et->buckets[b->hash & et->mask];
+
+    while (*prev != b){
+        prev = &(*prev)->next;
+    }
+    *prev = b->next;
+    free(b);
+    et->count--;
+}
+
+/* Unlink the flow and remove it from the flow table */
+static void
+etable_rm_flow(etable_t *et, fwd_info_t *fi)
+{
+    etable_unlink(et, fi);
+    et->rm_fn(fi);
+}
+
+
+void
+etable_init(etable_t *et, etable_rm_fn_t rm_fn)
+{
+    memset(et, 0, sizeof(etable_t));
+    et->buckets = xzalloc(ETABLE_MIN_BUCKETS * sizeof(etable_bucket_t *));
+    et->mask = ETABLE_MIN_BUCKETS - 1;
+    et->pxtr[0].key.type = ETABLE_PXTR;
+    et->pxtr[1].key.type = ETABLE_PXTR;
+    et->no_local.key.type = ETABLE_LOCAL_EID;
+    et->rm_fn = rm_fn;
+}
+
+/* Free the index. The flows are not removed nor unlinked */
+void
+etable_uninit(etable_t *et)
+{
+    etable_bucket_t *b, *next;
+    uint32_t i;
+
+    if (!et->buckets){
+        return;
+    }
+    for (i = 0; i <= et->mask; i++){
+        for (b = et->buckets[i]; b; b = next){
+            next = b->next;
+            free(b);
+        }
+    }
+    free(et->buckets);
+    memset(et, 0, sizeof(etable_t));
+}
+
+/* Link the flow with the EID of its mapping, with the EID of its local
+ * mapping and, for negative mappings forwarded natively, with the PeTRs of
+ * its AFI */
+int
+etable_add(etable_t *et, fwd_info_t *fi)
+{
+    etable_key_t key, local_key;
+
+    if (!fi->associated_entry
+            || etable_key_from_laddr(fi->associated_entry, ETABLE_EID, &key) != GOOD){
+        OOR_LOG(LDBG_2, "etable_add: The EID of the flow is not an IP prefix. It can not be "
+                "invalidated");
+        return (BAD);
+    }
+    etable_list_add(etable_bucket_get(et, &key), fi);
+
+    /* Without local EID the flow is removed by any change of the local
+     * mappings */
+    if (fi->local_entry
+            && etable_key_from_laddr(fi->local_entry, ETABLE_LOCAL_EID, &local_key) == GOOD){
+        etable_list_add(etable_bucket_get(et, &local_key), fi);
+    }else{
+        etable_list_add(&et->no_local, fi);
+    }
+
+    if (fi->neg_map_reply_act == ACT_NATIVE_FWD){
+        etable_list_add(&et->pxtr[etable_afi_idx(key.afi)], fi);
+    }
+    return (GOOD);
+}
+
+/* Remove the references of the index to the flow. Used when the flow table
+ * evicts it */
+void
+etable_unlink(etable_t *et, fwd_info_t *fi)
+{
+    etable_bucket_t *b = (etable_bucket_t *)fi->eid_link.list;
+
+    if (b){
+        etable_list_del(b, fi);
+        if (b->nflows == 0){
+            etable_bucket_del(et, b);
+        }
+    }
+    b = (etable_bucket_t *)fi->local_link.list;
+    if (b){
+        etable_list_del(b, fi);
+        if (b->nflows == 0 && b != &et->no_local){
+            etable_bucket_del(et, b);
+        }
+    }
+    b = (etable_bucket_t *)fi->pxtr_link.list;
+    if (b){
+        etable_list_del(b, fi);
+    }
+}
+
+/* Eviction callback of the flow tables whose evict_arg is the EID index of
+ * the same data plane */
+void
+etable_evict_flow(void *et, fwd_info_t *fi)
+{
+    etable_unlink((etable_t *)et, fi);
+}
+
+/* Remove the flows associated with the EID. When the EID is the whole IPv4 or
+ * IPv6 space, the PeTRs have changed and the flows forwarded to them are
+ * removed too. Returns BAD if no flow was found */
+int
+etable_remove_eid(etable_t *et, lisp_addr_t *eid)
+{
+    etable_bucket_t *b, *pxtr = NULL;
+    etable_key_t key;
+    uint32_t n;
+
+    if (etable_key_from_laddr(eid, ETABLE_EID, &key) != GOOD){
+        return (BAD);
+    }
+    if (key.plen == 0 && key.iid == 0){
+        pxtr = &et->pxtr[etable_afi_idx(key.afi)];
+    }
+
+    b = etable_bucket_lookup(et, &key, etable_key_hash(&key));
+    if (!b && (!pxtr || !pxtr->flows)){
+        return (BAD);
+    }
+    if (b){
+        /* The bucket is freed with its last flow */
+        for (n = b->nflows; n > 0; n--){
+            etable_rm_flow(et, b->flows);
+        }
+    }
+    if (pxtr){
+        while (pxtr->flows){
+            etable_rm_flow(et, pxtr->flows);
+        }
+    }
+    return (GOOD);
+}
+
+/* The locators of a local mapping changed. Its flows keep their RLOCs if their
+ * source RLOC is one of src_rlocs. The rest are removed to be resolved again.
+ * Returns the number of flows removed */
+uint32_t
+etable_update_local_eid(etable_t *et, lisp_addr_t *eid, lisp_addr_t *src_rlocs,
+        int nrlocs)
+{
+    etable_bucket_t *b;
+    etable_key_t key;
+    fwd_info_t *fi, *next;
+    fwd_entry_tuple_t *fe;
+    uint32_t n, removed = 0;
+    int i;
+
+    while (et->no_local.flows){
+        etable_rm_flow(et, et->no_local.flows);
+        removed++;
+    }
+    if (etable_key_from_laddr(eid, ETABLE_LOCAL_EID, &key) != GOOD){
+        return (removed);
+    }
+    b = etable_bucket_lookup(et, &key, etable_key_hash(&key));
+    if (!b){
+        return (removed);
+    }
+    /* The bucket is freed if its last flow is removed */
+    for (n = b->nflows, fi = b->flows; n > 0; n--, fi = next){
+        next = fi->local_link.next;
+        fe = (fwd_entry_tuple_t *)fi->dp_conf_inf;
+        for (i = 0; fe && fe->srloc && fe->drloc && i < nrlocs; i++){
+            if (lisp_addr_cmp(fe->srloc, &src_rlocs[i]) == 0){
+                break;
+            }
+        }
+        if (!fe || !fe->srloc || !fe->drloc || i == nrlocs){
+            etable_rm_flow(et, fi);
+            removed++;
+        }
+    }
+    return (removed);
+}
+
+/* Remove all the flows of the index */
+void
+etable_flush(etable_t *et)
+{
+    etable_bucket_t *b;
+    uint32_t i, n;
+
+    for (i = 0; i <= et->mask; i++){
+        while ((b = et->buckets[i])){
+            for (n = b->nflows; n > 0; n--){
+                etable_rm_flow(et, b->flows);
+            }
+        }
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ETABLE_H_
+#define ETABLE_H_
+
+#include "../lib/packets.h"
+
+typedef struct fwd_info_ fwd_info_t;
+
+/* Called to remove from the flow table a flow invalidated by the index. The
+ * flow is no longer linked when it is called */
+typedef void (*etable_rm_fn_t)(fwd_info_t *fi);
+
+typedef enum {
+    ETABLE_EID,         /* Flows of a remote EID, linked through eid_link */
+    ETABLE_LOCAL_EID,   /* Flows of a local EID, linked through local_link */
+    ETABLE_PXTR         /* Flows sent to the PeTRs, linked through pxtr_link */
+} etable_list_e;
+
+/* EID prefix with the address stored in network order and the bits beyond
+ * plen set to 0. The padding is zeroed so keys can be compared with memcmp */
+typedef struct etable_key_ {
+    uint8_t             addr[16];
+    uint32_t            iid;
+    uint8_t             plen;
+    uint8_t             afi;
+    uint8_t             type;       /* etable_list_e */
+    uint8_t             pad;
+} etable_key_t;
+
+/* Flows associated with a remote or a local EID prefix, or flows forwarded to
+ * the PeTRs of an AFI */
+typedef struct etable_bucket_ {
+    struct etable_bucket_ *next;
+    uint32_t            hash;
+    etable_key_t        key;
+    uint32_t            nflows;
+    fwd_info_t          *flows;
+} etable_bucket_t;
+
+/* Index of the flows of the data plane by the EID prefix of their mapping and
+ * of their local mapping.
+ * Flows are linked in place so an EID is invalidated in time proportional to
+ * its number of flows, and a flow is unlinked in constant time when it is
+ * evicted. Buckets are created with the first flow of an EID and freed with
+ * the last one, except the PeTR lists of IPv4 [0] and IPv6 [1] EIDs and the
+ * list of flows without local EID */
+typedef struct etable_ {
+    etable_bucket_t     **buckets;
+    uint32_t            mask;       /* number of buckets - 1 */
+    uint32_t            count;
+    etable_bucket_t     pxtr[2];
+    /* Flows whose local EID is not known. Removed on any local change */
+    etable_bucket_t     no_local;
+    etable_rm_fn_t      rm_fn;
+} etable_t;
+
+void etable_init(etable_t *et, etable_rm_fn_t rm_fn);
+void etable_uninit(etable_t *et);
+int etable_add(etable_t *et, fwd_info_t *fi);
+void etable_unlink(etable_t *et, fwd_info_t *fi);
+void etable_evict_flow(void *et, fwd_info_t *fi);
+int etable_remove_eid(etable_t *et, lisp_addr_t *eid);
+uint32_t etable_update_local_eid(etable_t *et, lisp_addr_t *eid, lisp_addr_t *src_rlocs,
+        int nrlocs);
+void etable_flush(etable_t *et);
+
+static inline uint32_t etable_size(etable_t *et)
+{
+    return (et->count);
+}
+
+#endif /* ETABLE_H_ */
@@ -0,0 +1,265 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+#include "pending_pkts.h"
+#include "../lib/mem_util.h"
+#include "../lib/oor_log.h"
+#include "../liblisp/liblisp.h"
+
+#define PENDING_PKTS_EXPIRY_INTERVAL    1
+
+static int pending_table_expiry_cb(oor_timer_t *timer);
+static void pending_queue_del(pending_queue_t *q);
+
+static inline uint32_t
+pending_clock()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint32_t)ts.tv_sec);
+}
+
+static inline uint32_t
+pending_pkt_mem(uint32_t len)
+{
+    return (sizeof(pending_pkt_t) + LBUF_STACK_OFFSET + len);
+}
+
+static void
+pending_queue_del(pending_queue_t *q)
+{
+    pending_pkt_t *p, *next;
+
+    for (p = q->head; p; p = next){
+        next = p->next;
+        free(p);
+    }
+    free(q->eid);
+    free(q);
+}
+
+
+pending_table_t *
+pending_table_new(uint32_t max_pkts_per_eid, uint32_t max_mem)
+{
+    pending_table_t *pt = xzalloc(sizeof(pending_table_t));
+
+    /* The queues are removed from the table before freeing them */
+    pt->queues = shash_new();
+    pt->max_pkts_per_eid = max_pkts_per_eid;
+    pt->max_mem = max_mem;
+    pt->expiry_timer = oor_timer_create(PENDING_PKTS_TIMER);
+    oor_timer_init(pt->expiry_timer, pt, pending_table_expiry_cb, pt, NULL, NULL);
+    return (pt);
+}
+
+void
+pending_table_del(pending_table_t *pt)
+{
+    glist_t *queues;
+    glist_entry_t *it;
+
+    if (!pt){
+        return;
+    }
+    oor_timer_stop(pt->expiry_timer);
+    queues = shash_values(pt->queues);
+    glist_for_each_entry(it, queues){
+        pending_queue_del((pending_queue_t *)glist_entry_data(it));
+    }
+    glist_destroy(queues);
+    shash_destroy(pt->queues);
+    pending_table_dump_stats(pt, LDBG_1);
+    free(pt);
+}
+
+/* Copy the packet to the queue of the EID prefix whose Map-Request is
+ * outstanding. Returns BAD if the packet is dropped because a cap is reached */
+int
+pending_table_add(pending_table_t *pt, lisp_addr_t *eid, lbuf_t *b,
+        packet_tuple_t *tuple)
+{
+    char *eid_str = lisp_addr_to_char(eid);
+    pending_queue_t *q;
+    pending_pkt_t *p;
+    uint32_t len = lbuf_size(b);
+    uint32_t mem = pending_pkt_mem(len);
+
+    q = (pending_queue_t *)shash_lookup(pt->queues, eid_str);
+    if (q && q->npkts >= pt->max_pkts_per_eid){
+        pt->stats.eid_cap_drops++;
+        return (BAD);
+    }
+    if (pt->mem + mem > pt->max_mem){
+        pt->stats.mem_cap_drops++;
+        return (BAD);
+    }
+
+    if (!q){
+        q = xzalloc(sizeof(pending_queue_t));
+        q->eid = strdup(eid_str);
+        q->created = pending_clock();
+        shash_insert(pt->queues, strdup(eid_str), q);
+        if (pt->nqueues++ == 0){
+            oor_timer_start(pt->expiry_timer, PENDING_PKTS_EXPIRY_INTERVAL);
+        }
+    }
+
+    p = xmalloc(mem);
+    p->next = NULL;
+    p->tuple = *tuple;
+    lbuf_use_stack(&p->pkt, (uint8_t *)(p + 1), LBUF_STACK_OFFSET + len);
+    lbuf_reserve(&p->pkt, LBUF_STACK_OFFSET);
+    lbuf_put(&p->pkt, lbuf_data(b), len);
+    if (q->tail){
+        q->tail->next = p;
+    }else{
+        q->head = p;
+    }
+    q->tail = p;
+    q->npkts++;
+    q->mem += mem;
+    pt->mem += mem;
+    pt->stats.queued++;
+
+    OOR_LOG(LDBG_3, "pending_table_add: Packet queued waiting for the mapping of %s (%u queued)",
+            eid_str, q->npkts);
+    return (GOOD);
+}
+
+/* Remove the queue of the EID prefix. If replay_fn is not NULL, the packets
+ * are passed to it in arrival order and then end_fn is called, otherwise they
+ * are dropped. The queue is detached before replaying, so replay_fn can queue
+ * the packets again. Returns the number of packets of the queue */
+int
+pending_table_flush(pending_table_t *pt, lisp_addr_t *eid,
+        pending_replay_fn_t replay_fn, pending_replay_end_fn_t end_fn)
+{
+    char *eid_str = lisp_addr_to_char(eid);
+    pending_queue_t *q;
+    pending_pkt_t *p;
+    uint32_t npkts;
+
+    q = (pending_queue_t *)shash_lookup(pt->queues, eid_str);
+    if (!q){
+        return (0);
+    }
+    shash_remove(pt->queues, eid_str);
+    pt->nqueues--;
+    pt->mem -= q->mem;
+    npkts = q->npkts;
+
+    if (replay_fn){
+        OOR_LOG(LDBG_2, "pending_table_flush: Forwarding %u packets waiting for the mapping of %s",
+                npkts, q->eid);
+        for (p = q->head; p; p = p->next){
+            lbuf_reset_ip(&p->pkt);
+            replay_fn(&p->pkt, &p->tuple);
+        }
+        if (end_fn){
+            end_fn();
+        }
+        pt->stats.replayed += npkts;
+    }else{
+        OOR_LOG(LDBG_2, "pending_table_flush: Dropping %u packets waiting for the mapping of %s",
+                npkts, q->eid);
+        pt->stats.dropped += npkts;
+    }
+    pending_queue_del(q);
+
+    return (npkts);
+}
+
+/* Drop the queues that have been waiting more than PENDING_PKTS_TIMEOUT.
+ * Returns the number of packets dropped */
+uint32_t
+pending_table_expire(pending_table_t *pt)
+{
+    glist_t *queues;
+    glist_entry_t *it;
+    pending_queue_t *q;
+    uint32_t now = pending_clock();
+    uint32_t expired = 0;
+
+    if (pt->nqueues == 0){
+        return (0);
+    }
+    queues = shash_values(pt->queues);
+    glist_for_each_entry(it, queues){
+        q = (pending_queue_t *)glist_entry_data(it);
+        if (now - q->created < PENDING_PKTS_TIMEOUT){
+            continue;
+        }
+        expired += q->npkts;
+        pt->mem -= q->mem;
+        pt->nqueues--;
+        shash_remove(pt->queues, q->eid);
+        pending_queue_del(q);
+    }
+    glist_destroy(queues);
+    pt->stats.expired += expired;
+
+    return (expired);
+}
+
+static int
+pending_table_expiry_cb(oor_timer_t *timer)
+{
+    pending_table_t *pt = (pending_table_t *)oor_timer_cb_argument(timer);
+    uint32_t expired;
+
+    expired = pending_table_expire(pt);
+    if (expired > 0){
+        OOR_LOG(LDBG_2, "Pending packets: Dropped %u packets without mapping after %d seconds",
+                expired, PENDING_PKTS_TIMEOUT);
+        pending_table_dump_stats(pt, LDBG_3);
+    }
+    /* The timer is only running while there are packets waiting */
+    if (pt->nqueues > 0){
+        oor_timer_start(timer, PENDING_PKTS_EXPIRY_INTERVAL);
+    }
+
+    return (GOOD);
+}
+
+void
+pending_table_dump_stats(pending_table_t *pt, int log_level)
+{
+    if (!is_loggable(log_level)){
+        return;
+    }
+    OOR_LOG(log_level, "Pending packets: %u EIDs, %u/%u bytes, queued: %"PRIu64
+            ", replayed: %"PRIu64", dropped: %"PRIu64", per EID cap drops: %"PRIu64
+            ", memory cap drops: %"PRIu64", expired: %"PRIu64,
+            pt->nqueues, pt->mem, pt->max_mem, pt->stats.queued,
+            pt->stats.replayed, pt->stats.dropped, pt->stats.eid_cap_drops,
+            pt->stats.mem_cap_drops, pt->stats.expired);
+}
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
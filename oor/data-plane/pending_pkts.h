@@ -0,0 +1,94 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef PENDING_PKTS_H_
+#define PENDING_PKTS_H_
+
+#include "../lib/lbuf.h"
+#include "../lib/packets.h"
+#include "../lib/shash.h"
+#include "../lib/timers.h"
+#include "../liblisp/lisp_address.h"
+
+/* Seconds a packet can wait for the Map-Reply of its destination EID. It is
+ * only a safeguard: the queues are flushed or dropped by the control plane
+ * when the Map-Request is answered or abandoned */
+#define PENDING_PKTS_TIMEOUT    10
+
+typedef struct pending_pkt_ {
+    struct pending_pkt_ *next;
+    packet_tuple_t      tuple;
+    lbuf_t              pkt;
+} pending_pkt_t;
+
+/* Packets waiting for the mapping of the same EID prefix, in arrival order */
+typedef struct pending_queue_ {
+    char            *eid;
+    pending_pkt_t   *head;
+    pending_pkt_t   *tail;
+    uint32_t        npkts;
+    uint32_t        mem;
+    uint32_t        created;
+} pending_queue_t;
+
+typedef struct pending_stats_ {
+    uint64_t queued;
+    uint64_t replayed;
+    uint64_t dropped;       /* Map-Request failed */
+    uint64_t eid_cap_drops;
+    uint64_t mem_cap_drops;
+    uint64_t expired;
+} pending_stats_t;
+
+/* Packets of flows whose destination is being resolved. They are kept while
+ * the Map-Request is outstanding and forwarded in a batch once the mapping is
+ * installed. Both the number of packets per EID and the total memory used are
+ * bounded */
+typedef struct pending_table_ {
+    shash_t         *queues;    /* char *eid -> pending_queue_t */
+    uint32_t        nqueues;
+    uint32_t        max_pkts_per_eid;
+    uint32_t        max_mem;
+    uint32_t        mem;
+    oor_timer_t     *expiry_timer;
+    pending_stats_t stats;
+} pending_table_t;
+
+typedef void (*pending_replay_fn_t)(lbuf_t *b, packet_tuple_t *tuple);
+/* Called once all the packets of a queue have been replayed and before they
+ * are freed. The packets only queued by the replay function must be sent */
+typedef void (*pending_replay_end_fn_t)();
+
+pending_table_t *pending_table_new(uint32_t max_pkts_per_eid, uint32_t max_mem);
+void pending_table_del(pending_table_t *pt);
+int pending_table_add(pending_table_t *pt, lisp_addr_t *eid, lbuf_t *b,
+        packet_tuple_t *tuple);
+int pending_table_flush(pending_table_t *pt, lisp_addr_t *eid,
+        pending_replay_fn_t replay_fn, pending_replay_end_fn_t end_fn);
+uint32_t pending_table_expire(pending_table_t *pt);
+void pending_table_dump_stats(pending_table_t *pt, int log_level);
+
+#endif /* PENDING_PKTS_H_ */
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,364 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "ptable.h"
+#include "../lib/mem_util.h"
+#include "../lib/packets.h"
+#include "../lib/oor_log.h"
+#include "../fwd_policies/fwd_policy.h"
+#include "../liblisp/liblisp.h"
+
+
+static inline int
+ptable_afi_idx(int afi)
+{
+    return (afi == AF_INET ? 0 : 1);
+}
+
+/* Copy the first plen bits of addr */
+static inline void
+ptable_pref_init(ptable_pref_t *pref, void *addr, int afi, uint8_t plen)
+{
+    int nbytes = plen >> 3;
+
+    memset(pref, 0, sizeof(ptable_pref_t));
+    memcpy(pref->addr, addr, nbytes);
+    if (plen & 0x07){
+        pref->addr[nbytes] = ((uint8_t *)addr)[nbytes] & (0xff << (8 - (plen & 0x07)));
+    }
+    pref->plen = plen;
+    pref->afi = afi;
+}
+
+static int
+ptable_pref_from_laddr(lisp_addr_t *laddr, ptable_pref_t *pref)
+{
+    lisp_addr_t *ip_pref = lisp_addr_get_ip_pref_addr(laddr);
+    ip_addr_t *ip;
+
+    if (!ip_pref){
+        return (BAD);
+    }
+    ip = lisp_addr_ip_get_addr(ip_pref);
+    if (!ip || (ip_addr_afi(ip) != AF_INET && ip_addr_afi(ip) != AF_INET6)){
+        return (BAD);
+    }
+    ptable_pref_init(pref, ip_addr_get_addr(ip), ip_addr_afi(ip),
+            lisp_addr_ip_get_plen(ip_pref));
+    return (GOOD);
+}
+
+static inline int
+ptable_pref_equal(ptable_pref_t *p1, ptable_pref_t *p2)
+{
+    return (memcmp(p1, p2, sizeof(ptable_pref_t)) == 0);
+}
+
+/* Check if the address is part of the prefix */
+static inline int
+ptable_pref_contains(ptable_pref_t *pref, uint8_t *addr, int afi)
+{
+    int nbytes = pref->plen >> 3;
+
+    if (pref->afi != afi || memcmp(pref->addr, addr, nbytes) != 0){
+        return (FALSE);
+    }
+    if (pref->plen & 0x07){
+        return (pref->addr[nbytes] ==
+                (addr[nbytes] & (0xff << (8 - (pref->plen & 0x07)))));
+    }
+    return (TRUE);
+}
+
+static inline uint32_t
+ptable_pref_hash(ptable_pref_t *pref)
+{
+    uint32_t words[5];
+
+    memcpy(words, pref->addr, sizeof(pref->addr));
+    words[4] = (pref->plen << 8) | pref->afi;
+    return (pkt_hash_key(words, 5, 2013));
+}
+
+/* Account a new entry with the prefix length of pref. The lengths are kept
+ * sorted from the longest to the shortest */
+static void
+ptable_plen_ref(ptable_t *pt, ptable_pref_t *pref)
+{
+    int idx = ptable_afi_idx(pref->afi);
+    int i;
+
+    if (pt->plen_count[idx][pref->plen]++ > 0){
+        return;
+    }
+    for (i = pt->nplens[idx]; i > 0 && pt->plens[idx][i - 1] < pref->plen; i--){
+        pt->plens[idx][i] = pt->plens[idx][i - 1];
+    }
+    pt->plens[idx][i] = pref->plen;
+    pt->nplens[idx]++;
+}
+
+static void
+ptable_plen_unref(ptable_t *pt, ptable_pref_t *pref)
+{
+    int idx = ptable_afi_idx(pref->afi);
+    int i;
+
+    if (--pt->plen_count[idx][pref->plen] > 0){
+        return;
+    }
+    for (i = 0; pt->plens[idx][i] != pref->plen; i++);
+    for (; i < pt->nplens[idx] - 1; i++){
+        pt->plens[idx][i] = pt->plens[idx][i + 1];
+    }
+    pt->nplens[idx]--;
+}
+
+static void
+ptable_entry_del(ptable_t *pt, ptable_entry_t *entry)
+{
+    ptable_plen_unref(pt, &entry->dst);
+    fwd_pref_info_del(entry->pref_info);
+    free(entry);
+    pt->count--;
+}
+
+
+void
+ptable_init(ptable_t *pt, uint32_t max_entries)
+{
+    uint32_t nbuckets = 16;
+
+    memset(pt, 0, sizeof(ptable_t));
+    while (nbuckets < max_entries){
+        nbuckets <<= 1;
+    }
+    pt->max_entries = max_entries;
+    if (max_entries > 0){
+        pt->buckets = xzalloc(nbuckets * sizeof(ptable_entry_t *));
+        pt->mask = nbuckets - 1;
+    }
+}
+
+void
+ptable_uninit(ptable_t *pt)
+{
+    if (pt->max_entries > 0){
+        ptable_dump_stats(pt, LDBG_1);
+    }
+    ptable_flush(pt);
+    free(pt->buckets);
+    pt->buckets = NULL;
+}
+
+/* Add the forwarding information of a pair of EID prefixes, replacing the
+ * previous one. iid is the one of the tuples that will be looked up. The table
+ * takes ownership of pref_info even if it can not be added */
+int
+ptable_insert(ptable_t *pt, fwd_pref_info_t *pref_info, uint32_t iid)
+{
+    ptable_entry_t *entry, **bucket;
+    ptable_pref_t dst, src;
+    uint32_t hash;
+
+    if (pt->max_entries == 0
+            || ptable_pref_from_laddr(&pref_info->dst_pref, &dst) != GOOD
+            || ptable_pref_from_laddr(&pref_info->src_pref, &src) != GOOD){
+        fwd_pref_info_del(pref_info);
+        return (BAD);
+    }
+
+    hash = ptable_pref_hash(&dst);
+    bucket = &pt->buckets[hash & pt->mask];
+    for (entry = *bucket; entry; entry = entry->next){
+        if (entry->hash == hash && ptable_pref_equal(&entry->dst, &dst)
+                && ptable_pref_equal(&entry->src, &src) && entry->iid == iid
+                && entry->pref_info->iid == pref_info->iid){
+            fwd_pref_info_del(entry->pref_info);
+            entry->pref_info = pref_info;
+            return (GOOD);
+        }
+    }
+
+    if (pt->count >= pt->max_entries){
+        OOR_LOG(LDBG_3, "ptable_insert: Prefix table full. Flows to %s are "
+                "resolved by the control plane", lisp_addr_to_char(pref_info->dst_eid));
+        fwd_pref_info_del(pref_info);
+        return (BAD);
+    }
+
+    entry = xmalloc(sizeof(ptable_entry_t));
+    entry->hash = hash;
+    entry->dst = dst;
+    entry->src = src;
+    entry->iid = iid;
+    entry->pref_info = pref_info;
+    entry->next = *bucket;
+    *bucket = entry;
+    pt->count++;
+    pt->stats.inserts++;
+    ptable_plen_ref(pt, &dst);
+    OOR_LOG(LDBG_3, "ptable_insert: Caching the RLOCs of the flows %s -> %s",
+            lisp_addr_to_char(&pref_info->src_pref), lisp_addr_to_char(&pref_info->dst_pref));
+    return (GOOD);
+}
+
+/* Return the forwarding information of the longest destination prefix
+ * containing the destination of the tuple whose source prefix contains its
+ * source and whose IID is the one of the tuple */
+fwd_pref_info_t *
+ptable_lookup(ptable_t *pt, packet_tuple_t *tpl)
+{
+    ip_addr_t *src_ip = lisp_addr_ip(&tpl->src_addr);
+    ip_addr_t *dst_ip = lisp_addr_ip(&tpl->dst_addr);
+    ptable_entry_t *entry;
+    ptable_pref_t dst;
+    uint32_t hash;
+    int afi, idx, i;
+
+    if (pt->count == 0){
+        pt->stats.misses++;
+        return (NULL);
+    }
+    afi = ip_addr_afi(dst_ip);
+    idx = ptable_afi_idx(afi);
+    for (i = 0; i < pt->nplens[idx]; i++){
+        ptable_pref_init(&dst, ip_addr_get_addr(dst_ip), afi, pt->plens[idx][i]);
+        hash = ptable_pref_hash(&dst);
+        for (entry = pt->buckets[hash & pt->mask]; entry; entry = entry->next){
+            if (entry->hash == hash && entry->iid == tpl->iid
+                    && ptable_pref_equal(&entry->dst, &dst)
+                    && ptable_pref_contains(&entry->src, ip_addr_get_addr(src_ip),
+                            ip_addr_afi(src_ip))){
+                pt->stats.hits++;
+                return (entry->pref_info);
+            }
+        }
+    }
+    pt->stats.misses++;
+    return (NULL);
+}
+
+/* Remove the entries whose destination prefix is the one of eid or contains
+ * it. The last ones would be used for the flows of a new more specific
+ * prefix */
+void
+ptable_remove_eid(ptable_t *pt, lisp_addr_t *eid)
+{
+    ptable_entry_t *entry, **pentry;
+    ptable_pref_t pref, dst;
+    uint8_t plens[PTABLE_MAX_PLEN + 1];
+    uint32_t hash, iid = 0;
+    int idx, nplens, i;
+
+    if (pt->count == 0 || ptable_pref_from_laddr(eid, &pref) != GOOD){
+        return;
+    }
+    if (lisp_addr_is_iid(eid)){
+        iid = lcaf_iid_get_iid(lisp_addr_get_lcaf(eid));
+    }
+
+    /* The lengths are modified when the last entry of a length is removed */
+    idx = ptable_afi_idx(pref.afi);
+    nplens = pt->nplens[idx];
+    memcpy(plens, pt->plens[idx], nplens);
+    for (i = 0; i < nplens; i++){
+        if (plens[i] > pref.plen){
+            continue;
+        }
+        ptable_pref_init(&dst, pref.addr, pref.afi, plens[i]);
+        hash = ptable_pref_hash(&dst);
+        pentry = &pt->buckets[hash & pt->mask];
+        while ((entry = *pentry) != NULL){
+            if (entry->hash == hash && ptable_pref_equal(&entry->dst, &dst)
+                    && entry->pref_info->iid == iid){
+                OOR_LOG(LDBG_3, "ptable_remove_eid: Removing the cached RLOCs of "
+                        "the flows %s -> %s", lisp_addr_to_char(&entry->pref_info->src_pref),
+                        lisp_addr_to_char(&entry->pref_info->dst_pref));
+                *pentry = entry->next;
+                ptable_entry_del(pt, entry);
+                pt->stats.invalidations++;
+            }else{
+                pentry = &entry->next;
+            }
+        }
+    }
+}
+
+/* Remove the entries whose source prefix is the one of the local eid. Their
+ * RLOC vectors are no longer valid. The whole table is scanned since entries
+ * are hashed by their destination */
+void
+ptable_remove_local_eid(ptable_t *pt, lisp_addr_t *eid)
+{
+    ptable_entry_t *entry, **pentry;
+    ptable_pref_t pref;
+    uint32_t i, iid = 0;
+
+    if (pt->count == 0 || ptable_pref_from_laddr(eid, &pref) != GOOD){
+        return;
+    }
+    if (lisp_addr_is_iid(eid)){
+        iid = lcaf_iid_get_iid(lisp_addr_get_lcaf(eid));
+    }
+
+    for (i = 0; i <= pt->mask; i++){
+        pentry = &pt->buckets[i];
+        while ((entry = *pentry) != NULL){
+            if (ptable_pref_equal(&entry->src, &pref) && entry->pref_info->iid == iid){
+                *pentry = entry->next;
+                ptable_entry_del(pt, entry);
+                pt->stats.invalidations++;
+            }else{
+                pentry = &entry->next;
+            }
+        }
+    }
+}
+
+void
+ptable_flush(ptable_t *pt)
+{
+    ptable_entry_t *entry, *next;
+    uint32_t i;
+
+    if (pt->count == 0){
+        return;
+    }
+    for (i = 0; i <= pt->mask; i++){
+        for (entry = pt->buckets[i]; entry; entry = next){
+            next = entry->next;
+            ptable_entry_del(pt, entry);
+            pt->stats.invalidations++;
+        }
+        pt->buckets[i] = NULL;
+    }
+}
+
+void
+ptable_dump_stats(ptable_t *pt, int log_level)
+{
+    if (!is_loggable(log_level)){
+        return;
+    }
+    OOR_LOG(log_level, "Prefix table: %u/%u entries, hits: %"PRIu64", misses: %"
+            PRIu64", inserts: %"PRIu64", invalidations: %"PRIu64, pt->count,
+            pt->max_entries, pt->stats.hits, pt->stats.misses, pt->stats.inserts,
+            pt->stats.invalidations);
+}
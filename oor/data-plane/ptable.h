@@ -0,0 +1,88 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef PTABLE_H_
+#define PTABLE_H_
+
+#include "../lib/packets.h"
+
+typedef struct fwd_pref_info_ fwd_pref_info_t;
+
+#define PTABLE_MAX_PLEN     128
+
+/* IP prefix with the address stored in network order and the bits beyond
+ * plen set to 0 */
+typedef struct ptable_pref_ {
+    uint8_t             addr[16];
+    uint8_t             plen;
+    uint8_t             afi;
+} ptable_pref_t;
+
+typedef struct ptable_entry_ {
+    struct ptable_entry_ *next;
+    uint32_t            hash;       /* Hash of the destination prefix */
+    ptable_pref_t       dst;
+    ptable_pref_t       src;
+    /* IID of the tuples of the flows. 0 when the data plane doesn't know the
+     * IID of the packets (xTR and MN) */
+    uint32_t            iid;
+    fwd_pref_info_t     *pref_info;
+} ptable_entry_t;
+
+typedef struct ptable_stats_ {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t inserts;
+    uint64_t invalidations;
+} ptable_stats_t;
+
+/* Forwarding information of the flows between a local and a remote EID
+ * prefix. Entries are hashed by their remote prefix. A lookup probes the
+ * prefix lengths present in the table from the longest to the shortest, and
+ * returns the first entry whose local prefix contains the source of the
+ * packet. When the table is full no new entries are added until some are
+ * invalidated */
+typedef struct ptable_ {
+    ptable_entry_t      **buckets;
+    uint32_t            mask;       /* number of buckets - 1 */
+    uint32_t            count;
+    uint32_t            max_entries;
+    /* Entries per prefix length and distinct lengths in decreasing order,
+     * for IPv4 [0] and IPv6 [1] */
+    uint32_t            plen_count[2][PTABLE_MAX_PLEN + 1];
+    uint8_t             plens[2][PTABLE_MAX_PLEN + 1];
+    int                 nplens[2];
+    ptable_stats_t      stats;
+} ptable_t;
+
+void ptable_init(ptable_t *pt, uint32_t max_entries);
+void ptable_uninit(ptable_t *pt);
+int ptable_insert(ptable_t *pt, fwd_pref_info_t *pref_info, uint32_t iid);
+fwd_pref_info_t *ptable_lookup(ptable_t *pt, packet_tuple_t *tpl);
+void ptable_remove_eid(ptable_t *pt, lisp_addr_t *eid);
+void ptable_remove_local_eid(ptable_t *pt, lisp_addr_t *eid);
+void ptable_flush(ptable_t *pt);
+void ptable_dump_stats(ptable_t *pt, int log_level);
+
+static inline uint32_t ptable_size(ptable_t *pt)
+{
+    return (pt->count);
+}
+
+#endif /* PTABLE_H_ */
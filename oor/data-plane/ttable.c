@@ -26,40 +26,79 @@
 #include "../liblisp/liblisp.h"
 
 
-/* Maximum size of the tuple table */
-#define MAX_SIZE 10000
+/* Slots are kept at most at 3/4 of their capacity to have short probe
+ * sequences */
+#define TTABLE_LOAD_FACTOR_NUM  4
+#define TTABLE_LOAD_FACTOR_DEN  3
 
-void ttable_remove_with_khiter(ttable_t *tt, khiter_t k);
+/* Seconds between two aging sweeps and bounds of the number of slots checked
+ * in each of them. The upper bound limits the time the data plane can be
+ * blocked by a sweep */
+#define TTABLE_AGING_INTERVAL   1
+#define TTABLE_AGING_MIN_SLOTS  64
+#define TTABLE_AGING_MAX_SLOTS  65536
+
+static void ttable_remove_slot(ttable_t *tt, uint32_t pos);
+static void ttable_evict_one(ttable_t *tt);
+static int ttable_aging_cb(oor_timer_t *timer);
+
+static inline uint32_t
+ttable_clock()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint32_t)ts.tv_sec);
+}
 
 
 void
-ttable_init(ttable_t *tt)
+ttable_init(ttable_t *tt, uint32_t max_entries, ttable_evict_fn_t evict_fn,
+        void *evict_arg)
 {
-    tt->htable =  kh_init(ttable);
-    list_init(&tt->head_list);
+    uint64_t min_slots = (uint64_t)max_entries * TTABLE_LOAD_FACTOR_NUM / TTABLE_LOAD_FACTOR_DEN;
+    uint32_t nslots = 16;
+
+    while (nslots < min_slots){
+        nslots <<= 1;
+    }
+    tt->slots = xzalloc(nslots * sizeof(ttable_entry_t));
+    tt->mask = nslots - 1;
+    tt->count = 0;
+    tt->max_entries = max_entries;
+    tt->clock_hand = 0;
+    tt->evict_fn = evict_fn;
+    tt->evict_arg = evict_arg;
+    tt->now = ttable_clock();
+    tt->idle_timeout = 0;
+    tt->sweep_pos = 0;
+    tt->aging_timer = NULL;
+    memset(&tt->stats, 0, sizeof(ttable_stats_t));
 }
 
 void
 ttable_uninit(ttable_t *tt)
 {
-    khiter_t k;
-    fwd_info_t *fi;
+    uint32_t i;
 
-    for (k = kh_begin(tt->htable); k != kh_end(tt->htable); ++k){
-        if (kh_exist(tt->htable, k)){
-            // The key is remove when removing value
-            fi = kh_value(tt->htable,k);
-            fwd_info_del(fi);
+    ttable_dump_stats(tt, LDBG_1);
+    oor_timer_stop(tt->aging_timer);
+    tt->aging_timer = NULL;
+    for (i = 0; i <= tt->mask; i++){
+        if (tt->slots[i].fi){
+            fwd_info_del(tt->slots[i].fi);
         }
     }
-    kh_destroy(ttable, tt->htable);
+    free(tt->slots);
+    tt->slots = NULL;
+    tt->count = 0;
 }
 
 ttable_t *
-ttable_create()
+ttable_create(uint32_t max_entries, ttable_evict_fn_t evict_fn, void *evict_arg)
 {
    ttable_t *tt = xzalloc(sizeof(ttable_t));
-   ttable_init(tt);
+   ttable_init(tt, max_entries, evict_fn, evict_arg);
    return(tt);
 }
 
@@ -70,21 +109,60 @@ ttable_destroy(ttable_t *tt)
     free(tt);
 }
 
+/* Returns the slot of the key or the first empty slot of its probe sequence */
+static inline uint32_t
+ttable_find_slot(ttable_t *tt, pkt_tuple_key_t *key, uint32_t hash)
+{
+    uint32_t pos = hash & tt->mask;
+    ttable_entry_t *entry;
+
+    for (;;){
+        entry = &tt->slots[pos];
+        if (!entry->fi || (entry->hash == hash && pkt_tuple_key_equal(&entry->key, key))){
+            return (pos);
+        }
+        pos = (pos + 1) & tt->mask;
+    }
+}
 
 int
 ttable_insert(ttable_t *tt, packet_tuple_t *tpl, fwd_info_t *fi)
 {
-    khiter_t k;
-    int ret;
+    pkt_tuple_key_t key;
+    ttable_entry_t *entry;
+    uint32_t hash, pos;
+
+    pkt_tuple_to_key(tpl, &key);
+    hash = pkt_tuple_key_hash(&key);
+    pos = ttable_find_slot(tt, &key, hash);
+    entry = &tt->slots[pos];
+
+    if (entry->fi){
+        /* Replace the previous forwarding information of the flow */
+        if (tt->evict_fn){
+            tt->evict_fn(tt->evict_arg, entry->fi);
+        }
+        fwd_info_del(entry->fi);
+        entry->fi = fi;
+        entry->last_seen = tt->now;
+        entry->referenced = TRUE;
+        return (GOOD);
+    }
 
     /* If table is full remove old entries */
-    if (kh_size(tt->htable) >= MAX_SIZE) {
-        OOR_LOG(LDBG_1,"ttable_insert: Max size of forwarding table reached.");
-        return (BAD);
+    if (tt->count >= tt->max_entries) {
+        ttable_evict_one(tt);
+        /* The slot may have changed when compacting the probe sequence */
+        pos = ttable_find_slot(tt, &key, hash);
+        entry = &tt->slots[pos];
     }
 
-    k = kh_put(ttable,tt->htable,tpl,&ret);
-    kh_value(tt->htable, k) = fi;
+    entry->key = key;
+    entry->hash = hash;
+    entry->fi = fi;
+    entry->last_seen = tt->now;
+    entry->referenced = TRUE;
+    tt->count++;
     OOR_LOG(LDBG_3,"ttable_insert: Inserted tupla: %s ", pkt_tuple_to_char(tpl));
     return (GOOD);
 }
@@ -92,46 +170,216 @@ ttable_insert(ttable_t *tt, packet_tuple_t *tpl, fwd_info_t *fi)
 void
 ttable_remove(ttable_t *tt, packet_tuple_t *tpl)
 {
-    khiter_t k;
+    pkt_tuple_key_t key;
+    uint32_t hash, pos;
     fwd_info_t *fi;
 
-    k = kh_get(ttable,tt->htable, tpl);
-    if (k == kh_end(tt->htable)){
+    pkt_tuple_to_key(tpl, &key);
+    hash = pkt_tuple_key_hash(&key);
+    pos = ttable_find_slot(tt, &key, hash);
+    fi = tt->slots[pos].fi;
+    if (!fi){
         return;
     }
 
-    fi = kh_value(tt->htable,k);
     OOR_LOG(LDBG_3,"ttable_remove: Remove tupla: %s ", pkt_tuple_to_char(tpl));
-    // We don't remove the key (tuple). It is part of the fwd_info_t;
-    /* Free value */
+    ttable_remove_slot(tt, pos);
+    /* Free value. tpl could be part of it */
     fwd_info_del(fi);
-    /* Remove entry from hash table */
-    kh_del(ttable,tt->htable,k);
 }
 
+/* Remove all the flows of the table */
 void
-ttable_remove_with_khiter(ttable_t *tt, khiter_t k)
+ttable_flush(ttable_t *tt)
 {
     fwd_info_t *fi;
+    uint32_t i;
 
-    fi = kh_value(tt->htable,k);
-    OOR_LOG(LDBG_3,"ttable_remove_with_khiter: Remove tupla: %s ", pkt_tuple_to_char((packet_tuple_t *)fi->dp_conf_inf));
-    fwd_info_del(fi);
-    kh_del(ttable,tt->htable,k);
+    for (i = 0; i <= tt->mask; i++){
+        fi = tt->slots[i].fi;
+        if (!fi){
+            continue;
+        }
+        if (tt->evict_fn){
+            tt->evict_fn(tt->evict_arg, fi);
+        }
+        fwd_info_del(fi);
+    }
+    memset(tt->slots, 0, (tt->mask + 1) * sizeof(ttable_entry_t));
+    tt->count = 0;
+    tt->clock_hand = 0;
+    tt->sweep_pos = 0;
 }
 
 fwd_info_t *
 ttable_lookup(ttable_t *tt, packet_tuple_t *tpl)
 {
-    fwd_info_t *fi;
-    khiter_t k;
+    pkt_tuple_key_t key;
+    ttable_entry_t *entry;
+    uint32_t hash;
 
-    k = kh_get(ttable,tt->htable, tpl);
-    if (k == kh_end(tt->htable)){
+    pkt_tuple_to_key(tpl, &key);
+    hash = pkt_tuple_key_hash(&key);
+    entry = &tt->slots[ttable_find_slot(tt, &key, hash)];
+    if (!entry->fi){
+        tt->stats.misses++;
         return (NULL);
     }
-    fi = kh_value(tt->htable,k);
+    /* Avoid dirtying the cache line when nothing changes */
+    if (!entry->referenced || entry->last_seen != tt->now){
+        entry->referenced = TRUE;
+        entry->last_seen = tt->now;
+    }
+    tt->stats.hits++;
 
-    return (fi);
+    return (entry->fi);
+}
+
+/* Start the periodic removal of the flows not used in the last idle_timeout
+ * seconds. 0 disables aging. The timer is kept anyway to advance the clock of
+ * the table, also used to track the activity of the map cache entries */
+void
+ttable_start_aging(ttable_t *tt, uint32_t idle_timeout)
+{
+    tt->idle_timeout = idle_timeout;
+    if (!tt->aging_timer){
+        tt->aging_timer = oor_timer_create(FLOW_AGING_TIMER);
+        oor_timer_init(tt->aging_timer, tt, ttable_aging_cb, tt, NULL, NULL);
+    }
+    oor_timer_start(tt->aging_timer, TTABLE_AGING_INTERVAL);
 }
 
+/* Incremental sweep of idle flows. Each call checks a bounded number of slots
+ * starting where the previous one stopped, so that the whole table is checked
+ * about twice per idle timeout without blocking the forwarding of packets.
+ * Returns the number of flows removed */
+uint32_t
+ttable_age_flows(ttable_t *tt)
+{
+    ttable_entry_t *entry;
+    fwd_info_t *fi;
+    uint32_t nslots = tt->mask + 1;
+    uint32_t rounds, budget, aged = 0;
+
+    tt->now = ttable_clock();
+    if (tt->idle_timeout == 0 || tt->count == 0){
+        return (0);
+    }
+
+    rounds = tt->idle_timeout / (2 * TTABLE_AGING_INTERVAL);
+    budget = nslots / (rounds > 0 ? rounds : 1);
+    if (budget < TTABLE_AGING_MIN_SLOTS){
+        budget = TTABLE_AGING_MIN_SLOTS;
+    } else if (budget > TTABLE_AGING_MAX_SLOTS){
+        budget = TTABLE_AGING_MAX_SLOTS;
+    }
+    if (budget > nslots){
+        budget = nslots;
+    }
+
+    while (budget > 0){
+        budget--;
+        entry = &tt->slots[tt->sweep_pos];
+        if (entry->fi && tt->now - entry->last_seen >= tt->idle_timeout){
+            fi = entry->fi;
+            if (tt->evict_fn){
+                tt->evict_fn(tt->evict_arg, fi);
+            }
+            ttable_remove_slot(tt, tt->sweep_pos);
+            fwd_info_del(fi);
+            aged++;
+            /* The next entry of the probe sequence may have been moved to
+             * this slot. Check it again */
+            continue;
+        }
+        tt->sweep_pos = (tt->sweep_pos + 1) & tt->mask;
+    }
+    tt->stats.aged += aged;
+
+    return (aged);
+}
+
+static int
+ttable_aging_cb(oor_timer_t *timer)
+{
+    ttable_t *tt = (ttable_t *)oor_timer_cb_argument(timer);
+    uint32_t aged;
+
+    aged = ttable_age_flows(tt);
+    if (aged > 0){
+        OOR_LOG(LDBG_2, "Flow table: Removed %u flows idle for more than %u seconds",
+                aged, tt->idle_timeout);
+        ttable_dump_stats(tt, LDBG_3);
+    }
+    oor_timer_start(timer, TTABLE_AGING_INTERVAL);
+
+    return (GOOD);
+}
+
+void
+ttable_dump_stats(ttable_t *tt, int log_level)
+{
+    if (!is_loggable(log_level)){
+        return;
+    }
+    OOR_LOG(log_level, "Flow table: %u/%u entries (%u slots), hits: %"PRIu64
+            ", misses: %"PRIu64", evictions: %"PRIu64", aged: %"PRIu64,
+            tt->count, tt->max_entries, tt->mask + 1, tt->stats.hits,
+            tt->stats.misses, tt->stats.evictions, tt->stats.aged);
+}
+
+/* Empty the slot and move back the following entries of the probe sequence
+ * that could be stored in it. This way no tombstones are needed */
+static void
+ttable_remove_slot(ttable_t *tt, uint32_t pos)
+{
+    uint32_t i = pos, j = pos, home;
+
+    for (;;){
+        j = (j + 1) & tt->mask;
+        if (!tt->slots[j].fi){
+            break;
+        }
+        home = tt->slots[j].hash & tt->mask;
+        if (((j - home) & tt->mask) >= ((j - i) & tt->mask)){
+            tt->slots[i] = tt->slots[j];
+            i = j;
+        }
+    }
+    tt->slots[i].fi = NULL;
+    tt->count--;
+}
+
+/* CLOCK replacement: advance the hand clearing the referenced bit of the used
+ * entries until an entry not used since the last pass is found */
+static void
+ttable_evict_one(ttable_t *tt)
+{
+    ttable_entry_t *entry;
+    fwd_info_t *fi;
+
+    if (tt->count == 0){
+        return;
+    }
+
+    for (;;){
+        entry = &tt->slots[tt->clock_hand];
+        if (entry->fi){
+            if (!entry->referenced){
+                break;
+            }
+            entry->referenced = FALSE;
+        }
+        tt->clock_hand = (tt->clock_hand + 1) & tt->mask;
+    }
+
+    fi = entry->fi;
+    OOR_LOG(LDBG_3,"ttable_evict_one: Flow table full. Evicting a flow associated "
+            "with EID %s", lisp_addr_to_char(fi->associated_entry));
+    if (tt->evict_fn){
+        tt->evict_fn(tt->evict_arg, fi);
+    }
+    ttable_remove_slot(tt, tt->clock_hand);
+    fwd_info_del(fi);
+    tt->stats.evictions++;
+}
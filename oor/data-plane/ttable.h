@@ -21,27 +21,79 @@
 #define TTABLE_H_
 
 #include <time.h>
-#include "../elibs/khash/khash.h"
-#include "../elibs/ovs/list.h"
 #include "../lib/packets.h"
+#include "../lib/timers.h"
 
 typedef struct fwd_info_ fwd_info_t;
 
+/* Called before an entry is removed from the table to make room for a new
+ * one. The fwd_info_t is freed by the table after the call. arg is the
+ * evict_arg of the table */
+typedef void (*ttable_evict_fn_t)(void *arg, fwd_info_t *fi);
 
-KHASH_INIT(ttable, packet_tuple_t *, fwd_info_t *, 1, pkt_tuple_hash, pkt_tuple_cmp)
+/* Slot of the table. Key and hash are stored inline so a lookup usually
+ * touches a single cache line. A slot is empty when fi is NULL */
+typedef struct ttable_entry_ {
+    pkt_tuple_key_t     key;
+    uint32_t            hash;
+    fwd_info_t          *fi;
+    uint32_t            last_seen;  /* Coarse time of the last hit in seconds */
+    uint8_t             referenced; /* CLOCK bit. Set on each hit */
+} ttable_entry_t;
 
+typedef struct ttable_stats_ {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t aged;
+} ttable_stats_t;
+
+/* Open addressing table (linear probing) of flows. When it reaches its max
+ * number of entries, the entries not used since the last pass of the CLOCK
+ * hand are evicted one by one. Flows idle for more than idle_timeout seconds
+ * are removed by an incremental sweep driven by the aging timer */
 typedef struct ttable {
-    khash_t(ttable) *htable; //<packet_tuple_t *, fwd_info_t *>
-    struct ovs_list head_list; /* To order flows */
+    ttable_entry_t      *slots;
+    uint32_t            mask;       /* number of slots - 1 */
+    uint32_t            count;
+    uint32_t            max_entries;
+    uint32_t            clock_hand;
+    ttable_evict_fn_t   evict_fn;
+    void                *evict_arg;
+    /* Aging of idle flows. now is only updated by the aging timer so the
+     * lookups don't need to read the clock. It is also the time reported as
+     * last use of the map cache entries */
+    uint32_t            now;
+    uint32_t            idle_timeout;
+    uint32_t            sweep_pos;
+    oor_timer_t         *aging_timer;
+    ttable_stats_t      stats;
 } ttable_t;
 
-void ttable_init(ttable_t *tt);
+void ttable_init(ttable_t *tt, uint32_t max_entries, ttable_evict_fn_t evict_fn,
+        void *evict_arg);
 void ttable_uninit(ttable_t *tt);
-ttable_t *ttable_create();
+ttable_t *ttable_create(uint32_t max_entries, ttable_evict_fn_t evict_fn,
+        void *evict_arg);
 void ttable_destroy(ttable_t *tt);
 int ttable_insert(ttable_t *, packet_tuple_t *tpl, fwd_info_t *fe);
 void ttable_remove(ttable_t *tt, packet_tuple_t *tpl);
+void ttable_flush(ttable_t *tt);
 fwd_info_t *ttable_lookup(ttable_t *tt, packet_tuple_t *tpl);
+void ttable_start_aging(ttable_t *tt, uint32_t idle_timeout);
+uint32_t ttable_age_flows(ttable_t *tt);
+void ttable_dump_stats(ttable_t *tt, int log_level);
+
+/* Set the idle timeout without the aging timer. The owner of the table must
+ * call ttable_age_flows periodically */
+static inline void ttable_set_idle_timeout(ttable_t *tt, uint32_t idle_timeout)
+{
+    tt->idle_timeout = idle_timeout;
+}
 
+static inline uint32_t ttable_size(ttable_t *tt)
+{
+    return (tt->count);
+}
 
 #endif /* TTABLE_H_ */
@@ -18,10 +18,12 @@
  */
 
 
+#include <errno.h>
 #include <linux/rtnetlink.h>
 #include "tun.h"
 #include "tun_input.h"
 #include "tun_output.h"
+#include "tun_worker.h"
 #include "../data-plane.h"
 #include "../../oor_external.h"
 #include "../../fwd_policies/fwd_policy.h"
@@ -52,10 +54,10 @@ void tun_process_new_gateway(iface_t *iface,lisp_addr_t *gateway);
 void tun_process_rm_gateway(iface_t *iface,lisp_addr_t *gateway);
 
 void tun_set_default_output_ifaces();
+static void tun_out_socks_changed();
 void tun_iface_remove_routing_rules(iface_t *iface);
 int tun_rm_fwd_from_entry(lisp_addr_t *eid_prefix, uint8_t is_local);
-tun_dplane_data_t * tun_dplane_data_new_init(oor_encap_t encap_type);
-void tun_dplane_data_free(tun_dplane_data_t *data);
+int tun_update_local_fwd(lisp_addr_t *eid_prefix, glist_t *src_rlocs);
 
 
 data_plane_struct_t dplane_tun = {
@@ -72,16 +74,40 @@ data_plane_struct_t dplane_tun = {
         .datap_updated_addr = tun_updated_addr,
         .datap_update_link = tun_updated_link,
         .datap_rm_fwd_from_entry = tun_rm_fwd_from_entry,
+        .datap_update_local_fwd = tun_update_local_fwd,
         .datap_reset_all_fwd = tun_reset_all_fwd,
+        .datap_flush_pending = tun_flush_pending,
         .datap_data = NULL
 };
 
+THREAD_LOCAL tun_dplane_shard_t *tun_thread_shard = NULL;
+
 inline tun_dplane_data_t *
 tun_get_datap_data()
 {
     return ((tun_dplane_data_t *)dplane_tun.datap_data);
 }
 
+/* Open the AF_PACKET ring receiving the encapsulated packets of afi when it
+ * is configured. Returns NULL if raw sockets should be used instead */
+static pkt_ring_t *
+tun_open_rx_ring(int afi, int data_port, int (*cb_func)(sock_t *))
+{
+    pkt_ring_t *ring;
+
+    if (dplane_conf.rx_ring_size == 0){
+        return (NULL);
+    }
+    ring = pkt_ring_new(afi, data_port, (uint32_t)dplane_conf.rx_ring_size * 1024);
+    if (!ring){
+        OOR_LOG(LWRN, "tun_configure_data_plane: Couldn't create the IPv%d data RX ring. "
+                "Using a raw socket", afi == AF_INET ? 4 : 6);
+        return (NULL);
+    }
+    sockmstr_register_read_listener(smaster, cb_func, ring, pkt_ring_fd(ring));
+    return (ring);
+}
+
 /*
  * tun_configure_data_plane not has variable list of parameters
  */
@@ -89,31 +115,67 @@ int
 tun_configure_data_plane(oor_dev_type_e dev_type, oor_encap_t encap_type, ...)
 {
     int (*cb_func)(sock_t *) = NULL;
+    int (*ring_cb_func)(sock_t *) = NULL;
     int ipv4_data_input_fd = -1;
     int ipv6_data_input_fd = -1;
     int data_port;
+    int nworkers = dplane_conf.data_plane_threads;
+    int *tun_fds = NULL;
+    int i;
+    tun_dplane_data_t *data;
 
     /* Configure data plane */
-    tun_receive_fd = create_tun_tap(TUN, TUN_IFACE_NAME, TUN_MTU);
-    if (tun_receive_fd <= BAD){
-        return (BAD);
+    if (nworkers > 0){
+        /* One queue of the tun per worker */
+        tun_fds = xmalloc(nworkers * sizeof(int));
+        if (create_tun_tap_multiqueue(TUN, TUN_IFACE_NAME, TUN_MTU, tun_fds, nworkers) != GOOD){
+            OOR_LOG(LWRN, "tun_configure_data_plane: Couldn't create a multiqueue tun device. "
+                    "Packets will be forwarded by the main thread");
+            free(tun_fds);
+            tun_fds = NULL;
+            nworkers = 0;
+        }
+    }
+    if (nworkers == 0){
+        tun_receive_fd = create_tun_tap(TUN, TUN_IFACE_NAME, TUN_MTU);
+        if (tun_receive_fd <= BAD){
+            return (BAD);
+        }
+        tun_fds = &tun_receive_fd;
+    }else{
+        tun_receive_fd = tun_fds[0];
     }
     tun_ifindex = if_nametoindex (TUN_IFACE_NAME);
+    /* Packets are read from the tun until there are no more pending ones */
+    for (i = 0; i < (nworkers > 0 ? nworkers : 1); i++){
+        if (fcntl(tun_fds[i], F_SETFL, fcntl(tun_fds[i], F_GETFL, 0) | O_NONBLOCK) == -1){
+            OOR_LOG(LERR, "tun_configure_data_plane: Couldn't set tun device as non blocking: %s",
+                    strerror(errno));
+            return (BAD);
+        }
+    }
     switch (dev_type){
     case MN_MODE:
-        sockmstr_register_read_listener(smaster, tun_output_recv, NULL,tun_receive_fd);
+        if (nworkers == 0){
+            sockmstr_register_read_listener(smaster, tun_output_recv, NULL,tun_receive_fd);
+        }
         cb_func = tun_process_input_packet;
+        ring_cb_func = tun_process_input_ring;
         break;
     case xTR_MODE:
         /* We add route tables for IPv4 and IPv6 even no EID exists for this afi*/
         /* Rules created for EID will redirect traffic to this table*/
         configure_routing_to_tun_router(AF_INET);
         configure_routing_to_tun_router(AF_INET6);
-        sockmstr_register_read_listener(smaster, tun_output_recv, NULL,tun_receive_fd);
+        if (nworkers == 0){
+            sockmstr_register_read_listener(smaster, tun_output_recv, NULL,tun_receive_fd);
+        }
         cb_func = tun_process_input_packet;
+        ring_cb_func = tun_process_input_ring;
         break;
     case RTR_MODE:
         cb_func = tun_rtr_process_input_packet;
+        ring_cb_func = tun_rtr_process_input_ring;
         break;
     default:
         return (BAD);
@@ -130,24 +192,47 @@ tun_configure_data_plane(oor_dev_type_e dev_type, oor_encap_t encap_type, ...)
         return (BAD);
     }
 
-    /* Generate receive sockets for data port (4341) */
-    if (default_rloc_afi != AF_INET6) {
-        ipv4_data_input_fd = open_data_raw_input_socket(AF_INET, data_port);
-        sockmstr_register_read_listener(smaster, cb_func, NULL,
-                ipv4_data_input_fd);
-    }
+    data = tun_dplane_data_new_init(encap_type, nworkers);
+    dplane_tun.datap_data = (void *)data;
+
+    if (nworkers == 0){
+        tun_shard_init(&data->shards[0], tun_receive_fd, NULL);
+
+        /* Generate receive sockets for data port (4341) */
+        if (default_rloc_afi != AF_INET6) {
+            data->rx_ring_v4 = tun_open_rx_ring(AF_INET, data_port, ring_cb_func);
+            if (!data->rx_ring_v4){
+                ipv4_data_input_fd = open_data_raw_input_socket(AF_INET, data_port);
+                sockmstr_register_read_listener(smaster, cb_func, NULL,
+                        ipv4_data_input_fd);
+            }
+        }
 
-    if (default_rloc_afi != AF_INET) {
-        ipv6_data_input_fd = open_data_raw_input_socket(AF_INET6, data_port);
-        sockmstr_register_read_listener(smaster, cb_func, NULL,
-                ipv6_data_input_fd);
+        if (default_rloc_afi != AF_INET) {
+            data->rx_ring_v6 = tun_open_rx_ring(AF_INET6, data_port, ring_cb_func);
+            if (!data->rx_ring_v6){
+                ipv6_data_input_fd = open_data_raw_input_socket(AF_INET6, data_port);
+                sockmstr_register_read_listener(smaster, cb_func, NULL,
+                        ipv6_data_input_fd);
+            }
+        }
+    }else if (dplane_conf.rx_ring_size > 0){
+        OOR_LOG(LWRN, "tun_configure_data_plane: data-rx-ring-size is not used with "
+                "data plane threads");
     }
-    dplane_tun.datap_data = (void *)tun_dplane_data_new_init(encap_type);
 
     /* Select the default rlocs for output data packets and output control
      * packets */
     tun_set_default_output_ifaces();
 
+    if (nworkers > 0){
+        if (tun_workers_start(data, tun_fds, dev_type != RTR_MODE, cb_func, data_port) != GOOD){
+            free(tun_fds);
+            return (BAD);
+        }
+        free(tun_fds);
+    }
+
     return (GOOD);
 }
 
@@ -201,6 +286,7 @@ tun_add_datap_iface_addr(iface_t *iface, int afi)
         }
         break;
     }
+    tun_out_socks_changed();
 
     return (GOOD);
 }
@@ -607,6 +693,7 @@ tun_updated_addr(iface_t *iface, lisp_addr_t *old_addr, lisp_addr_t *new_addr)
         }
         del_rule(old_addr_ip_afi, 0, iface->iface_index, iface->iface_index, RTN_UNICAST,
                         old_addr, NULL, 0);
+        tun_out_socks_changed();
         return (GOOD);
     }
 
@@ -684,6 +771,7 @@ tun_updated_addr(iface_t *iface, lisp_addr_t *old_addr, lisp_addr_t *new_addr)
             new_addr, NULL, 0);
 
     bind_socket(sckt, new_addr_ip_afi, new_addr,0);
+    tun_out_socks_changed();
 
     return (GOOD);
 }
@@ -732,6 +820,7 @@ tun_updated_link(iface_t *iface, int old_iface_index, int new_iface_index,
                 "interface");
         tun_set_default_output_ifaces();
     }
+    tun_out_socks_changed();
 
     return (GOOD);
 }
@@ -901,73 +990,74 @@ tun_iface_remove_routing_rules(iface_t *iface)
 int
 tun_rm_fwd_from_entry(lisp_addr_t *eid_prefix, uint8_t is_local)
 {
-    char * eid_prefix_char = lisp_addr_to_char(eid_prefix);
-    glist_t *fwd_tpl_list, *pxtr_fwd_tpl_list;
-    glist_entry_t *tpl_it;
-    fwd_info_t *fi;
-    tun_dplane_data_t *data = (tun_dplane_data_t *)dplane_tun.datap_data;
-    packet_tuple_t *tpl;
+    tun_dplane_data_t *data = tun_get_datap_data();
 
+    if (data->shards[0].worker){
+        /* The forwarding state is owned by the worker threads */
+        return (tun_workers_rm_fwd_from_entry(data, eid_prefix, is_local));
+    }
+    return (tun_shard_rm_fwd_from_entry(&data->shards[0], eid_prefix, is_local));
+}
 
+int
+tun_shard_rm_fwd_from_entry(tun_dplane_shard_t *shard, lisp_addr_t *eid_prefix,
+        uint8_t is_local)
+{
     if (is_local){
-        return (tun_reset_all_fwd());
+        tun_shard_reset_fwd(shard);
+        return (GOOD);
+    }
+    /* New flows to the EID, or to a more specific prefix of it, are resolved
+     * again by the control plane */
+    ptable_remove_eid(&(shard->ptable), eid_prefix);
+
+    OOR_LOG(LDBG_3, "tun_rm_fwd_from_entry: Removing all the forwarding entries association with the EID %s",
+            lisp_addr_to_char(eid_prefix));
+    if (etable_remove_eid(&(shard->etable), eid_prefix) != GOOD){
+        OOR_LOG(LDBG_2, "tun_rm_fwd_from_entry: No forwarding entries associated with %s",
+                lisp_addr_to_char(eid_prefix));
+        return (BAD);
     }
 
-    if (strcmp(eid_prefix_char,FULL_IPv4_ADDRESS_SPACE) == 0){ // Update of the PeTR list for IPv4 EIDs or RTR list
-        OOR_LOG(LDBG_3, "tun_rm_fwd_from_entry: Removing all the forwarding entries association with the PeTRs for IPv4 EIDs");
-        pxtr_fwd_tpl_list = (glist_t *)shash_lookup(data->eid_to_dp_entries,FULL_IPv4_ADDRESS_SPACE);
-        /* Remove all the entries associated with the PxTR */
-
-        while (glist_size(pxtr_fwd_tpl_list) > 0){
-            tpl = (packet_tuple_t *)glist_first_data(pxtr_fwd_tpl_list);
-            fi = ttable_lookup(&(data->ttable), tpl);
-            // When we recurively call this function using the associated_entry we will execute "else" statement where we also
-            // update the list of entries associated with PxTR.
-            tun_rm_fwd_from_entry(fi->associated_entry,is_local);
-        }
-    }else if(strcmp(eid_prefix_char,FULL_IPv6_ADDRESS_SPACE) == 0){ // Update of the PeTR list for IPv6 EIDs or RTR list
-        OOR_LOG(LDBG_3, "tun_rm_fwd_from_entry: Removing all the forwarding entries association with the PeTRs for IPv6 EIDs");
-        pxtr_fwd_tpl_list = (glist_t *)shash_lookup(data->eid_to_dp_entries,FULL_IPv6_ADDRESS_SPACE);
-        /* Remove all the entries associated with the PxTR */
-
-        while (glist_size(pxtr_fwd_tpl_list) > 0){
-            tpl = (packet_tuple_t *)glist_first_data(pxtr_fwd_tpl_list);
-            fi = ttable_lookup(&(data->ttable), tpl);
-            // When we recurively call this function using the associated_entry we will execute "else" statement where we also
-            // update the list of entries associated with PxTR.
-            tun_rm_fwd_from_entry(fi->associated_entry,is_local);
-        }
+    return (GOOD);
+}
+
+int
+tun_update_local_fwd(lisp_addr_t *eid_prefix, glist_t *src_rlocs)
+{
+    tun_dplane_data_t *data = tun_get_datap_data();
+    glist_entry_t *it;
+    lisp_addr_t *rlocs;
+    int nrlocs = 0, res;
+
+    rlocs = xmalloc((glist_size(src_rlocs) + 1) * sizeof(lisp_addr_t));
+    glist_for_each_entry(it, src_rlocs){
+        lisp_addr_copy(&rlocs[nrlocs++], (lisp_addr_t *)glist_entry_data(it));
+    }
+    if (data->shards[0].worker){
+        /* Each worker receives its own copy of the RLOCs */
+        res = tun_workers_update_local_fwd(data, eid_prefix, rlocs, nrlocs);
     }else{
-        OOR_LOG(LDBG_3, "tun_rm_fwd_from_entry: Removing all the forwarding entries association with the EID %s",eid_prefix_char);
-        fwd_tpl_list = (glist_t *)shash_lookup(data->eid_to_dp_entries,eid_prefix_char);
-        if (!fwd_tpl_list){
-            OOR_LOG(LDBG_2, "tun_rm_fwd_from_entry: Entry %s not found in the shasht!",eid_prefix_char);
-            return (BAD);
-        }
-        /* Check if it is a negative entry in order to remove also from PxTRs list */
-        tpl = (packet_tuple_t *)glist_first_data(fwd_tpl_list);
-        fi = ttable_lookup(&(data->ttable), tpl);
-        if (fi->neg_map_reply_act == ACT_NATIVE_FWD){ //negative mapping
-            switch (lisp_addr_ip_afi(fi->associated_entry)){
-            case AF_INET:
-                pxtr_fwd_tpl_list = (glist_t *)shash_lookup(data->eid_to_dp_entries,FULL_IPv4_ADDRESS_SPACE);
-                break;
-            case AF_INET6:
-                pxtr_fwd_tpl_list = (glist_t *)shash_lookup(data->eid_to_dp_entries,FULL_IPv6_ADDRESS_SPACE);
-                break;
-            default:
-                OOR_LOG(LDBG_1, "tun_rm_fwd_from_entry: Associated entry is not IP");
-                return (BAD);
-            }
-            glist_for_each_entry(tpl_it,fwd_tpl_list){
-                tpl = (packet_tuple_t *)glist_entry_data(tpl_it);
-                glist_remove_obj(tpl,pxtr_fwd_tpl_list);
-            }
-        }
-        /* Remove associated entry from eid_to_dp_entries */
-        shash_remove(data->eid_to_dp_entries, eid_prefix_char);
+        res = tun_shard_update_local_fwd(&data->shards[0], eid_prefix, rlocs, nrlocs);
     }
+    free(rlocs);
+    return (res);
+}
+
+/* The locators of a local mapping changed. The flows of the mapping whose
+ * source RLOC is still one of src_rlocs are not modified. The rest, and the
+ * prefixes cached for the mapping, are resolved again by the control plane */
+int
+tun_shard_update_local_fwd(tun_dplane_shard_t *shard, lisp_addr_t *eid_prefix,
+        lisp_addr_t *src_rlocs, int nrlocs)
+{
+    uint32_t nflows = ttable_size(&(shard->ttable));
+    uint32_t removed;
 
+    ptable_remove_local_eid(&(shard->ptable), eid_prefix);
+    removed = etable_update_local_eid(&(shard->etable), eid_prefix, src_rlocs, nrlocs);
+    OOR_LOG(LDBG_2, "tun_update_local_fwd: Local mapping %s updated. Removed %u of %u flows",
+            lisp_addr_to_char(eid_prefix), removed, nflows);
     return (GOOD);
 }
 
@@ -977,31 +1067,171 @@ tun_rm_fwd_from_entry(lisp_addr_t *eid_prefix, uint8_t is_local)
 int
 tun_reset_all_fwd()
 {
-    tun_dplane_data_t *data = (tun_dplane_data_t *)dplane_tun.datap_data;
+    tun_dplane_data_t *data = tun_get_datap_data();
 
-    shash_destroy(data->eid_to_dp_entries);
-    data->eid_to_dp_entries = shash_new_managed((free_value_fn_t)glist_destroy);
-    /* Insert entry for PeTRs */
-    shash_insert(data->eid_to_dp_entries, strdup(FULL_IPv4_ADDRESS_SPACE), glist_new());
-    shash_insert(data->eid_to_dp_entries, strdup(FULL_IPv6_ADDRESS_SPACE), glist_new());
+    if (data->shards[0].worker){
+        return (tun_workers_rm_fwd_from_entry(data, NULL, TRUE));
+    }
+    tun_shard_reset_fwd(&data->shards[0]);
     return (GOOD);
 }
 
+void
+tun_shard_reset_fwd(tun_dplane_shard_t *shard)
+{
+    etable_flush(&(shard->etable));
+    ptable_flush(&(shard->ptable));
+}
+
+/* Replace the output sockets of the shard of a worker. The flows point to the
+ * previous sockets, so all of them are removed */
+void
+tun_shard_set_out_socks(tun_dplane_shard_t *shard, tun_out_socks_t *out_socks)
+{
+    /* Packets may be queued using the previous sockets */
+    send_batch_flush(shard->send_batch);
+    ttable_flush(&(shard->ttable));
+    ptable_flush(&(shard->ptable));
+    tun_out_socks_del(shard->out_socks);
+    shard->out_socks = out_socks;
+}
+
+/* Output socket of a local RLOC to be used by the thread of the shard. NULL if
+ * there is no socket for the RLOC */
+int *
+tun_shard_out_sock(tun_dplane_shard_t *shard, lisp_addr_t *rloc)
+{
+    tun_out_socks_t *out_socks = shard->out_socks;
+    ip_addr_t *ip;
+    int i;
+
+    if (!shard->worker){
+        return (get_out_socket_ptr_from_address(rloc));
+    }
+    ip = lisp_addr_ip(rloc);
+    if (!out_socks || !ip){
+        return (NULL);
+    }
+    for (i = 0; i < out_socks->nsocks; i++){
+        if (ip_addr_cmp(&out_socks->addrs[i], ip) == 0){
+            return (&out_socks->fds[i]);
+        }
+    }
+    return (NULL);
+}
+
+int
+tun_shard_default_out_sock(tun_dplane_shard_t *shard, int afi)
+{
+    tun_out_socks_t *out_socks = shard->out_socks;
+    int pos;
+
+    if (!shard->worker){
+        return (tun_get_default_output_socket(afi));
+    }
+    if (!out_socks){
+        return (ERR_SOCKET);
+    }
+    pos = afi == AF_INET ? out_socks->default_v4 : out_socks->default_v6;
+    return (pos == -1 ? ERR_SOCKET : out_socks->fds[pos]);
+}
+
+/* Add a duplicate of the output socket of addr. Returns its position or -1 */
+static int
+tun_out_socks_add(tun_out_socks_t *out_socks, lisp_addr_t *addr, int fd)
+{
+    int pos = out_socks->nsocks;
+
+    /* The socket is set to 0 when the address is removed */
+    if (!addr || lisp_addr_is_no_addr(addr) || fd <= 0){
+        return (-1);
+    }
+    out_socks->fds[pos] = dup(fd);
+    if (out_socks->fds[pos] == -1){
+        OOR_LOG(LWRN, "tun_out_socks_add: Couldn't duplicate the output socket of %s: %s",
+                lisp_addr_to_char(addr), strerror(errno));
+        return (-1);
+    }
+    ip_addr_copy(&out_socks->addrs[pos], lisp_addr_ip(addr));
+    out_socks->nsocks++;
+    return (pos);
+}
+
+/* Copy of the output sockets of the interfaces to be handed over to a
+ * worker. Main thread only */
+tun_out_socks_t *
+tun_out_socks_new()
+{
+    tun_dplane_data_t *data = tun_get_datap_data();
+    tun_out_socks_t *out_socks;
+    glist_entry_t *it;
+    iface_t *iface;
+    int max_socks = 2 * glist_size(interface_list) + 1;
+    int pos;
+
+    out_socks = xzalloc(sizeof(tun_out_socks_t));
+    out_socks->addrs = xzalloc(max_socks * sizeof(ip_addr_t));
+    out_socks->fds = xzalloc(max_socks * sizeof(int));
+    out_socks->default_v4 = -1;
+    out_socks->default_v6 = -1;
+    glist_for_each_entry(it, interface_list){
+        iface = (iface_t *)glist_entry_data(it);
+        pos = tun_out_socks_add(out_socks, iface->ipv4_address, iface->out_socket_v4);
+        if (pos != -1 && iface == data->default_out_iface_v4){
+            out_socks->default_v4 = pos;
+        }
+        pos = tun_out_socks_add(out_socks, iface->ipv6_address, iface->out_socket_v6);
+        if (pos != -1 && iface == data->default_out_iface_v6){
+            out_socks->default_v6 = pos;
+        }
+    }
+    return (out_socks);
+}
+
+void
+tun_out_socks_del(tun_out_socks_t *out_socks)
+{
+    int i;
+
+    if (!out_socks){
+        return;
+    }
+    for (i = 0; i < out_socks->nsocks; i++){
+        close(out_socks->fds[i]);
+    }
+    free(out_socks->addrs);
+    free(out_socks->fds);
+    free(out_socks);
+}
+
+/* The output sockets or the default output interfaces changed. The workers
+ * receive a new copy of the sockets */
+static void
+tun_out_socks_changed()
+{
+    tun_dplane_data_t *data = tun_get_datap_data();
+
+    if (data && data->nshards > 0 && data->shards[0].worker){
+        tun_workers_set_out_socks(data);
+    }
+}
+
 tun_dplane_data_t *
-tun_dplane_data_new_init(oor_encap_t encap_type)
+tun_dplane_data_new_init(oor_encap_t encap_type, int nworkers)
 {
     tun_dplane_data_t * data;
-    data = xmalloc(sizeof(tun_dplane_data_t));
+    data = xzalloc(sizeof(tun_dplane_data_t));
     if (!data){
         return (NULL);
     }
     data->encap_type = encap_type;
-    data->eid_to_dp_entries = shash_new_managed((free_value_fn_t)glist_destroy);
-    /* Insert entry for PeTRs */
-    shash_insert(data->eid_to_dp_entries, strdup(FULL_IPv4_ADDRESS_SPACE), glist_new());
-    shash_insert(data->eid_to_dp_entries, strdup(FULL_IPv6_ADDRESS_SPACE), glist_new());
-
-    ttable_init(&(data->ttable));
+    data->nshards = nworkers > 0 ? nworkers : 1;
+    data->shards = xzalloc(data->nshards * sizeof(tun_dplane_shard_t));
+    data->miss_notify_fd = -1;
+    if (dplane_conf.pending_pkts_per_eid > 0){
+        data->pending = pending_table_new(dplane_conf.pending_pkts_per_eid,
+                dplane_conf.pending_pkts_mem * 1024);
+    }
     return (data);
 }
 
@@ -1011,11 +1241,81 @@ tun_dplane_data_free(tun_dplane_data_t *data)
     if (!data){
         return;
     }
-    shash_destroy(data->eid_to_dp_entries);
-    ttable_uninit(&(data->ttable));
+    if (data->shards[0].worker){
+        tun_workers_stop(data);
+    }else{
+        tun_shard_uninit(&data->shards[0]);
+    }
+    pending_table_del(data->pending);
+    pkt_ring_del(data->rx_ring_v4);
+    pkt_ring_del(data->rx_ring_v6);
+    free(data->shards);
     free(data);
 }
 
+void
+tun_shard_init(tun_dplane_shard_t *shard, int tun_fd, tun_worker_t *worker)
+{
+    shard->tun_fd = tun_fd;
+    shard->worker = worker;
+    etable_init(&(shard->etable), tun_rm_dp_entry);
+    ttable_init(&(shard->ttable), dplane_conf.flow_table_size, etable_evict_flow,
+            &(shard->etable));
+    if (worker){
+        /* Aging of the flows is done by the worker itself */
+        ttable_set_idle_timeout(&(shard->ttable), dplane_conf.flow_idle_timeout);
+    }else{
+        ttable_start_aging(&(shard->ttable), dplane_conf.flow_idle_timeout);
+    }
+    ptable_init(&(shard->ptable), dplane_conf.prefix_table_size);
+
+    shard->pkt_batch_size = dplane_conf.pkt_batch_size;
+    shard->pkts_mem = xmalloc(shard->pkt_batch_size * TUN_PKT_BUF_SIZE);
+    shard->pkts = xzalloc(shard->pkt_batch_size * sizeof(lbuf_t));
+    shard->pkts_inf = xzalloc(shard->pkt_batch_size * sizeof(data_pkt_inf_t));
+    shard->send_batch = send_batch_new(shard->pkt_batch_size);
+}
+
+/* Must be called from the thread owning the shard or once it has finished */
+void
+tun_shard_uninit(tun_dplane_shard_t *shard)
+{
+    tun_dplane_shard_t *prev_shard = tun_thread_shard;
+
+    if (!shard->etable.buckets){
+        return;
+    }
+    /* The entries removed from the tables are looked up in the shard of the
+     * running thread */
+    tun_thread_shard = shard;
+    ttable_uninit(&(shard->ttable));
+    etable_uninit(&(shard->etable));
+    ptable_uninit(&(shard->ptable));
+    tun_thread_shard = prev_shard;
+    send_batch_del(shard->send_batch);
+    tun_out_socks_del(shard->out_socks);
+    free(shard->pkts_inf);
+    free(shard->pkts);
+    free(shard->pkts_mem);
+    memset(shard, 0, sizeof(tun_dplane_shard_t));
+}
+
+/* Point each buffer of the batch to its memory slot leaving headroom bytes
+ * to push headers */
+void
+tun_pkt_batch_reset(tun_dplane_shard_t *shard, int headroom)
+{
+    int i;
+
+    for (i = 0; i < shard->pkt_batch_size; i++){
+        lbuf_use_stack(&shard->pkts[i], shard->pkts_mem + i * TUN_PKT_BUF_SIZE,
+                TUN_PKT_BUF_SIZE);
+        if (headroom){
+            lbuf_reserve(&shard->pkts[i], headroom);
+        }
+    }
+}
+
 /*
  * Editor modelines
  *
@@ -21,14 +21,20 @@
 #define TUN_H_
 
 
+#include "../etable.h"
+#include "../pending_pkts.h"
+#include "../ptable.h"
 #include "../ttable.h"
 #include "../encapsulations/vxlan-gpe.h"
+#include "../../lib/pkt_ring.h"
 #include "../../lib/shash.h"
+#include "../../lib/sockets.h"
 #include "../../liblisp/liblisp.h"
 
 
 #define TUN_IFACE_NAME          "lispTun0"
 #define TUN_RECEIVE_SIZE        2048
+#define TUN_PKT_BUF_SIZE        MAX_IP_PKT_LEN
 
 
 /*
@@ -69,19 +75,98 @@ int tun_get_default_output_socket(int);
 
 typedef struct iface iface_t;
 
+typedef struct tun_worker_ tun_worker_t;
+
+/* Output sockets of the local RLOCs used by a worker. The sockets are
+ * duplicates owned by the worker, so the main thread can close or replace the
+ * sockets of the interfaces at any time. Built by the main thread and handed
+ * over to the worker, which releases the previous ones */
+typedef struct tun_out_socks_{
+    int nsocks;
+    ip_addr_t *addrs;
+    int *fds;
+    /* Position in fds of the socket of the default output interfaces. -1 if
+     * there is no default interface for the AFI */
+    int default_v4;
+    int default_v6;
+}tun_out_socks_t;
+
+/* Forwarding state of the data plane. There is one shard per data plane worker
+ * thread, or a single one processed by the main loop when no workers are
+ * configured. A shard is only accessed by the thread that owns it */
+typedef struct tun_dplane_shard_{
+    /* Tun queue where decapsulated packets are written */
+    int tun_fd;
+    /* Flows of each EID prefix. Used to find the fwd entries to be removed
+     * of the data plane when there is a change with the mapping of the eid */
+    etable_t etable;
+    /* Hash table containg the forward info from a tupla */
+    ttable_t ttable;
+    /* RLOCs of the flows between pairs of EID prefixes. Used to build the
+     * forward info of new flows without calling the control plane */
+    ptable_t ptable;
+    /* Buffers of the packets read in a single wake up of a data socket and
+     * packets encapsulated pending to be sent */
+    int pkt_batch_size;
+    uint8_t *pkts_mem;
+    lbuf_t *pkts;
+    data_pkt_inf_t *pkts_inf;
+    send_batch_t *send_batch;
+    /* Output sockets of a worker. NULL for the shard of the main loop, which
+     * uses the sockets of the interfaces */
+    tun_out_socks_t *out_socks;
+    /* Thread processing the shard. NULL for the shard of the main loop */
+    tun_worker_t *worker;
+}tun_dplane_shard_t;
+
 typedef struct tun_dplane_data_{
     oor_encap_t encap_type;
     iface_t *default_out_iface_v4;
     iface_t *default_out_iface_v6;
-    /* < char *eid -> glist_t <fwd_info_t *>> Used to find the fwd entries to be removed
-     * of the data plane when there is a change with the mapping of the eid */
-    shash_t *eid_to_dp_entries; //< char *eid -> glist_t <fwd_info_t *>>
-    /* Hash table containg the forward info from a tupla */
-    ttable_t ttable;
+    int nshards;
+    tun_dplane_shard_t *shards;
+    /* eventfd used by the workers to notify flow misses to the main loop */
+    int miss_notify_fd;
+    /* Packets waiting for a Map-Reply. Only accessed by the main thread */
+    pending_table_t *pending;
+    /* AF_PACKET rings receiving the encapsulated packets. NULL when they are
+     * received from raw sockets */
+    pkt_ring_t *rx_ring_v4;
+    pkt_ring_t *rx_ring_v6;
 }tun_dplane_data_t;
 
+/* Shard of the running thread. Only set in the worker threads */
+extern THREAD_LOCAL tun_dplane_shard_t *tun_thread_shard;
+
 tun_dplane_data_t * tun_get_datap_data();
+tun_dplane_data_t * tun_dplane_data_new_init(oor_encap_t encap_type, int nworkers);
+void tun_dplane_data_free(tun_dplane_data_t *data);
+void tun_pkt_batch_reset(tun_dplane_shard_t *shard, int headroom);
 int tun_reset_all_fwd();
+int tun_flush_pending(lisp_addr_t *eid_prefix, uint8_t resolved);
+int tun_shard_rm_fwd_from_entry(tun_dplane_shard_t *shard, lisp_addr_t *eid_prefix,
+        uint8_t is_local);
+int tun_shard_update_local_fwd(tun_dplane_shard_t *shard, lisp_addr_t *eid_prefix,
+        lisp_addr_t *src_rlocs, int nrlocs);
+void tun_shard_reset_fwd(tun_dplane_shard_t *shard);
+void tun_shard_set_out_socks(tun_dplane_shard_t *shard, tun_out_socks_t *out_socks);
+int *tun_shard_out_sock(tun_dplane_shard_t *shard, lisp_addr_t *rloc);
+int tun_shard_default_out_sock(tun_dplane_shard_t *shard, int afi);
+tun_out_socks_t *tun_out_socks_new();
+void tun_out_socks_del(tun_out_socks_t *out_socks);
+void tun_shard_init(tun_dplane_shard_t *shard, int tun_fd, tun_worker_t *worker);
+void tun_shard_uninit(tun_dplane_shard_t *shard);
+int tun_add_dp_entry(tun_dplane_shard_t *shard, fwd_info_t *fi);
+void tun_rm_dp_entry(fwd_info_t *fi);
+
+static inline tun_dplane_shard_t *
+tun_get_shard()
+{
+    if (tun_thread_shard){
+        return (tun_thread_shard);
+    }
+    return (&tun_get_datap_data()->shards[0]);
+}
 
 extern data_plane_struct_t dplane_tun;
 
@@ -23,49 +23,25 @@
 #include "tun.h"
 #include "tun_input.h"
 #include "tun_output.h"
+#include "tun_worker.h"
 #include "../../lib/packets.h"
+#include "../../lib/pkt_ring.h"
 #include "../../lib/mem_util.h"
 #include "../../liblisp/liblisp.h"
 #include "../../lib/oor_log.h"
 
-/* static buffer to receive packets */
-static uint8_t pkt_recv_buf[MAX_IP_PKT_LEN+1];
-static lbuf_t pkt_buf;
+static int tun_decap_hdr(lbuf_t *b, int port, uint8_t ttl, uint8_t tos,
+        uint32_t *iid);
 
-int
-tun_read_and_decap_pkt(int sock, lbuf_t *b, uint32_t *iid)
+/* Pull the LISP or VXLAN-GPE header of a packet pointing to it. The outer
+ * TTL and TOS are copied to the inner header */
+static int
+tun_decap_hdr(lbuf_t *b, int port, uint8_t ttl, uint8_t tos, uint32_t *iid)
 {
-    uint8_t ttl = 0, tos = 0;
-    int afi;
-    struct udphdr *udph;
     lisp_data_hdr_t *lisph;
     vxlan_gpe_hdr_t *vxlanh;
-    int port;
 
-    if (sock_data_recv(sock, b, &afi, &ttl, &tos) != GOOD) {
-        return(BAD);
-    }
-
-    if (afi == AF_INET){
-        /* With input RAW UDP sockets in IPv4, we get the whole external
-         * IPv4 packet */
-        lbuf_reset_ip(b);
-        pkt_pull_ip(b);
-        lbuf_reset_udp(b);
-    }else{
-        /* With input RAW UDP sockets in IPv6, we get the whole external
-         * UDP packet */
-        lbuf_reset_udp(b);
-    }
-
-    udph = pkt_pull_udp(b);
-    if (ntohs(udplen(udph)) < 16){//8 udp header + 8 lisp header
-        return (ERR_NOT_ENCAP);
-    }
-
-    /* FILTER UDP: with input RAW UDP sockets, we receive all UDP packets,
-     * we only want LISP data ones */
-    switch (ntohs(udpdport(udph))){
+    switch (port){
     case LISP_DATA_PORT:
         lisph = lisp_data_pull_hdr(b);
         if (LDHDR_LSB_BIT(lisph)){
@@ -73,8 +49,6 @@ tun_read_and_decap_pkt(int sock, lbuf_t *b, uint32_t *iid)
         }else{
             *iid = 0;
         }
-
-        port = LISP_DATA_PORT;
         break;
     case VXLAN_GPE_DATA_PORT:
 
@@ -82,7 +56,6 @@ tun_read_and_decap_pkt(int sock, lbuf_t *b, uint32_t *iid)
         if (VXLAN_HDR_VNI_BIT(vxlanh)){
             *iid = vxlan_gpe_hdr_get_vni(vxlanh);
         }
-        port = VXLAN_GPE_DATA_PORT;
         break;
     default:
         return (ERR_NOT_ENCAP);
@@ -101,20 +74,135 @@ tun_read_and_decap_pkt(int sock, lbuf_t *b, uint32_t *iid)
     return(GOOD);
 }
 
+/* Decapsulate a packet received from a data raw socket. The outer TTL and TOS
+ * are copied to the inner header */
 int
-tun_process_input_packet(sock_t *sl)
+tun_decap_pkt(lbuf_t *b, int afi, uint8_t ttl, uint8_t tos, uint32_t *iid)
 {
+    struct udphdr *udph;
+
+    if (afi == AF_INET){
+        /* With input RAW UDP sockets in IPv4, we get the whole external
+         * IPv4 packet */
+        lbuf_reset_ip(b);
+        pkt_pull_ip(b);
+        lbuf_reset_udp(b);
+    }else{
+        /* With input RAW UDP sockets in IPv6, we get the whole external
+         * UDP packet */
+        lbuf_reset_udp(b);
+    }
+
+    udph = pkt_pull_udp(b);
+    if (ntohs(udplen(udph)) < 16){//8 udp header + 8 lisp header
+        return (ERR_NOT_ENCAP);
+    }
+
+    /* FILTER UDP: with input RAW UDP sockets, we receive all UDP packets,
+     * we only want LISP data ones */
+    return (tun_decap_hdr(b, ntohs(udpdport(udph)), ttl, tos, iid));
+}
+
+/* Decapsulate a packet received from a data datagram socket bound to port.
+ * The buffer starts at the LISP or VXLAN-GPE header */
+int
+tun_decap_dgram_pkt(lbuf_t *b, int port, uint8_t ttl, uint8_t tos, uint32_t *iid)
+{
+    if (lbuf_size(b) < 8){ // 8-> At least LISP header size
+        return (ERR_NOT_ENCAP);
+    }
+    return (tun_decap_hdr(b, port, ttl, tos, iid));
+}
+
+int
+tun_read_and_decap_pkt(int sock, lbuf_t *b, uint32_t *iid)
+{
+    uint8_t ttl = 0, tos = 0;
+    int afi;
+
+    if (sock_data_recv(sock, b, &afi, &ttl, &tos) != GOOD) {
+        return(BAD);
+    }
+
+    return (tun_decap_pkt(b, afi, ttl, tos, iid));
+}
+
+/* Decapsulate the packet i of the batch of the shard. Workers receive the
+ * packets from datagram sockets while the main thread uses raw sockets */
+static inline int
+tun_shard_decap_pkt(tun_dplane_shard_t *shard, int i, uint32_t *iid)
+{
+    data_pkt_inf_t *inf = &shard->pkts_inf[i];
+
+    if (shard->worker){
+        return (tun_decap_dgram_pkt(&shard->pkts[i], tun_worker_data_port(shard->worker),
+                inf->ttl, inf->tos, iid));
+    }
+    return (tun_decap_pkt(&shard->pkts[i], inf->afi, inf->ttl, inf->tos, iid));
+}
+
+/* Decapsulate the npkts packets of the batch and write them to the tun */
+static void
+tun_input_batch(tun_dplane_shard_t *shard, int npkts)
+{
+    lbuf_t *b;
     uint32_t iid;
-    lbuf_use_stack(&pkt_buf, &pkt_recv_buf, MAX_IP_PKT_LEN);
+    int i;
 
-    if (tun_read_and_decap_pkt(sl->fd, &pkt_buf, &iid) != GOOD) {
-        return (BAD);
+    for (i = 0; i < npkts; i++){
+        b = &shard->pkts[i];
+        if (tun_shard_decap_pkt(shard, i, &iid) != GOOD) {
+            continue;
+        }
+
+        /* XXX Destination packet should be checked it belongs to this xTR */
+        if ((write(shard->tun_fd, lbuf_l3(b), lbuf_size(b))) < 0) {
+            OOR_LOG(LDBG_2, "lisp_input: write error: %s\n ", strerror(errno));
+        }
     }
+}
+
+/* Decapsulate the npkts packets of the batch and encapsulate them again
+ * towards their next hop */
+static void
+tun_rtr_input_batch(tun_dplane_shard_t *shard, int npkts)
+{
+    packet_tuple_t tpl;
+    lbuf_t *b;
+    int i;
+
+    for (i = 0; i < npkts; i++){
+        b = &shard->pkts[i];
+        if (tun_shard_decap_pkt(shard, i, &(tpl.iid)) != GOOD) {
+            continue;
+        }
 
-    /* XXX Destination packet should be checked it belongs to this xTR */
-    if ((write(tun_receive_fd, lbuf_l3(&pkt_buf), lbuf_size(&pkt_buf))) < 0) {
-        OOR_LOG(LDBG_2, "lisp_input: write error: %s\n ", strerror(errno));
+        OOR_LOG(LDBG_3, "Forwarding packet to OUPUT for re-encapsulation");
+
+        lbuf_point_to_l3(b);
+        lbuf_reset_ip(b);
+
+        if (pkt_parse_5_tuple(b, &tpl) != GOOD) {
+            continue;
+        }
+        tun_output(b, &tpl);
+    }
+    tun_output_flush();
+}
+
+int
+tun_process_input_packet(sock_t *sl)
+{
+    tun_dplane_shard_t *shard = tun_get_shard();
+    int npkts;
+
+    tun_pkt_batch_reset(shard, 0);
+    npkts = sock_data_recv_batch(sl->fd, shard->pkts, shard->pkts_inf,
+            shard->pkt_batch_size);
+    if (npkts == 0){
+        return (BAD);
     }
+    tun_input_batch(shard, npkts);
 
     return (GOOD);
 }
@@ -122,26 +210,57 @@ tun_process_input_packet(sock_t *sl)
 int
 tun_rtr_process_input_packet(struct sock *sl)
 {
-    packet_tuple_t tpl;
-    lbuf_use_stack(&pkt_buf, &pkt_recv_buf, MAX_IP_PKT_LEN);
+    tun_dplane_shard_t *shard = tun_get_shard();
+    int npkts;
+
     /* Reserve space in case the received packet was IPv6. In this case the IPv6 header is
      * not provided */
-    lbuf_reserve(&pkt_buf,LBUF_STACK_OFFSET);
-
-    if (tun_read_and_decap_pkt(sl->fd, &pkt_buf, &(tpl.iid)) != GOOD) {
+    tun_pkt_batch_reset(shard, LBUF_STACK_OFFSET);
+    npkts = sock_data_recv_batch(sl->fd, shard->pkts, shard->pkts_inf,
+            shard->pkt_batch_size);
+    if (npkts == 0){
         return (BAD);
     }
+    tun_rtr_input_batch(shard, npkts);
 
-    OOR_LOG(LDBG_3, "Forwarding packet to OUPUT for re-encapsulation");
+    return(GOOD);
+}
 
-    lbuf_point_to_l3(&pkt_buf);
-    lbuf_reset_ip(&pkt_buf);
+/* Same as tun_process_input_packet for packets received from an AF_PACKET
+ * ring. The packets are processed in place: the buffers of the batch point
+ * to the ring until its blocks are released */
+int
+tun_process_input_ring(sock_t *sl)
+{
+    tun_dplane_shard_t *shard = tun_get_shard();
+    pkt_ring_t *ring = (pkt_ring_t *)sl->arg;
+    int npkts;
 
-    if (pkt_parse_5_tuple(&pkt_buf, &tpl) != GOOD) {
-        return (BAD);
+    npkts = pkt_ring_recv_batch(ring, shard->pkts, shard->pkts_inf,
+            shard->pkt_batch_size);
+    if (npkts > 0){
+        tun_input_batch(shard, npkts);
     }
-    tun_output(&pkt_buf, &tpl);
+    pkt_ring_release(ring);
 
-    return(GOOD);
+    return (npkts > 0 ? GOOD : BAD);
+}
+
+int
+tun_rtr_process_input_ring(sock_t *sl)
+{
+    tun_dplane_shard_t *shard = tun_get_shard();
+    pkt_ring_t *ring = (pkt_ring_t *)sl->arg;
+    int npkts;
+
+    /* The ring reserves headroom before each packet for the new headers */
+    npkts = pkt_ring_recv_batch(ring, shard->pkts, shard->pkts_inf,
+            shard->pkt_batch_size);
+    if (npkts > 0){
+        tun_rtr_input_batch(shard, npkts);
+    }
+    pkt_ring_release(ring);
+
+    return (npkts > 0 ? GOOD : BAD);
 }
 
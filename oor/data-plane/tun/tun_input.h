@@ -31,7 +31,12 @@
 #include "../../lib/sockets.h"
 #include "../../lib/cksum.h"
 
+int tun_decap_pkt(lbuf_t *b, int afi, uint8_t ttl, uint8_t tos, uint32_t *iid);
+int tun_decap_dgram_pkt(lbuf_t *b, int port, uint8_t ttl, uint8_t tos, uint32_t *iid);
+int tun_read_and_decap_pkt(int sock, lbuf_t *b, uint32_t *iid);
 int tun_process_input_packet(struct sock *sl);
 int tun_rtr_process_input_packet(struct sock *sl);
+int tun_process_input_ring(struct sock *sl);
+int tun_rtr_process_input_ring(struct sock *sl);
 
 #endif /*TUN_IFACE_LIST_H_*/
@@ -22,6 +22,8 @@
 
 #include "tun.h"
 #include "tun_output.h"
+#include "tun_worker.h"
+#include "../data-plane.h"
 #include "../encapsulations/vxlan-gpe.h"
 #include "../../fwd_policies/fwd_policy.h"
 #include "../../fwd_policies/flow_balancing/fwd_entry_tuple.h"
@@ -33,14 +35,21 @@
 #include "../../lib/sockets-util.h"
 
 
-/* static buffer to receive packets */
-static uint8_t pkt_recv_buf[TUN_RECEIVE_SIZE];
-static lbuf_t pkt_buf;
-
-
 static int tun_output_multicast(lbuf_t *b, packet_tuple_t *tuple);
 static int tun_output_unicast(lbuf_t *b, packet_tuple_t *tuple);
 static int tun_forward_native(lbuf_t *b, lisp_addr_t *dst);
+static int tun_send_raw_packet(int sock, lbuf_t *b, ip_addr_t *dip);
+
+/* Queue the packet in the output batch. It is sent when tun_output_flush is
+ * called, once all the received packets have been processed */
+static int
+tun_send_raw_packet(int sock, lbuf_t *b, ip_addr_t *dip)
+{
+    tun_dplane_shard_t *shard = tun_get_shard();
+
+    return (send_batch_add_packet(shard->send_batch, sock, lbuf_data(b),
+            lbuf_size(b), dip, 0));
+}
 
 static int
 tun_forward_native(lbuf_t *b, lisp_addr_t *dst)
@@ -51,14 +60,14 @@ tun_forward_native(lbuf_t *b, lisp_addr_t *dst)
             lisp_addr_to_char(dst));
 
     afi = lisp_addr_ip_afi(dst);
-    sock = tun_get_default_output_socket(afi);
+    sock = tun_shard_default_out_sock(tun_get_shard(), afi);
 
     if (sock == ERR_SOCKET) {
         OOR_LOG(LDBG_2, "tun_forward_native: No output interface for afi %d", afi);
         return (BAD);
     }
 
-    ret = send_raw_packet(sock, lbuf_data(b), lbuf_size(b), lisp_addr_ip(dst));
+    ret = tun_send_raw_packet(sock, b, lisp_addr_ip(dst));
     return (ret);
 }
 
@@ -93,11 +102,14 @@ make_mcast_addr(packet_tuple_t *tuple, lisp_addr_t *addr){
 }
 
 
+/* Called by the EID index to remove an invalidated flow */
 void
-tun_rm_dp_entry(packet_tuple_t *tuple)
+tun_rm_dp_entry(fwd_info_t *fi)
 {
-    tun_dplane_data_t *data = tun_get_datap_data();
-    ttable_remove(&(data->ttable), tuple);
+    tun_dplane_shard_t *shard = tun_get_shard();
+    fwd_entry_tuple_t *fe = (fwd_entry_tuple_t *)fi->dp_conf_inf;
+
+    ttable_remove(&(shard->ttable), fe->tuple);
 }
 
 static int
@@ -149,75 +161,248 @@ tun_output_multicast(lbuf_t *b, packet_tuple_t *tuple)
     return (GOOD);
 }
 
+/* Prebuild the outer headers of the packets of the flow. Only the fields that
+ * change per packet are filled when encapsulating */
 static int
-tun_output_unicast(lbuf_t *b, packet_tuple_t *tuple)
+tun_build_hdr_tmpl(fwd_info_t *fi)
+{
+    fwd_entry_tuple_t *fe = (fwd_entry_tuple_t *)fi->dp_conf_inf;
+
+    switch (fi->encap){
+    case ENCP_LISP:
+        return (lisp_data_hdr_tmpl_init(&fe->hdr_tmpl, fe->src_port, fe->dst_port,
+                fe->srloc, fe->drloc, fe->iid, dplane_conf.ipv4_udp_checksum));
+    case ENCP_VXLAN_GPE:
+        return (vxlan_gpe_data_hdr_tmpl_init(&fe->hdr_tmpl, VXLAN_GPE_DATA_PORT,
+                VXLAN_GPE_DATA_PORT, fe->srloc, fe->drloc, fe->iid,
+                &fe->tuple->dst_addr, dplane_conf.ipv4_udp_checksum));
+    }
+    return (BAD);
+}
+
+/* Obtain from the control plane the forwarding information of a flow.
+ * Returns NULL if there is no forwarding information for it */
+fwd_info_t *
+tun_get_fwd_info(packet_tuple_t *tuple)
 {
     fwd_info_t *fi;
     fwd_entry_tuple_t *fe;
-    glist_t *fwd_tuple_lst, *pxtr_fwd_tuple_list;
-    tun_dplane_data_t *dp_data;
-    /* For xTR tuple->iid is 0 when received while for RTRs tuple->iid is the correct value */
-    uint32_t iid = tuple->iid;
-
-    dp_data = tun_get_datap_data();
 
-    fi = ttable_lookup(&(dp_data->ttable), tuple);
-    if (!fi) {
-        fi = (fwd_info_t *)ctrl_get_forwarding_info(tuple);
-        if (!fi){
-            return (BAD);
-        }
-        fe = (fwd_entry_tuple_t *)fi->dp_conf_inf;
-        if (!fe){
-            return (BAD);
-        }
-        if (fe->srloc && fe->drloc)  {
-            fe->out_sock = get_out_socket_ptr_from_address(fe->srloc);
-        }
-        // While we can not get iid from interface (xTR), we insert the tupla with iid = 0.
-        // For RTRs iid is initialized with the right value. Used to search in the table
-        // We only support a same EID prefix per xTR
-        fe->tuple->iid = iid;
-        // fe->tuple is cloned from tuple
-        if (ttable_insert(&(dp_data->ttable), fe->tuple, fi) != GOOD){
-            /* If table is full, reset the data plane */
-            tun_reset_all_fwd();
-            ttable_insert(&(dp_data->ttable), fe->tuple, fi);
+    fi = (fwd_info_t *)ctrl_get_forwarding_info(tuple);
+    if (!fi){
+        return (NULL);
+    }
+    fe = (fwd_entry_tuple_t *)fi->dp_conf_inf;
+    if (!fe){
+        fwd_info_del(fi);
+        return (NULL);
+    }
+    if (fe->srloc && fe->drloc)  {
+        fe->out_sock = get_out_socket_ptr_from_address(fe->srloc);
+        if (tun_build_hdr_tmpl(fi) != GOOD){
+            OOR_LOG(LDBG_2, "tun_get_fwd_info: Couldn't build the headers for RLOCs %s -> %s",
+                    lisp_addr_to_char(fe->srloc), lisp_addr_to_char(fe->drloc));
         }
+    }
+    // While we can not get iid from interface (xTR), we insert the tupla with iid = 0.
+    // For RTRs iid is initialized with the right value. Used to search in the table
+    // We only support a same EID prefix per xTR
+    fe->tuple->iid = tuple->iid;
+    return (fi);
+}
+
+/* Build the forwarding information of a new flow from the RLOCs cached for its
+ * EID prefixes. Returns NULL if they are not cached */
+static fwd_info_t *
+tun_get_cached_fwd_info(tun_dplane_shard_t *shard, packet_tuple_t *tuple)
+{
+    fwd_pref_info_t *pref_info;
+    fwd_info_t *fi;
+    fwd_entry_tuple_t *fe;
+    lisp_addr_t *srloc, *drloc;
+    int *out_sock;
+    uint32_t hash, iid;
+
+    pref_info = ptable_lookup(&(shard->ptable), tuple);
+    if (!pref_info){
+        return (NULL);
+    }
+    /* As done by the control plane, the tuple is hashed with the IID of the
+     * local EID. The flow is stored with the IID of the packet */
+    iid = tuple->iid;
+    tuple->iid = pref_info->iid;
+    hash = pkt_tuple_hash(tuple);
+    tuple->iid = iid;
+    if (fwd_pref_info_select_rlocs(pref_info, hash, &srloc, &drloc) != GOOD){
+        return (NULL);
+    }
+    out_sock = pref_info->src_socks[srloc - pref_info->src_rlocs];
+    if (!out_sock){
+        return (NULL);
+    }
+
+    fi = fwd_info_new();
+    fi->associated_entry = lisp_addr_clone(pref_info->dst_eid);
+    fi->local_entry = lisp_addr_clone(pref_info->src_eid);
+    fi->encap = pref_info->encap;
+    fwd_info_set_activity(fi, pref_info->activity);
+    fe = fwd_entry_tuple_new_init(tuple, srloc, drloc, LISP_DATA_PORT,
+            LISP_DATA_PORT, pref_info->iid, out_sock);
+    fi->dp_conf_inf = fe;
+    fi->data_del_fn = (fwd_info_data_del_fn)fwd_entry_tuple_del;
+    if (tun_build_hdr_tmpl(fi) != GOOD){
+        OOR_LOG(LDBG_2, "tun_get_cached_fwd_info: Couldn't build the headers for RLOCs %s -> %s",
+                lisp_addr_to_char(fe->srloc), lisp_addr_to_char(fe->drloc));
+    }
+    return (fi);
+}
+
+/* Resolve the output sockets of the source RLOCs of the prefixes. Called by
+ * the thread owning the shard, so the workers use their own sockets */
+static void
+tun_bind_pref_info(tun_dplane_shard_t *shard, fwd_pref_info_t *pref_info)
+{
+    int i;
+
+    pref_info->src_socks = xzalloc((pref_info->src_rlocs_len + 1) * sizeof(int *));
+    for (i = 0; i < pref_info->src_rlocs_len; i++){
+        pref_info->src_socks[i] = tun_shard_out_sock(shard, &pref_info->src_rlocs[i]);
+    }
+}
+
+/* Insert the forwarding information of a flow in the flow table of the shard
+ * and associate it with its EID prefix */
+int
+tun_add_dp_entry(tun_dplane_shard_t *shard, fwd_info_t *fi)
+{
+    fwd_entry_tuple_t *fe = (fwd_entry_tuple_t *)fi->dp_conf_inf;
+
+    // fe->tuple is cloned from tuple. If table is full, a flow is evicted
+    ttable_insert(&(shard->ttable), fe->tuple, fi);
+
+    if (fi->pref_info){
+        /* The next new flows between the same EID prefixes are resolved by
+         * the data plane */
+        tun_bind_pref_info(shard, fi->pref_info);
+        ptable_insert(&(shard->ptable), fi->pref_info, fe->tuple->iid);
+        fi->pref_info = NULL;
+    }
+
+    /* Associate eid with fwd_info */
+    if (etable_add(&(shard->etable), fi) == GOOD){
+        OOR_LOG(LDBG_3, "tun_add_dp_entry: The tupla [%s] has been associated with the EID %s%s",
+                pkt_tuple_to_char(fe->tuple),lisp_addr_to_char(fi->associated_entry),
+                fi->neg_map_reply_act == ACT_NATIVE_FWD ? " and with PeTRs" : "");
+    }
+    return (GOOD);
+}
+
+/* The packets of the flow would be dropped because the Map-Request of the
+ * destination is still outstanding */
+uint8_t
+tun_fwd_info_pending(fwd_info_t *fi)
+{
+    fwd_entry_tuple_t *fe = (fwd_entry_tuple_t *)fi->dp_conf_inf;
+
+    return (fi->map_pending && fi->neg_map_reply_act != ACT_NATIVE_FWD
+            && (!fe->srloc || !fe->drloc));
+}
+
+/* Keep the packet until the mapping of eid is received. Main thread only */
+int
+tun_pending_add(lisp_addr_t *eid, lbuf_t *b, packet_tuple_t *tuple)
+{
+    tun_dplane_data_t *data = tun_get_datap_data();
+
+    if (!data->pending || tun_thread_shard){
+        OOR_LOG(LDBG_3, "tun_output_unicast: Packet dropped");
+        return (GOOD);
+    }
+    return (pending_table_add(data->pending, eid, b, tuple));
+}
+
+static void
+tun_pending_replay(lbuf_t *b, packet_tuple_t *tuple)
+{
+    tun_dplane_data_t *data = tun_get_datap_data();
+
+    if (data->shards[0].worker){
+        tun_workers_replay(data, b, tuple);
+    }else{
+        tun_output(b, tuple);
+    }
+}
 
+/* The replayed packets are only referenced by the output batch of the main
+ * loop, so they are sent before the pending queue is freed. The workers
+ * received a copy of them */
+static void
+tun_pending_replay_end()
+{
+    tun_dplane_data_t *data = tun_get_datap_data();
+
+    if (data->shards[0].worker){
+        tun_workers_notify_all(data);
+    }else{
+        tun_output_flush();
+    }
+}
 
-        /* Associate eid with fwd_info */
-        fwd_tuple_lst = (glist_t *)shash_lookup(dp_data->eid_to_dp_entries,lisp_addr_to_char(fi->associated_entry));
-        if (!fwd_tuple_lst){
-            fwd_tuple_lst = glist_new_managed((glist_del_fct)tun_rm_dp_entry);
-            shash_insert(dp_data->eid_to_dp_entries, strdup(lisp_addr_to_char(fi->associated_entry)), fwd_tuple_lst);
+/* Forward, or drop if the mapping couldn't be obtained, the packets waiting
+ * for the Map-Reply of eid_prefix */
+int
+tun_flush_pending(lisp_addr_t *eid_prefix, uint8_t resolved)
+{
+    tun_dplane_data_t *data = tun_get_datap_data();
+
+    if (!data->pending){
+        return (GOOD);
+    }
+    if (resolved){
+        pending_table_flush(data->pending, eid_prefix, tun_pending_replay,
+                tun_pending_replay_end);
+    }else{
+        pending_table_flush(data->pending, eid_prefix, NULL, NULL);
+    }
+    return (GOOD);
+}
+
+static int
+tun_output_unicast(lbuf_t *b, packet_tuple_t *tuple)
+{
+    fwd_info_t *fi;
+    fwd_entry_tuple_t *fe;
+    tun_dplane_shard_t *shard = tun_get_shard();
+
+    fi = ttable_lookup(&(shard->ttable), tuple);
+    if (!fi) {
+        fi = tun_get_cached_fwd_info(shard, tuple);
+        if (!fi && shard->worker){
+            /* The control plane is only accessed from the main thread. The
+             * packet is replayed once the forwarding information is received */
+            return (tun_worker_queue_miss(shard->worker, b, tuple));
         }
-        glist_add(fe->tuple,fwd_tuple_lst);
-        OOR_LOG(LDBG_3, "tun_output_unicast: The tupla [%s] has been associated with the EID %s",
-                pkt_tuple_to_char(tuple),lisp_addr_to_char(fi->associated_entry));
-
-        if(fi->neg_map_reply_act == ACT_NATIVE_FWD){ // Forwarding entry should be also associated with PeTRs list
-            switch (lisp_addr_ip_afi(fi->associated_entry)){
-            case AF_INET:
-                pxtr_fwd_tuple_list = (glist_t *)shash_lookup(dp_data->eid_to_dp_entries,FULL_IPv4_ADDRESS_SPACE);
-                break;
-            case AF_INET6:
-                pxtr_fwd_tuple_list = (glist_t *)shash_lookup(dp_data->eid_to_dp_entries,FULL_IPv6_ADDRESS_SPACE);
-                break;
-            default:
-                OOR_LOG(LDBG_3, "tun_output_unicast: Forwarding to PeTR is only for IP EIDs. It should never reach here");
+        if (!fi){
+            fi = tun_get_fwd_info(tuple);
+            if (!fi){
                 return (BAD);
             }
-            glist_add(fe->tuple,pxtr_fwd_tuple_list);
-            OOR_LOG(LDBG_3, "  and with PeTRs");
         }
-    }else{
-        fe = fi->dp_conf_inf;
+        if (tun_add_dp_entry(shard, fi) != GOOD){
+            return (BAD);
+        }
+    }
+    fe = fi->dp_conf_inf;
+    if (fi->activity){
+        mcache_activity_touch(fi->activity, shard->ttable.now);
     }
 
     /* Packets with no/negative map cache entry AND no PETR
      * OR packets with missing src or dst RLOCs*/
     if (!fe->srloc || !fe->drloc) {
+        if (tun_fwd_info_pending(fi)){
+            return (tun_pending_add(fi->associated_entry, b, tuple));
+        }
         switch (fi->neg_map_reply_act){
         case ACT_NO_ACTION:
         case ACT_SEND_MREQ:
@@ -233,18 +418,12 @@ tun_output_unicast(lbuf_t *b, packet_tuple_t *tuple)
             lisp_addr_to_char(fe->srloc),
             lisp_addr_to_char(fe->drloc));
 
-    switch (fi->encap){
-    case ENCP_LISP:
-        lisp_data_encap(b, fe->src_port, fe->dst_port, fe->srloc, fe->drloc, fe->iid);
-        break;
-    case ENCP_VXLAN_GPE:
-        vxlan_gpe_data_encap(b, VXLAN_GPE_DATA_PORT, VXLAN_GPE_DATA_PORT, fe->srloc, fe->drloc, fe->iid,
-                             &tuple->dst_addr);
-        break;
+    if (pkt_push_hdr_tmpl(b, &fe->hdr_tmpl) != GOOD){
+        OOR_LOG(LDBG_3, "tun_output_unicast: No outer headers for the flow. Discarding packet");
+        return (BAD);
     }
 
-    return(send_raw_packet(*(fe->out_sock), lbuf_data(b), lbuf_size(b),
-               lisp_addr_ip(fe->drloc)));
+    return(tun_send_raw_packet(*(fe->out_sock), b, lisp_addr_ip(fe->drloc)));
 }
 
 int
@@ -267,27 +446,47 @@ tun_output(lbuf_t *b, packet_tuple_t *tpl)
     return(GOOD);
 }
 
+/* Send the packets queued by tun_output */
+int
+tun_output_flush()
+{
+    tun_dplane_shard_t *shard = tun_get_shard();
+
+    if (shard->worker){
+        tun_worker_flush_misses(shard->worker);
+    }
+    return (send_batch_flush(shard->send_batch) == 0 ? GOOD : BAD);
+}
+
 int
 tun_output_recv(sock_t *sl)
 {
+    tun_dplane_shard_t *shard = tun_get_shard();
     packet_tuple_t tpl;
+    lbuf_t *b;
+    int i, npkts;
 
-    lbuf_use_stack(&pkt_buf, &pkt_recv_buf, TUN_RECEIVE_SIZE);
-    lbuf_reserve(&pkt_buf, LBUF_STACK_OFFSET);
-
-    if (sock_recv(sl->fd, &pkt_buf) != GOOD) {
+    tun_pkt_batch_reset(shard, LBUF_STACK_OFFSET);
+    npkts = sock_recv_batch(sl->fd, shard->pkts, shard->pkt_batch_size);
+    if (npkts == 0) {
         OOR_LOG(LWRN, "OUTPUT: Error while reading from tun!");
         return (BAD);
     }
-    lbuf_reset_ip(&pkt_buf);
-    if (pkt_parse_5_tuple(&pkt_buf, &tpl) != GOOD) {
-        return (BAD);
+
+    for (i = 0; i < npkts; i++){
+        b = &shard->pkts[i];
+        lbuf_reset_ip(b);
+        if (pkt_parse_5_tuple(b, &tpl) != GOOD) {
+            continue;
+        }
+        /* XXX Since OOR doesn't support same local prefixes with different IIDs when
+         * operating as a XTR or MN, we use IID = 0 to calculate the hash of the ttable.
+         * The actual IID to be used on the encapsulation processed is already stored
+         * in the forwarding entry, which is obtained on a ttable miss.*/
+        tpl.iid = 0;
+        tun_output(b, &tpl);
     }
-    /* XXX Since OOR doesn't support same local prefixes with different IIDs when
-     * operating as a XTR or MN, we use IID = 0 to calculate the hash of the ttable.
-     * The actual IID to be used on the encapsulation processed is already stored
-     * in the forwarding entry, which is obtained on a ttable miss.*/
-    tpl.iid = 0;
-    tun_output(&pkt_buf, &tpl);
+    tun_output_flush();
+
     return (GOOD);
 }
@@ -36,5 +36,9 @@
 
 int tun_output_recv(sock_t *sl);
 int tun_output(lbuf_t *, packet_tuple_t *);
+int tun_output_flush();
+fwd_info_t *tun_get_fwd_info(packet_tuple_t *tuple);
+uint8_t tun_fwd_info_pending(fwd_info_t *fi);
+int tun_pending_add(lisp_addr_t *eid, lbuf_t *b, packet_tuple_t *tuple);
 
 #endif /*TUN_OUTPUT_H_*/
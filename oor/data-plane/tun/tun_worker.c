@@ -0,0 +1,570 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "tun_worker.h"
+#include "tun_output.h"
+#include "../data-plane.h"
+#include "../../oor_external.h"
+#include "../../fwd_policies/fwd_policy.h"
+#include "../../fwd_policies/flow_balancing/fwd_entry_tuple.h"
+#include "../../lib/mem_util.h"
+#include "../../lib/oor_log.h"
+
+
+typedef enum tun_worker_msg_type_ {
+    TUN_WMSG_MISS,      /* Worker -> main: packet without forwarding entry */
+    TUN_WMSG_FWD_INFO,  /* Main -> worker: forwarding info of a miss */
+    TUN_WMSG_RM_FWD,    /* Main -> worker: remove the entries of an EID */
+    TUN_WMSG_UPDATE_LOCAL /* Main -> worker: the locators of a local EID changed */
+} tun_worker_msg_type_e;
+
+/* Message exchanged through the rings. For misses, the packet is stored after
+ * the message with LBUF_STACK_OFFSET bytes of headroom for the encapsulation */
+typedef struct tun_worker_msg_ {
+    tun_worker_msg_type_e   type;
+    packet_tuple_t          tuple;
+    fwd_info_t              *fi;
+    lisp_addr_t             *eid;
+    /* Source RLOCs of the local EID that are still valid */
+    lisp_addr_t             *rlocs;
+    int                     nrlocs;
+    lbuf_t                  pkt;
+} tun_worker_msg_t;
+
+static void *tun_worker_run(void *arg);
+static int tun_worker_process_ctrl_msgs(sock_t *sl);
+static int tun_workers_process_misses(sock_t *sl);
+static void tun_worker_age_flows(tun_worker_t *w);
+static void tun_worker_msg_del(tun_worker_msg_t *msg);
+static int tun_worker_bind_fwd_info(tun_dplane_shard_t *shard, fwd_info_t *fi);
+static int tun_worker_init(tun_worker_t *w, int id, tun_dplane_shard_t *shard,
+        int tun_fd, uint8_t read_tun, int (*input_cb)(sock_t *), int data_port);
+static void tun_worker_uninit(tun_worker_t *w);
+
+
+static inline void
+eventfd_notify(int fd)
+{
+    uint64_t one = 1;
+
+    if (write(fd, &one, sizeof(one)) < 0 && errno != EAGAIN){
+        OOR_LOG(LDBG_1, "eventfd_notify: write error: %s", strerror(errno));
+    }
+}
+
+static inline void
+eventfd_clear(int fd)
+{
+    uint64_t cnt;
+
+    if (read(fd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN){
+        OOR_LOG(LDBG_1, "eventfd_clear: read error: %s", strerror(errno));
+    }
+}
+
+static void
+tun_worker_msg_del(tun_worker_msg_t *msg)
+{
+    if (msg->fi){
+        fwd_info_del(msg->fi);
+    }
+    if (msg->eid){
+        lisp_addr_del(msg->eid);
+    }
+    free(msg->rlocs);
+    free(msg);
+}
+
+/* Message carrying a copy of the packet */
+static tun_worker_msg_t *
+tun_worker_msg_new_pkt(tun_worker_msg_type_e type, lbuf_t *b, packet_tuple_t *tuple)
+{
+    tun_worker_msg_t *msg;
+    uint32_t len = lbuf_size(b);
+
+    msg = xmalloc(sizeof(tun_worker_msg_t) + LBUF_STACK_OFFSET + len);
+    msg->type = type;
+    msg->tuple = *tuple;
+    msg->fi = NULL;
+    msg->eid = NULL;
+    msg->rlocs = NULL;
+    msg->nrlocs = 0;
+    lbuf_use_stack(&msg->pkt, (uint8_t *)(msg + 1), LBUF_STACK_OFFSET + len);
+    lbuf_reserve(&msg->pkt, LBUF_STACK_OFFSET);
+    lbuf_put(&msg->pkt, lbuf_data(b), len);
+    return (msg);
+}
+
+/* Called by the worker when the flow of the packet is not in its table. The
+ * packet is copied and sent to the main thread. The main thread is notified
+ * once all the packets of the batch have been processed */
+int
+tun_worker_queue_miss(tun_worker_t *w, lbuf_t *b, packet_tuple_t *tuple)
+{
+    tun_worker_msg_t *msg;
+
+    msg = tun_worker_msg_new_pkt(TUN_WMSG_MISS, b, tuple);
+    if (spsc_ring_push(w->to_ctrl, msg) != GOOD){
+        OOR_LOG(LDBG_3, "tun_worker_queue_miss: Worker %d queue full. Packet dropped", w->id);
+        w->stats.miss_drops++;
+        free(msg);
+        return (BAD);
+    }
+    w->stats.misses++;
+    w->miss_pending = TRUE;
+    return (GOOD);
+}
+
+void
+tun_worker_flush_misses(tun_worker_t *w)
+{
+    tun_dplane_data_t *data;
+
+    if (!w->miss_pending){
+        return;
+    }
+    w->miss_pending = FALSE;
+    data = tun_get_datap_data();
+    eventfd_notify(data->miss_notify_fd);
+}
+
+/* Main thread: obtain the forwarding info of the misses of all the workers and
+ * send it back to them */
+static int
+tun_workers_process_misses(sock_t *sl)
+{
+    tun_dplane_data_t *data = tun_get_datap_data();
+    tun_worker_t *w;
+    tun_worker_msg_t *msg;
+    uint8_t notify;
+    int i;
+
+    eventfd_clear(sl->fd);
+    for (i = 0; i < data->nshards; i++){
+        w = data->shards[i].worker;
+        notify = FALSE;
+        while ((msg = (tun_worker_msg_t *)spsc_ring_pop(w->to_ctrl)) != NULL){
+            msg->type = TUN_WMSG_FWD_INFO;
+            msg->fi = tun_get_fwd_info(&msg->tuple);
+            if (msg->fi && tun_fwd_info_pending(msg->fi)){
+                /* The packet waits in the main thread for the Map-Reply.
+                 * The entry is not installed in the worker, so the next
+                 * packets of the flow are also sent here */
+                tun_pending_add(msg->fi->associated_entry, &msg->pkt, &msg->tuple);
+                tun_worker_msg_del(msg);
+                continue;
+            }
+            if (spsc_ring_push(w->from_ctrl, msg) != GOOD){
+                OOR_LOG(LDBG_3, "tun_workers_process_misses: Worker %d queue full. "
+                        "Packet dropped", w->id);
+                __atomic_add_fetch(&w->stats.reply_drops, 1, __ATOMIC_RELAXED);
+                tun_worker_msg_del(msg);
+                continue;
+            }
+            notify = TRUE;
+        }
+        if (notify){
+            eventfd_notify(w->notify_fd);
+        }
+    }
+    return (GOOD);
+}
+
+/* Worker: the forwarding info built by the main thread points to the output
+ * socket of an interface. Use the copy of the worker instead */
+static int
+tun_worker_bind_fwd_info(tun_dplane_shard_t *shard, fwd_info_t *fi)
+{
+    fwd_entry_tuple_t *fe = (fwd_entry_tuple_t *)fi->dp_conf_inf;
+
+    if (!fe->srloc || !fe->drloc){
+        return (GOOD);
+    }
+    fe->out_sock = tun_shard_out_sock(shard, fe->srloc);
+    if (!fe->out_sock){
+        OOR_LOG(LDBG_3, "tun_worker_bind_fwd_info: No output socket for RLOC %s. "
+                "Packet dropped", lisp_addr_to_char(fe->srloc));
+        return (BAD);
+    }
+    return (GOOD);
+}
+
+/* Worker: process the messages received from the main thread */
+static int
+tun_worker_process_ctrl_msgs(sock_t *sl)
+{
+    tun_worker_t *w = (tun_worker_t *)sl->arg;
+    tun_dplane_shard_t *shard = w->shard;
+    tun_worker_msg_t *msg;
+    tun_out_socks_t *out_socks;
+
+    eventfd_clear(sl->fd);
+    out_socks = __atomic_exchange_n(&w->new_out_socks, NULL, __ATOMIC_ACQ_REL);
+    if (out_socks){
+        tun_shard_set_out_socks(shard, out_socks);
+    }
+    while ((msg = (tun_worker_msg_t *)spsc_ring_pop(w->from_ctrl)) != NULL){
+        switch (msg->type){
+        case TUN_WMSG_FWD_INFO:
+            if (!msg->fi || tun_worker_bind_fwd_info(shard, msg->fi) != GOOD){
+                break;
+            }
+            /* Several packets of the same flow may have missed */
+            if (!ttable_lookup(&(shard->ttable), &msg->tuple)){
+                tun_add_dp_entry(shard, msg->fi);
+                msg->fi = NULL;
+            }
+            lbuf_reset_ip(&msg->pkt);
+            tun_output(&msg->pkt, &msg->tuple);
+            w->stats.replayed++;
+            break;
+        case TUN_WMSG_RM_FWD:
+            tun_shard_rm_fwd_from_entry(shard, msg->eid, FALSE);
+            break;
+        case TUN_WMSG_UPDATE_LOCAL:
+            tun_shard_update_local_fwd(shard, msg->eid, msg->rlocs, msg->nrlocs);
+            break;
+        default:
+            break;
+        }
+        tun_worker_msg_del(msg);
+    }
+
+    if (__atomic_exchange_n(&w->reset_pending, 0, __ATOMIC_ACQ_REL)){
+        tun_shard_reset_fwd(shard);
+    }
+    tun_output_flush();
+    return (GOOD);
+}
+
+/* Main thread: send to a worker a packet that was waiting for its mapping.
+ * The worker installs the forwarding info of the flow and forwards it. The
+ * workers are notified by tun_workers_notify_all */
+int
+tun_workers_replay(tun_dplane_data_t *data, lbuf_t *b, packet_tuple_t *tuple)
+{
+    tun_worker_t *w;
+    tun_worker_msg_t *msg;
+    fwd_info_t *fi;
+
+    fi = tun_get_fwd_info(tuple);
+    if (!fi){
+        return (BAD);
+    }
+    if (tun_fwd_info_pending(fi)){
+        tun_pending_add(fi->associated_entry, b, tuple);
+        fwd_info_del(fi);
+        return (GOOD);
+    }
+    w = data->shards[pkt_tuple_hash(tuple) % data->nshards].worker;
+    msg = tun_worker_msg_new_pkt(TUN_WMSG_FWD_INFO, b, tuple);
+    msg->fi = fi;
+    if (spsc_ring_push(w->from_ctrl, msg) != GOOD){
+        OOR_LOG(LDBG_3, "tun_workers_replay: Worker %d queue full. Packet dropped",
+                w->id);
+        __atomic_add_fetch(&w->stats.reply_drops, 1, __ATOMIC_RELAXED);
+        tun_worker_msg_del(msg);
+        return (BAD);
+    }
+    return (GOOD);
+}
+
+/* Main thread: hand over to the workers a copy of the output sockets of the
+ * interfaces. A copy not taken yet by a worker is replaced */
+void
+tun_workers_set_out_socks(tun_dplane_data_t *data)
+{
+    tun_worker_t *w;
+    tun_out_socks_t *out_socks;
+    int i;
+
+    for (i = 0; i < data->nshards; i++){
+        w = data->shards[i].worker;
+        out_socks = __atomic_exchange_n(&w->new_out_socks, tun_out_socks_new(),
+                __ATOMIC_ACQ_REL);
+        tun_out_socks_del(out_socks);
+        eventfd_notify(w->notify_fd);
+    }
+}
+
+void
+tun_workers_notify_all(tun_dplane_data_t *data)
+{
+    int i;
+
+    for (i = 0; i < data->nshards; i++){
+        eventfd_notify(data->shards[i].worker->notify_fd);
+    }
+}
+
+/* Main thread: remove from all the workers the forwarding entries associated
+ * with an EID, or all of them if a local mapping changed */
+int
+tun_workers_rm_fwd_from_entry(tun_dplane_data_t *data, lisp_addr_t *eid_prefix,
+        uint8_t is_local)
+{
+    tun_worker_t *w;
+    tun_worker_msg_t *msg;
+    int i;
+
+    for (i = 0; i < data->nshards; i++){
+        w = data->shards[i].worker;
+        if (!is_local){
+            msg = xzalloc(sizeof(tun_worker_msg_t));
+            msg->type = TUN_WMSG_RM_FWD;
+            msg->eid = lisp_addr_clone(eid_prefix);
+            if (spsc_ring_push(w->from_ctrl, msg) != GOOD){
+                /* The state of the worker can not be partially updated */
+                tun_worker_msg_del(msg);
+                is_local = TRUE;
+            }
+        }
+        if (is_local){
+            __atomic_store_n(&w->reset_pending, 1, __ATOMIC_RELEASE);
+        }
+        eventfd_notify(w->notify_fd);
+    }
+    return (GOOD);
+}
+
+/* Main thread: update in all the workers the forwarding entries of a local
+ * EID whose locators changed */
+int
+tun_workers_update_local_fwd(tun_dplane_data_t *data, lisp_addr_t *eid_prefix,
+        lisp_addr_t *src_rlocs, int nrlocs)
+{
+    tun_worker_t *w;
+    tun_worker_msg_t *msg;
+    int i;
+
+    for (i = 0; i < data->nshards; i++){
+        w = data->shards[i].worker;
+        msg = xzalloc(sizeof(tun_worker_msg_t));
+        msg->type = TUN_WMSG_UPDATE_LOCAL;
+        msg->eid = lisp_addr_clone(eid_prefix);
+        msg->rlocs = xmalloc((nrlocs + 1) * sizeof(lisp_addr_t));
+        memcpy(msg->rlocs, src_rlocs, nrlocs * sizeof(lisp_addr_t));
+        msg->nrlocs = nrlocs;
+        if (spsc_ring_push(w->from_ctrl, msg) != GOOD){
+            /* The state of the worker can not be partially updated */
+            tun_worker_msg_del(msg);
+            __atomic_store_n(&w->reset_pending, 1, __ATOMIC_RELEASE);
+        }
+        eventfd_notify(w->notify_fd);
+    }
+    return (GOOD);
+}
+
+/* The flows of the shard are aged by the worker each time the clock advances a
+ * second. The epoll timeout ensures the worker wakes up at least once per
+ * second */
+static void
+tun_worker_age_flows(tun_worker_t *w)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if ((uint32_t)ts.tv_sec != w->shard->ttable.now){
+        ttable_age_flows(&(w->shard->ttable));
+    }
+}
+
+static void *
+tun_worker_run(void *arg)
+{
+    tun_worker_t *w = (tun_worker_t *)arg;
+
+    tun_thread_shard = w->shard;
+    OOR_LOG(LDBG_1, "Data plane worker %d started", w->id);
+    while (__atomic_load_n(&w->running, __ATOMIC_ACQUIRE)){
+        sockmstr_process_all(w->smaster);
+        tun_worker_age_flows(w);
+    }
+    /* The forwarding state is removed by the worker that owns it */
+    tun_shard_uninit(w->shard);
+    OOR_LOG(LDBG_1, "Data plane worker %d stopped: %"PRIu64" misses, %"PRIu64
+            " dropped, %"PRIu64" replayed, %"PRIu64" dropped after resolution",
+            w->id, w->stats.misses, w->stats.miss_drops, w->stats.replayed,
+            __atomic_load_n(&w->stats.reply_drops, __ATOMIC_RELAXED));
+    return (NULL);
+}
+
+static int
+tun_worker_init(tun_worker_t *w, int id, tun_dplane_shard_t *shard, int tun_fd,
+        uint8_t read_tun, int (*input_cb)(sock_t *), int data_port)
+{
+    int sock;
+
+    w->id = id;
+    w->shard = shard;
+    w->data_port = data_port;
+    w->running = 1;
+    w->smaster = sockmstr_create();
+    w->to_ctrl = spsc_ring_new(TUN_WORKER_RING_SIZE);
+    w->from_ctrl = spsc_ring_new(TUN_WORKER_RING_SIZE);
+    w->notify_fd = eventfd(0, EFD_NONBLOCK);
+    if (!w->smaster || !w->to_ctrl || !w->from_ctrl || w->notify_fd == -1){
+        OOR_LOG(LERR, "tun_worker_init: Couldn't allocate worker %d", id);
+        return (BAD);
+    }
+    sockmstr_register_read_listener(w->smaster, tun_worker_process_ctrl_msgs,
+            w, w->notify_fd);
+
+    tun_shard_init(shard, tun_fd, w);
+    shard->out_socks = tun_out_socks_new();
+    if (read_tun){
+        sockmstr_register_read_listener(w->smaster, tun_output_recv, NULL, tun_fd);
+    }
+
+    /* The kernel distributes the received data packets between the sockets
+     * of the workers */
+    if (default_rloc_afi != AF_INET6) {
+        sock = open_data_reuseport_input_socket(AF_INET, data_port);
+        if (sock == ERR_SOCKET){
+            return (BAD);
+        }
+        sockmstr_register_read_listener(w->smaster, input_cb, NULL, sock);
+    }
+    if (default_rloc_afi != AF_INET) {
+        sock = open_data_reuseport_input_socket(AF_INET6, data_port);
+        if (sock == ERR_SOCKET){
+            return (BAD);
+        }
+        sockmstr_register_read_listener(w->smaster, input_cb, NULL, sock);
+    }
+    return (GOOD);
+}
+
+static void
+tun_worker_uninit(tun_worker_t *w)
+{
+    tun_worker_msg_t *msg;
+
+    /* Closes the tun queue, the data sockets and the notify_fd */
+    sockmstr_destroy(w->smaster);
+    tun_out_socks_del(w->new_out_socks);
+    if (w->to_ctrl){
+        while ((msg = (tun_worker_msg_t *)spsc_ring_pop(w->to_ctrl)) != NULL){
+            tun_worker_msg_del(msg);
+        }
+        spsc_ring_del(w->to_ctrl);
+    }
+    if (w->from_ctrl){
+        while ((msg = (tun_worker_msg_t *)spsc_ring_pop(w->from_ctrl)) != NULL){
+            tun_worker_msg_del(msg);
+        }
+        spsc_ring_del(w->from_ctrl);
+    }
+}
+
+/* Start one worker per shard. The tun queue of each worker is only read when
+ * the device encapsulates traffic from local EIDs (xTR and MN) */
+int
+tun_workers_start(tun_dplane_data_t *data, int *tun_fds, uint8_t read_tun,
+        int (*input_cb)(sock_t *), int data_port)
+{
+    tun_worker_t *w;
+    sigset_t all_signals, old_signals;
+    int i, j, err;
+
+    data->miss_notify_fd = eventfd(0, EFD_NONBLOCK);
+    if (data->miss_notify_fd == -1){
+        OOR_LOG(LERR, "tun_workers_start: eventfd: %s", strerror(errno));
+        return (BAD);
+    }
+    sockmstr_register_read_listener(smaster, tun_workers_process_misses, NULL,
+            data->miss_notify_fd);
+
+    /* Signals are only handled by the main thread. The mask is inherited by
+     * the workers */
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_BLOCK, &all_signals, &old_signals);
+    for (i = 0; i < data->nshards; i++){
+        w = xzalloc(sizeof(tun_worker_t));
+        w->notify_fd = -1;
+        if (tun_worker_init(w, i, &data->shards[i], tun_fds[i], read_tun,
+                input_cb, data_port) != GOOD){
+            break;
+        }
+        err = pthread_create(&w->thread, NULL, tun_worker_run, w);
+        if (err != 0){
+            OOR_LOG(LERR, "tun_workers_start: Couldn't create worker %d: %s",
+                    i, strerror(err));
+            break;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+
+    if (i < data->nshards){
+        /* Stop the workers already running and release the failed one */
+        for (j = i + 1; j < data->nshards; j++){
+            close(tun_fds[j]);
+        }
+        data->nshards = i;
+        tun_workers_stop(data);
+        if (w->shard && w->shard->worker){
+            tun_shard_uninit(w->shard);
+        }
+        tun_worker_uninit(w);
+        free(w);
+        return (BAD);
+    }
+    OOR_LOG(LINF, "Data plane running in %d worker threads", data->nshards);
+    return (GOOD);
+}
+
+void
+tun_workers_stop(tun_dplane_data_t *data)
+{
+    tun_worker_t *w;
+    int i;
+
+    for (i = 0; i < data->nshards; i++){
+        w = data->shards[i].worker;
+        __atomic_store_n(&w->running, 0, __ATOMIC_RELEASE);
+        eventfd_notify(w->notify_fd);
+    }
+    for (i = 0; i < data->nshards; i++){
+        w = data->shards[i].worker;
+        pthread_join(w->thread, NULL);
+        tun_worker_uninit(w);
+        data->shards[i].worker = NULL;
+        free(w);
+    }
+    if (data->miss_notify_fd != -1){
+        sockmstr_unregister_read_listenedr(smaster,
+                sockmstr_register_get_by_fd(smaster, data->miss_notify_fd));
+        data->miss_notify_fd = -1;
+    }
+}
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,88 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef TUN_WORKER_H_
+#define TUN_WORKER_H_
+
+#include <pthread.h>
+#include "tun.h"
+#include "../../lib/spsc_ring.h"
+
+/* Number of messages that can be pending in each direction between a worker
+ * and the main thread. Misses that don't fit are dropped */
+#define TUN_WORKER_RING_SIZE    1024
+
+typedef struct tun_worker_stats_ {
+    uint64_t misses;        /* Packets sent to the main thread on a flow miss */
+    uint64_t miss_drops;    /* Packets dropped because the ring was full */
+    uint64_t replayed;      /* Packets forwarded once the miss was resolved */
+    /* Resolved packets dropped because the ring to the worker was full.
+     * Updated by the main thread */
+    uint64_t reply_drops;
+} tun_worker_stats_t;
+
+/* Data plane thread. It owns a shard of the forwarding state, a queue of the
+ * tun device and its own SO_REUSEPORT data sockets. Flow misses are resolved by
+ * the main thread, which is the only one accessing the control plane */
+struct tun_worker_ {
+    pthread_t           thread;
+    int                 id;
+    tun_dplane_shard_t  *shard;
+    sockmstr_t          *smaster;
+    /* eventfd used by the main thread to wake up the worker */
+    int                 notify_fd;
+    spsc_ring_t         *to_ctrl;
+    spsc_ring_t         *from_ctrl;
+    int                 running;
+    /* Set by the main thread when all the forwarding state must be removed */
+    int                 reset_pending;
+    /* Output sockets handed over by the main thread. Taken by the worker */
+    tun_out_socks_t     *new_out_socks;
+    uint8_t             miss_pending;
+    int                 data_port;
+    tun_worker_stats_t  stats;
+};
+
+int tun_workers_start(tun_dplane_data_t *data, int *tun_fds, uint8_t read_tun,
+        int (*input_cb)(sock_t *), int data_port);
+void tun_workers_stop(tun_dplane_data_t *data);
+int tun_workers_rm_fwd_from_entry(tun_dplane_data_t *data, lisp_addr_t *eid_prefix,
+        uint8_t is_local);
+int tun_workers_update_local_fwd(tun_dplane_data_t *data, lisp_addr_t *eid_prefix,
+        lisp_addr_t *src_rlocs, int nrlocs);
+int tun_worker_queue_miss(tun_worker_t *w, lbuf_t *b, packet_tuple_t *tuple);
+void tun_worker_flush_misses(tun_worker_t *w);
+int tun_workers_replay(tun_dplane_data_t *data, lbuf_t *b, packet_tuple_t *tuple);
+void tun_workers_notify_all(tun_dplane_data_t *data);
+void tun_workers_set_out_socks(tun_dplane_data_t *data);
+
+static inline int
+tun_worker_data_port(tun_worker_t *w)
+{
+    return (w->data_port);
+}
+
+#endif /* TUN_WORKER_H_ */
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
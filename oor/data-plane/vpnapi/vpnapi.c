@@ -44,6 +44,7 @@ int vpnapi_update_link(iface_t *iface, int old_iface_index, int new_iface_index,
         int status);
 int vpnapi_reset_socket(int fd, int afi);
 int vpnapi_rm_fwd_from_entry(lisp_addr_t *eid_prefix, uint8_t is_local);
+int vpnapi_update_local_fwd(lisp_addr_t *eid_prefix, glist_t *src_rlocs);
 vpnapi_data_t * vpnapi_data_new_init(oor_encap_t encap_type, int tun_socket,
         int ipv4_data_socket, int ipv6_data_socket);
 void vpnapi_data_free(vpnapi_data_t *data);
@@ -62,6 +63,7 @@ data_plane_struct_t dplane_vpnapi = {
         .datap_updated_addr = vpnapi_updated_addr,
         .datap_update_link = vpnapi_update_link,
         .datap_rm_fwd_from_entry = vpnapi_rm_fwd_from_entry,
+        .datap_update_local_fwd = vpnapi_update_local_fwd,
         .datap_reset_all_fwd = vpnapi_reset_all_fwd,
         .datap_data = NULL
 };
@@ -349,77 +351,46 @@ vpnapi_reset_socket(int fd, int afi)
 int
 vpnapi_rm_fwd_from_entry(lisp_addr_t *eid_prefix, uint8_t is_local)
 {
-    char * eid_prefix_char = lisp_addr_to_char(eid_prefix);
-    glist_t *fwd_tpl_list, *pxtr_fwd_tpl_list;
-    glist_entry_t *tpl_it;
-    fwd_info_t *fi;
     vpnapi_data_t *data = (vpnapi_data_t *)dplane_vpnapi.datap_data;
-    packet_tuple_t *tpl;
-
 
     if (is_local){
         return (vpnapi_reset_all_fwd());
     }
 
-    if (strcmp(eid_prefix_char,FULL_IPv4_ADDRESS_SPACE) == 0){ // Update of the PeTR list for IPv4 EIDs or RTR list
-        OOR_LOG(LDBG_3, "vpnapi_rm_fwd_from_entry: Removing all the forwarding entries association with the PeTRs for IPv4 EIDs");
-        pxtr_fwd_tpl_list = (glist_t *)shash_lookup(data->eid_to_dp_entries,FULL_IPv4_ADDRESS_SPACE);
-        /* Remove all the entries associated with the PxTR */
-
-        while (glist_size(pxtr_fwd_tpl_list) > 0){
-            tpl = (packet_tuple_t *)glist_first_data(pxtr_fwd_tpl_list);
-            fi = ttable_lookup(&(data->ttable), tpl);
-            // When we recurively call this function using the associated_entry we will execute "else" statement where we also
-            // update the list of entries associated with PxTR.
-            vpnapi_rm_fwd_from_entry(fi->associated_entry,is_local);
-        }
-    }else if(strcmp(eid_prefix_char,FULL_IPv6_ADDRESS_SPACE) == 0){ // Update of the PeTR list for IPv6 EIDs or RTR list
-        OOR_LOG(LDBG_3, "vpnapi_rm_fwd_from_entry: Removing all the forwarding entries association with the PeTRs for IPv6 EIDs");
-        pxtr_fwd_tpl_list = (glist_t *)shash_lookup(data->eid_to_dp_entries,FULL_IPv6_ADDRESS_SPACE);
-        /* Remove all the entries associated with the PxTR */
-
-        while (glist_size(pxtr_fwd_tpl_list) > 0){
-            tpl = (packet_tuple_t *)glist_first_data(pxtr_fwd_tpl_list);
-            fi = ttable_lookup(&(data->ttable), tpl);
-            // When we recurively call this function using the associated_entry we will execute "else" statement where we also
-            // update the list of entries associated with PxTR.
-            vpnapi_rm_fwd_from_entry(fi->associated_entry,is_local);
-        }
-    }else{
-        OOR_LOG(LDBG_3, "vpnapi_rm_fwd_from_entry: Removing all the forwarding entries association with the EID %s",eid_prefix_char);
-        fwd_tpl_list = (glist_t *)shash_lookup(data->eid_to_dp_entries,eid_prefix_char);
-        if (!fwd_tpl_list){
-            OOR_LOG(LDBG_2, "vpnapi_rm_fwd_from_entry: Entry %s not found in the shasht!",eid_prefix_char);
-            return (BAD);
-        }
-        /* Check if it is a negative entry in order to remove also from PxTRs list */
-        tpl = (packet_tuple_t *)glist_first_data(fwd_tpl_list);
-        fi = ttable_lookup(&(data->ttable), tpl);
-        if (fi->neg_map_reply_act == ACT_NATIVE_FWD){ //negative mapping
-            switch (lisp_addr_ip_afi(fi->associated_entry)){
-            case AF_INET:
-                pxtr_fwd_tpl_list = (glist_t *)shash_lookup(data->eid_to_dp_entries,FULL_IPv4_ADDRESS_SPACE);
-                break;
-            case AF_INET6:
-                pxtr_fwd_tpl_list = (glist_t *)shash_lookup(data->eid_to_dp_entries,FULL_IPv6_ADDRESS_SPACE);
-                break;
-            default:
-                OOR_LOG(LDBG_1, "vpnapi_rm_fwd_from_entry: Associated entry is not IP");
-                return (BAD);
-            }
-            glist_for_each_entry(tpl_it,fwd_tpl_list){
-                tpl = (packet_tuple_t *)glist_entry_data(tpl_it);
-                glist_remove_obj(tpl,pxtr_fwd_tpl_list);
-            }
-        }
-        /* Remove associated entry from eid_to_dp_entries */
-        shash_remove(data->eid_to_dp_entries, eid_prefix_char);
+    OOR_LOG(LDBG_3, "vpnapi_rm_fwd_from_entry: Removing all the forwarding entries association with the EID %s",
+            lisp_addr_to_char(eid_prefix));
+    if (etable_remove_eid(&(data->etable), eid_prefix) != GOOD){
+        OOR_LOG(LDBG_2, "vpnapi_rm_fwd_from_entry: No forwarding entries associated with %s",
+                lisp_addr_to_char(eid_prefix));
+        return (BAD);
     }
 
     return (GOOD);
 }
 
 
+/* The locators of a local mapping changed. Only the flows whose source RLOC is
+ * no longer in src_rlocs are removed */
+int
+vpnapi_update_local_fwd(lisp_addr_t *eid_prefix, glist_t *src_rlocs)
+{
+    vpnapi_data_t *data = (vpnapi_data_t *)dplane_vpnapi.datap_data;
+    glist_entry_t *it;
+    lisp_addr_t *rlocs;
+    uint32_t removed;
+    int nrlocs = 0;
+
+    rlocs = xmalloc((glist_size(src_rlocs) + 1) * sizeof(lisp_addr_t));
+    glist_for_each_entry(it, src_rlocs){
+        lisp_addr_copy(&rlocs[nrlocs++], (lisp_addr_t *)glist_entry_data(it));
+    }
+    removed = etable_update_local_eid(&(data->etable), eid_prefix, rlocs, nrlocs);
+    OOR_LOG(LDBG_2, "vpnapi_update_local_fwd: Local mapping %s updated. Removed %u flows",
+            lisp_addr_to_char(eid_prefix), removed);
+    free(rlocs);
+    return (GOOD);
+}
+
 /* Remove all the fwd programmed in the data plane
  * Used when a change is produced in the local mappings */
 
@@ -428,11 +399,7 @@ vpnapi_reset_all_fwd()
 {
     vpnapi_data_t *data = (vpnapi_data_t *)dplane_vpnapi.datap_data;
 
-    shash_destroy(data->eid_to_dp_entries);
-    data->eid_to_dp_entries = shash_new_managed((free_value_fn_t)glist_destroy);
-    /* Insert entry for PeTRs */
-    shash_insert(data->eid_to_dp_entries, strdup(FULL_IPv4_ADDRESS_SPACE), glist_new());
-    shash_insert(data->eid_to_dp_entries, strdup(FULL_IPv6_ADDRESS_SPACE), glist_new());
+    etable_flush(&(data->etable));
     return (GOOD);
 }
 
@@ -449,12 +416,10 @@ vpnapi_data_new_init(oor_encap_t encap_type, int tun_socket,
     data->tun_socket = tun_socket;
     data->ipv4_data_socket = ipv4_data_socket;
     data->ipv6_data_socket = ipv6_data_socket;
-    data->eid_to_dp_entries = shash_new_managed((free_value_fn_t)glist_destroy);
-    /* Insert entry for PeTRs */
-    shash_insert(data->eid_to_dp_entries, strdup(FULL_IPv4_ADDRESS_SPACE), glist_new());
-    shash_insert(data->eid_to_dp_entries, strdup(FULL_IPv6_ADDRESS_SPACE), glist_new());
-
-    ttable_init(&(data->ttable));
+    etable_init(&(data->etable), vpnapi_rm_dp_entry);
+    ttable_init(&(data->ttable), dplane_conf.flow_table_size, etable_evict_flow,
+            &(data->etable));
+    ttable_start_aging(&(data->ttable), dplane_conf.flow_idle_timeout);
     return (data);
 }
 
@@ -464,7 +429,7 @@ vpnapi_data_free(vpnapi_data_t *data)
     if (!data){
         return;
     }
-    shash_destroy(data->eid_to_dp_entries);
     ttable_uninit(&(data->ttable));
+    etable_uninit(&(data->etable));
     free(data);
 }
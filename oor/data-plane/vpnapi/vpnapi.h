@@ -21,6 +21,7 @@
 #ifndef VPN_API_H_
 #define VPN_API_H_
 
+#include "../etable.h"
 #include "../ttable.h"
 #include "../../lib/shash.h"
 
@@ -29,13 +30,14 @@ typedef struct vpnapi_data_ {
     int tun_socket;
     int ipv4_data_socket;
     int ipv6_data_socket;
-    /* < char *eid -> glist_t <fwd_info_t *>> Used to find the fwd entries to be removed
+    /* Flows of each EID prefix. Used to find the fwd entries to be removed
      * of the data plane when there is a change with the mapping of the eid */
-    shash_t *eid_to_dp_entries; //< char *eid -> glist_t <fwd_info_t *>>
+    etable_t etable;
     /* Hash table containg the forward info from a tupla */
     ttable_t ttable;
 } vpnapi_data_t;
 
 vpnapi_data_t * vpnapi_get_datap_data();
 int vpnapi_reset_all_fwd();
+void vpnapi_rm_dp_entry(fwd_info_t *fi);
 #endif /* VPN_API_H_ */
@@ -39,7 +39,6 @@ static lbuf_t pkt_buf;
 
 static int vpnapi_output_unicast(lbuf_t *b, packet_tuple_t *tuple);
 static int vpnapi_forward_native(lbuf_t *b, lisp_addr_t *dst);
-void vpnapi_rm_dp_entry(packet_tuple_t *tuple);
 
 
 static int
@@ -54,7 +53,6 @@ vpnapi_output_unicast(lbuf_t *b, packet_tuple_t *tuple)
 {
     fwd_info_t *fi;
     fwd_entry_tuple_t *fe;
-    glist_t *fwd_tuple_lst, *pxtr_fwd_tuple_list;
     vpnapi_data_t *dp_data;
     int dst_port;
     /* For xTR tuple->iid is 0 when received while for RTRs tuple->iid is the correct value */
@@ -88,41 +86,21 @@ vpnapi_output_unicast(lbuf_t *b, packet_tuple_t *tuple)
         // For RTRs iid is initialized with the right value
         //   We only support a same EID prefix per xTR
         fe->tuple->iid = iid;
-        // fe->tuple is cloned from tuple
-        if (ttable_insert(&(dp_data->ttable), fe->tuple, fi) != GOOD){
-            /* If table is full, reset the data plane */
-            vpnapi_reset_all_fwd();
-            ttable_insert(&(dp_data->ttable), fe->tuple, fi);
-        }
+        // fe->tuple is cloned from tuple. If table is full, a flow is evicted
+        ttable_insert(&(dp_data->ttable), fe->tuple, fi);
 
         /* Associate eid with fwd_info.*/
-        fwd_tuple_lst = (glist_t *)shash_lookup(dp_data->eid_to_dp_entries,lisp_addr_to_char(fi->associated_entry));
-        if (!fwd_tuple_lst){
-            fwd_tuple_lst = glist_new_managed((glist_del_fct)vpnapi_rm_dp_entry);
-            shash_insert(dp_data->eid_to_dp_entries, strdup(lisp_addr_to_char(fi->associated_entry)), fwd_tuple_lst);
-        }
-        glist_add(fe->tuple,fwd_tuple_lst);
-        OOR_LOG(LDBG_3, "vpnapi_output_unicast: The tupla [%s] has been associated with the EID %s",
-                pkt_tuple_to_char(tuple),lisp_addr_to_char(fi->associated_entry));
-
-        if(fi->neg_map_reply_act == ACT_NATIVE_FWD){ // Forwarding entry should be also associated with PeTRs list
-            switch (lisp_addr_ip_afi(fi->associated_entry)){
-            case AF_INET:
-                pxtr_fwd_tuple_list = (glist_t *)shash_lookup(dp_data->eid_to_dp_entries,FULL_IPv4_ADDRESS_SPACE);
-                break;
-            case AF_INET6:
-                pxtr_fwd_tuple_list = (glist_t *)shash_lookup(dp_data->eid_to_dp_entries,FULL_IPv6_ADDRESS_SPACE);
-                break;
-            default:
-                OOR_LOG(LDBG_3, "vpnapi_output_unicast: Forwarding to PeTR is only for IP EIDs. It should never reach here");
-                return (BAD);
-            }
-            glist_add(fe->tuple,pxtr_fwd_tuple_list);
-            OOR_LOG(LDBG_3, "  and with PeTRs");
+        if (etable_add(&(dp_data->etable), fi) == GOOD){
+            OOR_LOG(LDBG_3, "vpnapi_output_unicast: The tupla [%s] has been associated with the EID %s%s",
+                    pkt_tuple_to_char(tuple),lisp_addr_to_char(fi->associated_entry),
+                    fi->neg_map_reply_act == ACT_NATIVE_FWD ? " and with PeTRs" : "");
         }
     }else{
         fe = fi->dp_conf_inf;
     }
+    if (fi->activity){
+        mcache_activity_touch(fi->activity, dp_data->ttable.now);
+    }
 
     /* Packets with no/negative map cache entry AND no PETR
      * OR packets with missing src or dst RLOCs*/
@@ -206,9 +184,12 @@ vpnapi_send_ctrl_msg(lbuf_t *buf, uconn_t *udp_conn)
     return (BAD);
 }
 
+/* Called by the EID index to remove an invalidated flow */
 void
-vpnapi_rm_dp_entry(packet_tuple_t *tuple)
+vpnapi_rm_dp_entry(fwd_info_t *fi)
 {
     vpnapi_data_t *data = vpnapi_get_datap_data();
-    ttable_remove(&(data->ttable), tuple);
+    fwd_entry_tuple_t *fe = (fwd_entry_tuple_t *)fi->dp_conf_inf;
+
+    ttable_remove(&(data->ttable), fe->tuple);
 }
@@ -72,6 +72,12 @@ typedef struct htable_nonces_ htable_nonces_t;
 
 
 #define DEFAULT_MAP_REQUEST_RETRIES             3
+#define DEFAULT_MAP_CACHE_REFRESH               10 // % of the TTL before expiry
+#define MAX_MAP_CACHE_REFRESH                   50
+#define DEFAULT_MAP_CACHE_MAX_ENTRIES           65536
+#define DEFAULT_MAP_CACHE_MAX_MEM               0  // KB. 0 is no limit
+#define DEFAULT_MAP_CACHE_SNAPSHOT_INTERVAL     0  // Only saved on shutdown
+#define MIN_MAP_CACHE_SNAPSHOT_INTERVAL         60
 
 #define MAP_REGISTER_INTERVAL                   60
 #define MS_SITE_EXPIRATION                      180
@@ -102,6 +108,9 @@ typedef struct htable_nonces_ htable_nonces_t;
 
 #define IP6VERSION      6   /* what's the symbol? */
 #define PACKED          __attribute__ ((__packed__))
+/* Per thread storage. Used by the functions returning static buffers that can
+ * be called from the data plane worker threads */
+#define THREAD_LOCAL    __thread
 #define uchar           u_char
 
 #define UPDATED             2
@@ -30,6 +30,7 @@
 
 
 #include "sha1.h"
+#include "sha_hw.h"
 
 #include <string.h>
 
@@ -98,7 +99,8 @@ void mbedtls_sha1_starts( mbedtls_sha1_context *ctx )
 }
 
 #if !defined(MBEDTLS_SHA1_PROCESS_ALT)
-void mbedtls_sha1_process( mbedtls_sha1_context *ctx, const unsigned char data[64] )
+/* Portable compression function */
+static void sha1_process_c( uint32_t state[5], const unsigned char data[64] )
 {
     uint32_t temp, W[16], A, B, C, D, E;
 
@@ -133,11 +135,11 @@ void mbedtls_sha1_process( mbedtls_sha1_context *ctx, const unsigned char data[6
     e += S(a,5) + F(b,c,d) + K + x; b = S(b,30);        \
 }
 
-    A = ctx->state[0];
-    B = ctx->state[1];
-    C = ctx->state[2];
-    D = ctx->state[3];
-    E = ctx->state[4];
+    A = state[0];
+    B = state[1];
+    C = state[2];
+    D = state[3];
+    E = state[4];
 
 #define F(x,y,z) (z ^ (x & (y ^ z)))
 #define K 0x5A827999
@@ -247,11 +249,48 @@ void mbedtls_sha1_process( mbedtls_sha1_context *ctx, const unsigned char data[6
 #undef K
 #undef F
 
-    ctx->state[0] += A;
-    ctx->state[1] += B;
-    ctx->state[2] += C;
-    ctx->state[3] += D;
-    ctx->state[4] += E;
+    state[0] += A;
+    state[1] += B;
+    state[2] += C;
+    state[3] += D;
+    state[4] += E;
+}
+
+void mbedtls_sha1_blocks( uint32_t state[5], const unsigned char *data,
+                          size_t blocks )
+{
+    const mbedtls_sha_hw_t *hw = mbedtls_sha_hw();
+
+    if( hw != NULL && hw->sha1 != NULL )
+    {
+        hw->sha1( state, data, blocks );
+        return;
+    }
+    while( blocks-- > 0 )
+    {
+        sha1_process_c( state, data );
+        data += 64;
+    }
+}
+
+void mbedtls_sha1_blocks_x2( uint32_t state_a[5], const unsigned char *data_a,
+                             uint32_t state_b[5], const unsigned char *data_b,
+                             size_t blocks )
+{
+    const mbedtls_sha_hw_t *hw = mbedtls_sha_hw();
+
+    if( hw != NULL && hw->sha1_x2 != NULL )
+    {
+        hw->sha1_x2( state_a, data_a, state_b, data_b, blocks );
+        return;
+    }
+    mbedtls_sha1_blocks( state_a, data_a, blocks );
+    mbedtls_sha1_blocks( state_b, data_b, blocks );
+}
+
+void mbedtls_sha1_process( mbedtls_sha1_context *ctx, const unsigned char data[64] )
+{
+    mbedtls_sha1_blocks( ctx->state, data, 1 );
 }
 #endif /* !MBEDTLS_SHA1_PROCESS_ALT */
 
@@ -284,11 +323,11 @@ void mbedtls_sha1_update( mbedtls_sha1_context *ctx, const unsigned char *input,
         left = 0;
     }
 
-    while( ilen >= 64 )
+    if( ilen >= 64 )
     {
-        mbedtls_sha1_process( ctx, input );
-        input += 64;
-        ilen  -= 64;
+        mbedtls_sha1_blocks( ctx->state, input, ilen / 64 );
+        input += ilen & ~(size_t) 0x3F;
+        ilen  &= 0x3F;
     }
 
     if( ilen > 0 )
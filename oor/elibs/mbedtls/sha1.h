@@ -99,6 +99,26 @@ void mbedtls_sha1_finish( mbedtls_sha1_context *ctx, unsigned char output[20] );
 /* Internal use */
 void mbedtls_sha1_process( mbedtls_sha1_context *ctx, const unsigned char data[64] );
 
+/**
+ * \brief          Compress consecutive 64 bytes blocks into a SHA-1 state.
+ *                 Uses the SHA instructions of the CPU when available
+ *
+ * \param state    intermediate digest state
+ * \param data     blocks to process
+ * \param blocks   number of blocks
+ */
+void mbedtls_sha1_blocks( uint32_t state[5], const unsigned char *data,
+                          size_t blocks );
+
+/**
+ * \brief          Compress two independent streams with the same number of
+ *                 blocks. Faster than two calls to mbedtls_sha1_blocks when
+ *                 the rounds of both streams can be interleaved
+ */
+void mbedtls_sha1_blocks_x2( uint32_t state_a[5], const unsigned char *data_a,
+                             uint32_t state_b[5], const unsigned char *data_b,
+                             size_t blocks );
+
 #ifdef __cplusplus
 }
 #endif
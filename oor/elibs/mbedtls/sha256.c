@@ -30,6 +30,7 @@
 
 
 #include "sha256.h"
+#include "sha_hw.h"
 
 #include <string.h>
 
@@ -166,14 +167,15 @@ static const uint32_t K[] =
     d += temp1; h = temp1 + temp2;              \
 }
 
-void mbedtls_sha256_process( mbedtls_sha256_context *ctx, const unsigned char data[64] )
+/* Portable compression function */
+static void sha256_process_c( uint32_t state[8], const unsigned char data[64] )
 {
     uint32_t temp1, temp2, W[64];
     uint32_t A[8];
     unsigned int i;
 
     for( i = 0; i < 8; i++ )
-        A[i] = ctx->state[i];
+        A[i] = state[i];
 
 #if defined(MBEDTLS_SHA256_SMALLER)
     for( i = 0; i < 64; i++ )
@@ -218,7 +220,44 @@ void mbedtls_sha256_process( mbedtls_sha256_context *ctx, const unsigned char da
 #endif /* MBEDTLS_SHA256_SMALLER */
 
     for( i = 0; i < 8; i++ )
-        ctx->state[i] += A[i];
+        state[i] += A[i];
+}
+
+void mbedtls_sha256_blocks( uint32_t state[8], const unsigned char *data,
+                            size_t blocks )
+{
+    const mbedtls_sha_hw_t *hw = mbedtls_sha_hw();
+
+    if( hw != NULL && hw->sha256 != NULL )
+    {
+        hw->sha256( state, data, blocks );
+        return;
+    }
+    while( blocks-- > 0 )
+    {
+        sha256_process_c( state, data );
+        data += 64;
+    }
+}
+
+void mbedtls_sha256_blocks_x2( uint32_t state_a[8], const unsigned char *data_a,
+                               uint32_t state_b[8], const unsigned char *data_b,
+                               size_t blocks )
+{
+    const mbedtls_sha_hw_t *hw = mbedtls_sha_hw();
+
+    if( hw != NULL && hw->sha256_x2 != NULL )
+    {
+        hw->sha256_x2( state_a, data_a, state_b, data_b, blocks );
+        return;
+    }
+    mbedtls_sha256_blocks( state_a, data_a, blocks );
+    mbedtls_sha256_blocks( state_b, data_b, blocks );
+}
+
+void mbedtls_sha256_process( mbedtls_sha256_context *ctx, const unsigned char data[64] )
+{
+    mbedtls_sha256_blocks( ctx->state, data, 1 );
 }
 #endif /* !MBEDTLS_SHA256_PROCESS_ALT */
 
@@ -252,11 +291,11 @@ void mbedtls_sha256_update( mbedtls_sha256_context *ctx, const unsigned char *in
         left = 0;
     }
 
-    while( ilen >= 64 )
+    if( ilen >= 64 )
     {
-        mbedtls_sha256_process( ctx, input );
-        input += 64;
-        ilen  -= 64;
+        mbedtls_sha256_blocks( ctx->state, input, ilen / 64 );
+        input += ilen & ~(size_t) 0x3F;
+        ilen  &= 0x3F;
     }
 
     if( ilen > 0 )
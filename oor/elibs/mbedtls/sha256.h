@@ -103,6 +103,26 @@ void mbedtls_sha256_finish( mbedtls_sha256_context *ctx, unsigned char output[32
 /* Internal use */
 void mbedtls_sha256_process( mbedtls_sha256_context *ctx, const unsigned char data[64] );
 
+/**
+ * \brief          Compress consecutive 64 bytes blocks into a SHA-256 state.
+ *                 Uses the SHA instructions of the CPU when available
+ *
+ * \param state    intermediate digest state
+ * \param data     blocks to process
+ * \param blocks   number of blocks
+ */
+void mbedtls_sha256_blocks( uint32_t state[8], const unsigned char *data,
+                            size_t blocks );
+
+/**
+ * \brief          Compress two independent streams with the same number of
+ *                 blocks. Faster than two calls to mbedtls_sha256_blocks when
+ *                 the rounds of both streams can be interleaved
+ */
+void mbedtls_sha256_blocks_x2( uint32_t state_a[8], const unsigned char *data_a,
+                               uint32_t state_b[8], const unsigned char *data_b,
+                               size_t blocks );
+
 #ifdef __cplusplus
 }
 #endif
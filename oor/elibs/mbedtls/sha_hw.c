@@ -0,0 +1,691 @@
+/*
+ *  SHA-1 and SHA-256 compression functions using the SHA instructions
+ *  of the CPU (x86 SHA extensions and ARMv8 cryptography extensions)
+ *
+ *  Copyright (C) 2015 Cisco Systems, Inc.
+ *  Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+/*
+ *  The kernels are compiled with per function target attributes, so the
+ *  rest of the code doesn't need to be built for a CPU with SHA
+ *  instructions. The CPU is probed at run time and the portable code of
+ *  sha1.c and sha256.c is used when the instructions are not available.
+ */
+
+#include "sha_hw.h"
+
+#include <string.h>
+
+#if ( defined(__x86_64__) || defined(__i386__) ) && \
+    ( defined(__clang__) || ( defined(__GNUC__) && __GNUC__ >= 5 ) )
+#define SHA_HW_X86
+#endif
+
+#if defined(__aarch64__) && defined(__linux__) && \
+    ( defined(__ARM_FEATURE_CRYPTO) || \
+      ( defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 6 ) )
+#define SHA_HW_ARM64
+#endif
+
+#if defined(SHA_HW_X86)
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA_X86_TARGET  __attribute__((target("sha,sse4.1,ssse3")))
+#endif
+
+#if defined(SHA_HW_ARM64)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#if defined(__ARM_FEATURE_CRYPTO)
+#define SHA_ARM_TARGET
+#else
+#define SHA_ARM_TARGET  __attribute__((target("+crypto")))
+#endif
+#endif
+
+#if defined(SHA_HW_X86) || defined(SHA_HW_ARM64)
+static const uint32_t sha256_k[64] =
+{
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5,
+    0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+    0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC,
+    0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7,
+    0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
+    0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3,
+    0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5,
+    0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
+    0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+#endif
+
+#if defined(SHA_HW_X86)
+/*
+ * x86 SHA extensions. The words of the message schedule are kept in four
+ * registers (w0..w3) that are rotated on each group of four rounds.
+ */
+
+#define SHA1_NI_LOAD( w, i )                                            \
+    w = _mm_shuffle_epi8( _mm_loadu_si128(                              \
+            (const __m128i *) ( data + 16 * ( i ) ) ), mask )
+
+#define SHA1_NI_QROUND( ecur, eoth, w, f )                              \
+    ecur = _mm_sha1nexte_epu32( ecur, w );                              \
+    eoth = abcd;                                                        \
+    abcd = _mm_sha1rnds4_epu32( abcd, ecur, f )
+
+#define SHA1_NI_STEP( ecur, eoth, wa, wb, wc, wd, f )                   \
+    SHA1_NI_QROUND( ecur, eoth, wa, f );                                \
+    wb = _mm_sha1msg2_epu32( wb, wa );                                  \
+    wd = _mm_sha1msg1_epu32( wd, wa );                                  \
+    wc = _mm_xor_si128( wc, wa )
+
+static inline __attribute__((always_inline)) SHA_X86_TARGET void
+sha1_ni_block( __m128i *pabcd, __m128i *pe0, const unsigned char *data )
+{
+    const __m128i mask = _mm_set_epi64x( 0x0001020304050607ULL,
+                                         0x08090a0b0c0d0e0fULL );
+    __m128i abcd, abcd_save, e0, e0_save, e1, w0, w1, w2, w3;
+
+    abcd = abcd_save = *pabcd;
+    e0 = e0_save = *pe0;
+
+    SHA1_NI_LOAD( w0, 0 );
+    e0 = _mm_add_epi32( e0, w0 );
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32( abcd, e0, 0 );
+
+    SHA1_NI_LOAD( w1, 1 );
+    SHA1_NI_QROUND( e1, e0, w1, 0 );
+    w0 = _mm_sha1msg1_epu32( w0, w1 );
+
+    SHA1_NI_LOAD( w2, 2 );
+    SHA1_NI_QROUND( e0, e1, w2, 0 );
+    w1 = _mm_sha1msg1_epu32( w1, w2 );
+    w0 = _mm_xor_si128( w0, w2 );
+
+    SHA1_NI_LOAD( w3, 3 );
+    SHA1_NI_STEP( e1, e0, w3, w0, w1, w2, 0 );
+    SHA1_NI_STEP( e0, e1, w0, w1, w2, w3, 0 );
+    SHA1_NI_STEP( e1, e0, w1, w2, w3, w0, 1 );
+    SHA1_NI_STEP( e0, e1, w2, w3, w0, w1, 1 );
+    SHA1_NI_STEP( e1, e0, w3, w0, w1, w2, 1 );
+    SHA1_NI_STEP( e0, e1, w0, w1, w2, w3, 1 );
+    SHA1_NI_STEP( e1, e0, w1, w2, w3, w0, 1 );
+    SHA1_NI_STEP( e0, e1, w2, w3, w0, w1, 2 );
+    SHA1_NI_STEP( e1, e0, w3, w0, w1, w2, 2 );
+    SHA1_NI_STEP( e0, e1, w0, w1, w2, w3, 2 );
+    SHA1_NI_STEP( e1, e0, w1, w2, w3, w0, 2 );
+    SHA1_NI_STEP( e0, e1, w2, w3, w0, w1, 2 );
+    SHA1_NI_STEP( e1, e0, w3, w0, w1, w2, 3 );
+    SHA1_NI_STEP( e0, e1, w0, w1, w2, w3, 3 );
+
+    SHA1_NI_QROUND( e1, e0, w1, 3 );
+    w2 = _mm_sha1msg2_epu32( w2, w1 );
+    w3 = _mm_xor_si128( w3, w1 );
+
+    SHA1_NI_QROUND( e0, e1, w2, 3 );
+    w3 = _mm_sha1msg2_epu32( w3, w2 );
+
+    SHA1_NI_QROUND( e1, e0, w3, 3 );
+
+    *pe0 = _mm_sha1nexte_epu32( e0, e0_save );
+    *pabcd = _mm_add_epi32( abcd, abcd_save );
+}
+
+static inline __attribute__((always_inline)) SHA_X86_TARGET void
+sha1_ni_load( const uint32_t *state, __m128i *abcd, __m128i *e0 )
+{
+    *abcd = _mm_shuffle_epi32(
+            _mm_loadu_si128( (const __m128i *) state ), 0x1B );
+    *e0 = _mm_set_epi32( (int) state[4], 0, 0, 0 );
+}
+
+static inline __attribute__((always_inline)) SHA_X86_TARGET void
+sha1_ni_store( uint32_t *state, __m128i abcd, __m128i e0 )
+{
+    _mm_storeu_si128( (__m128i *) state, _mm_shuffle_epi32( abcd, 0x1B ) );
+    state[4] = (uint32_t) _mm_extract_epi32( e0, 3 );
+}
+
+static SHA_X86_TARGET void
+sha1_ni_blocks( uint32_t *state, const unsigned char *data, size_t blocks )
+{
+    __m128i abcd, e0;
+
+    sha1_ni_load( state, &abcd, &e0 );
+    while( blocks-- > 0 )
+    {
+        sha1_ni_block( &abcd, &e0, data );
+        data += 64;
+    }
+    sha1_ni_store( state, abcd, e0 );
+}
+
+static SHA_X86_TARGET void
+sha1_ni_blocks_x2( uint32_t *state_a, const unsigned char *data_a,
+                   uint32_t *state_b, const unsigned char *data_b,
+                   size_t blocks )
+{
+    __m128i abcd_a, e0_a, abcd_b, e0_b;
+
+    sha1_ni_load( state_a, &abcd_a, &e0_a );
+    sha1_ni_load( state_b, &abcd_b, &e0_b );
+    while( blocks-- > 0 )
+    {
+        sha1_ni_block( &abcd_a, &e0_a, data_a );
+        sha1_ni_block( &abcd_b, &e0_b, data_b );
+        data_a += 64;
+        data_b += 64;
+    }
+    sha1_ni_store( state_a, abcd_a, e0_a );
+    sha1_ni_store( state_b, abcd_b, e0_b );
+}
+
+#define SHA256_NI_LOAD( w, i )                                          \
+    w = _mm_shuffle_epi8( _mm_loadu_si128(                              \
+            (const __m128i *) ( data + 16 * ( i ) ) ), mask )
+
+#define SHA256_NI_QROUND( k, w )                                        \
+    msg = _mm_add_epi32( w,                                             \
+            _mm_loadu_si128( (const __m128i *) &sha256_k[k] ) );        \
+    s1 = _mm_sha256rnds2_epu32( s1, s0, msg );                          \
+    msg = _mm_shuffle_epi32( msg, 0x0E );                               \
+    s0 = _mm_sha256rnds2_epu32( s0, s1, msg )
+
+#define SHA256_NI_SCHED( wa, wb, wd )                                   \
+    wb = _mm_sha256msg2_epu32(                                          \
+            _mm_add_epi32( wb, _mm_alignr_epi8( wa, wd, 4 ) ), wa )
+
+#define SHA256_NI_STEP( k, wa, wb, wd )                                 \
+    SHA256_NI_QROUND( k, wa );                                          \
+    SHA256_NI_SCHED( wa, wb, wd );                                      \
+    wd = _mm_sha256msg1_epu32( wd, wa )
+
+/* s0 holds ABEF and s1 CDGH, the layout used by sha256rnds2 */
+static inline __attribute__((always_inline)) SHA_X86_TARGET void
+sha256_ni_block( __m128i *ps0, __m128i *ps1, const unsigned char *data )
+{
+    const __m128i mask = _mm_set_epi64x( 0x0c0d0e0f08090a0bULL,
+                                         0x0405060700010203ULL );
+    __m128i s0, s1, msg, w0, w1, w2, w3;
+
+    s0 = *ps0;
+    s1 = *ps1;
+
+    SHA256_NI_LOAD( w0, 0 );
+    SHA256_NI_QROUND( 0, w0 );
+
+    SHA256_NI_LOAD( w1, 1 );
+    SHA256_NI_QROUND( 4, w1 );
+    w0 = _mm_sha256msg1_epu32( w0, w1 );
+
+    SHA256_NI_LOAD( w2, 2 );
+    SHA256_NI_QROUND( 8, w2 );
+    w1 = _mm_sha256msg1_epu32( w1, w2 );
+
+    SHA256_NI_LOAD( w3, 3 );
+    SHA256_NI_STEP( 12, w3, w0, w2 );
+    SHA256_NI_STEP( 16, w0, w1, w3 );
+    SHA256_NI_STEP( 20, w1, w2, w0 );
+    SHA256_NI_STEP( 24, w2, w3, w1 );
+    SHA256_NI_STEP( 28, w3, w0, w2 );
+    SHA256_NI_STEP( 32, w0, w1, w3 );
+    SHA256_NI_STEP( 36, w1, w2, w0 );
+    SHA256_NI_STEP( 40, w2, w3, w1 );
+    SHA256_NI_STEP( 44, w3, w0, w2 );
+    SHA256_NI_STEP( 48, w0, w1, w3 );
+
+    SHA256_NI_QROUND( 52, w1 );
+    SHA256_NI_SCHED( w1, w2, w0 );
+
+    SHA256_NI_QROUND( 56, w2 );
+    SHA256_NI_SCHED( w2, w3, w1 );
+
+    SHA256_NI_QROUND( 60, w3 );
+
+    *ps0 = _mm_add_epi32( s0, *ps0 );
+    *ps1 = _mm_add_epi32( s1, *ps1 );
+}
+
+static inline __attribute__((always_inline)) SHA_X86_TARGET void
+sha256_ni_load( const uint32_t *state, __m128i *s0, __m128i *s1 )
+{
+    __m128i tmp;
+
+    tmp = _mm_shuffle_epi32(
+            _mm_loadu_si128( (const __m128i *) &state[0] ), 0xB1 );
+    *s1 = _mm_shuffle_epi32(
+            _mm_loadu_si128( (const __m128i *) &state[4] ), 0x1B );
+    *s0 = _mm_alignr_epi8( tmp, *s1, 8 );
+    *s1 = _mm_blend_epi16( *s1, tmp, 0xF0 );
+}
+
+static inline __attribute__((always_inline)) SHA_X86_TARGET void
+sha256_ni_store( uint32_t *state, __m128i s0, __m128i s1 )
+{
+    __m128i tmp;
+
+    tmp = _mm_shuffle_epi32( s0, 0x1B );
+    s1 = _mm_shuffle_epi32( s1, 0xB1 );
+    _mm_storeu_si128( (__m128i *) &state[0], _mm_blend_epi16( tmp, s1, 0xF0 ) );
+    _mm_storeu_si128( (__m128i *) &state[4], _mm_alignr_epi8( s1, tmp, 8 ) );
+}
+
+static SHA_X86_TARGET void
+sha256_ni_blocks( uint32_t *state, const unsigned char *data, size_t blocks )
+{
+    __m128i s0, s1;
+
+    sha256_ni_load( state, &s0, &s1 );
+    while( blocks-- > 0 )
+    {
+        sha256_ni_block( &s0, &s1, data );
+        data += 64;
+    }
+    sha256_ni_store( state, s0, s1 );
+}
+
+static SHA_X86_TARGET void
+sha256_ni_blocks_x2( uint32_t *state_a, const unsigned char *data_a,
+                     uint32_t *state_b, const unsigned char *data_b,
+                     size_t blocks )
+{
+    __m128i s0_a, s1_a, s0_b, s1_b;
+
+    sha256_ni_load( state_a, &s0_a, &s1_a );
+    sha256_ni_load( state_b, &s0_b, &s1_b );
+    while( blocks-- > 0 )
+    {
+        sha256_ni_block( &s0_a, &s1_a, data_a );
+        sha256_ni_block( &s0_b, &s1_b, data_b );
+        data_a += 64;
+        data_b += 64;
+    }
+    sha256_ni_store( state_a, s0_a, s1_a );
+    sha256_ni_store( state_b, s0_b, s1_b );
+}
+
+static const mbedtls_sha_hw_t sha_hw_x86 =
+{
+    "x86 SHA extensions",
+    sha1_ni_blocks,
+    sha1_ni_blocks_x2,
+    sha256_ni_blocks,
+    sha256_ni_blocks_x2
+};
+
+static const mbedtls_sha_hw_t *sha_hw_cpu( void )
+{
+    unsigned int a, b, c, d;
+
+    /* SSSE3 and SSE4.1 are used to load and store the state */
+    if( __get_cpuid( 1, &a, &b, &c, &d ) == 0 ||
+        ( c & ( 1u << 9 ) ) == 0 || ( c & ( 1u << 19 ) ) == 0 )
+        return( NULL );
+    if( __get_cpuid_max( 0, NULL ) < 7 )
+        return( NULL );
+    __cpuid_count( 7, 0, a, b, c, d );
+    if( ( b & ( 1u << 29 ) ) == 0 )
+        return( NULL );
+
+    return( &sha_hw_x86 );
+}
+#endif /* SHA_HW_X86 */
+
+#if defined(SHA_HW_ARM64)
+/*
+ * ARMv8 cryptography extensions. SHA-1 and SHA-256 are reported separately
+ * by the kernel, so one of them may not be available.
+ */
+
+#define SHA_CE_LOAD( w, i )                                             \
+    w = vreinterpretq_u32_u8( vrev32q_u8( vld1q_u8( data + 16 * ( i ) ) ) )
+
+#define SHA1_CE_QROUND( op, ecur, enext, w, k )                         \
+    wk = vaddq_u32( w, vdupq_n_u32( k ) );                              \
+    enext = vsha1h_u32( vgetq_lane_u32( abcd, 0 ) );                    \
+    abcd = op( abcd, ecur, wk )
+
+#define SHA1_CE_STEP( op, ecur, enext, wa, wb, wc, wd, k )              \
+    SHA1_CE_QROUND( op, ecur, enext, wa, k );                           \
+    wa = vsha1su1q_u32( vsha1su0q_u32( wa, wb, wc ), wd )
+
+#define SHA1_K0     0x5A827999
+#define SHA1_K1     0x6ED9EBA1
+#define SHA1_K2     0x8F1BBCDC
+#define SHA1_K3     0xCA62C1D6
+
+static inline __attribute__((always_inline)) SHA_ARM_TARGET void
+sha1_ce_block( uint32x4_t *pabcd, uint32_t *pe0, const unsigned char *data )
+{
+    uint32x4_t abcd, wk, w0, w1, w2, w3;
+    uint32_t e0, e1;
+
+    abcd = *pabcd;
+    e0 = *pe0;
+
+    SHA_CE_LOAD( w0, 0 );
+    SHA_CE_LOAD( w1, 1 );
+    SHA_CE_LOAD( w2, 2 );
+    SHA_CE_LOAD( w3, 3 );
+
+    SHA1_CE_STEP( vsha1cq_u32, e0, e1, w0, w1, w2, w3, SHA1_K0 );
+    SHA1_CE_STEP( vsha1cq_u32, e1, e0, w1, w2, w3, w0, SHA1_K0 );
+    SHA1_CE_STEP( vsha1cq_u32, e0, e1, w2, w3, w0, w1, SHA1_K0 );
+    SHA1_CE_STEP( vsha1cq_u32, e1, e0, w3, w0, w1, w2, SHA1_K0 );
+    SHA1_CE_STEP( vsha1cq_u32, e0, e1, w0, w1, w2, w3, SHA1_K0 );
+    SHA1_CE_STEP( vsha1pq_u32, e1, e0, w1, w2, w3, w0, SHA1_K1 );
+    SHA1_CE_STEP( vsha1pq_u32, e0, e1, w2, w3, w0, w1, SHA1_K1 );
+    SHA1_CE_STEP( vsha1pq_u32, e1, e0, w3, w0, w1, w2, SHA1_K1 );
+    SHA1_CE_STEP( vsha1pq_u32, e0, e1, w0, w1, w2, w3, SHA1_K1 );
+    SHA1_CE_STEP( vsha1pq_u32, e1, e0, w1, w2, w3, w0, SHA1_K1 );
+    SHA1_CE_STEP( vsha1mq_u32, e0, e1, w2, w3, w0, w1, SHA1_K2 );
+    SHA1_CE_STEP( vsha1mq_u32, e1, e0, w3, w0, w1, w2, SHA1_K2 );
+    SHA1_CE_STEP( vsha1mq_u32, e0, e1, w0, w1, w2, w3, SHA1_K2 );
+    SHA1_CE_STEP( vsha1mq_u32, e1, e0, w1, w2, w3, w0, SHA1_K2 );
+    SHA1_CE_STEP( vsha1mq_u32, e0, e1, w2, w3, w0, w1, SHA1_K2 );
+    SHA1_CE_STEP( vsha1pq_u32, e1, e0, w3, w0, w1, w2, SHA1_K3 );
+    SHA1_CE_QROUND( vsha1pq_u32, e0, e1, w0, SHA1_K3 );
+    SHA1_CE_QROUND( vsha1pq_u32, e1, e0, w1, SHA1_K3 );
+    SHA1_CE_QROUND( vsha1pq_u32, e0, e1, w2, SHA1_K3 );
+    SHA1_CE_QROUND( vsha1pq_u32, e1, e0, w3, SHA1_K3 );
+
+    *pabcd = vaddq_u32( abcd, *pabcd );
+    *pe0 += e0;
+}
+
+static SHA_ARM_TARGET void
+sha1_ce_blocks( uint32_t *state, const unsigned char *data, size_t blocks )
+{
+    uint32x4_t abcd = vld1q_u32( state );
+    uint32_t e0 = state[4];
+
+    while( blocks-- > 0 )
+    {
+        sha1_ce_block( &abcd, &e0, data );
+        data += 64;
+    }
+    vst1q_u32( state, abcd );
+    state[4] = e0;
+}
+
+static SHA_ARM_TARGET void
+sha1_ce_blocks_x2( uint32_t *state_a, const unsigned char *data_a,
+                   uint32_t *state_b, const unsigned char *data_b,
+                   size_t blocks )
+{
+    uint32x4_t abcd_a = vld1q_u32( state_a ), abcd_b = vld1q_u32( state_b );
+    uint32_t e0_a = state_a[4], e0_b = state_b[4];
+
+    while( blocks-- > 0 )
+    {
+        sha1_ce_block( &abcd_a, &e0_a, data_a );
+        sha1_ce_block( &abcd_b, &e0_b, data_b );
+        data_a += 64;
+        data_b += 64;
+    }
+    vst1q_u32( state_a, abcd_a );
+    state_a[4] = e0_a;
+    vst1q_u32( state_b, abcd_b );
+    state_b[4] = e0_b;
+}
+
+#define SHA256_CE_QROUND( k, w )                                        \
+    wk = vaddq_u32( w, vld1q_u32( &sha256_k[k] ) );                     \
+    tmp = s0;                                                           \
+    s0 = vsha256hq_u32( s0, s1, wk );                                   \
+    s1 = vsha256h2q_u32( s1, tmp, wk )
+
+#define SHA256_CE_STEP( k, wa, wb, wc, wd )                             \
+    SHA256_CE_QROUND( k, wa );                                          \
+    wa = vsha256su1q_u32( vsha256su0q_u32( wa, wb ), wc, wd )
+
+static inline __attribute__((always_inline)) SHA_ARM_TARGET void
+sha256_ce_block( uint32x4_t *ps0, uint32x4_t *ps1, const unsigned char *data )
+{
+    uint32x4_t s0, s1, tmp, wk, w0, w1, w2, w3;
+
+    s0 = *ps0;
+    s1 = *ps1;
+
+    SHA_CE_LOAD( w0, 0 );
+    SHA_CE_LOAD( w1, 1 );
+    SHA_CE_LOAD( w2, 2 );
+    SHA_CE_LOAD( w3, 3 );
+
+    SHA256_CE_STEP(  0, w0, w1, w2, w3 );
+    SHA256_CE_STEP(  4, w1, w2, w3, w0 );
+    SHA256_CE_STEP(  8, w2, w3, w0, w1 );
+    SHA256_CE_STEP( 12, w3, w0, w1, w2 );
+    SHA256_CE_STEP( 16, w0, w1, w2, w3 );
+    SHA256_CE_STEP( 20, w1, w2, w3, w0 );
+    SHA256_CE_STEP( 24, w2, w3, w0, w1 );
+    SHA256_CE_STEP( 28, w3, w0, w1, w2 );
+    SHA256_CE_STEP( 32, w0, w1, w2, w3 );
+    SHA256_CE_STEP( 36, w1, w2, w3, w0 );
+    SHA256_CE_STEP( 40, w2, w3, w0, w1 );
+    SHA256_CE_STEP( 44, w3, w0, w1, w2 );
+    SHA256_CE_QROUND( 48, w0 );
+    SHA256_CE_QROUND( 52, w1 );
+    SHA256_CE_QROUND( 56, w2 );
+    SHA256_CE_QROUND( 60, w3 );
+
+    *ps0 = vaddq_u32( s0, *ps0 );
+    *ps1 = vaddq_u32( s1, *ps1 );
+}
+
+static SHA_ARM_TARGET void
+sha256_ce_blocks( uint32_t *state, const unsigned char *data, size_t blocks )
+{
+    uint32x4_t s0 = vld1q_u32( &state[0] ), s1 = vld1q_u32( &state[4] );
+
+    while( blocks-- > 0 )
+    {
+        sha256_ce_block( &s0, &s1, data );
+        data += 64;
+    }
+    vst1q_u32( &state[0], s0 );
+    vst1q_u32( &state[4], s1 );
+}
+
+static SHA_ARM_TARGET void
+sha256_ce_blocks_x2( uint32_t *state_a, const unsigned char *data_a,
+                     uint32_t *state_b, const unsigned char *data_b,
+                     size_t blocks )
+{
+    uint32x4_t s0_a = vld1q_u32( &state_a[0] ), s1_a = vld1q_u32( &state_a[4] );
+    uint32x4_t s0_b = vld1q_u32( &state_b[0] ), s1_b = vld1q_u32( &state_b[4] );
+
+    while( blocks-- > 0 )
+    {
+        sha256_ce_block( &s0_a, &s1_a, data_a );
+        sha256_ce_block( &s0_b, &s1_b, data_b );
+        data_a += 64;
+        data_b += 64;
+    }
+    vst1q_u32( &state_a[0], s0_a );
+    vst1q_u32( &state_a[4], s1_a );
+    vst1q_u32( &state_b[0], s0_b );
+    vst1q_u32( &state_b[4], s1_b );
+}
+
+static mbedtls_sha_hw_t sha_hw_arm64 =
+{
+    "ARMv8 crypto extensions", NULL, NULL, NULL, NULL
+};
+
+static const mbedtls_sha_hw_t *sha_hw_cpu( void )
+{
+    unsigned long hwcap = getauxval( AT_HWCAP );
+
+    if( hwcap & HWCAP_SHA1 )
+    {
+        sha_hw_arm64.sha1 = sha1_ce_blocks;
+        sha_hw_arm64.sha1_x2 = sha1_ce_blocks_x2;
+    }
+    if( hwcap & HWCAP_SHA2 )
+    {
+        sha_hw_arm64.sha256 = sha256_ce_blocks;
+        sha_hw_arm64.sha256_x2 = sha256_ce_blocks_x2;
+    }
+    if( sha_hw_arm64.sha1 == NULL && sha_hw_arm64.sha256 == NULL )
+        return( NULL );
+
+    return( &sha_hw_arm64 );
+}
+#endif /* SHA_HW_ARM64 */
+
+#if !defined(SHA_HW_X86) && !defined(SHA_HW_ARM64)
+static const mbedtls_sha_hw_t *sha_hw_cpu( void )
+{
+    return( NULL );
+}
+#endif
+
+/*
+ * Known answers: "abc", "" and the two blocks message of FIPS 180-2
+ */
+static const char sha_hw_kat_msg[] =
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+
+static const uint32_t sha1_kat_iv[5] =
+{
+    0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+};
+
+static const uint32_t sha1_kat[3][5] =
+{
+    { 0xA9993E36, 0x4706816A, 0xBA3E2571, 0x7850C26C, 0x9CD0D89D },
+    { 0xDA39A3EE, 0x5E6B4B0D, 0x3255BFEF, 0x95601890, 0xAFD80709 },
+    { 0x84983E44, 0x1C3BD26E, 0xBAAE4AA1, 0xF95129E5, 0xE54670F1 }
+};
+
+static const uint32_t sha256_kat_iv[8] =
+{
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+    0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+static const uint32_t sha256_kat[3][8] =
+{
+    { 0xBA7816BF, 0x8F01CFEA, 0x414140DE, 0x5DAE2223,
+      0xB00361A3, 0x96177A9C, 0xB410FF61, 0xF20015AD },
+    { 0xE3B0C442, 0x98FC1C14, 0x9AFBF4C8, 0x996FB924,
+      0x27AE41E4, 0x649B934C, 0xA495991B, 0x7852B855 },
+    { 0x248D6A61, 0xD20638B8, 0xE5C02693, 0x0C3E6039,
+      0xA33CE459, 0x64FF2167, 0xF6ECEDD4, 0x19DB06C1 }
+};
+
+static int sha_hw_kat( mbedtls_sha_blocks_t fn, mbedtls_sha_blocks_x2_t fn_x2,
+                       const uint32_t *iv, const uint32_t kat[3][8],
+                       size_t words, const unsigned char *abc,
+                       const unsigned char *empty, const unsigned char *two )
+{
+    uint32_t a[8], b[8];
+    size_t len = words * sizeof( uint32_t );
+
+    memcpy( a, iv, len );
+    fn( a, abc, 1 );
+    if( memcmp( a, kat[0], len ) != 0 )
+        return( -1 );
+
+    memcpy( a, iv, len );
+    fn( a, two, 2 );
+    if( memcmp( a, kat[2], len ) != 0 )
+        return( -1 );
+
+    memcpy( a, iv, len );
+    memcpy( b, iv, len );
+    fn_x2( a, abc, b, empty, 1 );
+    if( memcmp( a, kat[0], len ) != 0 || memcmp( b, kat[1], len ) != 0 )
+        return( -1 );
+
+    memcpy( a, iv, len );
+    memcpy( b, iv, len );
+    fn_x2( a, two, b, two, 2 );
+    if( memcmp( a, kat[2], len ) != 0 || memcmp( b, kat[2], len ) != 0 )
+        return( -1 );
+
+    return( 0 );
+}
+
+static int sha_hw_self_test( const mbedtls_sha_hw_t *hw )
+{
+    unsigned char abc[64], empty[64], two[128];
+    uint32_t sha1_kat8[3][8];
+    int i;
+
+    memset( abc, 0, sizeof( abc ) );
+    memcpy( abc, "abc", 3 );
+    abc[3] = 0x80;
+    abc[63] = 3 * 8;
+
+    memset( empty, 0, sizeof( empty ) );
+    empty[0] = 0x80;
+
+    memset( two, 0, sizeof( two ) );
+    memcpy( two, sha_hw_kat_msg, 56 );
+    two[56] = 0x80;
+    two[126] = ( 56 * 8 ) >> 8;
+    two[127] = ( 56 * 8 ) & 0xFF;
+
+    for( i = 0; i < 3; i++ )
+        memcpy( sha1_kat8[i], sha1_kat[i], sizeof( sha1_kat[i] ) );
+
+    if( hw->sha1 != NULL &&
+        sha_hw_kat( hw->sha1, hw->sha1_x2, sha1_kat_iv, sha1_kat8, 5,
+                    abc, empty, two ) != 0 )
+        return( -1 );
+    if( hw->sha256 != NULL &&
+        sha_hw_kat( hw->sha256, hw->sha256_x2, sha256_kat_iv, sha256_kat, 8,
+                    abc, empty, two ) != 0 )
+        return( -1 );
+
+    return( 0 );
+}
+
+static const mbedtls_sha_hw_t *sha_hw_kernels = NULL;
+static int sha_hw_probed = 0;
+static int sha_hw_enabled = 1;
+
+const mbedtls_sha_hw_t *mbedtls_sha_hw( void )
+{
+    const mbedtls_sha_hw_t *hw;
+
+    if( sha_hw_probed == 0 )
+    {
+        hw = sha_hw_cpu();
+        if( hw != NULL && sha_hw_self_test( hw ) != 0 )
+            hw = NULL;
+        sha_hw_kernels = hw;
+        sha_hw_probed = 1;
+    }
+
+    return( sha_hw_enabled ? sha_hw_kernels : NULL );
+}
+
+void mbedtls_sha_hw_enable( int enable )
+{
+    sha_hw_enabled = enable;
+}
@@ -0,0 +1,85 @@
+/*
+ *  SHA-1 and SHA-256 compression functions using the SHA instructions
+ *  of the CPU (x86 SHA extensions and ARMv8 cryptography extensions)
+ *
+ *  Copyright (C) 2015 Cisco Systems, Inc.
+ *  Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#ifndef MBEDTLS_SHA_HW_H
+#define MBEDTLS_SHA_HW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief          Compress consecutive 64 bytes blocks into a state
+ */
+typedef void (*mbedtls_sha_blocks_t)( uint32_t *state,
+                                      const unsigned char *data,
+                                      size_t blocks );
+
+/**
+ * \brief          Compress two independent streams with the same number of
+ *                 blocks. The rounds of both streams are interleaved to hide
+ *                 the latency of the SHA instructions
+ */
+typedef void (*mbedtls_sha_blocks_x2_t)( uint32_t *state_a,
+                                         const unsigned char *data_a,
+                                         uint32_t *state_b,
+                                         const unsigned char *data_b,
+                                         size_t blocks );
+
+/**
+ * \brief          Kernels supported by the running CPU. A NULL kernel means
+ *                 the portable implementation has to be used
+ */
+typedef struct
+{
+    const char *name;
+    mbedtls_sha_blocks_t sha1;
+    mbedtls_sha_blocks_x2_t sha1_x2;
+    mbedtls_sha_blocks_t sha256;
+    mbedtls_sha_blocks_x2_t sha256_x2;
+}
+mbedtls_sha_hw_t;
+
+/**
+ * \brief          Kernels of the running CPU. The CPU is probed on the first
+ *                 call and the kernels are checked against known answers
+ *                 before being used.
+ *
+ * \return         NULL if the CPU has no SHA instructions or their use has
+ *                 been disabled
+ */
+const mbedtls_sha_hw_t *mbedtls_sha_hw( void );
+
+/**
+ * \brief          Enable (default) or disable the use of the SHA
+ *                 instructions. Used to compare with the portable code
+ *
+ * \param enable   0 to use the portable implementation
+ */
+void mbedtls_sha_hw_enable( int enable );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MBEDTLS_SHA_HW_H */
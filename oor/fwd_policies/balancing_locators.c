@@ -28,7 +28,7 @@ static void balancing_locators_vecs_reset(balancing_locators_vecs *blv);
 static int select_best_priority_locators(glist_t *loct_list, locator_t **selected_locators,
         uint8_t is_mce);
 static locator_t **set_balancing_vector(locator_t **locators, int total_weight, int hcf,
-        int *locators_vec_length);
+        int *locators_vec_length, void *ctx);
 static inline void get_hcf_locators_weight(locator_t **locators, int *total_weight,int *hcf);
 static int highest_common_factor(int a, int b);
 
@@ -47,6 +47,14 @@ balancing_locators_vecs_new()
 
 void *
 balancing_locators_vecs_new_init(mapping_t *map, glist_t *loc_loct, uint8_t is_mce)
+{
+    return (balancing_locators_vecs_new_build(map, loc_loct, is_mce,
+            set_balancing_vector, NULL));
+}
+
+void *
+balancing_locators_vecs_new_build(mapping_t *map, glist_t *loc_loct,
+        uint8_t is_mce, balancing_vec_fn vec_fn, void *ctx)
 {
     balancing_locators_vecs *bal_vec;
 
@@ -55,7 +63,7 @@ balancing_locators_vecs_new_init(mapping_t *map, glist_t *loc_loct, uint8_t is_m
         return (NULL);
     }
 
-    if (balancing_vectors_calculate(bal_vec, map, loc_loct, is_mce) != GOOD){
+    if (balancing_vectors_build(bal_vec, map, loc_loct, is_mce, vec_fn, ctx) != GOOD){
         balancing_locators_vecs_del(bal_vec);
         OOR_LOG(LDBG_2,"balancing_locators_vecs_new_init: Error calculating balancing vectors");
         return (NULL);
@@ -127,6 +135,18 @@ balancing_locators_vec_dump(balancing_locators_vecs b_locators_vecs,
  */
 int
 balancing_vectors_calculate(balancing_locators_vecs *blv, mapping_t * map, glist_t *loc_loct, uint8_t is_mce)
+{
+    return (balancing_vectors_build(blv, map, loc_loct, is_mce,
+            set_balancing_vector, NULL));
+}
+
+/*
+ * Same as balancing_vectors_calculate but the vector of each set of locators
+ * is built by vec_fn
+ */
+int
+balancing_vectors_build(balancing_locators_vecs *blv, mapping_t * map,
+        glist_t *loc_loct, uint8_t is_mce, balancing_vec_fn vec_fn, void *ctx)
 {
     // Store locators with same priority. Maximum 32 locators (33 to no get out of array)
     locator_t *locators[3][33];
@@ -157,9 +177,9 @@ balancing_vectors_calculate(balancing_locators_vecs *blv, mapping_t * map, glist
                 ipv4_loct_list, locators[0], is_mce);
         if (min_priority[0] != UNUSED_RLOC_PRIORITY) {
             get_hcf_locators_weight(locators[0], &total_weight[0], &hcf[0]);
-            blv->v4_balancing_locators_vec = set_balancing_vector(
+            blv->v4_balancing_locators_vec = vec_fn(
                     locators[0], total_weight[0], hcf[0],
-                    &(blv->v4_locators_vec_length));
+                    &(blv->v4_locators_vec_length), ctx);
         }
     }
 
@@ -171,9 +191,9 @@ balancing_vectors_calculate(balancing_locators_vecs *blv, mapping_t * map, glist
                 ipv6_loct_list, locators[1], is_mce);
         if (min_priority[1] != UNUSED_RLOC_PRIORITY) {
             get_hcf_locators_weight(locators[1], &total_weight[1], &hcf[1]);
-            blv->v6_balancing_locators_vec = set_balancing_vector(
+            blv->v6_balancing_locators_vec = vec_fn(
                     locators[1], total_weight[1], hcf[1],
-                    &(blv->v6_locators_vec_length));
+                    &(blv->v6_locators_vec_length), ctx);
         }
     }
     /* Fill the locator balancing vec using IPv4 and IPv6 locators and according
@@ -205,9 +225,9 @@ balancing_vectors_calculate(balancing_locators_vecs *blv, mapping_t * map, glist
                 }
             }
             locators[2][pos] = NULL;
-            blv->balancing_locators_vec = set_balancing_vector(
+            blv->balancing_locators_vec = vec_fn(
                     locators[2], total_weight[2], hcf[2],
-                    &(blv->locators_vec_length));
+                    &(blv->locators_vec_length), ctx);
         }
     }
 
@@ -298,7 +318,7 @@ select_best_priority_locators(glist_t *loct_list, locator_t **selected_locators,
 
 static locator_t **
 set_balancing_vector(locator_t **locators, int total_weight, int hcf,
-        int *locators_vec_length)
+        int *locators_vec_length, void *ctx)
 {
     locator_t **balancing_locators_vec;
     int vector_length = 0;
@@ -40,9 +40,21 @@ typedef struct balancing_locators_vecs_ {
     int locators_vec_length;
 } balancing_locators_vecs;
 
+/*
+ * Build the balancing vector of a set of locators with the same priority.
+ * locators is NULL terminated. ctx is the one passed to the build function.
+ * The vector is released with free()
+ */
+typedef locator_t **(*balancing_vec_fn)(locator_t **locators, int total_weight,
+        int hcf, int *locators_vec_length, void *ctx);
+
 void *balancing_locators_vecs_new_init(mapping_t *map, glist_t *loc_loct, uint8_t is_mce);
+void *balancing_locators_vecs_new_build(mapping_t *map, glist_t *loc_loct,
+        uint8_t is_mce, balancing_vec_fn vec_fn, void *ctx);
 void balancing_locators_vecs_del(void * bal_vec);
 int balancing_vectors_calculate(balancing_locators_vecs *blv, mapping_t * map, glist_t *loc_loct, uint8_t is_mce);
+int balancing_vectors_build(balancing_locators_vecs *blv, mapping_t * map,
+        glist_t *loc_loct, uint8_t is_mce, balancing_vec_fn vec_fn, void *ctx);
 void balancing_locators_vec_dump(balancing_locators_vecs b_locators_vecs, mapping_t *mapping, int log_level);
 
 #endif /* OOR_FWD_POLICIES_BALANCING_LOCATORS_H_ */
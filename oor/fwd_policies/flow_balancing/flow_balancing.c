@@ -30,21 +30,15 @@
 #include "../../control/lisp_rtr.h"
 
 fb_dev_parm *fb_dev_parm_new();
-void *fb_new_dev_policy_inf(oor_ctrl_dev_t *ctrl_dev,
-        fwd_policy_dev_parm *dev_parm_inf);
-void fb_del_dev_policy_inf(void *dev_parm);
-int fb_init_map_loc_policy_inf(void *dev_parm, map_local_entry_t *mle,
-        fwd_policy_map_parm *map_parm);
 int fb_init_map_cache_policy_inf(void *dev_parm, mcache_entry_t *mce);
-int fb_get_fwd_entry(void *fwd_dev_parm,  map_local_entry_t *mle, mcache_entry_t *mce,
-        mcache_entry_t *petrs, packet_tuple_t *tuple, fwd_info_t *fwd_info);
 int fb_get_fwd_entry_2(fb_dev_parm *dev_parm,  map_local_entry_t *mle, mcache_entry_t *mce,
         packet_tuple_t *tuple, fwd_info_t *fwd_info);
 int fb_get_fwd_entry_rtr_nat(fb_dev_parm *dev_parm,  map_local_entry_t *mle, mcache_entry_t *mce,
         packet_tuple_t *tuple, fwd_info_t *fwd_info);
+static int fb_fill_pref_info(fb_dev_parm *dev_parm, map_local_entry_t *mle,
+        mcache_entry_t *mce, fwd_pref_info_t *pref_info);
 
 
-int fb_updated_map_loc_inf(void *dev_parm, map_local_entry_t *mle);
 int fb_updated_map_cache_inf(void *dev_parm, mcache_entry_t *mce);
 
 
@@ -58,7 +52,8 @@ fwd_policy_class  fwd_policy_flow_balancing = {
         .updated_map_loc_inf = fb_updated_map_loc_inf,
         .updated_map_cache_inf = fb_updated_map_cache_inf,
         .get_fwd_info = fb_get_fwd_entry,
-        .get_fwd_ip_addr = laddr_get_fwd_ip_addr
+        .get_fwd_ip_addr = laddr_get_fwd_ip_addr,
+        .get_src_rlocs = fb_get_src_rlocs
 };
 
 
@@ -86,6 +81,7 @@ fb_new_dev_policy_inf(oor_ctrl_dev_t *ctrl_dev,
     }
     dev_parm->dev_type = ctrl_dev_mode(ctrl_dev);
     dev_parm->loc_loct = ctrl_rlocs(ctrl_dev_get_ctrl_t(ctrl_dev));
+    dev_parm->ctrl_dev = ctrl_dev;
 
     return(dev_parm);
 }
@@ -137,6 +133,42 @@ fb_updated_map_cache_inf(void *dev_parm,mcache_entry_t *mce){
             mcache_entry_mapping(mce),dev_p->loc_loct, TRUE));
 }
 
+/* Source RLOCs of the balancing vectors of the local mapping. NULL if some of
+ * them is not an IP address */
+glist_t *
+fb_get_src_rlocs(void *dev_parm, map_local_entry_t *mle)
+{
+    fb_dev_parm *dev_p = (fb_dev_parm *)dev_parm;
+    balancing_locators_vecs *blv = (balancing_locators_vecs *)map_local_entry_fwd_info(mle);
+    locator_t **vecs[2];
+    int lens[2], i, j;
+    lisp_addr_t *addr;
+    glist_t *rlocs;
+
+    if (!blv){
+        return (NULL);
+    }
+    vecs[0] = blv->v4_balancing_locators_vec;
+    lens[0] = blv->v4_locators_vec_length;
+    vecs[1] = blv->v6_balancing_locators_vec;
+    lens[1] = blv->v6_locators_vec_length;
+
+    rlocs = glist_new_managed((glist_del_fct)lisp_addr_del);
+    for (i = 0; i < 2; i++){
+        for (j = 0; vecs[i] && j < lens[i]; j++){
+            addr = laddr_get_fwd_ip_addr(locator_addr(vecs[i][j]),dev_p->loc_loct);
+            if (!addr || lisp_addr_lafi(addr) != LM_AFI_IP){
+                glist_destroy(rlocs);
+                return (NULL);
+            }
+            if (!glist_contain_using_cmp_fct(addr, rlocs, (glist_cmp_fct)lisp_addr_cmp)){
+                glist_add(lisp_addr_clone(addr), rlocs);
+            }
+        }
+    }
+    return (rlocs);
+}
+
 
 /* Select the source and destination RLOC according to the priority and weight.
  * The destination RLOC is selected according to the AFI of the selected source
@@ -171,7 +203,11 @@ fb_get_fwd_entry(void *fwd_dev_parm,  map_local_entry_t *mle, mcache_entry_t *mc
         return (GOOD);
     }
     /* Other cases */
-    if (fb_get_fwd_entry_2(dev_parm,mle,mce,tuple,fwd_info) == ERR_NO_ROUTE){
+    if (fb_get_fwd_entry_2(dev_parm,mle,mce,tuple,fwd_info) == GOOD){
+        if (fwd_info->pref_info){
+            fb_fill_pref_info(dev_parm,mle,mce,fwd_info->pref_info);
+        }
+    }else{
         dmap = mcache_entry_mapping(mce);
         if (lisp_addr_is_lcaf(mapping_eid(dmap))){
             fwd_info->neg_map_reply_act = ACT_DROP;
@@ -200,6 +236,86 @@ fb_get_fwd_entry(void *fwd_dev_parm,  map_local_entry_t *mle, mcache_entry_t *mc
 }
 
 
+/* Vector of source locators to be used with the destination locators. The
+ * combined one is preferred when both mappings have IPv4 and IPv6 locators */
+static locator_t **
+fb_select_src_vec(balancing_locators_vecs *src_blv, balancing_locators_vecs *dst_blv,
+        int *src_vec_len)
+{
+    if (src_blv->balancing_locators_vec != NULL
+            && dst_blv->balancing_locators_vec != NULL) {
+        *src_vec_len = src_blv->locators_vec_length;
+        return (src_blv->balancing_locators_vec);
+    } else if (src_blv->v6_balancing_locators_vec != NULL
+            && dst_blv->v6_balancing_locators_vec != NULL) {
+        *src_vec_len = src_blv->v6_locators_vec_length;
+        return (src_blv->v6_balancing_locators_vec);
+    } else if (src_blv->v4_balancing_locators_vec != NULL
+            && dst_blv->v4_balancing_locators_vec != NULL) {
+        *src_vec_len = src_blv->v4_locators_vec_length;
+        return (src_blv->v4_balancing_locators_vec);
+    }
+    *src_vec_len = 0;
+    return (NULL);
+}
+
+/* Copy the forwarding addresses of a vector of locators */
+static int
+fb_vec_to_fwd_addrs(fb_dev_parm *dev_parm, locator_t **loc_vec, int vec_len,
+        lisp_addr_t **addrs)
+{
+    lisp_addr_t *addr;
+    int i;
+
+    if (!loc_vec || vec_len == 0){
+        *addrs = NULL;
+        return (0);
+    }
+    *addrs = xmalloc(vec_len * sizeof(lisp_addr_t));
+    for (i = 0; i < vec_len; i++){
+        addr = laddr_get_fwd_ip_addr(locator_addr(loc_vec[i]),dev_parm->loc_loct);
+        if (!addr || lisp_addr_lafi(addr) != LM_AFI_IP){
+            free(*addrs);
+            *addrs = NULL;
+            return (0);
+        }
+        lisp_addr_copy(&(*addrs)[i], addr);
+    }
+    return (vec_len);
+}
+
+/* Export the balancing vectors of the local and the remote mapping. The data
+ * plane selects from them the RLOCs of the next flows between both prefixes
+ * as fb_get_fwd_entry_2 does */
+static int
+fb_fill_pref_info(fb_dev_parm *dev_parm, map_local_entry_t *mle, mcache_entry_t *mce,
+        fwd_pref_info_t *pref_info)
+{
+    balancing_locators_vecs * src_blv = (balancing_locators_vecs *)map_local_entry_fwd_info(mle);
+    balancing_locators_vecs * dst_blv = (balancing_locators_vecs *)mcache_entry_routing_info(mce);
+    locator_t ** src_loc_vec;
+    int src_vec_len;
+
+    src_loc_vec = fb_select_src_vec(src_blv, dst_blv, &src_vec_len);
+    pref_info->src_rlocs_len = fb_vec_to_fwd_addrs(dev_parm, src_loc_vec,
+            src_vec_len, &pref_info->src_rlocs);
+    pref_info->dst_rlocs_v4_len = fb_vec_to_fwd_addrs(dev_parm,
+            dst_blv->v4_balancing_locators_vec, dst_blv->v4_locators_vec_length,
+            &pref_info->dst_rlocs_v4);
+    pref_info->dst_rlocs_v6_len = fb_vec_to_fwd_addrs(dev_parm,
+            dst_blv->v6_balancing_locators_vec, dst_blv->v6_locators_vec_length,
+            &pref_info->dst_rlocs_v6);
+    if (pref_info->src_rlocs_len == 0 || (pref_info->dst_rlocs_v4_len == 0
+            && pref_info->dst_rlocs_v6_len == 0)){
+        /* Not filled */
+        free(pref_info->src_rlocs);
+        pref_info->src_rlocs = NULL;
+        pref_info->src_rlocs_len = 0;
+        return (BAD);
+    }
+    return (GOOD);
+}
+
 int
 fb_get_fwd_entry_2(fb_dev_parm *dev_parm,  map_local_entry_t *mle, mcache_entry_t *mce,
         packet_tuple_t *tuple, fwd_info_t *fwd_info)
@@ -229,19 +345,8 @@ fb_get_fwd_entry_2(fb_dev_parm *dev_parm,  map_local_entry_t *mle, mcache_entry_
         goto done;
     }
 
-    if (src_blv->balancing_locators_vec != NULL
-            && dst_blv->balancing_locators_vec != NULL) {
-        src_loc_vec = src_blv->balancing_locators_vec;
-        src_vec_len = src_blv->locators_vec_length;
-    } else if (src_blv->v6_balancing_locators_vec != NULL
-            && dst_blv->v6_balancing_locators_vec != NULL) {
-        src_loc_vec = src_blv->v6_balancing_locators_vec;
-        src_vec_len = src_blv->v6_locators_vec_length;
-    } else if (src_blv->v4_balancing_locators_vec != NULL
-            && dst_blv->v4_balancing_locators_vec != NULL) {
-        src_loc_vec = src_blv->v4_balancing_locators_vec;
-        src_vec_len = src_blv->v4_locators_vec_length;
-    } else {
+    src_loc_vec = fb_select_src_vec(src_blv, dst_blv, &src_vec_len);
+    if (!src_loc_vec) {
         if (src_blv->v4_balancing_locators_vec == NULL
                 && src_blv->v6_balancing_locators_vec == NULL) {
             OOR_LOG(LDBG_3, "fb_get_fwd_entry: No SRC locators "
@@ -21,12 +21,26 @@
 
 #include "../../defs.h"
 #include "../../lib/generic_list.h"
+#include "../fwd_policy.h"
 
 
 typedef struct fb_dev_parm_ {
     oor_dev_type_e     dev_type;
     glist_t *          loc_loct;
+    oor_ctrl_dev_t *   ctrl_dev;
 }fb_dev_parm;
 
+/* Also used by the policies whose forwarding information of a mapping is a
+ * balancing_locators_vecs */
+void *fb_new_dev_policy_inf(oor_ctrl_dev_t *ctrl_dev,
+        fwd_policy_dev_parm *dev_parm_inf);
+void fb_del_dev_policy_inf(void *dev_parm);
+int fb_init_map_loc_policy_inf(void *dev_parm, map_local_entry_t *mle,
+        fwd_policy_map_parm *map_parm);
+int fb_updated_map_loc_inf(void *dev_parm, map_local_entry_t *mle);
+int fb_get_fwd_entry(void *fwd_dev_parm,  map_local_entry_t *mle, mcache_entry_t *mce,
+        mcache_entry_t *petrs, packet_tuple_t *tuple, fwd_info_t *fwd_info);
+glist_t *fb_get_src_rlocs(void *dev_parm, map_local_entry_t *mle);
+
 
 #endif /* FLOW_BALANCING_H_ */
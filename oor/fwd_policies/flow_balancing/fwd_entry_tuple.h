@@ -32,6 +32,8 @@ typedef struct fwd_entry_tuple_ {
     uint16_t dst_port;
     int *out_sock;
     uint32_t iid;
+    /* Outer headers of the encapsulated packets. Built by the data plane */
+    pkt_hdr_tmpl_t hdr_tmpl;
 } fwd_entry_tuple_t;
 
 fwd_entry_tuple_t *fwd_entry_tuple_new_init(packet_tuple_t *tuple, lisp_addr_t *srloc,
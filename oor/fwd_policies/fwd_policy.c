@@ -20,9 +20,11 @@
 #include "fwd_policy.h"
 #include "../lib/oor_log.h"
 
-static fwd_policy_class *fwd_policy_libs[2] = {
+static fwd_policy_class *fwd_policy_libs[4] = {
         &fwd_policy_flow_balancing,
-        &fwd_policy_vpp_balancing
+        &fwd_policy_vpp_balancing,
+        &fwd_policy_maglev_balancing,
+        &fwd_policy_rtt_balancing
 };
 
 void policy_loct_parm_del(fwd_policy_loct_parm *pol_loct);
@@ -34,6 +36,10 @@ fwd_policy_class_find(char *lib)
 		return(fwd_policy_libs[0]);
 	}else if (strcmp(lib,"vpp_balancing") == 0){
 	    return(fwd_policy_libs[1]);
+	}else if (strcmp(lib,"maglev_balancing") == 0){
+	    return(fwd_policy_libs[2]);
+	}else if (strcmp(lib,"rtt_balancing") == 0){
+	    return(fwd_policy_libs[3]);
 	}
 	OOR_LOG(LERR, "The forward policy library \"%s\" has not been found",lib);
 	return (NULL);
@@ -109,5 +115,85 @@ fwd_info_del(fwd_info_t * fwd_info)
     if(fwd_info->associated_entry){
        lisp_addr_del(fwd_info->associated_entry);
     }
+    if (fwd_info->local_entry){
+        lisp_addr_del(fwd_info->local_entry);
+    }
+    if (fwd_info->pref_info){
+        fwd_pref_info_del(fwd_info->pref_info);
+    }
+    mcache_activity_unref(fwd_info->activity);
     free(fwd_info);
 }
+
+/* Associate the flow with the activity of its map cache entry. The flow keeps
+ * a reference as it may outlive the entry */
+void
+fwd_info_set_activity(fwd_info_t *fwd_info, mcache_activity_t *act)
+{
+    mcache_activity_unref(fwd_info->activity);
+    fwd_info->activity = act ? mcache_activity_ref(act) : NULL;
+}
+
+/* Empty forwarding information of the flows between two EIDs. The RLOC
+ * vectors are filled by the policy */
+fwd_pref_info_t *
+fwd_pref_info_new(lisp_addr_t *src_eid, lisp_addr_t *dst_eid)
+{
+    fwd_pref_info_t *pref_info;
+    lisp_addr_t *src_pref = lisp_addr_get_ip_pref_addr(src_eid);
+    lisp_addr_t *dst_pref = lisp_addr_get_ip_pref_addr(dst_eid);
+
+    if (!src_pref || !dst_pref){
+        return (NULL);
+    }
+    pref_info = xzalloc(sizeof(fwd_pref_info_t));
+    lisp_addr_copy(&pref_info->src_pref, src_pref);
+    lisp_addr_copy(&pref_info->dst_pref, dst_pref);
+    pref_info->src_eid = lisp_addr_clone(src_eid);
+    pref_info->dst_eid = lisp_addr_clone(dst_eid);
+    if (lisp_addr_is_iid(src_eid)){
+        pref_info->iid = lcaf_iid_get_iid(lisp_addr_get_lcaf(src_eid));
+    }
+    return (pref_info);
+}
+
+void
+fwd_pref_info_del(fwd_pref_info_t *pref_info)
+{
+    lisp_addr_del(pref_info->src_eid);
+    lisp_addr_del(pref_info->dst_eid);
+    free(pref_info->src_rlocs);
+    free(pref_info->dst_rlocs_v4);
+    free(pref_info->dst_rlocs_v6);
+    free(pref_info->src_socks);
+    mcache_activity_unref(pref_info->activity);
+    free(pref_info);
+}
+
+/* Select the RLOCs of the flow with the hash of its tuple. Returns BAD if
+ * there is no destination RLOC of the AFI of the selected source RLOC */
+int
+fwd_pref_info_select_rlocs(fwd_pref_info_t *pref_info, uint32_t hash,
+        lisp_addr_t **srloc, lisp_addr_t **drloc)
+{
+    if (hash == 0 || pref_info->src_rlocs_len == 0){
+        return (BAD);
+    }
+    *srloc = &pref_info->src_rlocs[hash % pref_info->src_rlocs_len];
+    switch (lisp_addr_ip_afi(*srloc)){
+    case AF_INET:
+        if (pref_info->dst_rlocs_v4_len == 0){
+            return (BAD);
+        }
+        *drloc = &pref_info->dst_rlocs_v4[hash % pref_info->dst_rlocs_v4_len];
+        return (GOOD);
+    case AF_INET6:
+        if (pref_info->dst_rlocs_v6_len == 0){
+            return (BAD);
+        }
+        *drloc = &pref_info->dst_rlocs_v6[hash % pref_info->dst_rlocs_v6_len];
+        return (GOOD);
+    default:
+        return (BAD);
+    }
+}
@@ -56,12 +56,65 @@ typedef struct fwd_policy_loct_parm_t{
 	shash_t 		*paramiters;
 } fwd_policy_loct_parm;
 
+/*
+ * RLOCs of all the flows between a local and a remote EID prefix. Filled by the
+ * policy when the RLOCs of a flow only depend on the hash of its tuple: the
+ * source RLOC is src_rlocs[hash % src_rlocs_len] and the destination RLOC is
+ * selected the same way from the vector of the AFI of the source RLOC.
+ * The data plane uses it to forward the new flows between both prefixes
+ * without asking the control plane
+ */
+typedef struct fwd_pref_info_{
+    lisp_addr_t src_pref;       /* IP prefix of the local EID */
+    lisp_addr_t dst_pref;       /* IP prefix of the remote EID */
+    lisp_addr_t *src_eid;       /* EID of the local mapping */
+    lisp_addr_t *dst_eid;       /* EID of the map cache entry */
+    uint32_t iid;
+    oor_encap_t encap;
+    lisp_addr_t *src_rlocs;
+    lisp_addr_t *dst_rlocs_v4;
+    lisp_addr_t *dst_rlocs_v6;
+    int src_rlocs_len;
+    int dst_rlocs_v4_len;
+    int dst_rlocs_v6_len;
+    /* Output socket of each source RLOC, NULL if it has none. Resolved by the
+     * data plane when the entry is added to the table of the thread using it */
+    int **src_socks;
+    /* Activity of the map cache entry. Inherited by the flows created from
+     * the prefix information */
+    mcache_activity_t *activity;
+}fwd_pref_info_t;
+
+/* Position of a flow in a list of flows kept by the data plane. The list is
+ * NULL when the flow is not linked */
+typedef struct fwd_info_link_{
+    struct fwd_info_ *prev;
+    struct fwd_info_ *next;
+    void *list;
+}fwd_info_link_t;
+
 typedef struct fwd_info_{
     lisp_addr_t *associated_entry;
+    /* EID of the local mapping of the source. NULL if not known */
+    lisp_addr_t *local_entry;
     void *dp_conf_inf;
     lisp_action_e neg_map_reply_act;
     oor_encap_t encap;
+    /* The Map-Request of the destination EID is still outstanding */
+    uint8_t map_pending;
     fwd_info_data_del_fn data_del_fn;
+    /* Requested by the control device when the RLOCs of the flow only depend
+     * on its EID prefixes. NULL if the policy couldn't fill it */
+    fwd_pref_info_t *pref_info;
+    /* Flows of the same EID, of the same local EID and flows forwarded to the
+     * PeTRs. Used by the data plane to find the flows affected by a mapping
+     * change */
+    fwd_info_link_t eid_link;
+    fwd_info_link_t local_link;
+    fwd_info_link_t pxtr_link;
+    /* Activity of the map cache entry used to forward the flow. Touched by
+     * the data plane for each packet. NULL if there is no active entry */
+    mcache_activity_t *activity;
 }fwd_info_t;
 
 /* functions to manipulate routing */
@@ -77,10 +130,18 @@ typedef struct fwd_policy_class {
     int (*get_fwd_info)(void *dev_parm, map_local_entry_t *mle, mcache_entry_t *mce, mcache_entry_t *petrs,
             packet_tuple_t *tuple, fwd_info_t *fdw_info);
     lisp_addr_t *(*get_fwd_ip_addr)(lisp_addr_t *addr, glist_t *locl_rlocs_addr);
+    /* Optional. IP addresses <lisp_addr_t *> that can be selected as source
+     * RLOC of the flows of a local mapping. The list is released by the caller */
+    glist_t *(*get_src_rlocs)(void *dev_parm, map_local_entry_t *mle);
+    /* Optional. Called when the measured metrics of the RLOCs of a map cache
+     * entry change. Policies not using them leave it NULL */
+    int (*updated_rloc_metrics)(void *dev_parm, mcache_entry_t *mce);
 } fwd_policy_class;
 
 
 extern fwd_policy_class fwd_policy_flow_balancing;
+extern fwd_policy_class fwd_policy_maglev_balancing;
+extern fwd_policy_class fwd_policy_rtt_balancing;
 #ifdef VPP
 extern fwd_policy_class fwd_policy_vpp_balancing;
 #else
@@ -97,5 +158,10 @@ void fwd_policy_loct_parm_del(fwd_policy_loct_parm *pol_loct);
 fwd_policy_class *fwd_policy_class_find(char *lib);
 fwd_info_t *fwd_info_new();
 void fwd_info_del(fwd_info_t * fwd_info);
+fwd_pref_info_t *fwd_pref_info_new(lisp_addr_t *src_eid, lisp_addr_t *dst_eid);
+void fwd_pref_info_del(fwd_pref_info_t *pref_info);
+void fwd_info_set_activity(fwd_info_t *fwd_info, mcache_activity_t *act);
+int fwd_pref_info_select_rlocs(fwd_pref_info_t *pref_info, uint32_t hash,
+        lisp_addr_t **srloc, lisp_addr_t **drloc);
 
 #endif /* ROUTING_POLICY_H_ */
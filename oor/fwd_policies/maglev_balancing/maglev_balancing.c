@@ -0,0 +1,207 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "maglev_balancing.h"
+#include "../balancing_locators.h"
+#include "../fwd_addr_func.h"
+#include "../fwd_policy.h"
+#include "../flow_balancing/flow_balancing.h"
+#include "../../lib/oor_log.h"
+#include "../../lib/packets.h"
+#include "../../liblisp/liblisp.h"
+
+#define MGLV_KEY_WORDS          16
+#define MGLV_OFFSET_SEED        0x6d676c76
+#define MGLV_SKIP_SEED          0x736b6970
+
+/* Locator filling the lookup table */
+typedef struct mglv_loct_ {
+    locator_t *loct;
+    uint32_t hash;
+    uint32_t pos;       /* Next position of its permutation */
+    uint32_t skip;
+    uint32_t weight;
+    uint32_t filled;    /* Positions taken */
+} mglv_loct_t;
+
+int mglv_init_map_loc_policy_inf(void *dev_parm, map_local_entry_t *mle,
+        fwd_policy_map_parm *map_parm);
+int mglv_init_map_cache_policy_inf(void *dev_parm, mcache_entry_t *mce);
+int mglv_updated_map_loc_inf(void *dev_parm, map_local_entry_t *mle);
+int mglv_updated_map_cache_inf(void *dev_parm, mcache_entry_t *mce);
+static locator_t **mglv_build_table(locator_t **locators, int total_weight,
+        int hcf, int *locators_vec_length, void *ctx);
+
+/* Locators are selected by fb_get_fwd_entry as in the flow balancing policy:
+ * the position hash % MGLV_TABLE_SIZE of the table is used */
+fwd_policy_class  fwd_policy_maglev_balancing = {
+        .new_dev_policy_inf = fb_new_dev_policy_inf,
+        .del_dev_policy_inf = fb_del_dev_policy_inf,
+        .init_map_loc_policy_inf = mglv_init_map_loc_policy_inf,
+        .del_map_loc_policy_inf = balancing_locators_vecs_del,
+        .init_map_cache_policy_inf = mglv_init_map_cache_policy_inf,
+        .del_map_cache_policy_inf = balancing_locators_vecs_del,
+        .updated_map_loc_inf = mglv_updated_map_loc_inf,
+        .updated_map_cache_inf = mglv_updated_map_cache_inf,
+        .get_fwd_info = fb_get_fwd_entry,
+        .get_fwd_ip_addr = laddr_get_fwd_ip_addr,
+        .get_src_rlocs = fb_get_src_rlocs
+};
+
+
+int
+mglv_init_map_loc_policy_inf(void *dev_parm, map_local_entry_t *mle,
+        fwd_policy_map_parm *map_parm)
+{
+    fb_dev_parm *dev_p = (fb_dev_parm *)dev_parm;
+    void *fwd_inf;
+
+    fwd_inf = balancing_locators_vecs_new_build(map_local_entry_mapping(mle),
+            dev_p->loc_loct, FALSE, mglv_build_table, NULL);
+    if (!fwd_inf){
+        return (BAD);
+    }
+    map_local_entry_set_fwd_info(mle, fwd_inf, balancing_locators_vecs_del);
+    return (GOOD);
+}
+
+int
+mglv_init_map_cache_policy_inf(void *dev_parm, mcache_entry_t *mce)
+{
+    fb_dev_parm *dev_p = (fb_dev_parm *)dev_parm;
+    void *routing_inf;
+
+    routing_inf = balancing_locators_vecs_new_build(mcache_entry_mapping(mce),
+            dev_p->loc_loct, TRUE, mglv_build_table, NULL);
+    if (!routing_inf){
+        return (BAD);
+    }
+    mcache_entry_set_routing_info(mce, routing_inf, balancing_locators_vecs_del);
+    return (GOOD);
+}
+
+int
+mglv_updated_map_loc_inf(void *dev_parm, map_local_entry_t *mle)
+{
+    fb_dev_parm *dev_p = (fb_dev_parm *)dev_parm;
+    return (balancing_vectors_build(map_local_entry_fwd_info(mle),
+            map_local_entry_mapping(mle), dev_p->loc_loct, FALSE,
+            mglv_build_table, NULL));
+}
+
+int
+mglv_updated_map_cache_inf(void *dev_parm, mcache_entry_t *mce)
+{
+    fb_dev_parm *dev_p = (fb_dev_parm *)dev_parm;
+    return (balancing_vectors_build(mcache_entry_routing_info(mce),
+            mcache_entry_mapping(mce), dev_p->loc_loct, TRUE,
+            mglv_build_table, NULL));
+}
+
+/* The permutation of a locator only depends on its address, so it is the same
+ * in every rebuild of the table and in every node */
+static void
+mglv_loct_init(mglv_loct_t *ml, locator_t *loct, uint32_t weight)
+{
+    uint32_t key[MGLV_KEY_WORDS];
+    char *str = lisp_addr_to_char(locator_addr(loct));
+    size_t len = strlen(str);
+
+    memset(key, 0, sizeof(key));
+    memcpy(key, str, len < sizeof(key) ? len : sizeof(key));
+
+    ml->loct = loct;
+    ml->hash = pkt_hash_key(key, MGLV_KEY_WORDS, MGLV_OFFSET_SEED);
+    ml->pos = ml->hash % MGLV_TABLE_SIZE;
+    ml->skip = pkt_hash_key(key, MGLV_KEY_WORDS, MGLV_SKIP_SEED)
+            % (MGLV_TABLE_SIZE - 1) + 1;
+    ml->weight = weight;
+    ml->filled = 0;
+}
+
+/* Order independent of the order of the locators in the mapping */
+static int
+mglv_loct_cmp(const void *a, const void *b)
+{
+    const mglv_loct_t *ma = (const mglv_loct_t *)a;
+    const mglv_loct_t *mb = (const mglv_loct_t *)b;
+
+    if (ma->hash != mb->hash){
+        return (ma->hash < mb->hash ? -1 : 1);
+    }
+    return (lisp_addr_cmp(locator_addr(ma->loct), locator_addr(mb->loct)));
+}
+
+/*
+ * Build the lookup table of a set of locators with the same priority. Each
+ * turn is given to the locator with the lowest ratio of positions taken to
+ * weight, which takes the next free position of its permutation. With equal
+ * weights this is the round robin of Maglev
+ */
+static locator_t **
+mglv_build_table(locator_t **locators, int total_weight, int hcf,
+        int *locators_vec_length, void *ctx)
+{
+    mglv_loct_t *mls;
+    locator_t **table;
+    uint8_t used[MGLV_TABLE_SIZE];
+    uint32_t weight;
+    int n = 0, ctr, sel, filled;
+
+    for (ctr = 0; locators[ctr] != NULL; ctr++);
+    mls = xmalloc((ctr + 1) * sizeof(mglv_loct_t));
+    for (ctr = 0; locators[ctr] != NULL; ctr++){
+        /* If all locators have weight 0, all of them get the same share */
+        weight = total_weight != 0 ? locator_weight(locators[ctr]) / hcf : 1;
+        if (weight == 0){
+            continue;
+        }
+        mglv_loct_init(&mls[n], locators[ctr], weight);
+        n++;
+    }
+    if (n == 0){
+        free(mls);
+        *locators_vec_length = 0;
+        return (NULL);
+    }
+    qsort(mls, n, sizeof(mglv_loct_t), mglv_loct_cmp);
+
+    table = xmalloc(MGLV_TABLE_SIZE * sizeof(locator_t *));
+    memset(used, 0, sizeof(used));
+    for (filled = 0; filled < MGLV_TABLE_SIZE; filled++){
+        sel = 0;
+        for (ctr = 1; ctr < n; ctr++){
+            if ((uint64_t)(mls[ctr].filled + 1) * mls[sel].weight
+                    < (uint64_t)(mls[sel].filled + 1) * mls[ctr].weight){
+                sel = ctr;
+            }
+        }
+        /* The table size is prime, so the permutation visits every position */
+        while (used[mls[sel].pos]){
+            mls[sel].pos = (mls[sel].pos + mls[sel].skip) % MGLV_TABLE_SIZE;
+        }
+        used[mls[sel].pos] = TRUE;
+        table[mls[sel].pos] = mls[sel].loct;
+        mls[sel].filled++;
+    }
+    free(mls);
+
+    *locators_vec_length = MGLV_TABLE_SIZE;
+    return (table);
+}
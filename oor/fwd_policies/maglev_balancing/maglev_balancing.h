@@ -0,0 +1,36 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef MAGLEV_BALANCING_H_
+#define MAGLEV_BALANCING_H_
+
+/*
+ * Locator selection with Maglev consistent hashing. Instead of repeating each
+ * locator weight/hcf times, the balancing vectors are lookup tables of
+ * MGLV_TABLE_SIZE positions. Each locator fills the table following its own
+ * permutation of the positions, derived from its address, and takes a number
+ * of positions proportional to its weight. When a locator goes up or down
+ * only the positions it gains or loses change of owner, so about 1/N of the
+ * flows are moved to a different RLOC.
+ */
+
+/* Prime and much bigger than the number of locators of the same priority */
+#define MGLV_TABLE_SIZE         127
+
+#endif /* MAGLEV_BALANCING_H_ */
@@ -0,0 +1,187 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "rtt_balancing.h"
+#include "../balancing_locators.h"
+#include "../fwd_addr_func.h"
+#include "../fwd_policy.h"
+#include "../flow_balancing/flow_balancing.h"
+#include "../../control/lisp_tr.h"
+#include "../../lib/oor_log.h"
+#include "../../liblisp/liblisp.h"
+
+int rtt_init_map_cache_policy_inf(void *dev_parm, mcache_entry_t *mce);
+int rtt_updated_map_cache_inf(void *dev_parm, mcache_entry_t *mce);
+static locator_t **rtt_build_vector(locator_t **locators, int total_weight,
+        int hcf, int *locators_vec_length, void *ctx);
+
+/* Local mappings are balanced as in the flow balancing policy. Only the
+ * remote locators are measured */
+fwd_policy_class  fwd_policy_rtt_balancing = {
+        .new_dev_policy_inf = fb_new_dev_policy_inf,
+        .del_dev_policy_inf = fb_del_dev_policy_inf,
+        .init_map_loc_policy_inf = fb_init_map_loc_policy_inf,
+        .del_map_loc_policy_inf = balancing_locators_vecs_del,
+        .init_map_cache_policy_inf = rtt_init_map_cache_policy_inf,
+        .del_map_cache_policy_inf = balancing_locators_vecs_del,
+        .updated_map_loc_inf = fb_updated_map_loc_inf,
+        .updated_map_cache_inf = rtt_updated_map_cache_inf,
+        .get_fwd_info = fb_get_fwd_entry,
+        .get_fwd_ip_addr = laddr_get_fwd_ip_addr,
+        .get_src_rlocs = fb_get_src_rlocs,
+        .updated_rloc_metrics = rtt_updated_map_cache_inf
+};
+
+
+int
+rtt_init_map_cache_policy_inf(void *dev_parm, mcache_entry_t *mce)
+{
+    fb_dev_parm *dev_p = (fb_dev_parm *)dev_parm;
+    void *routing_inf;
+
+    routing_inf = balancing_locators_vecs_new_build(mcache_entry_mapping(mce),
+            dev_p->loc_loct, TRUE, rtt_build_vector, dev_p);
+    if (!routing_inf){
+        return (BAD);
+    }
+    mcache_entry_set_routing_info(mce, routing_inf, balancing_locators_vecs_del);
+    return (GOOD);
+}
+
+int
+rtt_updated_map_cache_inf(void *dev_parm, mcache_entry_t *mce)
+{
+    fb_dev_parm *dev_p = (fb_dev_parm *)dev_parm;
+    return (balancing_vectors_build(mcache_entry_routing_info(mce),
+            mcache_entry_mapping(mce), dev_p->loc_loct, TRUE,
+            rtt_build_vector, dev_p));
+}
+
+/* Metrics of the RLOC used to reach the locator. NULL if not measured */
+static tr_rloc_metrics_t *
+rtt_loct_metrics(fb_dev_parm *dev_p, locator_t *loct)
+{
+    lisp_tr_t *tr;
+    lisp_addr_t *addr;
+
+    switch (dev_p->dev_type){
+    case xTR_MODE:
+    case RTR_MODE:
+    case MN_MODE:
+        break;
+    default:
+        return (NULL);
+    }
+    tr = &(lisp_tr_abstract_cast(dev_p->ctrl_dev)->tr);
+    addr = laddr_get_fwd_ip_addr(locator_addr(loct), dev_p->loc_loct);
+    if (!addr){
+        return (NULL);
+    }
+    return (tr_rloc_metrics(tr, addr));
+}
+
+static uint64_t
+gcd64(uint64_t a, uint64_t b)
+{
+    uint64_t c;
+
+    while (b != 0){
+        c = a % b;
+        a = b;
+        b = c;
+    }
+    return (a);
+}
+
+/*
+ * Build the balancing vector of a set of locators with the same priority.
+ * Each locator takes a number of consecutive positions proportional to
+ * weight * (1 - loss) / delay
+ */
+static locator_t **
+rtt_build_vector(locator_t **locators, int total_weight, int hcf,
+        int *locators_vec_length, void *ctx)
+{
+    fb_dev_parm *dev_p = (fb_dev_parm *)ctx;
+    tr_rloc_metrics_t *metrics;
+    locator_t **vec;
+    uint64_t delay[33], share[33], slots[33];
+    uint64_t best_delay = 0, total_share = 0, div = 0, len = 0, ctr1;
+    uint32_t loss;
+    int ctr, pos = 0;
+
+    for (ctr = 0; locators[ctr] != NULL; ctr++){
+        metrics = rtt_loct_metrics(dev_p, locators[ctr]);
+        delay[ctr] = 0;
+        share[ctr] = 1000;
+        if (metrics && metrics->srtt != 0){
+            delay[ctr] = tr_rloc_metrics_delay(metrics);
+            if (best_delay == 0 || delay[ctr] < best_delay){
+                best_delay = delay[ctr];
+            }
+        }
+        if (metrics){
+            loss = metrics->loss < RTT_MAX_LOSS ? metrics->loss : RTT_MAX_LOSS;
+            share[ctr] = 1000 - loss;
+        }
+    }
+
+    for (ctr = 0; locators[ctr] != NULL; ctr++){
+        /* If all locators have weight 0, all of them have the same weight */
+        if (total_weight != 0){
+            share[ctr] *= locator_weight(locators[ctr]) / hcf;
+        }
+        /* Shares relative to the fastest locator */
+        if (best_delay != 0 && delay[ctr] != 0){
+            share[ctr] = share[ctr] * best_delay / delay[ctr];
+        }
+        total_share += share[ctr];
+    }
+
+    for (ctr = 0; locators[ctr] != NULL; ctr++){
+        slots[ctr] = 0;
+        if (total_weight != 0 && locator_weight(locators[ctr]) == 0){
+            continue;
+        }
+        slots[ctr] = total_share != 0
+                ? (share[ctr] * RTT_VEC_SIZE + total_share / 2) / total_share : 1;
+        if (slots[ctr] == 0){
+            slots[ctr] = 1;
+        }
+        div = gcd64(div, slots[ctr]);
+        len += slots[ctr];
+    }
+    if (len == 0){
+        *locators_vec_length = 0;
+        return (NULL);
+    }
+
+    vec = xmalloc((len / div) * sizeof(locator_t *));
+    for (ctr = 0; locators[ctr] != NULL; ctr++){
+        for (ctr1 = 0; ctr1 < slots[ctr] / div; ctr1++){
+            vec[pos] = locators[ctr];
+            pos++;
+        }
+        OOR_LOG(LDBG_3,"rtt_build_vector: Locator %s -> %d positions",
+                lisp_addr_to_char(locator_addr(locators[ctr])), (int)(slots[ctr] / div));
+    }
+    *locators_vec_length = pos;
+
+    return (vec);
+}
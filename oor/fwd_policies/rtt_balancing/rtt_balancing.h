@@ -0,0 +1,37 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef RTT_BALANCING_H_
+#define RTT_BALANCING_H_
+
+/*
+ * Locator selection biased by the RTT and loss measured with RLOC probing.
+ * The priority of the locators is respected, but the share of the flows of
+ * each locator with the best priority is its weight scaled by the inverse of
+ * its delay (smoothed RTT plus twice its jitter) and by its delivery ratio.
+ * Locators without measurements are treated as the fastest ones. Every usable
+ * locator keeps at least one position of the balancing vector.
+ */
+
+/* Approximate length of the balancing vectors */
+#define RTT_VEC_SIZE            64
+/* Loss above which the share of a locator is no longer reduced (1/1000) */
+#define RTT_MAX_LOSS            900
+
+#endif /* RTT_BALANCING_H_ */
@@ -355,6 +355,29 @@ glist_remove_obj_with_ptr(void *data, glist_t *list)
 }
 
 
+/**
+ * glist_extract_obj_with_ptr - remove object from list without deleting it.
+ * The value of the pointer is used to get the element to be removed
+ * @data: object to be removed
+ * @list: list from which the entry is to be removed
+ */
+void
+glist_extract_obj_with_ptr(void *data, glist_t *list)
+{
+    glist_entry_t *entry;
+
+    if (!list || list->size == 0) {
+        return;
+    }
+
+    glist_for_each_entry(entry,list){
+        if(entry->data == data){
+            glist_extract(entry,list);
+            return;
+        }
+    }
+}
+
 void
 glist_remove_all(glist_t *lst)
 {
@@ -71,6 +71,7 @@ void glist_extract(glist_entry_t *entry, glist_t *list);
 void glist_remove(glist_entry_t *entry, glist_t *list);
 void glist_remove_obj(void * data,glist_t * list);
 void glist_remove_obj_with_ptr(void * data, glist_t * list);
+void glist_extract_obj_with_ptr(void * data, glist_t * list);
 void glist_dump(glist_t *list, glist_to_char_fct dump_fct, int log_level);
 void glist_destroy(glist_t *lst);
 void glist_remove_all(glist_t *lst);
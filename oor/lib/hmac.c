@@ -20,103 +20,419 @@
 #include <stdlib.h>
 
 #include "hmac.h"
+#include "mem_util.h"
 #include "oor_log.h"
-#include "../elibs/mbedtls/md.h"
 #include "../liblisp/lisp_message_fields.h"
+#include "../elibs/mbedtls/sha1.h"
+#include "../elibs/mbedtls/sha256.h"
 
+/* Block size of SHA-1 and SHA-256 */
+#define HMAC_BLOCK_SIZE     64
 
+/* Compression functions used by the batch verification */
+typedef struct hmac_blocks_fns_ {
+    void (*blocks)(uint32_t *state, const unsigned char *data, size_t blocks);
+    void (*blocks_x2)(uint32_t *state_a, const unsigned char *data_a,
+            uint32_t *state_b, const unsigned char *data_b, size_t blocks);
+} hmac_blocks_fns_t;
+
+/* Message of a batch. The inner hash compresses the full blocks of the packet
+ * and then the tail, which holds the last bytes of the packet and the
+ * padding */
+typedef struct hmac_lane_ {
+    hmac_auth_req_t *req;
+    hmac_md_state_t *st;
+    const hmac_blocks_fns_t *fns;
+    size_t auth_data_len;
+    uint32_t h[8];
+    const unsigned char *seg[2];
+    size_t seg_blocks[2];
+    int seg_idx;
+    uint8_t auth_data_copy[MBEDTLS_MD_MAX_SIZE];
+    unsigned char tail[2 * HMAC_BLOCK_SIZE];
+} hmac_lane_t;
+
+static const hmac_blocks_fns_t hmac_sha1_fns = {
+        mbedtls_sha1_blocks, mbedtls_sha1_blocks_x2
+};
+static const hmac_blocks_fns_t hmac_sha256_fns = {
+        mbedtls_sha256_blocks, mbedtls_sha256_blocks_x2
+};
+
+static int hmac_md_state_init(hmac_md_state_t *st, mbedtls_md_type_t md_type,
+        const char *key);
+static void hmac_md_state_uninit(hmac_md_state_t *st);
+static hmac_md_state_t *hmac_key_state(hmac_key_t *hkey, uint8_t key_id,
+        size_t *auth_data_len);
+static void hmac_md_state_compute(hmac_md_state_t *st, const void *packet,
+        size_t pckt_len, uint8_t *out);
+
+
+hmac_key_t *
+hmac_key_new(const char *key)
+{
+    hmac_key_t *hkey;
+
+    if (!key){
+        return (NULL);
+    }
+    hkey = xzalloc(sizeof(hmac_key_t));
+    hkey->key = strdup(key);
+    if (hmac_md_state_init(&hkey->sha1, MBEDTLS_MD_SHA1, key) != GOOD
+            || hmac_md_state_init(&hkey->sha256, MBEDTLS_MD_SHA256, key) != GOOD){
+        OOR_LOG(LERR, "hmac_key_new: Couldn't initialize the HMAC contexts");
+        hmac_key_del(hkey);
+        return (NULL);
+    }
+
+    return (hkey);
+}
+
+void
+hmac_key_del(hmac_key_t *hkey)
+{
+    if (!hkey){
+        return;
+    }
+    hmac_md_state_uninit(&hkey->sha1);
+    hmac_md_state_uninit(&hkey->sha256);
+    free(hkey->key);
+    free(hkey);
+}
+
+/* Hash the inner and outer padded keys (RFC 2104). The HMAC of each message
+ * continues from these states */
+static int
+hmac_md_state_init(hmac_md_state_t *st, mbedtls_md_type_t md_type, const char *key)
+{
+    const mbedtls_md_info_t *md_info;
+    unsigned char ipad[HMAC_BLOCK_SIZE], opad[HMAC_BLOCK_SIZE];
+    unsigned char sum[MBEDTLS_MD_MAX_SIZE];
+    const unsigned char *k = (const unsigned char *)key;
+    size_t keylen = strlen(key), i;
+
+    mbedtls_md_init(&st->inner);
+    mbedtls_md_init(&st->outer);
+    mbedtls_md_init(&st->work);
+
+    md_info = mbedtls_md_info_from_type(md_type);
+    if (mbedtls_md_setup(&st->inner, md_info, 0) != 0
+            || mbedtls_md_setup(&st->outer, md_info, 0) != 0
+            || mbedtls_md_setup(&st->work, md_info, 0) != 0){
+        return (BAD);
+    }
+
+    /* Keys longer than a block are replaced by their hash */
+    if (keylen > HMAC_BLOCK_SIZE){
+        mbedtls_md(md_info, k, keylen, sum);
+        k = sum;
+        keylen = mbedtls_md_get_size(md_info);
+    }
+    memset(ipad, 0x36, HMAC_BLOCK_SIZE);
+    memset(opad, 0x5C, HMAC_BLOCK_SIZE);
+    for (i = 0; i < keylen; i++){
+        ipad[i] ^= k[i];
+        opad[i] ^= k[i];
+    }
+
+    mbedtls_md_starts(&st->inner);
+    mbedtls_md_update(&st->inner, ipad, HMAC_BLOCK_SIZE);
+    mbedtls_md_starts(&st->outer);
+    mbedtls_md_update(&st->outer, opad, HMAC_BLOCK_SIZE);
+
+    if (md_type == MBEDTLS_MD_SHA1){
+        memcpy(st->inner_h, ((mbedtls_sha1_context *)st->inner.md_ctx)->state,
+                5 * sizeof(uint32_t));
+        memcpy(st->outer_h, ((mbedtls_sha1_context *)st->outer.md_ctx)->state,
+                5 * sizeof(uint32_t));
+    }else{
+        memcpy(st->inner_h, ((mbedtls_sha256_context *)st->inner.md_ctx)->state,
+                8 * sizeof(uint32_t));
+        memcpy(st->outer_h, ((mbedtls_sha256_context *)st->outer.md_ctx)->state,
+                8 * sizeof(uint32_t));
+    }
+
+    memset(ipad, 0, HMAC_BLOCK_SIZE);
+    memset(opad, 0, HMAC_BLOCK_SIZE);
+    memset(sum, 0, sizeof(sum));
+
+    return (GOOD);
+}
+
+static void
+hmac_md_state_uninit(hmac_md_state_t *st)
+{
+    mbedtls_md_free(&st->inner);
+    mbedtls_md_free(&st->outer);
+    mbedtls_md_free(&st->work);
+    memset(st->inner_h, 0, sizeof(st->inner_h));
+    memset(st->outer_h, 0, sizeof(st->outer_h));
+}
+
+/* Precomputed state of the key for the hash of the key id and length of the
+ * authentication data. NULL if the key id is not supported */
+static hmac_md_state_t *
+hmac_key_state(hmac_key_t *hkey, uint8_t key_id, size_t *auth_data_len)
+{
+    switch (key_id) {
+    case HMAC_SHA_1_96:
+        *auth_data_len = SHA1_AUTH_DATA_LEN;
+        return (&hkey->sha1);
+    case HMAC_SHA_256_128:
+        *auth_data_len = SHA256_AUTH_DATA_LEN;
+        return (&hkey->sha256);
+    default:
+        OOR_LOG(LDBG_2, "HMAC unknown key type: %d", (int)key_id);
+        return (NULL);
+    }
+}
+
+/* Inner and outer hash passes of the message */
+static void
+hmac_md_state_compute(hmac_md_state_t *st, const void *packet, size_t pckt_len,
+        uint8_t *out)
+{
+    unsigned char ihash[MBEDTLS_MD_MAX_SIZE];
+
+    mbedtls_md_clone(&st->work, &st->inner);
+    mbedtls_md_update(&st->work, (const unsigned char *)packet, pckt_len);
+    mbedtls_md_finish(&st->work, ihash);
+
+    mbedtls_md_clone(&st->work, &st->outer);
+    mbedtls_md_update(&st->work, ihash, mbedtls_md_get_size(st->work.md_info));
+    mbedtls_md_finish(&st->work, out);
+}
 
 /*
  * Compute and fill auth data field
- *
- * TODO Support more than SHA1
  */
 
 int
-complete_auth_fields(uint8_t key_id, const char *key, void *packet, size_t pckt_len,
+complete_auth_fields(uint8_t key_id, hmac_key_t *key, void *packet, size_t pckt_len,
         void *auth_data_pos)
 {
-    const mbedtls_md_info_t *md_info;
-    mbedtls_md_type_t md_type;
+    hmac_md_state_t *st;
     size_t auth_data_len;
 
-    switch (key_id) {
-    case NO_KEY:
+    if (key_id == NO_KEY){
         return (GOOD);
-    case HMAC_SHA_1_96:
-        md_type = MBEDTLS_MD_SHA1;
-        auth_data_len = SHA1_AUTH_DATA_LEN;
-        break;
-    default:
-        OOR_LOG(LDBG_2, "complete_auth_fields: HMAC unknown key type: %d", (int)key_id);
-        return(BAD);
     }
-
-    md_info = mbedtls_md_info_from_type(md_type);
-
-    memset(auth_data_pos,0,auth_data_len);
-    if (mbedtls_md_hmac(md_info,
-            (const unsigned char *)key,
-            strlen(key),
-            (const unsigned char *)packet,
-            pckt_len,
-            (unsigned char *)auth_data_pos) != 0){
-        OOR_LOG(LDBG_2, "complete_auth_fields: Error using mbedtls");
+    if (!key || (st = hmac_key_state(key, key_id, &auth_data_len)) == NULL){
         return (BAD);
     }
 
+    memset(auth_data_pos,0,auth_data_len);
+    hmac_md_state_compute(st, packet, pckt_len, (uint8_t *)auth_data_pos);
+
     return (GOOD);
 }
 
 
 int
-check_auth_field(uint8_t key_id, const char *key, void *packet, size_t pckt_len,
+check_auth_field(uint8_t key_id, hmac_key_t *key, void *packet, size_t pckt_len,
         void *auth_data_pos)
 {
-    size_t auth_data_len;
-    uint8_t* auth_data_copy;
-
-    const mbedtls_md_info_t *md_info;
-    mbedtls_md_type_t md_type;
-
-    switch (key_id) {
-    case HMAC_SHA_1_96:
-        md_type = MBEDTLS_MD_SHA1;
-        auth_data_len = SHA1_AUTH_DATA_LEN;
-        break;
-    default:
-        OOR_LOG(LDBG_2, "complete_auth_fields: HMAC unknown key type: %d", (int)key_id);
-        return(BAD);
-    }
+    hmac_md_state_t *st;
+    size_t auth_data_len, i;
+    uint8_t auth_data_copy[MBEDTLS_MD_MAX_SIZE];
+    uint8_t auth_data[MBEDTLS_MD_MAX_SIZE];
+    uint8_t diff = 0;
 
-    auth_data_copy = (uint8_t *) xmalloc(auth_data_len*sizeof(uint8_t));
-    if (auth_data_copy == NULL) {
-        OOR_LOG(LERR, "check_sha1_hmac: malloc() failed");
-        return(ERR_MALLOC);
+    if (!key || (st = hmac_key_state(key, key_id, &auth_data_len)) == NULL){
+        return (BAD);
     }
 
-    /* Copy the data to another location and put 0's on the auth data field of the packet */
+    /* The HMAC is computed with the auth data field of the packet set to 0 */
     memcpy(auth_data_copy,auth_data_pos,auth_data_len);
     memset(auth_data_pos,0,auth_data_len);
+    hmac_md_state_compute(st, packet, pckt_len, auth_data);
+    memcpy(auth_data_pos,auth_data_copy,auth_data_len);
 
+    /* Constant time comparison */
+    for (i = 0; i < auth_data_len; i++){
+        diff |= auth_data[i] ^ auth_data_copy[i];
+    }
 
-    md_info = mbedtls_md_info_from_type(md_type);
-    if (mbedtls_md_hmac(md_info,
-            (const unsigned char *)key,
-            strlen(key),
-            (const unsigned char *)packet,
-            pckt_len,
-            (unsigned char *)auth_data_pos) != 0){
-        OOR_LOG(LDBG_2, "check_auth_field: Error using mbedtls");
+    return (diff == 0 ? GOOD : BAD);
+}
+
+/* Writes the length of the hashed data in bits at the end of the padding */
+static void
+hmac_put_len(unsigned char *end, uint64_t bytes)
+{
+    uint64_t bits = bytes * 8;
+    int i;
+
+    for (i = 1; i <= 8; i++){
+        end[-i] = (unsigned char)bits;
+        bits >>= 8;
+    }
+}
+
+/* Prepares the inner hash of a message. The auth data field of the packet is
+ * set to 0 until the lane is finished */
+static int
+hmac_lane_init(hmac_lane_t *lane, hmac_auth_req_t *req)
+{
+    const unsigned char *pkt = (const unsigned char *)req->packet;
+    size_t rem, tail_blocks;
+
+    lane->req = req;
+    if (!req->key || (lane->st = hmac_key_state(req->key, req->key_id,
+            &lane->auth_data_len)) == NULL){
         return (BAD);
     }
+    lane->fns = req->key_id == HMAC_SHA_1_96 ? &hmac_sha1_fns : &hmac_sha256_fns;
+    memcpy(lane->auth_data_copy, req->auth_data_pos, lane->auth_data_len);
+    memset(req->auth_data_pos, 0, lane->auth_data_len);
+
+    rem = req->pckt_len % HMAC_BLOCK_SIZE;
+    tail_blocks = rem < HMAC_BLOCK_SIZE - 8 ? 1 : 2;
+    memset(lane->tail, 0, sizeof(lane->tail));
+    memcpy(lane->tail, pkt + req->pckt_len - rem, rem);
+    lane->tail[rem] = 0x80;
+    /* The inner padded key is the first block of the hashed data */
+    hmac_put_len(lane->tail + tail_blocks * HMAC_BLOCK_SIZE,
+            HMAC_BLOCK_SIZE + req->pckt_len);
 
-    if ((strncmp((char *)auth_data_pos, (char *)auth_data_copy, auth_data_len)) == 0) {
-        free(auth_data_copy);
-        return(GOOD);
-    } else {
-        free(auth_data_copy);
-        return(BAD);
+    memcpy(lane->h, lane->st->inner_h, sizeof(lane->h));
+    lane->seg[0] = pkt;
+    lane->seg_blocks[0] = req->pckt_len / HMAC_BLOCK_SIZE;
+    lane->seg[1] = lane->tail;
+    lane->seg_blocks[1] = tail_blocks;
+    lane->seg_idx = 0;
+
+    return (GOOD);
+}
+
+/* Blocks left in the current segment of the lane */
+static size_t
+hmac_lane_blocks(hmac_lane_t *lane)
+{
+    while (lane->seg_idx < 2 && lane->seg_blocks[lane->seg_idx] == 0){
+        lane->seg_idx++;
     }
+    return (lane->seg_idx < 2 ? lane->seg_blocks[lane->seg_idx] : 0);
 }
 
+static void
+hmac_lane_consume(hmac_lane_t *lane, size_t blocks)
+{
+    lane->seg[lane->seg_idx] += blocks * HMAC_BLOCK_SIZE;
+    lane->seg_blocks[lane->seg_idx] -= blocks;
+}
+
+static void
+hmac_lane_run(hmac_lane_t *lane, size_t blocks)
+{
+    lane->fns->blocks(lane->h, lane->seg[lane->seg_idx], blocks);
+    hmac_lane_consume(lane, blocks);
+}
+
+/* Replaces the inner hash by the block of the outer hash */
+static void
+hmac_lane_outer_block(hmac_lane_t *lane, unsigned char *blk)
+{
+    size_t dlen = mbedtls_md_get_size(lane->st->inner.md_info), i;
+
+    memset(blk, 0, HMAC_BLOCK_SIZE);
+    for (i = 0; i < dlen / 4; i++){
+        blk[4 * i] = (unsigned char)(lane->h[i] >> 24);
+        blk[4 * i + 1] = (unsigned char)(lane->h[i] >> 16);
+        blk[4 * i + 2] = (unsigned char)(lane->h[i] >> 8);
+        blk[4 * i + 3] = (unsigned char)lane->h[i];
+    }
+    blk[dlen] = 0x80;
+    hmac_put_len(blk + HMAC_BLOCK_SIZE, HMAC_BLOCK_SIZE + dlen);
+    memcpy(lane->h, lane->st->outer_h, sizeof(lane->h));
+}
+
+/* Restores the auth data of the packet and compares it in constant time */
+static void
+hmac_lane_finish(hmac_lane_t *lane)
+{
+    size_t i;
+    uint8_t diff = 0;
+
+    memcpy(lane->req->auth_data_pos, lane->auth_data_copy, lane->auth_data_len);
+    for (i = 0; i < lane->auth_data_len; i++){
+        diff |= (uint8_t)(lane->h[i / 4] >> (24 - 8 * (i % 4))) ^ lane->auth_data_copy[i];
+    }
+    lane->req->res = diff == 0 ? GOOD : BAD;
+}
+
+/* HMAC of one or two lanes of the same hash. The blocks of both lanes are
+ * compressed together while both have blocks left */
+static void
+hmac_lanes_compute(hmac_lane_t *a, hmac_lane_t *b)
+{
+    unsigned char blk_a[HMAC_BLOCK_SIZE], blk_b[HMAC_BLOCK_SIZE];
+    size_t na, nb, n;
+
+    for (;;){
+        na = hmac_lane_blocks(a);
+        nb = b ? hmac_lane_blocks(b) : 0;
+        if (na > 0 && nb > 0){
+            n = na < nb ? na : nb;
+            a->fns->blocks_x2(a->h, a->seg[a->seg_idx], b->h, b->seg[b->seg_idx], n);
+            hmac_lane_consume(a, n);
+            hmac_lane_consume(b, n);
+        }else if (na > 0){
+            hmac_lane_run(a, na);
+        }else if (nb > 0){
+            hmac_lane_run(b, nb);
+        }else{
+            break;
+        }
+    }
+
+    hmac_lane_outer_block(a, blk_a);
+    if (b){
+        hmac_lane_outer_block(b, blk_b);
+        a->fns->blocks_x2(a->h, blk_a, b->h, blk_b, 1);
+        hmac_lane_finish(b);
+    }else{
+        a->fns->blocks(a->h, blk_a, 1);
+    }
+    hmac_lane_finish(a);
+}
+
+/*
+ * Verify the auth data of a batch of messages. Messages using the same hash
+ * are verified in pairs, interleaving the compression of both of them.
+ * The result of each message is stored in its request. Returns the number of
+ * valid messages
+ */
+int
+check_auth_fields_batch(hmac_auth_req_t *reqs, int count)
+{
+    hmac_lane_t lanes[2][2];
+    hmac_lane_t *pending[2] = {NULL, NULL};
+    hmac_lane_t *lane;
+    int i, h, valid = 0;
+
+    for (i = 0; i < count; i++){
+        h = reqs[i].key_id == HMAC_SHA_256_128 ? 1 : 0;
+        lane = pending[h] == &lanes[h][0] ? &lanes[h][1] : &lanes[h][0];
+        if (hmac_lane_init(lane, &reqs[i]) != GOOD){
+            reqs[i].res = BAD;
+        }else if (pending[h] == NULL){
+            pending[h] = lane;
+        }else{
+            hmac_lanes_compute(pending[h], lane);
+            pending[h] = NULL;
+        }
+    }
+    for (h = 0; h < 2; h++){
+        if (pending[h]){
+            hmac_lanes_compute(pending[h], NULL);
+        }
+    }
+
+    for (i = 0; i < count; i++){
+        if (reqs[i].res == GOOD){
+            valid++;
+        }
+    }
+    return (valid);
+}
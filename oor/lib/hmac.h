@@ -22,13 +22,58 @@
 
 #include <stdint.h>
 
+#include "../elibs/mbedtls/md.h"
+
 #define SHA1_AUTH_DATA_LEN         20
 #define SHA256_AUTH_DATA_LEN       32
 
-int complete_auth_fields(uint8_t key_id, const char *key, void *packet, size_t pckt_len,
+/* Hash state of an HMAC key once the inner and outer padded keys have been
+ * processed. The work context is used to compute the HMAC of a message.
+ * The chaining values of both states are also kept as words for the batch
+ * verification, which works directly with the compression function */
+typedef struct hmac_md_state_ {
+    mbedtls_md_context_t inner;
+    mbedtls_md_context_t outer;
+    mbedtls_md_context_t work;
+    uint32_t inner_h[8];
+    uint32_t outer_h[8];
+} hmac_md_state_t;
+
+/* Authentication key shared with a Map-Server, a site or an RTR. The states
+ * of the supported hash functions are computed when the key is created, so
+ * authenticating a message only costs the inner and outer hash passes */
+typedef struct hmac_key_ {
+    char *key;
+    hmac_md_state_t sha1;
+    hmac_md_state_t sha256;
+} hmac_key_t;
+
+hmac_key_t *hmac_key_new(const char *key);
+void hmac_key_del(hmac_key_t *hkey);
+static inline const char *hmac_key_str(hmac_key_t *hkey);
+
+int complete_auth_fields(uint8_t key_id, hmac_key_t *key, void *packet, size_t pckt_len,
         void *auth_data_pos);
 
-int check_auth_field(uint8_t key_id, const char *key, void *packet, size_t pckt_len,
+int check_auth_field(uint8_t key_id, hmac_key_t *key, void *packet, size_t pckt_len,
         void *auth_data_pos);
 
+/* Message whose authentication data is verified by check_auth_fields_batch */
+typedef struct hmac_auth_req_ {
+    uint8_t key_id;
+    hmac_key_t *key;
+    void *packet;
+    size_t pckt_len;
+    void *auth_data_pos;
+    int res;                /* GOOD or BAD once verified */
+} hmac_auth_req_t;
+
+int check_auth_fields_batch(hmac_auth_req_t *reqs, int count);
+
+static inline const char *
+hmac_key_str(hmac_key_t *hkey)
+{
+    return (hkey->key);
+}
+
 #endif /* HMAC_H_ */
@@ -99,6 +99,12 @@ htable_ptrs_destroy(htable_ptrs_t *ht)
     free(ht);
 }
 
+int
+htable_ptrs_size(htable_ptrs_t *ht)
+{
+    return (kh_size(ht->htable));
+}
+
 glist_t *
 htable_ptrs_keys(htable_ptrs_t *ht)
 {
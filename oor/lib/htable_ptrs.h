@@ -47,6 +47,7 @@ void htable_ptrs_insert(htable_ptrs_t *ht, void *key, void *val);
 void *htable_ptrs_remove(htable_ptrs_t *, void *);
 void *htable_ptrs_lookup(htable_ptrs_t *, void *);
 void htable_ptrs_destroy(htable_ptrs_t *sh);
+int htable_ptrs_size(htable_ptrs_t *ht);
 glist_t *htable_ptrs_keys(htable_ptrs_t *sh);
 glist_t *htable_ptrs_values(htable_ptrs_t *ht);
 
@@ -30,15 +30,42 @@
 
 
 
-int
-create_tun_tap(iface_type_t type, const char *iface_name, int mtu)
+/* Open a queue of the tun/tap device. The device is created if it doesn't
+ * exist */
+static int
+tun_tap_open_queue(const char *iface_name, int flags)
 {
     struct ifreq ifr;
-    int err = 0;
-    int tmpsocket = 0;
-    int flags = IFF_TAP | IFF_NO_PI; // Create a tunnel without persistence
     char *clonedev = CLONEDEV;
-    int receive_fd;
+    int fd;
+
+    /* open the clone device */
+    if( (fd = open(clonedev, O_RDWR)) < 0 ) {
+        OOR_LOG(LCRIT, "TUN/TAP: Failed to open clone device");
+        return(BAD);
+    }
+
+    memset(&ifr, 0, sizeof(ifr));
+
+    ifr.ifr_flags = flags;
+    strncpy(ifr.ifr_name, iface_name, IFNAMSIZ - 1);
+
+    // try to create the device
+    if (ioctl(fd, TUNSETIFF, (void *) &ifr) < 0) {
+        close(fd);
+        OOR_LOG(LCRIT, "TUN/TAP: Failed to create tunnel interface: %s.", strerror(errno));
+        if (errno == 16){
+            OOR_LOG(LCRIT, "Check no other instance of oor is running. Exiting ...");
+        }
+        return(BAD);
+    }
+    return (fd);
+}
+
+static int
+tun_tap_flags(iface_type_t type)
+{
+    int flags = IFF_TAP | IFF_NO_PI; // Create a tunnel without persistence
 
     switch (type){
     case TUN:
@@ -51,6 +78,21 @@ create_tun_tap(iface_type_t type, const char *iface_name, int mtu)
         OOR_LOG(LCRIT, "create_tun_tap: Unknown interface type");
         return (BAD);
     }
+    return (flags);
+}
+
+static int
+tun_tap_create(iface_type_t type, const char *iface_name, int mtu, int extra_flags)
+{
+    struct ifreq ifr;
+    int err = 0;
+    int tmpsocket = 0;
+    int flags;
+    int receive_fd;
+
+    if ((flags = tun_tap_flags(type)) == BAD){
+        return (BAD);
+    }
 
     /* Arguments taken by the function:
      *
@@ -58,28 +100,13 @@ create_tun_tap(iface_type_t type, const char *iface_name, int mtu)
      *   space to hold the interface name if '\0' is passed
      * int flags: interface flags (eg, IFF_TUN etc.)
      */
-
-    /* open the clone device */
-    if( (receive_fd = open(clonedev, O_RDWR)) < 0 ) {
-        OOR_LOG(LCRIT, "TUN/TAP: Failed to open clone device");
-        return(BAD);
+    if ((receive_fd = tun_tap_open_queue(iface_name, flags | extra_flags)) == BAD){
+        return (BAD);
     }
 
     memset(&ifr, 0, sizeof(ifr));
-
-    ifr.ifr_flags = flags;
     strncpy(ifr.ifr_name, iface_name, IFNAMSIZ - 1);
 
-    // try to create the device
-    if ((err = ioctl(receive_fd, TUNSETIFF, (void *) &ifr)) < 0) {
-        close(receive_fd);
-        OOR_LOG(LCRIT, "TUN/TAP: Failed to create tunnel interface: %s.", strerror(errno));
-        if (errno == 16){
-            OOR_LOG(LCRIT, "Check no other instance of oor is running. Exiting ...");
-        }
-        return(BAD);
-    }
-
     // get the ifindex for the tun/tap
     tmpsocket = socket(AF_INET, SOCK_DGRAM, 0); // Dummy socket for the ioctl, type/details unimportant
     if ((err = ioctl(tmpsocket, SIOCGIFINDEX, (void *)&ifr)) < 0) {
@@ -115,6 +142,37 @@ create_tun_tap(iface_type_t type, const char *iface_name, int mtu)
     return (receive_fd);
 }
 
+int
+create_tun_tap(iface_type_t type, const char *iface_name, int mtu)
+{
+    return (tun_tap_create(type, iface_name, mtu, 0));
+}
+
+/* Create a tun/tap device with nqueues queues. The descriptor of each queue is
+ * stored in fds. Packets sent to the device are distributed between the
+ * queues by flow */
+int
+create_tun_tap_multiqueue(iface_type_t type, const char *iface_name, int mtu,
+        int *fds, int nqueues)
+{
+    int i;
+
+    fds[0] = tun_tap_create(type, iface_name, mtu, IFF_MULTI_QUEUE);
+    if (fds[0] == BAD){
+        return (BAD);
+    }
+    for (i = 1; i < nqueues; i++){
+        fds[i] = tun_tap_open_queue(iface_name, tun_tap_flags(type) | IFF_MULTI_QUEUE);
+        if (fds[i] == BAD){
+            while (--i >= 0){
+                close(fds[i]);
+            }
+            return (BAD);
+        }
+    }
+    return (GOOD);
+}
+
 /*
  * bring_up_iface()
  *
@@ -37,7 +37,7 @@ lisp_site_prefix_init(lisp_addr_t *eid, uint32_t iid, int key_type, char *key,
         sp->eid_prefix = lisp_addr_clone(eid);
     }
     sp->key_type = key_type;
-    sp->key = strdup(key);
+    sp->key = hmac_key_new(key);
     sp->accept_more_specifics = more_specifics;
     sp->proxy_reply = proxy_reply;
     sp->merge = merge;
@@ -53,7 +53,7 @@ lisp_site_prefix_del(lisp_site_prefix_t *sp)
     if (sp->eid_prefix)
         lisp_addr_del(sp->eid_prefix);
     if (sp->key)
-        free(sp->key);
+        hmac_key_del(sp->key);
     free(sp);
 }
 
@@ -62,5 +62,66 @@ lisp_reg_site_del(lisp_reg_site_t *rs)
 {
     stop_timers_from_obj(rs,ptrs_to_timers_ht,nonces_ht);
     mapping_del(rs->site_map);
+    lisp_reg_site_unset_rec(rs);
+    lisp_reg_site_unset_proxy_mrep(rs);
     free(rs);
 }
+
+/* FNV-1a digest of the bytes of a mapping record */
+uint32_t
+lisp_reg_site_rec_digest(uint8_t *rec, uint32_t len)
+{
+    uint32_t digest = 2166136261u;
+    uint32_t i;
+
+    for (i = 0; i < len; i++){
+        digest ^= rec[i];
+        digest *= 16777619u;
+    }
+    return (digest);
+}
+
+/* Store a copy of the last registered record of the site. The Map-Notify
+ * record of the previous one is no longer valid */
+void
+lisp_reg_site_set_rec(lisp_reg_site_t *rs, lisp_site_prefix_t *sp,
+        uint8_t *rec, uint32_t len, uint32_t digest)
+{
+    lisp_reg_site_unset_rec(rs);
+    rs->rec = xmalloc(len);
+    memcpy(rs->rec, rec, len);
+    rs->rec_len = len;
+    rs->rec_digest = digest;
+    rs->site_pref = sp;
+}
+
+void
+lisp_reg_site_set_ntf_rec(lisp_reg_site_t *rs, uint8_t *ntf_rec, uint32_t len)
+{
+    free(rs->ntf_rec);
+    rs->ntf_rec = xmalloc(len);
+    memcpy(rs->ntf_rec, ntf_rec, len);
+    rs->ntf_rec_len = len;
+}
+
+void
+lisp_reg_site_unset_rec(lisp_reg_site_t *rs)
+{
+    free(rs->rec);
+    free(rs->ntf_rec);
+    rs->rec = NULL;
+    rs->ntf_rec = NULL;
+    rs->rec_len = 0;
+    rs->ntf_rec_len = 0;
+    rs->site_pref = NULL;
+}
+
+/* To be called each time the mapping of the site changes */
+void
+lisp_reg_site_unset_proxy_mrep(lisp_reg_site_t *rs)
+{
+    if (rs->proxy_mrep){
+        lisp_msg_destroy(rs->proxy_mrep);
+        rs->proxy_mrep = NULL;
+    }
+}
@@ -28,13 +28,23 @@ typedef struct lisp_site_prefix {
     uint8_t proxy_reply;
     uint8_t accept_more_specifics;
     lisp_key_type_e key_type;
-    char *key;
+    hmac_key_t *key;
     uint8_t merge;
 } lisp_site_prefix_t;
 
 typedef struct lisp_reg_site {
     mapping_t *site_map;
     uint8_t proxy_reply;
+    /* Bytes of the last registered record and the Map-Notify record built
+     * from it. Used to answer unchanged refreshes without parsing them */
+    lisp_site_prefix_t *site_pref;
+    uint8_t *rec;
+    uint32_t rec_len;
+    uint32_t rec_digest;
+    uint8_t *ntf_rec;
+    uint32_t ntf_rec_len;
+    /* Map-Reply sent on behalf of the site while the mapping doesn't change */
+    lbuf_t *proxy_mrep;
 } lisp_reg_site_t;
 
 lisp_site_prefix_t *lisp_site_prefix_init(lisp_addr_t *eid_prefix, uint32_t iid,
@@ -42,6 +52,13 @@ lisp_site_prefix_t *lisp_site_prefix_init(lisp_addr_t *eid_prefix, uint32_t iid,
         uint8_t merge);
 void lisp_site_prefix_del(lisp_site_prefix_t *sp);
 void lisp_reg_site_del(lisp_reg_site_t *rs);
+uint32_t lisp_reg_site_rec_digest(uint8_t *rec, uint32_t len);
+void lisp_reg_site_set_rec(lisp_reg_site_t *rs, lisp_site_prefix_t *sp,
+        uint8_t *rec, uint32_t len, uint32_t digest);
+void lisp_reg_site_set_ntf_rec(lisp_reg_site_t *rs, uint8_t *ntf_rec,
+        uint32_t len);
+void lisp_reg_site_unset_rec(lisp_reg_site_t *rs);
+void lisp_reg_site_unset_proxy_mrep(lisp_reg_site_t *rs);
 
 static inline lisp_addr_t *
 lsite_prefix(lisp_site_prefix_t *ls) {
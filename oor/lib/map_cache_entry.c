@@ -34,6 +34,7 @@ mcache_entry_new()
 
     mce->active = NOT_ACTIVE;
     mce->timestamp = time(NULL);
+    mce->activity = mcache_activity_new();
 
     return(mce);
 }
@@ -77,6 +78,8 @@ mcache_entry_del(mcache_entry_t *entry)
     if (entry->dev_specific_data != NULL){
         entry->dev_data_del (entry->dev_specific_data);
     }
+    lisp_addr_del(entry->requester);
+    mcache_activity_unref(entry->activity);
 
     free(entry);
 }
@@ -88,6 +91,75 @@ mcache_entry_eid(mcache_entry_t *mce)
     return(mapping_eid(mce->mapping));
 }
 
+/* Approximate memory used by the entry and its mapping */
+uint32_t
+mcache_entry_mem_size(mcache_entry_t *mce)
+{
+    mapping_t *map = mcache_entry_mapping(mce);
+    uint32_t size;
+
+    size = sizeof(mcache_entry_t) + sizeof(mcache_activity_t) + sizeof(mapping_t);
+    if (map->locators_lists){
+        size += glist_size(map->locators_lists) * (sizeof(glist_t) + sizeof(glist_entry_t));
+    }
+    size += mapping_locator_count(map) * (sizeof(locator_t) + sizeof(lisp_addr_t)
+            + sizeof(glist_entry_t));
+
+    return (size);
+}
+
+/* Static entries and the entries of the PeTRs are never evicted */
+uint8_t
+mcache_entry_evictable(mcache_entry_t *mce)
+{
+    lisp_addr_t *eid = mcache_entry_eid(mce);
+
+    if (mce->how_learned != MCE_DYNAMIC){
+        return (FALSE);
+    }
+    if (lisp_addr_is_ip_pref(eid) && lisp_addr_get_plen(eid) == 0){
+        return (FALSE);
+    }
+    return (TRUE);
+}
+
+void
+mcache_entry_set_requester(mcache_entry_t *mce, lisp_addr_t *requester)
+{
+    lisp_addr_del(mce->requester);
+    mce->requester = requester ? lisp_addr_clone(requester) : NULL;
+}
+
+mcache_activity_t *
+mcache_activity_new()
+{
+    mcache_activity_t *act = xzalloc(sizeof(mcache_activity_t));
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    act->last_used = (uint32_t)ts.tv_sec;
+    act->refs = 1;
+    return (act);
+}
+
+mcache_activity_t *
+mcache_activity_ref(mcache_activity_t *act)
+{
+    __atomic_add_fetch(&act->refs, 1, __ATOMIC_RELAXED);
+    return (act);
+}
+
+void
+mcache_activity_unref(mcache_activity_t *act)
+{
+    if (!act){
+        return;
+    }
+    if (__atomic_sub_fetch(&act->refs, 1, __ATOMIC_ACQ_REL) == 0){
+        free(act);
+    }
+}
+
 inline uint8_t
 mcache_has_locators(mcache_entry_t *m)
 {
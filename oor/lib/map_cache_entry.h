@@ -39,6 +39,17 @@ typedef enum mce_type {
 #define NOT_ACTIVE                      0
 #define ACTIVE                          1
 
+/* Last time, in seconds of CLOCK_MONOTONIC, the data plane forwarded a packet
+ * using the entry, and how often it does it. It is shared with the flows of
+ * the data plane, which may outlive the entry, so it is released when the
+ * last reference is dropped */
+typedef struct mcache_activity_ {
+    uint32_t last_used;
+    /* Number of seconds in which the entry has been used */
+    uint32_t uses;
+    uint32_t refs;
+} mcache_activity_t;
+
 typedef void (*routing_info_del_fct)(void *);
 typedef void (*dev_specific_data_del_fct)(void *);
 
@@ -53,6 +64,7 @@ typedef struct map_cache_entry_ {
     uint8_t active;
     uint8_t active_witin_period;
     time_t timestamp;
+    mcache_activity_t *activity;
 
     /* Routing info */
     void *                  routing_info;
@@ -64,6 +76,17 @@ typedef struct map_cache_entry_ {
 
     /* EID that requested the mapping. Helps with timers */
     lisp_addr_t *requester;
+
+    /* Position in the eviction list of the map cache. Only the dynamic
+     * entries are linked */
+    struct map_cache_entry_ *evict_prev;
+    struct map_cache_entry_ *evict_next;
+    /* Activity of the entry the last time it was checked for eviction and
+     * chances left before being evicted */
+    uint32_t evict_seen;
+    uint32_t evict_credit;
+    /* Memory accounted by the map cache for the entry */
+    uint32_t size;
 } mcache_entry_t;
 
 mcache_entry_t *mcache_entry_new();
@@ -85,7 +108,17 @@ static inline void *mcache_entry_routing_info(mcache_entry_t *);
 static inline void mcache_entry_set_routing_info(mcache_entry_t *, void *,
         routing_info_del_fct);
 lisp_addr_t *mcache_entry_eid(mcache_entry_t *mce);
-
+uint32_t mcache_entry_mem_size(mcache_entry_t *mce);
+uint8_t mcache_entry_evictable(mcache_entry_t *mce);
+void mcache_entry_set_requester(mcache_entry_t *mce, lisp_addr_t *requester);
+
+mcache_activity_t *mcache_activity_new();
+mcache_activity_t *mcache_activity_ref(mcache_activity_t *act);
+void mcache_activity_unref(mcache_activity_t *act);
+static inline void mcache_activity_touch(mcache_activity_t *act, uint32_t now);
+static inline uint32_t mcache_activity_last_used(mcache_activity_t *act);
+static inline void mcache_activity_set_last_used(mcache_activity_t *act, uint32_t last_used);
+static inline uint32_t mcache_activity_uses(mcache_activity_t *act);
 
 static inline mapping_t *
 mcache_entry_mapping(mcache_entry_t* mce)
@@ -132,5 +165,36 @@ mcache_entry_set_routing_info(mcache_entry_t *m, void *routing_inf, routing_info
     m->routing_inf_del = del_fct;
 }
 
+/* Called by the data plane for each packet. The shared cache line is only
+ * written once per second. Concurrent updates may lose a use, which is
+ * harmless as it is only used to rank the entries */
+static inline void
+mcache_activity_touch(mcache_activity_t *act, uint32_t now)
+{
+    if (__atomic_load_n(&act->last_used, __ATOMIC_RELAXED) != now){
+        __atomic_store_n(&act->last_used, now, __ATOMIC_RELAXED);
+        __atomic_store_n(&act->uses, __atomic_load_n(&act->uses, __ATOMIC_RELAXED) + 1,
+                __ATOMIC_RELAXED);
+    }
+}
+
+static inline uint32_t
+mcache_activity_last_used(mcache_activity_t *act)
+{
+    return (__atomic_load_n(&act->last_used, __ATOMIC_RELAXED));
+}
+
+/* Only used before the entry is shared with the data plane */
+static inline void
+mcache_activity_set_last_used(mcache_activity_t *act, uint32_t last_used)
+{
+    __atomic_store_n(&act->last_used, last_used, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t
+mcache_activity_uses(mcache_activity_t *act)
+{
+    return (__atomic_load_n(&act->uses, __ATOMIC_RELAXED));
+}
 
 #endif /* MAP_CACHE_ENTRY_H_ */
@@ -629,8 +629,8 @@ mdb_get_shortest_negative_prefix(mdb_t *db, lisp_addr_t *laddr)
     patricia_node_t *node;
     lisp_addr_t *pref, *neg_pref;
     prefix_t aux_pref;
-    uint8_t mask, pos1, pos2;
-    uint32_t *sub_addr, flag = 1, afi;
+    uint8_t mask;
+    uint32_t afi;
 
     pref=lisp_addr_new_lafi(LM_AFI_IPPREF);
     afi = lisp_addr_ip_afi(laddr);
@@ -641,16 +641,11 @@ mdb_get_shortest_negative_prefix(mdb_t *db, lisp_addr_t *laddr)
     node = _find_node(db, laddr, EXACT);
     if (node){
         if (node->parent){
+            /* The requested address up to the bit where it branches from
+             * the rest of entries. That bit is already the one of the side
+             * of the requested address */
             memcpy(&aux_pref,node->prefix,sizeof(prefix_t));
             mask = node->parent->bit + 1;
-            if (node->parent->r == node){
-               /* Set 1 in the last bit of the mask */
-               sub_addr = (uint32_t *)&(aux_pref.add);
-               pos1 = mask/32;
-               pos2 = mask%32;
-               flag = flag < (32 - pos2);
-               sub_addr[pos1] =  sub_addr[pos1] | flag;
-            }
             ip_addr_init(lisp_addr_ip(pref),(void *)&(aux_pref.add), afi);
             lisp_addr_set_plen(pref,mask);
             pref_conv_to_netw_pref(pref);
@@ -680,6 +675,59 @@ mdb_get_shortest_negative_prefix(mdb_t *db, lisp_addr_t *laddr)
     return (neg_pref);
 }
 
+/* Check if the database has entries more specific than the IP prefix, or IID
+ * and IP prefix, laddr */
+uint8_t
+mdb_has_more_specific(mdb_t *db, lisp_addr_t *laddr)
+{
+    patricia_tree_t *pt;
+    patricia_node_t *node, *it;
+    lisp_addr_t *ip_pref;
+    prefix_t *prefix;
+    u_char *addr, *it_addr;
+    uint8_t plen, found = FALSE;
+
+    ip_pref = lisp_addr_get_ip_pref_addr(laddr);
+    if (!ip_pref){
+        return (FALSE);
+    }
+    pt = _get_local_db_for_addr(db, laddr);
+    if (!pt){
+        return (FALSE);
+    }
+    plen = lisp_addr_ip_get_plen(ip_pref);
+    prefix = pt_make_ip_prefix(lisp_addr_ip_get_addr(ip_pref), plen);
+    if (!prefix){
+        return (FALSE);
+    }
+    addr = prefix_touchar(prefix);
+
+    /* All the prefixes starting with the first plen bits of laddr are below
+     * the first node of its path that tests a bit beyond them */
+    node = pt->head;
+    while (node && node->bit < plen){
+        if (BIT_TEST(addr[node->bit >> 3], 0x80 >> (node->bit & 0x07))){
+            node = node->r;
+        }else{
+            node = node->l;
+        }
+    }
+    if (node){
+        PATRICIA_WALK(node, it) {
+            it_addr = prefix_touchar(it->prefix);
+            if (it->data && it->prefix->bitlen > plen
+                    && memcmp(it_addr, addr, plen >> 3) == 0
+                    && ((plen & 0x07) == 0 || ((it_addr[plen >> 3] ^ addr[plen >> 3])
+                            & (0xff << (8 - (plen & 0x07)))) == 0)){
+                found = TRUE;
+                break;
+            }
+        } PATRICIA_WALK_END;
+    }
+    Deref_Prefix(prefix);
+    return (found);
+}
+
 inline int
 mdb_n_entries(mdb_t *mdb) {
     return(mdb->n_entries);
@@ -27,6 +27,11 @@
 #include "../oor_external.h"
 /* needed for hashword */
 #include "../elibs/bob/lookup3.c"
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
 #include "../liblisp/lisp_address.h"
 
 #define LISP_CONTROL_PORT 4342
@@ -272,6 +277,114 @@ pkt_push_inner_udp_and_ip(lbuf_t *b, uint16_t sp, uint16_t dp, ip_addr_t *sip,
     return(GOOD);
 }
 
+/* Build in 'tmpl' the outer IP and UDP headers followed by the encapsulation
+ * header 'shim'. The UDP checksum of IPv4 packets is only computed when
+ * 'udp_csum' is set. It is always computed for IPv6 (RFC 2460) */
+int
+pkt_hdr_tmpl_init(pkt_hdr_tmpl_t *tmpl, uint16_t sp, uint16_t dp,
+        ip_addr_t *sip, ip_addr_t *dip, void *shim, int shim_len, uint8_t udp_csum)
+{
+    lbuf_t b;
+    uint8_t buf[PKT_HDR_TMPL_MAX_LEN];
+    struct ip *iph;
+    uint16_t *words;
+
+    memset(tmpl, 0, sizeof(pkt_hdr_tmpl_t));
+    if (shim_len > PKT_HDR_TMPL_MAX_SHIM_LEN) {
+        return(BAD);
+    }
+
+    lbuf_use_stack(&b, buf, PKT_HDR_TMPL_MAX_LEN);
+    lbuf_reserve(&b, PKT_HDR_TMPL_MAX_LEN);
+    lbuf_push(&b, shim, shim_len);
+    pkt_push_udp(&b, sp, dp);
+    if (pkt_push_ip(&b, sip, dip, IPPROTO_UDP) == NULL) {
+        OOR_LOG(LDBG_1, "pkt_hdr_tmpl_init: Failed to build IP header");
+        return(BAD);
+    }
+
+    tmpl->len = lbuf_size(&b);
+    tmpl->ip_len = tmpl->len - sizeof(struct udphdr) - shim_len;
+    tmpl->afi = ip_addr_afi(sip);
+    memcpy(tmpl->hdr, lbuf_data(&b), tmpl->len);
+
+    if (tmpl->afi == AF_INET) {
+        iph = (struct ip *)tmpl->hdr;
+        tmpl->udp_csum = udp_csum;
+        tmpl->ip_id = ntohs(iph->ip_id);
+        /* ip_off, ip_src and ip_dst. The checksum word is not included */
+        words = (uint16_t *)iph;
+        tmpl->ip_sum = words[3] + words[6] + words[7] + words[8] + words[9];
+    } else {
+        tmpl->udp_csum = TRUE;
+    }
+
+    return(GOOD);
+}
+
+/* Encapsulate the packet in 'b' with the headers of 'tmpl'. The TTL and the
+ * TOS of the inner IP header are copied to the outer one */
+int
+pkt_push_hdr_tmpl(lbuf_t *b, pkt_hdr_tmpl_t *tmpl)
+{
+    struct ip *iph;
+    struct ip6_hdr *ip6h;
+    struct udphdr *uh;
+    uint16_t *words;
+    uint32_t sum;
+    int ttl = 0, tos = 0, udp_len;
+
+    if (tmpl->len == 0) {
+        return(BAD);
+    }
+
+    ip_hdr_ttl_and_tos(lbuf_data(b), &ttl, &tos);
+
+    udp_len = lbuf_size(b) + tmpl->len - tmpl->ip_len;
+    lbuf_push_uninit(b, tmpl->len - tmpl->ip_len);
+    lbuf_reset_udp(b);
+    lbuf_push_uninit(b, tmpl->ip_len);
+    lbuf_reset_ip(b);
+    memcpy(lbuf_data(b), tmpl->hdr, tmpl->len);
+
+    uh = lbuf_udp(b);
+    udplen(uh) = htons(udp_len);
+
+    switch (tmpl->afi) {
+    case AF_INET:
+        iph = lbuf_ip(b);
+        /* ttl = 0 workaround of uClibc. See ip_hdr_set_ttl_and_tos */
+        if (ttl != 0) {
+            iph->ip_ttl = ttl;
+        }
+        iph->ip_tos = tos;
+        iph->ip_len = htons(tmpl->ip_len + udp_len);
+        iph->ip_id = htons(++tmpl->ip_id);
+
+        /* Only the words that change per packet are added to the sum */
+        words = (uint16_t *)iph;
+        sum = tmpl->ip_sum + words[0] + words[1] + words[2] + words[4];
+        sum = (sum >> 16) + (sum & 0xffff);
+        sum += (sum >> 16);
+        iph->ip_sum = (uint16_t)~sum;
+        break;
+    case AF_INET6:
+        ip6h = lbuf_ip(b);
+        if (ttl != 0) {
+            ip6h->ip6_hops = ttl;
+        }
+        IPV6_SET_TC(ip6h, tos);
+        ip6h->ip6_plen = htons(udp_len);
+        break;
+    }
+
+    if (tmpl->udp_csum) {
+        udpsum(uh) = udp_checksum(uh, udp_len, lbuf_ip(b), tmpl->afi);
+    }
+
+    return(GOOD);
+}
+
 /* Fill the tuple with the 5 tuples of a packet:
  * (SRC IP, DST IP, PROTOCOL, SRC PORT, DST PORT) */
 int
@@ -386,67 +499,95 @@ pkt_parse_inner_5_tuple(lbuf_t *b, packet_tuple_t *tuple)
     return (GOOD);
 }
 
-/* Calculate the hash of the 5 tuples of a packet */
-uint32_t
-pkt_tuple_hash(packet_tuple_t *tuple)
+/* Hash a block of 32 bit words. When the target supports CRC32C instructions
+ * they are used followed by a final mix of the bits. Otherwise the hashword
+ * function of Bob Jenkins is used */
+static inline uint32_t
+pkt_hash_words(const uint32_t *words, size_t len, uint32_t seed)
 {
-    int hash = 0;
-    int len = 0;
-    int port = tuple->src_port;
-    uint32_t *tuples = NULL;
+#if defined(__SSE4_2__) || defined(__ARM_FEATURE_CRC32)
+    uint32_t hash = seed;
+    size_t i;
+
+    for (i = 0; i < len; i++){
+#if defined(__SSE4_2__)
+        hash = _mm_crc32_u32(hash, words[i]);
+#else
+        hash = __crc32cw(hash, words[i]);
+#endif
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+    return (hash);
+#else
+    return (hashword(words, len, seed));
+#endif
+}
 
-    port = port + ((int)tuple->dst_port << 16);
-    switch (lisp_addr_ip_afi(&tuple->src_addr)){
-    case AF_INET:
-        /* 1 integer src_addr
-         * + 1 integer dst_adr
-         * + 1 integer (ports)
-         * + 1 integer protocol
-         * + 1 iid*/
-        len = 5;
-        tuples = xmalloc(len * sizeof(uint32_t));
-        lisp_addr_copy_to(&tuples[0], &tuple->src_addr);
-        lisp_addr_copy_to(&tuples[1], &tuple->dst_addr);
-        tuples[2] = port;
-        tuples[3] = tuple->protocol;
-        tuples[4] = tuple->iid;
-        break;
-    case AF_INET6:
-        /* 4 integer src_addr
-         * + 4 integer dst_adr
-         * + 1 integer (ports)
-         * + 1 integer protocol
-         * + 1 iid */
-        len = 11;
-        tuples = xmalloc(len * sizeof(uint32_t));
-        lisp_addr_copy_to(&tuples[0], &tuple->src_addr);
-        lisp_addr_copy_to(&tuples[4], &tuple->dst_addr);
-        tuples[8] = port;
-        tuples[9] = tuple->protocol;
-        tuples[10] = tuple->iid;
-        break;
+/* Fill the fixed layout key of the tuple. Tuples are always built from IP
+ * packets: the ip address is accessed directly as it is also the first field
+ * of an IP prefix */
+void
+pkt_tuple_to_key(packet_tuple_t *tuple, pkt_tuple_key_t *key)
+{
+    ip_addr_t *src = &tuple->src_addr.ip;
+    ip_addr_t *dst = &tuple->dst_addr.ip;
+
+    if (src->afi == AF_INET){
+        memset(key, 0, sizeof(pkt_tuple_key_t));
+        memcpy(key->src_addr, &src->addr.v4, sizeof(struct in_addr));
+        memcpy(key->dst_addr, &dst->addr.v4, sizeof(struct in_addr));
+    }else{
+        memcpy(key->src_addr, &src->addr.v6, sizeof(struct in6_addr));
+        memcpy(key->dst_addr, &dst->addr.v6, sizeof(struct in6_addr));
+        key->pad = 0;
     }
+    key->src_port = tuple->src_port;
+    key->dst_port = tuple->dst_port;
+    key->protocol = tuple->protocol;
+    key->afi = src->afi;
+    key->iid = tuple->iid;
+}
+
+/* Hash of a key of len 32 bit words */
+uint32_t
+pkt_hash_key(const uint32_t *words, size_t len, uint32_t seed)
+{
+    return (pkt_hash_words(words, len, seed));
+}
 
+uint32_t
+pkt_tuple_key_hash(pkt_tuple_key_t *key)
+{
     /* XXX: why 2013 used as initial value? */
-    hash = hashword(tuples, len, 2013);
-    free(tuples);
-    return (hash);
+    return (pkt_hash_words((uint32_t *)key, PKT_TUPLE_KEY_WORDS, 2013));
+}
+
+/* Calculate the hash of the 5 tuples of a packet */
+uint32_t
+pkt_tuple_hash(packet_tuple_t *tuple)
+{
+    pkt_tuple_key_t key;
+
+    pkt_tuple_to_key(tuple, &key);
+    return (pkt_tuple_key_hash(&key));
 }
 
 /* Calculate the hash of the src, dst address of a packet */
 uint32_t
 pkt_src_dst_hash(lisp_addr_t *src_addr, lisp_addr_t *dst_addr)
 {
-    int hash = 0;
     int len = 0;
-    uint32_t *tuples = NULL;
+    uint32_t tuples[8];
 
     switch (lisp_addr_ip_afi(src_addr)){
     case AF_INET:
         /* 1 integer src_addr
          * + 1 integer dst_adr*/
         len = 2;
-        tuples = xmalloc(len * sizeof(uint32_t));
         lisp_addr_copy_to(&tuples[0], src_addr);
         lisp_addr_copy_to(&tuples[1], dst_addr);
         break;
@@ -454,26 +595,22 @@ pkt_src_dst_hash(lisp_addr_t *src_addr, lisp_addr_t *dst_addr)
         /* 4 integer src_addr
          * + 4 integer dst_adr */
         len = 8;
-        tuples = xmalloc(len * sizeof(uint32_t));
         lisp_addr_copy_to(&tuples[0], src_addr);
         lisp_addr_copy_to(&tuples[4], dst_addr);
         break;
     }
 
-    /* XXX: why 2013 used as initial value? */
-    hash = hashword(tuples, len, 2013);
-    free(tuples);
-    return (hash);
+    return (pkt_hash_words(tuples, len, 2013));
 }
 
 int
 pkt_tuple_cmp(packet_tuple_t *t1, packet_tuple_t *t2)
 {
-    return(t1->src_port == t2->src_port
-           && t1->dst_port == t2->dst_port
-           && (lisp_addr_cmp(&t1->src_addr, &t2->src_addr) == 0)
-           && (lisp_addr_cmp(&t1->dst_addr, &t2->dst_addr) == 0)
-           && t1->iid == t2->iid);
+    pkt_tuple_key_t k1, k2;
+
+    pkt_tuple_to_key(t1, &k1);
+    pkt_tuple_to_key(t2, &k2);
+    return (pkt_tuple_key_equal(&k1, &k2));
 }
 
 packet_tuple_t *
@@ -501,8 +638,8 @@ pkt_tuple_del(packet_tuple_t *tpl)
 char *
 pkt_tuple_to_char(packet_tuple_t *tpl)
 {
-    static char buf[2][200];
-    static int i=0;
+    static THREAD_LOCAL char buf[2][200];
+    static THREAD_LOCAL int i=0;
     size_t buf_size = sizeof(buf[0]);
     /* hack to allow more than one locator per line */
     i++; i = i % 2;
@@ -766,7 +903,7 @@ build_ip_udp_pcket(uint8_t *orig_pkt, int orig_pkt_len,lisp_addr_t *addr_from,
 char *
 ip_src_and_dst_to_char(struct iphdr *iph, char *fmt)
 {
-    static char buf[150];
+    static THREAD_LOCAL char buf[150];
     struct ip6_hdr *ip6h;
 
     *buf = '\0';
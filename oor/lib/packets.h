@@ -20,6 +20,7 @@
 #ifndef PACKETS_H_
 #define PACKETS_H_
 
+#include <string.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -73,6 +74,42 @@ typedef struct packet_tuple {
     uint32_t                        iid;
 } packet_tuple_t;
 
+/* Fixed layout key of a packet tuple used to hash and compare flows without
+ * allocating memory. Both addresses use 16 bytes (IPv4 ones are zero padded)
+ * so a key is processed as a contiguous block of 32 bit words */
+typedef struct pkt_tuple_key_ {
+    uint8_t                         src_addr[16];
+    uint8_t                         dst_addr[16];
+    uint16_t                        src_port;
+    uint16_t                        dst_port;
+    uint8_t                         protocol;
+    uint8_t                         afi;
+    uint16_t                        pad;
+    uint32_t                        iid;
+} pkt_tuple_key_t;
+
+#define PKT_TUPLE_KEY_WORDS (sizeof(pkt_tuple_key_t) / sizeof(uint32_t))
+
+/* Max length of the encapsulation header (LISP, VXLAN-GPE) carried after the
+ * outer UDP header of a header template */
+#define PKT_HDR_TMPL_MAX_SHIM_LEN 8
+#define PKT_HDR_TMPL_MAX_LEN    (sizeof(struct ip6_hdr) + sizeof(struct udphdr) \
+        + PKT_HDR_TMPL_MAX_SHIM_LEN)
+
+/* Outer IP, UDP and encapsulation headers prebuilt for a pair of RLOCs. When a
+ * packet is encapsulated, the template is copied in front of it and only the
+ * lengths, the IP ID, the TTL and the TOS are updated */
+typedef struct pkt_hdr_tmpl_ {
+    uint8_t                         hdr[PKT_HDR_TMPL_MAX_LEN];
+    uint8_t                         len;        /* 0 if not initialized */
+    uint8_t                         ip_len;
+    uint8_t                         afi;
+    uint8_t                         udp_csum;
+    uint16_t                        ip_id;
+    /* IPv4 header partial sum of the fields that don't change per packet */
+    uint32_t                        ip_sum;
+} pkt_hdr_tmpl_t;
+
 
 
 /*
@@ -107,12 +144,18 @@ int pkt_push_udp_and_ip(lbuf_t *, uint16_t, uint16_t, ip_addr_t *,
         ip_addr_t *);
 int pkt_push_inner_udp_and_ip(lbuf_t *b, uint16_t sp, uint16_t dp, ip_addr_t *sip,
         ip_addr_t *dip);
+int pkt_hdr_tmpl_init(pkt_hdr_tmpl_t *tmpl, uint16_t sp, uint16_t dp,
+        ip_addr_t *sip, ip_addr_t *dip, void *shim, int shim_len, uint8_t udp_csum);
+int pkt_push_hdr_tmpl(lbuf_t *b, pkt_hdr_tmpl_t *tmpl);
 int ip_hdr_set_ttl_and_tos(struct iphdr *, int ttl, int tos);
 int ip_hdr_ttl_and_tos(struct iphdr *, int *ttl, int *tos);
 
 int pkt_parse_5_tuple(lbuf_t *b, packet_tuple_t *tuple);
 
 int pkt_parse_inner_5_tuple(lbuf_t *b, packet_tuple_t *tuple);
+void pkt_tuple_to_key(packet_tuple_t *tuple, pkt_tuple_key_t *key);
+uint32_t pkt_hash_key(const uint32_t *words, size_t len, uint32_t seed);
+uint32_t pkt_tuple_key_hash(pkt_tuple_key_t *key);
 uint32_t pkt_tuple_hash(packet_tuple_t *tuple);
 uint32_t pkt_src_dst_hash(lisp_addr_t *src_addr, lisp_addr_t *dst_addr);
 int pkt_tuple_cmp(packet_tuple_t *t1, packet_tuple_t *t2);
@@ -123,6 +166,12 @@ int pkt_tuple_is_lisp(packet_tuple_t *tpl);
 
 char * ip_src_and_dst_to_char(struct iphdr *iph, char *fmt);
 
+static inline int
+pkt_tuple_key_equal(pkt_tuple_key_t *k1, pkt_tuple_key_t *k2)
+{
+    return (memcmp(k1, k2, sizeof(pkt_tuple_key_t)) == 0);
+}
+
 void pkt_add_uint32_in_3bytes (uint8_t *pkt, uint32_t val);
 uint32_t pkt_get_uint32_from_3bytes (uint8_t *pkt);
 
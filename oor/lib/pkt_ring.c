@@ -0,0 +1,323 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/udp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include "pkt_ring.h"
+#include "mem_util.h"
+#include "oor_log.h"
+#include "sockets-util.h"
+
+#define PKT_RING_MIN_BLOCKS     2
+/* Max bytes of a packet copied to the ring */
+#define PKT_RING_SNAP_LEN       0x40000
+
+static inline struct tpacket_block_desc *
+pkt_ring_block(pkt_ring_t *ring, int i)
+{
+    return ((struct tpacket_block_desc *)(ring->map + (size_t)i * PKT_RING_BLOCK_SIZE));
+}
+
+/* Classic BPF filter letting in the UDP packets addressed to the local host
+ * with destination port. The socket is SOCK_DGRAM so offsets are relative
+ * to the network header. IPv4 fragments and IPv6 packets with extension
+ * headers are not accepted */
+static int
+pkt_ring_attach_filter(int fd, int afi, uint16_t port)
+{
+    struct sock_filter filter_v4[] = {
+            BPF_STMT(BPF_LD | BPF_H | BPF_ABS, SKF_AD_OFF + SKF_AD_PKTTYPE),
+            BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, PACKET_OTHERHOST, 8, 0),
+            BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 9),                 /* Protocol */
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 6),
+            BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 6),                 /* MF and offset */
+            BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x3fff, 4, 0),
+            BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0),                /* IHL * 4 */
+            BPF_STMT(BPF_LD | BPF_H | BPF_IND, 2),                 /* UDP dport */
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, port, 0, 1),
+            BPF_STMT(BPF_RET | BPF_K, PKT_RING_SNAP_LEN),
+            BPF_STMT(BPF_RET | BPF_K, 0)
+    };
+    struct sock_filter filter_v6[] = {
+            BPF_STMT(BPF_LD | BPF_H | BPF_ABS, SKF_AD_OFF + SKF_AD_PKTTYPE),
+            BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, PACKET_OTHERHOST, 5, 0),
+            BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 6),                 /* Next header */
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 3),
+            BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 42),                /* UDP dport */
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, port, 0, 1),
+            BPF_STMT(BPF_RET | BPF_K, PKT_RING_SNAP_LEN),
+            BPF_STMT(BPF_RET | BPF_K, 0)
+    };
+    struct sock_fprog prog;
+
+    if (afi == AF_INET){
+        prog.filter = filter_v4;
+        prog.len = sizeof(filter_v4) / sizeof(struct sock_filter);
+    }else{
+        prog.filter = filter_v6;
+        prog.len = sizeof(filter_v6) / sizeof(struct sock_filter);
+    }
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0){
+        OOR_LOG(LERR, "pkt_ring_new: setsockopt SO_ATTACH_FILTER: %s", strerror(errno));
+        return (BAD);
+    }
+    return (GOOD);
+}
+
+/* UDP socket bound to port. Packets are received by the ring, so they are
+ * dropped by its filter instead of being queued */
+static int
+pkt_ring_open_dummy_socket(int afi, uint16_t port)
+{
+    struct sock_filter drop_all[] = {
+            BPF_STMT(BPF_RET | BPF_K, 0)
+    };
+    struct sock_fprog prog = {
+            .len = 1,
+            .filter = drop_all
+    };
+    int sock;
+
+    sock = open_udp_datagram_socket(afi);
+    if (sock == ERR_SOCKET){
+        return (ERR_SOCKET);
+    }
+    if (setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0
+            || bind_socket(sock, afi, NULL, port) != GOOD){
+        OOR_LOG(LERR, "pkt_ring_new: Couldn't open the UDP socket of port %d", port);
+        close(sock);
+        return (ERR_SOCKET);
+    }
+    return (sock);
+}
+
+/* Create a receive ring of size bytes (rounded to a multiple of the block
+ * size) for the packets of afi addressed to the UDP port. Requires
+ * CAP_NET_RAW */
+pkt_ring_t *
+pkt_ring_new(int afi, uint16_t port, uint32_t size)
+{
+    pkt_ring_t *ring;
+    struct tpacket_req3 req;
+    struct sockaddr_ll sll;
+    int version = TPACKET_V3;
+    int reserve = PKT_RING_HEADROOM;
+    uint16_t proto = afi == AF_INET ? ETH_P_IP : ETH_P_IPV6;
+
+    ring = xzalloc(sizeof(pkt_ring_t));
+    ring->afi = afi;
+    ring->map = MAP_FAILED;
+    ring->dummy_fd = ERR_SOCKET;
+    ring->nblocks = size / PKT_RING_BLOCK_SIZE;
+    if (ring->nblocks < PKT_RING_MIN_BLOCKS){
+        ring->nblocks = PKT_RING_MIN_BLOCKS;
+    }
+
+    /* No packet is queued until the socket is bound, once the filter and
+     * the ring are ready */
+    ring->fd = socket(AF_PACKET, SOCK_DGRAM, 0);
+    if (ring->fd < 0){
+        OOR_LOG(LERR, "pkt_ring_new: socket: %s", strerror(errno));
+        goto err;
+    }
+    if (pkt_ring_attach_filter(ring->fd, afi, port) != GOOD){
+        goto err;
+    }
+    if (setsockopt(ring->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0
+            || setsockopt(ring->fd, SOL_PACKET, PACKET_RESERVE, &reserve, sizeof(reserve)) < 0){
+        OOR_LOG(LERR, "pkt_ring_new: setsockopt: %s", strerror(errno));
+        goto err;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = PKT_RING_BLOCK_SIZE;
+    req.tp_block_nr = ring->nblocks;
+    req.tp_frame_size = PKT_RING_FRAME_SIZE;
+    req.tp_frame_nr = (PKT_RING_BLOCK_SIZE / PKT_RING_FRAME_SIZE) * ring->nblocks;
+    req.tp_retire_blk_tov = PKT_RING_BLOCK_TIMEOUT;
+    if (setsockopt(ring->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0){
+        OOR_LOG(LERR, "pkt_ring_new: setsockopt PACKET_RX_RING: %s", strerror(errno));
+        goto err;
+    }
+    ring->map_len = (size_t)PKT_RING_BLOCK_SIZE * ring->nblocks;
+    ring->map = mmap(NULL, ring->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+    if (ring->map == MAP_FAILED){
+        OOR_LOG(LERR, "pkt_ring_new: mmap: %s", strerror(errno));
+        goto err;
+    }
+
+    ring->dummy_fd = pkt_ring_open_dummy_socket(afi, port);
+    if (ring->dummy_fd == ERR_SOCKET){
+        goto err;
+    }
+
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(proto);
+    sll.sll_ifindex = 0;
+    if (bind(ring->fd, (struct sockaddr *)&sll, sizeof(sll)) < 0){
+        OOR_LOG(LERR, "pkt_ring_new: bind: %s", strerror(errno));
+        goto err;
+    }
+
+    OOR_LOG(LDBG_1, "pkt_ring_new: Receiving IPv%d packets to port %d from a ring of "
+            "%d blocks", afi == AF_INET ? 4 : 6, port, ring->nblocks);
+    return (ring);
+err:
+    pkt_ring_del(ring);
+    return (NULL);
+}
+
+void
+pkt_ring_del(pkt_ring_t *ring)
+{
+    if (!ring){
+        return;
+    }
+    if (ring->map != MAP_FAILED){
+        munmap(ring->map, ring->map_len);
+    }
+    if (ring->fd >= 0){
+        close(ring->fd);
+    }
+    if (ring->dummy_fd != ERR_SOCKET){
+        close(ring->dummy_fd);
+    }
+    free(ring);
+}
+
+/* Point the buffer to the network header of the packet. Like with raw
+ * sockets, IPv4 packets start at the IP header and IPv6 packets at the UDP
+ * header */
+static inline int
+pkt_ring_pkt_to_lbuf(pkt_ring_t *ring, struct tpacket3_hdr *hdr, lbuf_t *b,
+        data_pkt_inf_t *inf)
+{
+    uint8_t *data = (uint8_t *)hdr + hdr->tp_net;
+    struct ip *iph;
+    struct ip6_hdr *ip6h;
+
+    /* Truncated packets are discarded */
+    if (hdr->tp_snaplen < hdr->tp_len){
+        return (BAD);
+    }
+    lbuf_use_stack(b, data - PKT_RING_HEADROOM, PKT_RING_HEADROOM + hdr->tp_snaplen);
+    lbuf_reserve(b, PKT_RING_HEADROOM);
+    lbuf_set_size(b, hdr->tp_snaplen);
+
+    inf->afi = ring->afi;
+    if (ring->afi == AF_INET){
+        if (hdr->tp_snaplen < sizeof(struct ip) + sizeof(struct udphdr)){
+            return (BAD);
+        }
+        iph = (struct ip *)data;
+        inf->ttl = iph->ip_ttl;
+        inf->tos = iph->ip_tos;
+    }else{
+        if (hdr->tp_snaplen < sizeof(struct ip6_hdr) + sizeof(struct udphdr)){
+            return (BAD);
+        }
+        ip6h = (struct ip6_hdr *)data;
+        inf->ttl = ip6h->ip6_hlim;
+        inf->tos = (ntohl(ip6h->ip6_flow) >> 20) & 0xff;
+        lbuf_pull(b, sizeof(struct ip6_hdr));
+    }
+    return (GOOD);
+}
+
+/* Get up to count packets from the ring. The buffers point to the packets
+ * in the ring, which remain valid until pkt_ring_release is called */
+int
+pkt_ring_recv_batch(pkt_ring_t *ring, lbuf_t *bufs, data_pkt_inf_t *pkts_inf, int count)
+{
+    struct tpacket_block_desc *bd;
+    struct tpacket3_hdr *hdr;
+    int n = 0;
+
+    while (n < count){
+        if (ring->pkts_left == 0){
+            if (ring->cur_open){
+                /* Kept until released: its packets may still be in use */
+                ring->cur = (ring->cur + 1) % ring->nblocks;
+                ring->cur_open = FALSE;
+            }
+            if (ring->nheld == ring->nblocks){
+                break;
+            }
+            bd = pkt_ring_block(ring, ring->cur);
+            if (!(__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)){
+                break;
+            }
+            if (ring->nheld == 0){
+                ring->first_held = ring->cur;
+            }
+            ring->nheld++;
+            ring->cur_open = TRUE;
+            ring->pkts_left = bd->hdr.bh1.num_pkts;
+            ring->next_pkt = (uint8_t *)bd + bd->hdr.bh1.offset_to_first_pkt;
+            continue;
+        }
+
+        hdr = (struct tpacket3_hdr *)ring->next_pkt;
+        ring->next_pkt += hdr->tp_next_offset;
+        ring->pkts_left--;
+        if (pkt_ring_pkt_to_lbuf(ring, hdr, &bufs[n], &pkts_inf[n]) == GOOD){
+            n++;
+        }
+    }
+
+    return (n);
+}
+
+/* Return to the kernel the blocks whose packets have all been processed */
+void
+pkt_ring_release(pkt_ring_t *ring)
+{
+    struct tpacket_block_desc *bd;
+    int keep = ring->cur_open && ring->pkts_left > 0 ? 1 : 0;
+
+    while (ring->nheld > keep){
+        bd = pkt_ring_block(ring, ring->first_held);
+        __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        ring->first_held = (ring->first_held + 1) % ring->nblocks;
+        ring->nheld--;
+    }
+    if (ring->nheld == 0 && ring->cur_open){
+        /* The current block has been released */
+        ring->cur = ring->first_held;
+        ring->cur_open = FALSE;
+    }
+}
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,77 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef PKT_RING_H_
+#define PKT_RING_H_
+
+#include <stdint.h>
+#include <linux/if_packet.h>
+#include "lbuf.h"
+#include "sockets.h"
+
+/* Size of the blocks of the ring. Packets are appended to a block until it
+ * is full or its timeout expires and it is then handed over to user space */
+#define PKT_RING_BLOCK_SIZE     (1 << 17)
+#define PKT_RING_FRAME_SIZE     2048
+/* Max ms a non empty block is kept by the kernel */
+#define PKT_RING_BLOCK_TIMEOUT  1
+/* Headroom available before the network header of each packet */
+#define PKT_RING_HEADROOM       LBUF_STACK_OFFSET
+
+/* AF_PACKET socket with a TPACKET_V3 receive ring mapped in memory. A
+ * classic BPF filter only lets in the UDP packets addressed to a port.
+ * Packets are processed in place in the ring */
+typedef struct pkt_ring_ {
+    int fd;
+    /* UDP socket bound to the port to avoid ICMP port unreachable messages */
+    int dummy_fd;
+    int afi;
+    uint8_t *map;
+    size_t map_len;
+    int nblocks;
+    /* Blocks owned by user space: from first_held to the block being read */
+    int first_held;
+    int nheld;
+    /* Block being read and its packets not yet returned */
+    int cur;
+    uint8_t cur_open;
+    uint32_t pkts_left;
+    uint8_t *next_pkt;
+} pkt_ring_t;
+
+pkt_ring_t *pkt_ring_new(int afi, uint16_t port, uint32_t size);
+void pkt_ring_del(pkt_ring_t *ring);
+int pkt_ring_recv_batch(pkt_ring_t *ring, lbuf_t *bufs, data_pkt_inf_t *pkts_inf,
+        int count);
+void pkt_ring_release(pkt_ring_t *ring);
+
+static inline int
+pkt_ring_fd(pkt_ring_t *ring)
+{
+    return (ring->fd);
+}
+
+#endif /* PKT_RING_H_ */
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
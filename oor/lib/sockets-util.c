@@ -23,6 +23,7 @@
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
 
+#include "mem_util.h"
 #include "oor_log.h"
 #include "sockets-util.h"
 
@@ -348,6 +349,143 @@ send_raw_packet(int socket, const void *pkt, int plen, ip_addr_t *dip)
     return (GOOD);
 }
 
+send_batch_t *
+send_batch_new(int size)
+{
+    send_batch_t *batch;
+
+    batch = xzalloc(sizeof(send_batch_t));
+    batch->size = size;
+    batch->socks = xzalloc(size * sizeof(int));
+    batch->msgs = xzalloc(size * sizeof(struct mmsghdr));
+    batch->sock_msgs = xzalloc(size * sizeof(struct mmsghdr));
+    batch->iovs = xzalloc(size * sizeof(struct iovec));
+    batch->addrs = xzalloc(size * sizeof(*batch->addrs));
+    batch->sent = xzalloc(size * sizeof(uint8_t));
+
+    return (batch);
+}
+
+void
+send_batch_del(send_batch_t *batch)
+{
+    if (!batch){
+        return;
+    }
+    free(batch->socks);
+    free(batch->msgs);
+    free(batch->sock_msgs);
+    free(batch->iovs);
+    free(batch->addrs);
+    free(batch->sent);
+    free(batch);
+}
+
+/* Add a packet to the batch. dport is only used for datagram sockets. When the
+ * batch is full, the queued packets are sent before adding the new one */
+int
+send_batch_add_packet(send_batch_t *batch, int sock, const void *pkt, int plen,
+        ip_addr_t *dip, int dport)
+{
+    struct msghdr *msg;
+    int i;
+
+    if (batch->count == batch->size){
+        send_batch_flush(batch);
+    }
+
+    i = batch->count;
+    memset(&batch->addrs[i], 0, sizeof(batch->addrs[i]));
+    switch (ip_addr_afi(dip)) {
+    case AF_INET:
+        batch->addrs[i].s4.sin_family = AF_INET;
+        batch->addrs[i].s4.sin_port = htons(dport);
+        ip_addr_copy_to(&batch->addrs[i].s4.sin_addr, dip);
+        break;
+    case AF_INET6:
+        batch->addrs[i].s6.sin6_family = AF_INET6;
+        batch->addrs[i].s6.sin6_port = htons(dport);
+        ip_addr_copy_to(&batch->addrs[i].s6.sin6_addr, dip);
+        break;
+    default:
+        return(BAD);
+    }
+
+    batch->iovs[i].iov_base = (void *)pkt;
+    batch->iovs[i].iov_len = plen;
+
+    msg = &batch->msgs[i].msg_hdr;
+    memset(msg, 0, sizeof(struct msghdr));
+    msg->msg_name = &batch->addrs[i];
+    msg->msg_namelen = ip_addr_afi(dip) == AF_INET ?
+            sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6);
+    msg->msg_iov = &batch->iovs[i];
+    msg->msg_iovlen = 1;
+
+    batch->socks[i] = sock;
+    batch->count++;
+
+    return (GOOD);
+}
+
+static int
+send_mmsg_all(int sock, struct mmsghdr *msgs, int count)
+{
+    int sent = 0, nmsgs, errors = 0;
+
+    while (sent < count){
+        nmsgs = sendmmsg(sock, msgs + sent, count - sent, 0);
+        if (nmsgs < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            /* The first message of the remaining ones failed. Discard it
+             * and try with the next ones */
+            OOR_LOG(LDBG_2, "send_mmsg_all: send packet using fail descriptor %d failed -> %s",
+                    sock, strerror(errno));
+            errors++;
+            sent++;
+            continue;
+        }
+        sent += nmsgs;
+    }
+
+    return (errors);
+}
+
+/* Send all the queued packets. Packets are grouped by output socket preserving
+ * the order in which they were added. Returns the number of packets that could
+ * not be sent */
+int
+send_batch_flush(send_batch_t *batch)
+{
+    int i, j, sock, nmsgs, errors = 0;
+
+    if (batch->count == 0){
+        return (0);
+    }
+
+    memset(batch->sent, 0, batch->count);
+    for (i = 0; i < batch->count; i++){
+        if (batch->sent[i]){
+            continue;
+        }
+        sock = batch->socks[i];
+        nmsgs = 0;
+        for (j = i; j < batch->count; j++){
+            if (batch->sent[j] || batch->socks[j] != sock){
+                continue;
+            }
+            batch->sock_msgs[nmsgs++] = batch->msgs[j];
+            batch->sent[j] = TRUE;
+        }
+        errors += send_mmsg_all(sock, batch->sock_msgs, nmsgs);
+    }
+    batch->count = 0;
+
+    return (errors);
+}
+
 int
 send_datagram_packet (int sock, const void *packet, int packet_length,
         lisp_addr_t *addr_dest, int port_dest)
@@ -21,8 +21,26 @@
 #ifndef SOCKETS_UTIL_H_
 #define SOCKETS_UTIL_H_
 
+#include <sys/socket.h>
 #include "../liblisp/lisp_address.h"
 
+/* Packets queued to be sent with one sendmmsg call per output socket.
+ * Only references to the packets are stored: buffers should be kept
+ * until the batch is flushed */
+typedef struct send_batch_ {
+    int                 size;
+    int                 count;
+    int                 *socks;
+    struct mmsghdr      *msgs;
+    struct mmsghdr      *sock_msgs;
+    struct iovec        *iovs;
+    union {
+        struct sockaddr_in s4;
+        struct sockaddr_in6 s6;
+    }                   *addrs;
+    uint8_t             *sent;
+} send_batch_t;
+
 int open_ip_raw_socket(int afi);
 int open_udp_raw_socket(int afi);
 int opent_netlink_socket();
@@ -37,4 +55,15 @@ int send_raw_packet(int, const void *, int, ip_addr_t *);
 int send_datagram_packet (int sock, const void *packet, int packet_length,
         lisp_addr_t *addr_dest, int port_dest);
 
+send_batch_t *send_batch_new(int size);
+void send_batch_del(send_batch_t *batch);
+int send_batch_add_packet(send_batch_t *batch, int sock, const void *pkt,
+        int plen, ip_addr_t *dip, int dport);
+int send_batch_flush(send_batch_t *batch);
+
+static inline int send_batch_count(send_batch_t *batch)
+{
+    return (batch->count);
+}
+
 #endif /* SOCKETS_UTIL_H_ */
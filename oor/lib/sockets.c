@@ -20,6 +20,7 @@
 
 #include <netinet/in.h>
 #include <errno.h>
+#include <poll.h>
 #include <sys/socket.h>
 
 #include "oor_log.h"
@@ -35,6 +36,13 @@ sockmstr_create()
 {
     sockmstr_t *sm;
     sm = xzalloc(sizeof(sockmstr_t));
+    sm->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (sm->epoll_fd == -1){
+        OOR_LOG(LCRIT, "sockmstr_create: Couldn't create epoll instance: %s",
+                strerror(errno));
+        free(sm);
+        return (NULL);
+    }
     return (sm);
 }
 
@@ -65,16 +73,11 @@ sock_list_add(sock_list_t *lst, sock_t *sock)
 
     lst->tail = sock;
     lst->count++;
-    if (sock->fd > lst->maxfd) {
-        lst->maxfd = sock->fd;
-    }
-
 }
 
 static inline void
 sock_list_remove(sock_list_t *lst, struct sock *sock)
 {
-    int fd;
     if (sock->prev == NULL){
         lst->head = sock->next;
         if (sock->next != NULL){
@@ -86,24 +89,35 @@ sock_list_remove(sock_list_t *lst, struct sock *sock)
             sock->next->prev = sock->prev;
         }
     }
-    fd = sock->fd;
+    if (lst->tail == sock){
+        lst->tail = sock->prev;
+    }
     close(sock->fd);
     free(sock);
 
     lst->count--;
+}
 
-    if (fd == lst->maxfd){
-        sock= lst->head;
-        if (sock == NULL){
-            lst->maxfd = 0;
-        }
-        while (sock != NULL){
-            if (sock->fd > lst->maxfd) {
-                lst->maxfd = sock->fd;
-            }
-            sock = sock->next;
-        }
+/* Make room in the per fd arrays for the descriptor fd */
+static void
+sockmstr_grow_slots(sockmstr_t *m, int fd)
+{
+    int nslots = m->nslots > 0 ? m->nslots : 64;
+
+    while (nslots <= fd){
+        nslots <<= 1;
     }
+    m->slots = xrealloc(m->slots, nslots * sizeof(sock_slot_t));
+    memset(m->slots + m->nslots, 0, (nslots - m->nslots) * sizeof(sock_slot_t));
+    m->run = xrealloc(m->run, nslots * sizeof(int));
+    m->pending = xrealloc(m->pending, nslots * sizeof(int));
+    m->nslots = nslots;
+}
+
+static inline uint32_t
+sockmstr_epoll_flags(sockmstr_t *m)
+{
+    return (m->edge_triggered ? EPOLLIN | EPOLLET : EPOLLIN);
 }
 
 void
@@ -113,29 +127,20 @@ sockmstr_destroy(sockmstr_t *sm)
         return;
     }
     sock_list_remove_all(&sm->read);
+    close(sm->epoll_fd);
+    free(sm->slots);
+    free(sm->run);
+    free(sm->pending);
     free(sm);
     OOR_LOG(LDBG_1,"Sockets closed");
 }
 
 sock_t *
 sockmstr_register_get_by_fd(sockmstr_t *m, int fd){
-    sock_list_t *lst;
-    sock_t * sock = NULL;
-
-    lst = &m->read;
-    sock = lst->head;
-    if (sock == NULL){
+    if (fd < 0 || fd >= m->nslots){
         return (NULL);
     }
-
-    while (sock != NULL){
-        if (sock->fd == fd){
-            return (sock);
-        }
-        sock = sock->next;
-    }
-
-    return (sock);
+    return (m->slots[fd].sock);
 }
 
 sock_t *
@@ -177,11 +182,31 @@ sockmstr_register_read_listener(sockmstr_t *m,int (*func)(struct sock *),
         void *arg, int fd)
 {
     struct sock *sock;
+    struct epoll_event ev;
+
+    if (fd < 0){
+        OOR_LOG(LWRN, "sockmstr_register_read_listener: Invalid file descriptor %d", fd);
+        return (NULL);
+    }
     sock = xzalloc(sizeof(struct sock));
     sock->recv_cb = func;
     sock->type = SOCK_READ;
     sock->arg = arg;
     sock->fd = fd;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = sockmstr_epoll_flags(m);
+    ev.data.fd = fd;
+    if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1){
+        OOR_LOG(LERR, "sockmstr_register_read_listener: Couldn't add fd %d to epoll: %s",
+                fd, strerror(errno));
+        free(sock);
+        return (NULL);
+    }
+    if (fd >= m->nslots){
+        sockmstr_grow_slots(m, fd);
+    }
+    m->slots[fd].sock = sock;
     sock_list_add(&m->read, sock);
     return (sock);
 }
@@ -196,36 +221,87 @@ sock_fd(struct sock * sock)
 int
 sockmstr_unregister_read_listenedr(sockmstr_t *m, struct sock *sock)
 {
-   sock_list_remove(&m->read, sock);
-   return (GOOD);
+    epoll_ctl(m->epoll_fd, EPOLL_CTL_DEL, sock->fd, NULL);
+    if (m->slots[sock->fd].sock == sock){
+        m->slots[sock->fd].sock = NULL;
+    }
+    sock_list_remove(&m->read, sock);
+    return (GOOD);
 }
 
-
-static void
-sock_process_fd(struct sock_list *lst, fd_set *fdset)
+/* Select between level triggered (default) and edge triggered notification
+ * of the registered file descriptors */
+void
+sockmstr_set_edge_triggered(sockmstr_t *m, uint8_t enable)
 {
     struct sock *sit;
+    struct epoll_event ev;
 
-    for (sit = lst->head; sit; sit = sit->next) {
-        if (FD_ISSET(sit->fd, fdset))
-            (*sit->recv_cb)(sit);
+    if (m->edge_triggered == enable){
+        return;
+    }
+    m->edge_triggered = enable;
+    for (sit = m->read.head; sit; sit = sit->next) {
+        memset(&ev, 0, sizeof(ev));
+        ev.events = sockmstr_epoll_flags(m);
+        ev.data.fd = sit->fd;
+        if (epoll_ctl(m->epoll_fd, EPOLL_CTL_MOD, sit->fd, &ev) == -1){
+            OOR_LOG(LWRN, "sockmstr_set_edge_triggered: Couldn't modify fd %d: %s",
+                    sit->fd, strerror(errno));
+        }
+    }
+    OOR_LOG(LDBG_1, "Socket events notified as %s triggered",
+            enable ? "edge" : "level");
+}
+
+static inline int
+sock_is_readable(int fd)
+{
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN));
+}
+
+/* Call the callback of the sock registered with the fd. The fd is looked up
+ * at this point as a previous callback could have unregistered it */
+static inline void
+sockmstr_dispatch(sockmstr_t *m, int fd)
+{
+    struct sock *sock;
+
+    sock = m->slots[fd].sock;
+    if (!sock){
+        return;
+    }
+    (*sock->recv_cb)(sock);
+
+    /* With edge triggered notifications, no new event is received for data
+     * not consumed by the callback */
+    if (m->edge_triggered && m->slots[fd].sock == sock
+            && !m->slots[fd].queued && sock_is_readable(fd)){
+        m->slots[fd].queued = TRUE;
+        m->pending[m->npending++] = fd;
     }
 }
 
 void
 sockmstr_process_all(sockmstr_t *m)
 {
-    struct timeval tv;
+    int timeout, nevents, nrun, i, fd;
 
-    tv.tv_sec = 0;
-    tv.tv_usec = DEFAULT_SELECT_TIMEOUT;
+    /* Don't sleep if there are fds with data pending to be processed */
+    timeout = m->npending > 0 ? 0 : DEFAULT_SELECT_TIMEOUT;
 
     while (1) {
-        if (select(m->read.maxfd + 1, &m->readfds, NULL, NULL, &tv) == -1) {
+        nevents = epoll_wait(m->epoll_fd, m->events, SOCKMSTR_MAX_EVENTS, timeout);
+        if (nevents == -1) {
             if (errno == EINTR) {
                 continue;
             } else {
-                OOR_LOG(LDBG_2, "sock_process_all: select error: %s",
+                OOR_LOG(LDBG_2, "sock_process_all: epoll_wait error: %s",
                         strerror(errno));
                 return;
             }
@@ -234,15 +310,29 @@ sockmstr_process_all(sockmstr_t *m)
         }
     }
 
-    sock_process_fd(&m->read, &m->readfds);
-}
+    if (!m->edge_triggered){
+        for (i = 0; i < nevents; i++){
+            sockmstr_dispatch(m, m->events[i].data.fd);
+        }
+        return;
+    }
 
-void
-sockmstr_wait_on_all_read(sockmstr_t *m)
-{
-    struct sock *sit;
-    for (sit = m->read.head; sit; sit = sit->next) {
-        FD_SET(sit->fd, &m->readfds);
+    /* Process the fds pending from the previous iteration and the new ready
+     * ones. Each fd is processed once per iteration */
+    nrun = m->npending;
+    memcpy(m->run, m->pending, nrun * sizeof(int));
+    m->npending = 0;
+    for (i = 0; i < nevents; i++){
+        fd = m->events[i].data.fd;
+        if (fd < m->nslots && !m->slots[fd].queued){
+            m->slots[fd].queued = TRUE;
+            m->run[nrun++] = fd;
+        }
+    }
+    for (i = 0; i < nrun; i++){
+        fd = m->run[i];
+        m->slots[fd].queued = FALSE;
+        sockmstr_dispatch(m, fd);
     }
 }
 
@@ -307,15 +397,23 @@ open_data_raw_input_socket(int afi, uint16_t port)
     return (sock);
 }
 
-int
-open_data_datagram_input_socket(int afi, int port)
+static int
+open_data_datagram_socket(int afi, int port, uint8_t reuse_port)
 {
     int sock = ERR_SOCKET;
+    const int one = 1;
 
     if ((sock = open_udp_datagram_socket(afi)) < 0){
         return(ERR_SOCKET);
     }
 
+    if (reuse_port && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0){
+        OOR_LOG(LERR, "open_data_datagram_socket: setsockopt SO_REUSEPORT: %s",
+                strerror(errno));
+        close(sock);
+        return(ERR_SOCKET);
+    }
+
 #ifdef  UDP_NO_CHECK6_RX
     const int on = 1;
     /* Disable IPv6 checksum computation for IPv6 data sockets (RFC 6935
@@ -341,12 +439,26 @@ open_data_datagram_input_socket(int afi, int port)
     return (sock);
 }
 
+int
+open_data_datagram_input_socket(int afi, int port)
+{
+    return (open_data_datagram_socket(afi, port, FALSE));
+}
+
+/* Several sockets can be bound to the same data port. The kernel distributes
+ * the received packets between them by flow */
+int
+open_data_reuseport_input_socket(int afi, int port)
+{
+    return (open_data_datagram_socket(afi, port, TRUE));
+}
+
 int
 sock_recv(int sfd, lbuf_t *b)
 {
     int nread;
     nread = read(sfd, lbuf_data(b), lbuf_tailroom(b));
-    if (nread == 0) {
+    if (nread <= 0) {
         OOR_LOG(LWRN, "sock_recv: recvmsg error: %s", strerror(errno));
         return (BAD);
     }
@@ -355,23 +467,81 @@ sock_recv(int sfd, lbuf_t *b)
     return(GOOD);
 }
 
+/* Read up to count packets from a non blocking descriptor that doesn't support
+ * recvmmsg (i.e. tun device). Returns the number of packets stored in bufs */
+int
+sock_recv_batch(int sfd, lbuf_t *bufs, int count)
+{
+    int nread, nrecv = 0;
+
+    while (nrecv < count){
+        nread = read(sfd, lbuf_data(&bufs[nrecv]), lbuf_tailroom(&bufs[nrecv]));
+        if (nread <= 0) {
+            if (nread == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+                OOR_LOG(LWRN, "sock_recv_batch: read error: %s", strerror(errno));
+            }
+            break;
+        }
+        lbuf_set_size(&bufs[nrecv], lbuf_size(&bufs[nrecv]) + nread);
+        nrecv++;
+    }
+
+    return (nrecv);
+}
+
+/* Control data with the local address of a received control message */
+union ctrl_cmsg_data {
+    struct cmsghdr cmsg;
+    u_char data4[CMSG_SPACE(sizeof(struct in_pktinfo))];
+    u_char data6[CMSG_SPACE(sizeof(struct in6_pktinfo))];
+};
+
+/* Read the local address, remote port and remote address of a received
+ * control message */
+static void
+sock_ctrl_parse_cmsg(struct msghdr *msg, union sockunion *su, uconn_t *uc)
+{
+    struct cmsghdr *cmsgptr = NULL;
+
+    if (su->s4.sin_family == AF_INET) {
+        for (cmsgptr = CMSG_FIRSTHDR(msg); cmsgptr;
+                cmsgptr = CMSG_NXTHDR(msg, cmsgptr)) {
+            if (cmsgptr->cmsg_level == IPPROTO_IP
+                    && cmsgptr->cmsg_type == IP_PKTINFO) {
+                lisp_addr_ip_init(&uc->la,
+                        &(((struct in_pktinfo *) (CMSG_DATA(cmsgptr)))->ipi_addr),
+                        AF_INET);
+                break;
+            }
+        }
+
+        lisp_addr_ip_init(&uc->ra, &su->s4.sin_addr, AF_INET);
+        uc->rp = ntohs(su->s4.sin_port);
+    } else {
+        for (cmsgptr = CMSG_FIRSTHDR(msg); cmsgptr;
+                cmsgptr = CMSG_NXTHDR(msg, cmsgptr)) {
+            if (cmsgptr->cmsg_level == IPPROTO_IPV6
+                    && cmsgptr->cmsg_type == IPV6_PKTINFO) {
+                lisp_addr_ip_init(&uc->la,
+                        &(((struct in6_pktinfo *) (CMSG_DATA(cmsgptr)))->ipi6_addr),
+                        AF_INET6);
+                break;
+            }
+        }
+        lisp_addr_ip_init(&uc->ra, &su->s6.sin6_addr, AF_INET6);
+        uc->rp = ntohs(su->s6.sin6_port);
+    }
+}
+
 /* Get a packet from the socket. It also returns the destination addres and
  * source port of the packet */
 int
 sock_ctrl_recv(int sock, struct lbuf *buf, uconn_t *uc)
 {
-
-    union control_data {
-        struct cmsghdr cmsg;
-        u_char data4[CMSG_SPACE(sizeof(struct in_pktinfo))];
-        u_char data6[CMSG_SPACE(sizeof(struct in6_pktinfo))];
-    };
-
     union sockunion su;
     struct msghdr msg;
     struct iovec iov[1];
-    union control_data cmsg;
-    struct cmsghdr *cmsgptr = NULL;
+    union ctrl_cmsg_data cmsg;
     int nbytes = 0;
 
     iov[0].iov_base = lbuf_data(buf);
@@ -393,37 +563,96 @@ sock_ctrl_recv(int sock, struct lbuf *buf, uconn_t *uc)
 
     lbuf_set_size(buf, lbuf_size(buf) + nbytes);
 
-    /* read local address, remote port and remote address */
-    if (su.s4.sin_family == AF_INET) {
-        for (cmsgptr = CMSG_FIRSTHDR(&msg); cmsgptr;
-                cmsgptr = CMSG_NXTHDR(&msg, cmsgptr)) {
-            if (cmsgptr->cmsg_level == IPPROTO_IP
-                    && cmsgptr->cmsg_type == IP_PKTINFO) {
-                lisp_addr_ip_init(&uc->la,
-                        &(((struct in_pktinfo *) (CMSG_DATA(cmsgptr)))->ipi_addr),
-                        AF_INET);
-                break;
+    sock_ctrl_parse_cmsg(&msg, &su, uc);
+
+    return (GOOD);
+}
+
+/* Get up to count control messages from the socket using as few syscalls as
+ * possible. It doesn't block once the pending messages have been read.
+ * Returns the number of messages stored in bufs */
+int
+sock_ctrl_recv_batch(int sock, lbuf_t *bufs, uconn_t *ucs, int count)
+{
+    union sockunion su[SOCK_RECV_BATCH_CHUNK];
+    struct mmsghdr msgs[SOCK_RECV_BATCH_CHUNK];
+    struct iovec iovs[SOCK_RECV_BATCH_CHUNK];
+    union ctrl_cmsg_data cmsgs[SOCK_RECV_BATCH_CHUNK];
+    int i, chunk, nmsgs, nrecv = 0;
+
+    while (nrecv < count){
+        chunk = count - nrecv < SOCK_RECV_BATCH_CHUNK ?
+                count - nrecv : SOCK_RECV_BATCH_CHUNK;
+        memset(msgs, 0, chunk * sizeof(struct mmsghdr));
+        for (i = 0; i < chunk; i++){
+            iovs[i].iov_base = lbuf_data(&bufs[nrecv + i]);
+            iovs[i].iov_len = lbuf_tailroom(&bufs[nrecv + i]);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_control = &cmsgs[i];
+            msgs[i].msg_hdr.msg_controllen = sizeof(union ctrl_cmsg_data);
+            msgs[i].msg_hdr.msg_name = &su[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(union sockunion);
+        }
+
+        nmsgs = recvmmsg(sock, msgs, chunk, MSG_DONTWAIT, NULL);
+        if (nmsgs <= 0) {
+            if (nmsgs == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+                OOR_LOG(LWRN, "sock_ctrl_recv_batch: recvmmsg error: %s", strerror(errno));
             }
+            break;
         }
 
-        lisp_addr_ip_init(&uc->ra, &su.s4.sin_addr, AF_INET);
-        uc->rp = ntohs(su.s4.sin_port);
+        for (i = 0; i < nmsgs; i++){
+            lbuf_set_size(&bufs[nrecv + i], lbuf_size(&bufs[nrecv + i]) + msgs[i].msg_len);
+            sock_ctrl_parse_cmsg(&msgs[i].msg_hdr, &su[i], &ucs[nrecv + i]);
+        }
+        nrecv += nmsgs;
+        if (nmsgs < chunk){
+            break;
+        }
+    }
+
+    return (nrecv);
+}
+
+static void
+sock_data_parse_cmsg(struct msghdr *msg, int family, int *afi, uint8_t *ttl,
+        uint8_t *tos)
+{
+    struct cmsghdr *cmsgptr = NULL;
+
+    if (family == AF_INET) {
+        for (cmsgptr = CMSG_FIRSTHDR(msg); cmsgptr != NULL; cmsgptr =
+                CMSG_NXTHDR(msg, cmsgptr)) {
+
+            if (cmsgptr->cmsg_level == IPPROTO_IP
+                    && cmsgptr->cmsg_type == IP_TTL) {
+                *ttl = *((uint8_t *) CMSG_DATA(cmsgptr));
+            }
+
+            if (cmsgptr->cmsg_level == IPPROTO_IP
+                    && cmsgptr->cmsg_type == IP_TOS) {
+                *tos = *((uint8_t *) CMSG_DATA(cmsgptr));
+            }
+        }
+        *afi = AF_INET;
     } else {
-        for (cmsgptr = CMSG_FIRSTHDR(&msg); cmsgptr;
-                cmsgptr = CMSG_NXTHDR(&msg, cmsgptr)) {
+        for (cmsgptr = CMSG_FIRSTHDR(msg); cmsgptr != NULL; cmsgptr =
+                CMSG_NXTHDR(msg, cmsgptr)) {
+
             if (cmsgptr->cmsg_level == IPPROTO_IPV6
-                    && cmsgptr->cmsg_type == IPV6_PKTINFO) {
-                lisp_addr_ip_init(&uc->la,
-                        &(((struct in6_pktinfo *) (CMSG_DATA(cmsgptr)))->ipi6_addr),
-                        AF_INET6);
-                break;
+                    && cmsgptr->cmsg_type == IPV6_HOPLIMIT) {
+                *ttl = *((uint8_t *) CMSG_DATA(cmsgptr));
+            }
+
+            if (cmsgptr->cmsg_level == IPPROTO_IPV6
+                    && cmsgptr->cmsg_type == IPV6_TCLASS) {
+                *tos = *((uint8_t *) CMSG_DATA(cmsgptr));
             }
         }
-        lisp_addr_ip_init(&uc->ra, &su.s6.sin6_addr, AF_INET6);
-        uc->rp = ntohs(su.s6.sin6_port);
+        *afi = AF_INET6;
     }
-
-    return (GOOD);
 }
 
 int
@@ -439,7 +668,6 @@ sock_data_recv(int sock, lbuf_t *b, int *afi, uint8_t *ttl, uint8_t *tos)
     struct msghdr msg;
     struct iovec iov[1];
     union control_data cmsg;
-    struct cmsghdr *cmsgptr = NULL;
     int nbytes = 0;
 
     iov[0].iov_base = lbuf_data(b);
@@ -461,39 +689,66 @@ sock_data_recv(int sock, lbuf_t *b, int *afi, uint8_t *ttl, uint8_t *tos)
 
     lbuf_set_size(b, lbuf_size(b) + nbytes);
 
-    if (su.s4.sin_family == AF_INET) {
-        for (cmsgptr = CMSG_FIRSTHDR(&msg); cmsgptr != NULL; cmsgptr =
-                CMSG_NXTHDR(&msg, cmsgptr)) {
+    sock_data_parse_cmsg(&msg, su.s4.sin_family, afi, ttl, tos);
 
-            if (cmsgptr->cmsg_level == IPPROTO_IP
-                    && cmsgptr->cmsg_type == IP_TTL) {
-                *ttl = *((uint8_t *) CMSG_DATA(cmsgptr));
-            }
+    return (GOOD);
+}
 
-            if (cmsgptr->cmsg_level == IPPROTO_IP
-                    && cmsgptr->cmsg_type == IP_TOS) {
-                *tos = *((uint8_t *) CMSG_DATA(cmsgptr));
-            }
+/* Get up to count data packets from the socket using as few syscalls as
+ * possible. It doesn't block once the pending packets have been read.
+ * Returns the number of packets stored in bufs */
+int
+sock_data_recv_batch(int sock, lbuf_t *bufs, data_pkt_inf_t *pkts_inf, int count)
+{
+    union control_data {
+        struct cmsghdr cmsg;
+        u_char data[CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(int))];
+    };
+
+    union sockunion su[SOCK_RECV_BATCH_CHUNK];
+    struct mmsghdr msgs[SOCK_RECV_BATCH_CHUNK];
+    struct iovec iovs[SOCK_RECV_BATCH_CHUNK];
+    union control_data cmsgs[SOCK_RECV_BATCH_CHUNK];
+    int i, chunk, nmsgs, nrecv = 0;
+
+    while (nrecv < count){
+        chunk = count - nrecv < SOCK_RECV_BATCH_CHUNK ?
+                count - nrecv : SOCK_RECV_BATCH_CHUNK;
+        memset(msgs, 0, chunk * sizeof(struct mmsghdr));
+        for (i = 0; i < chunk; i++){
+            iovs[i].iov_base = lbuf_data(&bufs[nrecv + i]);
+            iovs[i].iov_len = lbuf_tailroom(&bufs[nrecv + i]);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_control = &cmsgs[i];
+            msgs[i].msg_hdr.msg_controllen = sizeof(union control_data);
+            msgs[i].msg_hdr.msg_name = &su[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(union sockunion);
         }
-        *afi = AF_INET;
-    } else {
-        for (cmsgptr = CMSG_FIRSTHDR(&msg); cmsgptr != NULL; cmsgptr =
-                CMSG_NXTHDR(&msg, cmsgptr)) {
 
-            if (cmsgptr->cmsg_level == IPPROTO_IPV6
-                    && cmsgptr->cmsg_type == IPV6_HOPLIMIT) {
-                *ttl = *((uint8_t *) CMSG_DATA(cmsgptr));
+        nmsgs = recvmmsg(sock, msgs, chunk, MSG_DONTWAIT, NULL);
+        if (nmsgs <= 0) {
+            if (nmsgs == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+                OOR_LOG(LWRN, "sock_data_recv_batch: recvmmsg error: %s", strerror(errno));
             }
+            break;
+        }
 
-            if (cmsgptr->cmsg_level == IPPROTO_IPV6
-                    && cmsgptr->cmsg_type == IPV6_TCLASS) {
-                *tos = *((uint8_t *) CMSG_DATA(cmsgptr));
-            }
+        for (i = 0; i < nmsgs; i++){
+            lbuf_set_size(&bufs[nrecv + i], lbuf_size(&bufs[nrecv + i]) + msgs[i].msg_len);
+            pkts_inf[nrecv + i].ttl = 0;
+            pkts_inf[nrecv + i].tos = 0;
+            sock_data_parse_cmsg(&msgs[i].msg_hdr, su[i].s4.sin_family,
+                    &pkts_inf[nrecv + i].afi, &pkts_inf[nrecv + i].ttl,
+                    &pkts_inf[nrecv + i].tos);
+        }
+        nrecv += nmsgs;
+        if (nmsgs < chunk){
+            break;
         }
-        *afi = AF_INET6;
     }
 
-    return (GOOD);
+    return (nrecv);
 }
 
 inline int
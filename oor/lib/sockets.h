@@ -20,6 +20,7 @@
 #ifndef SOCKETS_H_
 #define SOCKETS_H_
 
+#include <sys/epoll.h>
 #include "../defs.h"
 #include "sockets-util.h"
 #include "packets.h"
@@ -43,7 +44,6 @@ typedef struct sock_list {
     struct sock *head;
     struct sock *tail;
     int count;
-    int maxfd;
 }sock_list_t;
 
 typedef struct sock {
@@ -63,13 +63,30 @@ typedef struct uconn {
     uint16_t rp;        /* remote port */
 } uconn_t;
 
+/* Max number of events returned by a single epoll_wait call */
+#define SOCKMSTR_MAX_EVENTS     64
+
+/* Per fd state of the socket master. Used to get the sock_t of a ready fd in
+ * constant time */
+typedef struct sock_slot {
+    struct sock *sock;
+    uint8_t queued;     /* fd already in the list of fds to process */
+} sock_slot_t;
+
 typedef struct sockmstr {
     sock_list_t read;
 //    struct sock_list *write;
 //    struct sock_list *netlink;
-    fd_set readfds;
-//    fd_set *writefds;
-//    fd_set *netlinkfds;
+    int epoll_fd;
+    struct epoll_event events[SOCKMSTR_MAX_EVENTS];
+    sock_slot_t *slots;     /* Indexed by fd */
+    int nslots;
+    /* Edge triggered mode: fds still readable after their callback are
+     * processed again in the next iteration without waiting for new events */
+    uint8_t edge_triggered;
+    int *run;
+    int *pending;
+    int npending;
 } sockmstr_t;
 
 union sockunion {
@@ -77,6 +94,16 @@ union sockunion {
     struct sockaddr_in6 s6;
 };
 
+/* Max number of messages requested in a single recvmmsg call */
+#define SOCK_RECV_BATCH_CHUNK   64
+
+/* Outer header information of a received data packet */
+typedef struct data_pkt_inf_ {
+    int afi;
+    uint8_t ttl;
+    uint8_t tos;
+} data_pkt_inf_t;
+
 
 typedef struct iface iface_t;
 
@@ -88,16 +115,20 @@ sock_t *sockmstr_register_read_listener(sockmstr_t *m,
         int (*)(struct sock *), void *arg, int fd);
 int sock_fd(struct sock * sock);
 int sockmstr_unregister_read_listenedr(sockmstr_t *m, struct sock *sock);
+void sockmstr_set_edge_triggered(sockmstr_t *m, uint8_t enable);
 void sockmstr_process_all(sockmstr_t *m);
-void sockmstr_wait_on_all_read(sockmstr_t *m);
 
 int open_data_raw_input_socket(int afi, uint16_t port);
 int open_data_datagram_input_socket(int afi, int port);
+int open_data_reuseport_input_socket(int afi, int port);
 int open_control_input_socket(int afi);
 
 int sock_recv(int, lbuf_t *);
 int sock_ctrl_recv(int, lbuf_t *, uconn_t *);
+int sock_ctrl_recv_batch(int sock, lbuf_t *bufs, uconn_t *ucs, int count);
 int sock_data_recv(int sock, lbuf_t *b, int *afi, uint8_t *ttl, uint8_t *tos);
+int sock_recv_batch(int sfd, lbuf_t *bufs, int count);
+int sock_data_recv_batch(int sock, lbuf_t *bufs, data_pkt_inf_t *pkts_inf, int count);
 int uconn_init(uconn_t *uc, int lp, int rp, lisp_addr_t *la,
         lisp_addr_t *ra);
 uconn_t *uconn_clone(uconn_t *uc);
@@ -0,0 +1,58 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "spsc_ring.h"
+#include "mem_util.h"
+
+
+/* The size is rounded up to a power of 2 */
+spsc_ring_t *
+spsc_ring_new(uint32_t size)
+{
+    spsc_ring_t *ring;
+    uint32_t nslots = 2;
+
+    while (nslots < size){
+        nslots <<= 1;
+    }
+    if (posix_memalign((void **)&ring, SPSC_RING_CACHE_LINE, sizeof(spsc_ring_t)) != 0){
+        return (NULL);
+    }
+    memset(ring, 0, sizeof(spsc_ring_t));
+    ring->slots = xzalloc(nslots * sizeof(void *));
+    ring->mask = nslots - 1;
+    return (ring);
+}
+
+void
+spsc_ring_del(spsc_ring_t *ring)
+{
+    if (!ring){
+        return;
+    }
+    free(ring->slots);
+    free(ring);
+}
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,79 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../defs.h"
+
+#define SPSC_RING_CACHE_LINE    64
+
+/* Lock free ring of pointers with a single producer thread and a single
+ * consumer thread. The indexes are free running counters. Each one is only
+ * written by one of the threads and they are kept in different cache lines
+ * to avoid false sharing */
+typedef struct spsc_ring_ {
+    void        **slots;
+    uint32_t    mask;
+    uint32_t    head __attribute__((aligned(SPSC_RING_CACHE_LINE))); /* Written by the producer */
+    uint32_t    tail __attribute__((aligned(SPSC_RING_CACHE_LINE))); /* Written by the consumer */
+} spsc_ring_t;
+
+spsc_ring_t *spsc_ring_new(uint32_t size);
+void spsc_ring_del(spsc_ring_t *ring);
+
+/* Called by the producer. Returns BAD if the ring is full */
+static inline int
+spsc_ring_push(spsc_ring_t *ring, void *obj)
+{
+    uint32_t head = ring->head;
+
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) > ring->mask){
+        return (BAD);
+    }
+    ring->slots[head & ring->mask] = obj;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return (GOOD);
+}
+
+/* Called by the consumer. Returns NULL if the ring is empty */
+static inline void *
+spsc_ring_pop(spsc_ring_t *ring)
+{
+    uint32_t tail = ring->tail;
+    void *obj;
+
+    if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)){
+        return (NULL);
+    }
+    obj = ring->slots[tail & ring->mask];
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return (obj);
+}
+
+#endif /* SPSC_RING_H_ */
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
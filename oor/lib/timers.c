@@ -19,9 +19,12 @@
 
 #include <errno.h>
 #include <fcntl.h>
-#include <signal.h>
-#include <sys/time.h>
 #include <time.h>
+#ifdef ANDROID
+#include <sys/syscall.h>
+#else
+#include <sys/timerfd.h>
+#endif
 
 #include "oor_log.h"
 #include "timers.h"
@@ -29,70 +32,186 @@
 #include "../defs.h"
 #include "../oor_external.h"
 
+#ifdef ANDROID
+/* Bionic of the supported API levels doesn't wrap timerfd */
+#define timerfd_create(clockid, flags) \
+    syscall(__NR_timerfd_create, clockid, flags)
+#define timerfd_settime(fd, flags, new_value, old_value) \
+    syscall(__NR_timerfd_settime, fd, flags, new_value, old_value)
+#define TFD_NONBLOCK        O_NONBLOCK
+#define TFD_CLOEXEC         O_CLOEXEC
+#define TFD_TIMER_ABSTIME   1
+#endif
 
-/* Seconds */
-#define TICK_INTERVAL 1
-
-/* Good for a little over an hour */
-#define WHEEL_SIZE 4096
+/*
+ * Hierarchical timing wheel with a resolution of 1 ms. The first level has
+ * one spoke per ms of the next 256 ms. Each of the upper levels has 64
+ * spokes, each one covering a full rotation of the level below. Timers are
+ * linked in the spoke of the level that covers their expiration and moved
+ * down (cascaded) when the lower level completes a rotation. Timers beyond
+ * the last level (about 49 days) are cascaded again until they are in range.
+ * The timerfd is only armed for the next spoke with timers.
+ */
+#define WHEEL_LEVELS            5
+#define WHEEL_L0_BITS           8
+#define WHEEL_LN_BITS           6
+#define WHEEL_L0_SIZE           (1 << WHEEL_L0_BITS)
+#define WHEEL_LN_SIZE           (1 << WHEEL_LN_BITS)
+#define WHEEL_SIZE              (WHEEL_L0_SIZE + (WHEEL_LEVELS - 1) * WHEEL_LN_SIZE)
+#define WHEEL_MAX_TICKS         ((1ULL << (WHEEL_L0_BITS + (WHEEL_LEVELS - 1) * WHEEL_LN_BITS)) - 1)
+
+/* Max timers expired per wake up. The rest are expired in the next iteration
+ * of the event loop, after the pending sockets are served */
+#define TIMERS_MAX_EXPIRED      1024
+/* Timers started in seconds expire in a random instant of a window of 1/8
+ * of their duration, up to this value. Timers started together are spread
+ * instead of expiring in the same tick */
+#define TIMERS_MAX_JITTER_MS    500
 
 struct timer_wheel_{
-    int num_spokes;
-    int current_spoke;
+    uint64_t tick;          /* Next tick (ms) to be processed */
+    uint64_t armed;         /* Tick programmed in the timerfd. 0 if none */
     oor_timer_links_t *spokes;
-    timer_t tick_timer_id;
     int running_timers;
     int expirations;
 } timer_wheel = {.spokes=NULL};
 
-/* We don't have signalfd in bionic, fake it. */
-static int signal_pipe[2];
-
-static timer_t timer_id;
-
 /* timers file descriptor */
 int timers_fd = 0;
 
-static int destroy_timers_event_socket();
-static int build_timers_event_socket(int *timers_fd);
-static int process_timer_signal(sock_t *sl);
+static int process_timer_expiration(sock_t *sl);
 static void handle_timers(void);
 
 
-/*
- * create_timer_wheel()
- *
- * Creates the timer wheel structure and starts
- * the rotation timer.
- */
-static int
-create_timer_wheel(void)
+static inline uint64_t
+timers_now()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+static inline int
+wheel_level_shift(int level)
+{
+    return (level == 0 ? 0 : WHEEL_L0_BITS + (level - 1) * WHEEL_LN_BITS);
+}
+
+static inline int
+wheel_level_size(int level)
+{
+    return (level == 0 ? WHEEL_L0_SIZE : WHEEL_LN_SIZE);
+}
+
+static inline oor_timer_links_t *
+wheel_spoke(int level, uint32_t idx)
+{
+    if (level == 0){
+        return (&timer_wheel.spokes[idx]);
+    }
+    return (&timer_wheel.spokes[WHEEL_L0_SIZE + (level - 1) * WHEEL_LN_SIZE + idx]);
+}
+
+static inline int
+wheel_spoke_empty(oor_timer_links_t *spoke)
+{
+    return (spoke->next == spoke);
+}
+
+/* Program the timerfd to expire at tick. Only done when it is earlier than
+ * the programmed one */
+static void
+wheel_arm(uint64_t tick)
 {
-    //timer_t tid;
-    struct sigevent sev;
     struct itimerspec timerspec;
-    sev.sigev_notify = SIGEV_SIGNAL;
-    sev.sigev_signo = SIGRTMIN;
-    sev.sigev_value.sival_ptr = &timer_id;
-    if (timer_create(CLOCK_MONOTONIC, &sev, &timer_id) == -1) {
-        OOR_LOG(LINF, "timer_create(): %s", strerror(errno));
-        return (BAD);
+
+    if (timer_wheel.armed != 0 && timer_wheel.armed <= tick){
+        return;
+    }
+    memset(&timerspec, 0, sizeof(timerspec));
+    timerspec.it_value.tv_sec = tick / 1000;
+    timerspec.it_value.tv_nsec = (tick % 1000) * 1000000;
+    if (timerfd_settime(timers_fd, TFD_TIMER_ABSTIME, &timerspec, NULL) == -1) {
+        OOR_LOG(LWRN, "wheel_arm: timerfd_settime failed: %s", strerror(errno));
+        return;
     }
+    timer_wheel.armed = tick;
+}
 
-    timerspec.it_value.tv_nsec = 0;
-    timerspec.it_value.tv_sec = TICK_INTERVAL;
-    timerspec.it_interval.tv_nsec = 0;
-    timerspec.it_interval.tv_sec = TICK_INTERVAL;
+/* First tick, from the current one, with a spoke to process: a spoke of the
+ * first level with timers or a spoke of an upper level with timers to be
+ * cascaded. 0 if there are no timers */
+static uint64_t
+wheel_next_tick()
+{
+    uint64_t base, tick, next = 0;
+    int level, shift, size, d;
+
+    for (level = 0; level < WHEEL_LEVELS; level++){
+        shift = wheel_level_shift(level);
+        size = wheel_level_size(level);
+        /* First tick at or after the current one where the level turns */
+        base = (timer_wheel.tick + (1ULL << shift) - 1) >> shift;
+        for (d = 0; d < size; d++){
+            if (!wheel_spoke_empty(wheel_spoke(level, (base + d) & (size - 1)))){
+                tick = (base + d) << shift;
+                if (next == 0 || tick < next){
+                    next = tick;
+                }
+                break;
+            }
+        }
+    }
+    return (next);
+}
 
-    if (timer_settime(timer_id, 0, &timerspec, NULL) == -1) {
-        OOR_LOG(LINF, "create_wheel_timer: timer start failed for %d %s",
-                timer_id, strerror(errno));
-        return (BAD);
+/* Link a timer in the spoke that covers its expiration */
+static void
+insert_timer(oor_timer_t *tptr)
+{
+    oor_timer_links_t *prev, *spoke;
+    uint64_t expires, delta;
+    int level;
+
+    expires = tptr->expires > timer_wheel.tick ? tptr->expires : timer_wheel.tick;
+    delta = expires - timer_wheel.tick;
+    if (delta > WHEEL_MAX_TICKS){
+        delta = WHEEL_MAX_TICKS;
+        expires = timer_wheel.tick + delta;
+    }
+    for (level = 0; level < WHEEL_LEVELS - 1; level++){
+        if (delta < (1ULL << wheel_level_shift(level + 1))){
+            break;
+        }
     }
+    spoke = wheel_spoke(level,
+            (expires >> wheel_level_shift(level)) & (wheel_level_size(level) - 1));
 
-    return(GOOD);
+    /* append to end of spoke  */
+    prev = spoke->prev;
+    tptr->links.next = spoke;
+    tptr->links.prev = prev;
+    prev->next = (oor_timer_links_t *) tptr;
+    spoke->prev = (oor_timer_links_t *) tptr;
 }
 
+/* Move the timers of a spoke of an upper level to the levels below */
+static void
+cascade_timers(int level, uint32_t idx)
+{
+    oor_timer_links_t *spoke, *sit, *next;
+
+    spoke = wheel_spoke(level, idx);
+    sit = spoke->next;
+    spoke->next = spoke;
+    spoke->prev = spoke;
+    while (sit != spoke){
+        next = sit->next;
+        insert_timer(CONTAINER_OF(sit, oor_timer_t, links));
+        sit = next;
+    }
+}
 
 
 int
@@ -103,20 +222,15 @@ oor_timers_init()
 
     OOR_LOG(LDBG_1, "Initializing lmtimers...");
 
-    /* create timers event socket */
-    if (build_timers_event_socket(&timers_fd) == 0) {
-        OOR_LOG(LCRIT, " Error programming the timer signal. Exiting...");
+    timers_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timers_fd == -1) {
+        OOR_LOG(LCRIT, "timerfd_create(): %s. Exiting...", strerror(errno));
         return(BAD);
     }
 
-    if (create_timer_wheel() != GOOD) {
-        OOR_LOG(LINF, "Failed to set up timers.");
-        return(BAD);
-    }
-
-    timer_wheel.num_spokes = WHEEL_SIZE;
     timer_wheel.spokes = xmalloc(sizeof(oor_timer_links_t) * WHEEL_SIZE);
-    timer_wheel.current_spoke = 0;
+    timer_wheel.tick = timers_now();
+    timer_wheel.armed = 0;
     timer_wheel.running_timers = 0;
     timer_wheel.expirations = 0;
 
@@ -129,7 +243,7 @@ oor_timers_init()
 
 
     /* register timer fd with the socket master */
-    sockmstr_register_read_listener(smaster, process_timer_signal, NULL,
+    sockmstr_register_read_listener(smaster, process_timer_expiration, NULL,
             timers_fd);
 
     return(GOOD);
@@ -148,7 +262,7 @@ oor_timers_destroy()
 
     OOR_LOG(LDBG_1, "Destroying lmtimers ... ");
 
-    destroy_timers_event_socket();
+    close(timers_fd);
 
     spoke = &timer_wheel.spokes[0];
     for (i = 0; i < WHEEL_SIZE; i++) {
@@ -163,8 +277,7 @@ oor_timers_destroy()
         spoke++;
     }
     free(timer_wheel.spokes);
-    timer_delete(timer_id);
-
+    timer_wheel.spokes = NULL;
 }
 
 /*
@@ -217,36 +330,28 @@ oor_timer_nonces(oor_timer_t *timer)
     return (timer->nonces_lst);
 }
 
-/* Insert a timer in the wheel at the appropriate location. */
 static void
-insert_timer(oor_timer_t *tptr)
+timer_start(oor_timer_t *tptr, uint64_t msecs)
 {
-    oor_timer_links_t *prev, *spoke;
-    uint32_t pos;
-    uint32_t ticks;
-    uint32_t td;
+    oor_timer_links_t *next, *prev;
 
-    /* Number of ticks for this timer. */
-    ticks = tptr->duration;
+    /* See if this timer is also running. */
+    next = tptr->links.next;
 
-    /* tick position, referenced from the
-     * current index. */
-    td = (ticks % timer_wheel.num_spokes);
+    if (next != NULL) {
+        prev = tptr->links.prev;
+        next->prev = prev;
+        prev->next = next;
 
-    /* Full rotations required before this timer expires */
-    tptr->rotation_count = (ticks / timer_wheel.num_spokes);
+        /* Update stats */
+        timer_wheel.running_timers--;
+    }
 
-    /* Find the right spoke, and link the timer into the list at this position */
-    pos = ((timer_wheel.current_spoke + td) % timer_wheel.num_spokes);
-    spoke = &timer_wheel.spokes[pos];
+    tptr->expires = timers_now() + msecs;
+    insert_timer(tptr);
+    wheel_arm(tptr->expires > timer_wheel.tick ? tptr->expires : timer_wheel.tick);
 
-    /* append to end of spoke  */
-    prev = spoke->prev;
-    tptr->links.next = spoke;
-    tptr->links.prev = prev;
-    prev->next = (oor_timer_links_t *) tptr;
-    spoke->prev = (oor_timer_links_t *) tptr;
-    return;
+    timer_wheel.running_timers++;
 }
 
 /*
@@ -259,27 +364,21 @@ insert_timer(oor_timer_t *tptr)
 void
 oor_timer_start(oor_timer_t *tptr, int sexpiry)
 {
-    oor_timer_links_t *next, *prev;
+    uint64_t msecs, jitter;
 
-    /* See if this timer is also running. */
-    next = tptr->links.next;
-
-    if (next != NULL) {
-        prev = tptr->links.prev;
-        next->prev = prev;
-        prev->next = next;
-
-        /* Update stats */
-        timer_wheel.running_timers--;
+    msecs = sexpiry > 0 ? (uint64_t)sexpiry * 1000 : 0;
+    jitter = msecs / 8 < TIMERS_MAX_JITTER_MS ? msecs / 8 : TIMERS_MAX_JITTER_MS;
+    if (jitter > 0){
+        msecs = msecs - jitter / 2 + (uint64_t)random() % jitter;
     }
+    timer_start(tptr, msecs);
+}
 
-    /* Hook up the callback  */
-
-    tptr->duration = sexpiry;
-    insert_timer(tptr);
-
-    timer_wheel.running_timers++;
-    return;
+/* Same as oor_timer_start, without jitter and with the expiration in ms */
+void
+oor_timer_start_ms(oor_timer_t *tptr, uint32_t msexpiry)
+{
+    timer_start(tptr, msexpiry);
 }
 
 
@@ -321,150 +420,104 @@ oor_timer_stop(oor_timer_t *tptr)
     free(tptr);
 }
 
-
 /*
- * handle_timers()
- *
- * Update the wheel index, and expire any timers there, calling
- * the appropriate function to deal with it.
+ * Expire the timers of the current tick, after cascading the upper levels
+ * that complete a rotation. Returns BAD if the budget of expired timers is
+ * exhausted before processing all of them
  */
-static void
-handle_timers(void)
+static int
+expire_timers(int *budget)
 {
-    struct timeval  nowtime;
-    oor_timer_links_t    *current_spoke, *next, *prev;
+    oor_timer_links_t    *current_spoke;
     oor_timer_t          *tptr;
     oor_timer_callback_t  callback;
-
-    gettimeofday(&nowtime, NULL);
-    timer_wheel.current_spoke = (timer_wheel.current_spoke + 1) % timer_wheel.num_spokes;
-    current_spoke = &timer_wheel.spokes[timer_wheel.current_spoke];
-
-    tptr = (oor_timer_t *)current_spoke->next;
-    while ((oor_timer_links_t *)tptr != current_spoke) {
-        next = tptr->links.next;
-        prev = tptr->links.prev;
-
-        if (tptr->rotation_count > 0) {
-            tptr->rotation_count--;
-        } else {
-
-            prev->next = next;
-            next->prev = prev;
-            tptr->links.next = NULL;
-            tptr->links.prev = NULL;
-
-            /* Update stats */
-            timer_wheel.running_timers--;
-            timer_wheel.expirations++;
-
-            callback = tptr->cb;
-            (*callback)(tptr);
+    uint32_t idx;
+    int level;
+
+    idx = timer_wheel.tick & (WHEEL_L0_SIZE - 1);
+    if (idx == 0){
+        for (level = 1; level < WHEEL_LEVELS; level++){
+            idx = (timer_wheel.tick >> wheel_level_shift(level)) & (WHEEL_LN_SIZE - 1);
+            cascade_timers(level, idx);
+            if (idx != 0){
+                break;
+            }
         }
-        /* We can not use directly "next" as it could be released  in the
-         *  callback function  previously to be used */
-        tptr = (oor_timer_t *)(prev->next);
+        idx = 0;
     }
-}
-
-static int
-process_timer_signal(sock_t *sl)
-{
-    int sig;
-    int bytes;
-
-    bytes = read(sl->fd, &sig, sizeof(sig));
-
-    if (bytes != sizeof(sig)) {
-        OOR_LOG(LWRN, "process_event_signal(): nothing to read");
-        return(-1);
-    }
-
-    if (sig == SIGRTMIN) {
-        handle_timers();
-    }
-    return(0);
-}
+    current_spoke = wheel_spoke(0, idx);
 
+    /* The callbacks can stop and start other timers of the spoke */
+    while (!wheel_spoke_empty(current_spoke)) {
+        if (*budget == 0){
+            return (BAD);
+        }
+        (*budget)--;
+        tptr = CONTAINER_OF(current_spoke->next, oor_timer_t, links);
+        current_spoke->next = tptr->links.next;
+        tptr->links.next->prev = current_spoke;
+        tptr->links.next = NULL;
+        tptr->links.prev = NULL;
 
+        /* Update stats */
+        timer_wheel.running_timers--;
+        timer_wheel.expirations++;
 
-/*
- * event_sig_handler
- *
- * Forward signal to the fd for handling in the event loop
- */
-static void event_sig_handler(int sig)
-{
-    if (write(signal_pipe[1], &sig, sizeof(sig)) != sizeof(sig)) {
-        OOR_LOG(LWRN, "write signal %d: %s", sig, strerror(errno));
+        callback = tptr->cb;
+        (*callback)(tptr);
     }
+    return (GOOD);
 }
 
-
 /*
- * build_timer_event_socket
+ * handle_timers()
  *
- * Set up the event handler socket. This is
- * used to serialize events like timer expirations that
- * we would rather deal with synchronously. This avoids
- * having to deal with all sorts of locking and multithreading
- * nonsense.
+ * Process the ticks elapsed since the last wake up, jumping directly to the
+ * ones with timers, and program the timerfd for the next one
  */
-static int
-build_timers_event_socket(int *timers_fd)
+static void
+handle_timers(void)
 {
-    int flags;
-    struct sigaction sa;
-
-    if (pipe(signal_pipe) == -1) {
-        OOR_LOG(LERR, "build_timers_event_socket: signal pipe setup failed %s",
-                strerror(errno));
-        return (BAD);
-    }
-    *timers_fd = signal_pipe[0];
-
-    if ((flags = fcntl(*timers_fd, F_GETFL, 0)) == -1) {
-        OOR_LOG(LERR, "build_timers_event_socket: fcntl() F_GETFL failed %s",
-                strerror(errno));
-        return (BAD);
-    }
-    if (fcntl(*timers_fd, F_SETFL, flags | O_NONBLOCK) == -1) {
-        OOR_LOG(LERR, "build_timers_event_socket: fcntl() set O_NONBLOCK failed "
-                "%s", strerror(errno));
-        return (BAD);
+    uint64_t now, next;
+    int budget = TIMERS_MAX_EXPIRED;
+
+    now = timers_now();
+    timer_wheel.armed = 0;
+    while (timer_wheel.tick <= now) {
+        next = wheel_next_tick();
+        if (next == 0 || next > now){
+            timer_wheel.tick = now + 1;
+            break;
+        }
+        timer_wheel.tick = next;
+        if (expire_timers(&budget) != GOOD){
+            OOR_LOG(LDBG_3, "handle_timers: %d timers expired. Deferring the rest",
+                    TIMERS_MAX_EXPIRED);
+            break;
+        }
+        timer_wheel.tick++;
     }
 
-    memset(&sa, 0, sizeof(sa));
-    sa.sa_handler = event_sig_handler;
-    sa.sa_flags = 0;
-    sigemptyset(&sa.sa_mask);
-
-    if (sigaction(SIGRTMIN, &sa, NULL) == -1) {
-        OOR_LOG(LERR, "build_timers_event_socket: sigaction() failed %s",
-                strerror(errno));
-        exit_cleanup();
+    next = wheel_next_tick();
+    if (next != 0){
+        wheel_arm(next);
     }
-    return(GOOD);
 }
 
 static int
-destroy_timers_event_socket()
+process_timer_expiration(sock_t *sl)
 {
-    struct sigaction sa;
-
-    memset(&sa, 0, sizeof(sa));
-    sa.sa_handler = NULL;
-    sa.sa_flags = 0;
-    sigemptyset(&sa.sa_mask);
+    uint64_t expirations;
 
-    if (sigaction(SIGRTMIN, &sa, NULL) == -1) {
-        OOR_LOG(LERR, "destroy_timers_event_socket: sigaction() failed %s",
-                strerror(errno));
+    if (read(sl->fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        if (errno != EAGAIN) {
+            OOR_LOG(LWRN, "process_timer_expiration(): nothing to read");
+        }
+        return(-1);
     }
 
-    close(signal_pipe[0]);
-    close(signal_pipe[1]);
-    return(GOOD);
+    handle_timers();
+    return(0);
 }
 
 void
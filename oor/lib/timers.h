@@ -24,6 +24,9 @@
 
 typedef enum {
     EXPIRE_MAP_CACHE_TIMER,
+    REFRESH_MAP_CACHE_TIMER,
+    MAP_CACHE_SNAPSHOT_TIMER,
+    MAP_CACHE_EVICT_TIMER,
     MAP_REGISTER_TIMER,
     ENCAP_MAP_REGISTER_TIMER,
     MAP_REQUEST_RETRY_TIMER,
@@ -35,7 +38,9 @@ typedef enum {
     RE_ITR_RESOLUTION_TIMER,
     REG_SITE_EXPRY_TIMER,
     RTR_NAT_LOCT_EXPIRE_TIMER,
-    RTR_NAT_MAP_REG_NOTIFY_TIMER
+    RTR_NAT_MAP_REG_NOTIFY_TIMER,
+    FLOW_AGING_TIMER,
+    PENDING_PKTS_TIMER
 } timer_type;
 
 #define TIMER_NAME_LEN          64
@@ -51,8 +56,7 @@ typedef void (*oor_timer_del_cb_arg_fn)(void *arg);
 
 typedef struct oor_timer {
     oor_timer_links_t links;
-    int duration;
-    int rotation_count;
+    uint64_t expires;   /* Monotonic time of expiration in ms */
     oor_timer_callback_t cb; /* Callback function used  when timer is triggered*/
     oor_timer_del_cb_arg_fn del_arg_fn; /* Function to delete the argument*/
     void *cb_argument;  /* Arguments passed to the callback function*/
@@ -71,6 +75,7 @@ void oor_timer_init(oor_timer_t *new_timer, void *owner, oor_timer_callback_t cb
         void *arg, oor_timer_del_cb_arg_fn del_arg_fn, void *nonces_lst);
 
 void oor_timer_start(oor_timer_t *, int);
+void oor_timer_start_ms(oor_timer_t *, uint32_t);
 
 void oor_timer_stop(oor_timer_t *);
 
@@ -253,6 +253,77 @@ err:
     return(BAD);
 }
 
+/* Length of the address field at 'ptr' without parsing the address. Returns
+ * 0 if the AFI is not known or the field doesn't fit in 'max' bytes */
+static int
+lisp_msg_addr_field_len(uint8_t *ptr, int max)
+{
+    int len;
+
+    if (max < (int)sizeof(uint16_t)) {
+        return(0);
+    }
+
+    switch (ntohs(*(uint16_t *)ptr)) {
+    case LISP_AFI_NO_ADDR:
+        len = sizeof(uint16_t);
+        break;
+    case LISP_AFI_IP:
+        len = sizeof(uint16_t) + sizeof(struct in_addr);
+        break;
+    case LISP_AFI_IPV6:
+        len = sizeof(uint16_t) + sizeof(struct in6_addr);
+        break;
+    case LISP_AFI_LCAF:
+        if (max < (int)sizeof(lcaf_hdr_t)) {
+            return(0);
+        }
+        len = sizeof(lcaf_hdr_t) + ntohs(LCAF_CAST(ptr)->len);
+        break;
+    default:
+        return(0);
+    }
+
+    return(len <= max ? len : 0);
+}
+
+/* Length of the mapping record at the data pointer of 'b', found by walking
+ * the address fields without building the EID and the locators. Returns 0
+ * if the record is truncated or uses an unknown AFI */
+int
+lisp_msg_mapping_record_len(lbuf_t *b)
+{
+    uint8_t *ptr = lbuf_data(b);
+    int max = lbuf_size(b);
+    int i, len, rec_len;
+    void *mrec_hdr = ptr;
+
+    if (max < (int)sizeof(mapping_record_hdr_t)) {
+        return(0);
+    }
+    rec_len = sizeof(mapping_record_hdr_t);
+
+    len = lisp_msg_addr_field_len(ptr + rec_len, max - rec_len);
+    if (len == 0) {
+        return(0);
+    }
+    rec_len += len;
+
+    for (i = 0; i < MAP_REC_LOC_COUNT(mrec_hdr); i++) {
+        rec_len += sizeof(locator_hdr_t);
+        if (rec_len > max) {
+            return(0);
+        }
+        len = lisp_msg_addr_field_len(ptr + rec_len, max - rec_len);
+        if (len == 0) {
+            return(0);
+        }
+        rec_len += len;
+    }
+
+    return(rec_len);
+}
+
 int
 lisp_msg_parse_inf_req_eid_ttl(lbuf_t *b, lisp_addr_t *eid, int *ttl)
 {
@@ -409,6 +480,15 @@ lisp_msg_put_mapping(
     return(rec);
 }
 
+/* Appends an already encoded mapping record of 'len' bytes */
+void *
+lisp_msg_put_mapping_rec(lbuf_t *b, uint8_t *rec, int len)
+{
+    void *hdr = lbuf_put(b, rec, len);
+    increment_record_count(b);
+    return(hdr);
+}
+
 void *
 lisp_msg_put_neg_mapping(lbuf_t *b, lisp_addr_t *eid, int ttl,
         lisp_action_e act, lisp_authoritative_e a)
@@ -728,7 +808,7 @@ lisp_ecm_auth_type(lbuf_t *b)
 }
 
 int
-lisp_msg_fill_rtr_auth_data(lbuf_t *b, void *rtr_auth_hdr, lisp_key_type_e keyid, const char *key)
+lisp_msg_fill_rtr_auth_data(lbuf_t *b, void *rtr_auth_hdr, lisp_key_type_e keyid, hmac_key_t *key)
 {
     void *auth_record_hdr = RTR_AUTH_REC(rtr_auth_hdr);
     lbuf_t buff = *b;
@@ -738,7 +818,7 @@ lisp_msg_fill_rtr_auth_data(lbuf_t *b, void *rtr_auth_hdr, lisp_key_type_e keyid
 }
 
 int
-lisp_msg_check_rtr_auth_data(lbuf_t *b, void *rtr_auth_hdr, const char *key)
+lisp_msg_check_rtr_auth_data(lbuf_t *b, void *rtr_auth_hdr, hmac_key_t *key)
 {
     void *auth_record_hdr = RTR_AUTH_REC(rtr_auth_hdr);
     lbuf_t buff = *b;
@@ -774,7 +854,7 @@ lisp_msg_pull_rtr_auth_field(lbuf_t *b)
 /*************************** Auth Record *************************************/
 
 int
-lisp_msg_fill_auth_data(lbuf_t *b, void *auth_record_hdr, lisp_key_type_e keyid, const char *key)
+lisp_msg_fill_auth_data(lbuf_t *b, void *auth_record_hdr, lisp_key_type_e keyid, hmac_key_t *key)
 {
     AUTH_REC_KEY_ID(auth_record_hdr) = htons(keyid);
     AUTH_REC_DATA_LEN(auth_record_hdr) = htons(auth_data_get_len_for_type(keyid));
@@ -792,7 +872,7 @@ lisp_msg_fill_auth_data(lbuf_t *b, void *auth_record_hdr, lisp_key_type_e keyid,
 
 /* Checks auth field of Map-Register, Map-Notify and Info-Reply messages */
 int
-lisp_msg_check_auth_field(lbuf_t *b, void *auth_record_hdr, const char *key)
+lisp_msg_check_auth_field(lbuf_t *b, void *auth_record_hdr, hmac_key_t *key)
 {
     lisp_key_type_e keyid;
     uint16_t        ad_len  = 0;
@@ -903,6 +983,19 @@ lisp_data_encap(lbuf_t *b, int lp, int rp, lisp_addr_t *la, lisp_addr_t *ra, uin
     return(lbuf_data(b));
 }
 
+/* Prebuild the outer headers used to encapsulate the packets sent from RLOC
+ * 'la' to RLOC 'ra'. See pkt_push_hdr_tmpl */
+int
+lisp_data_hdr_tmpl_init(pkt_hdr_tmpl_t *tmpl, int lp, int rp, lisp_addr_t *la,
+        lisp_addr_t *ra, uint32_t iid, uint8_t udp_csum)
+{
+    lisp_data_hdr_t lhdr;
+
+    lisp_data_hdr_init(&lhdr, iid);
+    return(pkt_hdr_tmpl_init(tmpl, lp, rp, lisp_addr_ip(la), lisp_addr_ip(ra),
+            &lhdr, sizeof(lisp_data_hdr_t), udp_csum));
+}
+
 void *
 lisp_data_pull_hdr(lbuf_t *b)
 {
@@ -26,7 +26,9 @@
 #include "lisp_messages.h"
 #include "lisp_data.h"
 #include "../lib/generic_list.h"
+#include "../lib/hmac.h"
 #include "../lib/lbuf.h"
+#include "../lib/packets.h"
 
 
 #define LISP_DATA_HDR_LEN       8
@@ -46,6 +48,7 @@ int lisp_msg_parse_loc(lbuf_t *, locator_t *);
 int lisp_msg_parse_mapping_record_split(lbuf_t *, lisp_addr_t *, glist_t *,
                                         locator_t **);
 int lisp_msg_parse_mapping_record(lbuf_t *, mapping_t *, locator_t **);
+int lisp_msg_mapping_record_len(lbuf_t *);
 int lisp_msg_parse_inf_req_eid_ttl(lbuf_t *b, lisp_addr_t *eid, int *ttl);
 int lisp_msg_parse_xtr_id_site_id (lbuf_t *b, lisp_xtr_id *xtr_id,
         lisp_site_id *site_id);
@@ -57,6 +60,7 @@ void *lisp_msg_put_addr(lbuf_t *, lisp_addr_t *);
 void *lisp_msg_put_locator(lbuf_t *, locator_t *);
 void *lisp_msg_put_mapping_hdr(lbuf_t *) ;
 void *lisp_msg_put_mapping(lbuf_t *, mapping_t *, lisp_addr_t *);
+void *lisp_msg_put_mapping_rec(lbuf_t *, uint8_t *, int);
 void *lisp_msg_put_neg_mapping(lbuf_t *, lisp_addr_t *, int, lisp_action_e,
         lisp_authoritative_e a);
 void *lisp_msg_put_itr_rlocs(lbuf_t *, glist_t *);
@@ -82,14 +86,14 @@ char *lisp_msg_hdr_to_char(lbuf_t *b);
 char *lisp_msg_ecm_hdr_to_char(lbuf_t *b);
 /************************ ECM Auth header ************************************/
 ecm_auth_data_type lisp_ecm_auth_type(lbuf_t *b);
-int lisp_msg_fill_rtr_auth_data(lbuf_t *b, void *rtr_auth_hdr, lisp_key_type_e keyid, const char *key);
-int lisp_msg_check_rtr_auth_data(lbuf_t *b, void *rtr_auth_hdr, const char *key);
+int lisp_msg_fill_rtr_auth_data(lbuf_t *b, void *rtr_auth_hdr, lisp_key_type_e keyid, hmac_key_t *key);
+int lisp_msg_check_rtr_auth_data(lbuf_t *b, void *rtr_auth_hdr, hmac_key_t *key);
 void *lisp_msg_push_empty_rtr_auth_data(lbuf_t *b, lisp_key_type_e keyid);
 void *lisp_msg_pull_rtr_auth_field(lbuf_t *b);
 /*************************** Auth Record *************************************/
 int lisp_msg_fill_auth_data(lbuf_t *b, void *auth_record_hdr, lisp_key_type_e keyid,
-        const char *key);
-int lisp_msg_check_auth_field(lbuf_t *b, void *auth_record_hdr, const char *key);
+        hmac_key_t *key);
+int lisp_msg_check_auth_field(lbuf_t *b, void *auth_record_hdr, hmac_key_t *key);
 void *lisp_msg_put_empty_auth_record(lbuf_t *, lisp_key_type_e);
 void *lisp_msg_push_empty_auth_record(lbuf_t *b, lisp_key_type_e keyid);
 void *lisp_msg_put_inf_req_hdr_2(lbuf_t *b, lisp_addr_t *eid_pref, uint8_t ttl);
@@ -100,6 +104,8 @@ void *lisp_msg_pull_auth_field(lbuf_t *b);
 void *lisp_data_push_hdr(lbuf_t *b, uint32_t iid);
 void *lisp_data_pull_hdr(lbuf_t *b);
 void *lisp_data_encap(lbuf_t *, int, int, lisp_addr_t *, lisp_addr_t *, uint32_t);
+int lisp_data_hdr_tmpl_init(pkt_hdr_tmpl_t *tmpl, int lp, int rp, lisp_addr_t *la,
+        lisp_addr_t *ra, uint32_t iid, uint8_t udp_csum);
 
 static inline glist_t *laddr_list_new();
 static inline void laddr_list_init(glist_t *);
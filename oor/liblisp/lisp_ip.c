@@ -266,8 +266,8 @@ ip_prefix_copy(ip_prefix_t *dst, ip_prefix_t *src)
 char *
 ip_prefix_to_char(ip_prefix_t *pref)
 {
-    static char address[10][INET6_ADDRSTRLEN+5];
-    static unsigned int i;
+    static THREAD_LOCAL char address[10][INET6_ADDRSTRLEN+5];
+    static THREAD_LOCAL unsigned int i;
 
     /* Hack to allow more than one addresses per printf line.
      * Now maximum = 5 */
@@ -348,8 +348,8 @@ ip_prefix_from_char(char *addr, ip_prefix_t *ippref)
 char *
 ip_to_char(void *ip, int afi)
 {
-    static char address[10][INET6_ADDRSTRLEN+1];
-    static unsigned int i;
+    static THREAD_LOCAL char address[10][INET6_ADDRSTRLEN+1];
+    static THREAD_LOCAL unsigned int i;
     i++; i = i % 10;
     *address[i] = '\0';
     switch (afi) {
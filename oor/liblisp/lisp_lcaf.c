@@ -606,8 +606,8 @@ mc_type_get_grp_plen(mc_t *mc)
 char *
 mc_type_to_char(void *mc)
 {
-    static char buf[10][INET6_ADDRSTRLEN*2+4];
-    static unsigned int i   = 0;
+    static THREAD_LOCAL char buf[10][INET6_ADDRSTRLEN*2+4];
+    static THREAD_LOCAL unsigned int i   = 0;
 
     i++;
     i = i % 10;
@@ -857,8 +857,8 @@ iid_type_parse(uint8_t *offset, void **iid)
 char *
 iid_type_to_char(void *iid)
 {
-    static char buf[10][INET6_ADDRSTRLEN*2+4];
-    static unsigned int i   = 0;
+    static THREAD_LOCAL char buf[10][INET6_ADDRSTRLEN*2+4];
+    static THREAD_LOCAL unsigned int i   = 0;
 
     i++;
     i = i % 10;
@@ -1057,8 +1057,8 @@ geo_type_get_addr(geo_t *geo)
 char *
 geo_type_to_char(void *geo)
 {
-    static char buf[10][INET6_ADDRSTRLEN*2+4];
-    static unsigned int i   = 0;
+    static THREAD_LOCAL char buf[10][INET6_ADDRSTRLEN*2+4];
+    static THREAD_LOCAL unsigned int i   = 0;
 
     i++;
     i = i % 10;
@@ -1074,7 +1074,7 @@ geo_type_to_char(void *geo)
 char *
 geo_coord_to_char(geo_coordinates *coord)
 {
-    static char buf[INET6_ADDRSTRLEN*2+4];
+    static THREAD_LOCAL char buf[INET6_ADDRSTRLEN*2+4];
     *buf= '\0';
     snprintf(buf,sizeof(buf), "dir %d deg %d min %d sec %d",
             coord->dir, coord->deg, coord->min, coord->sec);
@@ -1363,9 +1363,9 @@ err:
 char *
 nat_type_to_char(void *nat)
 {
-    static char buf[5][500];
+    static THREAD_LOCAL char buf[5][500];
     size_t buf_size = sizeof(buf[0]);
-    static unsigned int i = 0;
+    static THREAD_LOCAL unsigned int i = 0;
     nat_t *nat_addr = (nat_t *)nat;
     int j = 0;
     glist_entry_t * it_rtr;
@@ -1603,9 +1603,9 @@ err:
 char *
 elp_type_to_char(void *elp)
 {
-    static char buf[5][500];
+    static THREAD_LOCAL char buf[5][500];
     size_t buf_size = sizeof(buf[0]);
-    static unsigned int i = 0;
+    static THREAD_LOCAL unsigned int i = 0;
     int j = 0;
     glist_entry_t * it = NULL;
     elp_node_t * node = NULL;
@@ -1878,9 +1878,9 @@ rle_type_get_size_to_write(void *rle)
 char *
 rle_type_to_char(void *rle)
 {
-    static char buf[3][500];
+    static THREAD_LOCAL char buf[3][500];
     size_t buf_size = sizeof(buf[0]);
-    static unsigned int i = 0;
+    static THREAD_LOCAL unsigned int i = 0;
     int j = 0;
     glist_entry_t * it = NULL;
     rle_node_t * node = NULL;
@@ -2085,9 +2085,9 @@ afi_list_type_to_char(void *afil)
 {
     lisp_addr_t * addr = NULL;
     glist_entry_t * it = NULL;
-    static char buf[3][500];
+    static THREAD_LOCAL char buf[3][500];
     size_t buf_size = sizeof(buf[0]);
-    static int i = 0;
+    static THREAD_LOCAL int i = 0;
     int j = 0;
 
     i++;
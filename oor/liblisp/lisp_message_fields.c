@@ -115,6 +115,8 @@ auth_data_get_len_for_type(lisp_key_type_e key_id)
         return (0);
     case (HMAC_SHA_1_96):
         return (LISP_SHA1_AUTH_DATA_LEN);
+    case (HMAC_SHA_256_128):
+        return (LISP_SHA256_AUTH_DATA_LEN);
     default:
         return (LISP_SHA1_AUTH_DATA_LEN);
     }
@@ -529,6 +529,7 @@ typedef enum lisp_key_type {
 } lisp_key_type_e;
 
 #define LISP_SHA1_AUTH_DATA_LEN         20
+#define LISP_SHA256_AUTH_DATA_LEN       32
 
 uint16_t auth_data_get_len_for_type(lisp_key_type_e key_id);
 
@@ -434,20 +434,14 @@ main(int argc, char **argv)
     OOR_LOG(LINF,"\n\n Open Overlay Router (%s): started... \n\n",OOR_VERSION);
 
 #if !defined(ANDROID) && !defined(OPENWRT)
-    /* Initialize API for external access */
+    /* Initialize API for external access. Requests are processed from the
+     * socket master */
     oor_api_init_server(&oor_api_connection);
+#endif
 
     for (;;) {
-        sockmstr_wait_on_all_read(smaster);
-        sockmstr_process_all(smaster);
-        oor_api_loop(&oor_api_connection);
-    }
-#else
-    for (;;) {
-        sockmstr_wait_on_all_read(smaster);
         sockmstr_process_all(smaster);
     }
-#endif
 
     /* event_loop returned: bad! */
     OOR_LOG(LINF, "Exiting...");
@@ -526,7 +520,6 @@ JNIEXPORT void JNICALL Java_org_openoverlayrouter_noroot_OOR_1JNI_oor_1loop(JNIE
 
     /* EVENT LOOP */
     while (oor_running) {
-        sockmstr_wait_on_all_read(smaster);
         sockmstr_process_all(smaster);
     }
     /* event_loop returned: bad! */